@@ -0,0 +1,391 @@
+-- ADAPTIVE SAMPLING ESTIMATOR
+
+-- adaptive_estimator data type (shell type)
+CREATE TYPE adaptive_estimator;
+
+-- get estimator size for the requested error rate / number of distinct items
+CREATE FUNCTION adaptive_size(error_rate real, ndistinct int) RETURNS int
+     AS '$libdir/adaptive_counter', 'adaptive_size'
+     LANGUAGE C;
+
+-- creates a new adaptive estimator with a given error / number of distinct items
+CREATE FUNCTION adaptive_init(error_rate real, ndistinct int) RETURNS adaptive_estimator
+     AS '$libdir/adaptive_counter', 'adaptive_init'
+     LANGUAGE C;
+
+-- merges the two estimators, creates a new one
+CREATE FUNCTION adaptive_merge(estimator1 adaptive_estimator, estimator2 adaptive_estimator) RETURNS adaptive_estimator
+     AS '$libdir/adaptive_counter', 'adaptive_merge_simple'
+     LANGUAGE C;
+
+-- merges the second estimator into the first one
+CREATE FUNCTION adaptive_merge_agg(estimator1 adaptive_estimator, estimator2 adaptive_estimator) RETURNS adaptive_estimator
+     AS '$libdir/adaptive_counter', 'adaptive_merge_agg'
+     LANGUAGE C;
+
+-- add an item to the estimator
+CREATE FUNCTION adaptive_add_item(counter adaptive_estimator, item anyelement) RETURNS void
+     AS '$libdir/adaptive_counter', 'adaptive_add_item'
+     LANGUAGE C;
+
+-- get error rate used when creating the estimator (as a real number)
+CREATE FUNCTION adaptive_get_error(counter adaptive_estimator) RETURNS real
+     AS '$libdir/adaptive_counter', 'adaptive_get_error'
+     LANGUAGE C STRICT;
+
+-- get expected number of distinct values used when creating the estimator (as integer)
+CREATE FUNCTION adaptive_get_ndistinct(counter adaptive_estimator) RETURNS int
+     AS '$libdir/adaptive_counter', 'adaptive_get_ndistinct'
+     LANGUAGE C STRICT;
+
+-- get number of distinct values used when creating the estimator (int)
+CREATE FUNCTION adaptive_get_item_size(counter adaptive_estimator) RETURNS int
+     AS '$libdir/adaptive_counter', 'adaptive_get_item_size'
+     LANGUAGE C STRICT;
+
+-- reset the estimator (start counting from the beginning)
+CREATE FUNCTION adaptive_reset(counter adaptive_estimator) RETURNS void
+     AS '$libdir/adaptive_counter', 'adaptive_reset'
+     LANGUAGE C STRICT;
+
+-- length of the estimator (about the same as adaptive_size with existing estimator)
+CREATE FUNCTION length(counter adaptive_estimator) RETURNS int
+     AS '$libdir/adaptive_counter', 'adaptive_length'
+     LANGUAGE C STRICT;
+
+-- get current estimate of the distinct values (as a real number)
+CREATE FUNCTION adaptive_get_estimate(counter adaptive_estimator) RETURNS real
+     AS '$libdir/adaptive_counter', 'adaptive_get_estimate'
+     LANGUAGE C STRICT;
+
+/* functions for the aggregates */
+CREATE FUNCTION adaptive_add_item_agg(counter adaptive_estimator, item anyelement, error_rate real, ndistinct int) RETURNS adaptive_estimator
+     AS '$libdir/adaptive_counter', 'adaptive_add_item_agg'
+     LANGUAGE C;
+
+CREATE FUNCTION adaptive_add_item_agg2(counter adaptive_estimator, item anyelement) RETURNS adaptive_estimator
+     AS '$libdir/adaptive_counter', 'adaptive_add_item_agg2'
+     LANGUAGE C;
+
+/* input / output functions */
+CREATE FUNCTION adaptive_in(value cstring) RETURNS adaptive_estimator
+     AS '$libdir/adaptive_counter', 'adaptive_in'
+     LANGUAGE C IMMUTABLE STRICT;
+
+CREATE FUNCTION adaptive_out(counter adaptive_estimator) RETURNS cstring
+     AS '$libdir/adaptive_counter', 'adaptive_out'
+     LANGUAGE C IMMUTABLE STRICT;
+
+-- data type for the adaptive-sampling based distinct estimator
+CREATE TYPE adaptive_estimator (
+    INPUT = adaptive_in,
+    OUTPUT = adaptive_out,
+    LIKE  = bytea
+);
+
+-- adaptive based aggregate (item, error rate, ndistinct)
+CREATE AGGREGATE adaptive_distinct(anyelement, real, int)
+(
+    sfunc = adaptive_add_item_agg,
+    stype = adaptive_estimator,
+    finalfunc = adaptive_get_estimate,
+    finalfunc_modify = read_only
+);
+
+-- adaptive based aggregate (item)
+CREATE AGGREGATE adaptive_distinct(anyelement)
+(
+    sfunc = adaptive_add_item_agg2,
+    stype = adaptive_estimator,
+    finalfunc = adaptive_get_estimate,
+    finalfunc_modify = read_only
+);
+
+-- build the counter(s), but does not perform the final estimation (i.e. can be used to pre-aggregate data)
+-- parameters: item, error_rate, ndistinct
+CREATE AGGREGATE adaptive_accum(anyelement, real, int)
+(
+    sfunc = adaptive_add_item_agg,
+    stype = adaptive_estimator
+);
+
+-- parameters: item
+CREATE AGGREGATE adaptive_accum(anyelement)
+(
+    sfunc = adaptive_add_item_agg2,
+    stype = adaptive_estimator
+);
+
+-- merges all the counters into just a single one (e.g. after running adaptive_accum)
+-- parameters: estimator
+CREATE AGGREGATE adaptive_merge(adaptive_estimator)
+(
+    sfunc = adaptive_merge_agg,
+    stype = adaptive_estimator
+);
+
+-- evaluates the estimate (for an estimator)
+CREATE OPERATOR # (
+    PROCEDURE = adaptive_get_estimate,
+    RIGHTARG = adaptive_estimator
+);
+
+-- merges two estimators into a new one
+CREATE OPERATOR || (
+    PROCEDURE = adaptive_merge,
+    LEFTARG  = adaptive_estimator,
+    RIGHTARG = adaptive_estimator,
+    COMMUTATOR = ||
+);
+
+-- pre-hashed values (bytea with at least 16 bytes, or bigint)
+
+CREATE FUNCTION adaptive_add_hash(counter adaptive_estimator, hash bytea) RETURNS void
+     AS '$libdir/adaptive_counter', 'adaptive_add_hashed'
+     LANGUAGE C;
+
+CREATE FUNCTION adaptive_add_hash(counter adaptive_estimator, hash bigint) RETURNS void
+     AS '$libdir/adaptive_counter', 'adaptive_add_hashed'
+     LANGUAGE C;
+
+CREATE FUNCTION adaptive_add_hashed_agg(counter adaptive_estimator, hash bytea, error_rate real, ndistinct int) RETURNS adaptive_estimator
+     AS '$libdir/adaptive_counter', 'adaptive_add_hashed_agg'
+     LANGUAGE C;
+
+CREATE FUNCTION adaptive_add_hashed_agg(counter adaptive_estimator, hash bigint, error_rate real, ndistinct int) RETURNS adaptive_estimator
+     AS '$libdir/adaptive_counter', 'adaptive_add_hashed_agg'
+     LANGUAGE C;
+
+CREATE FUNCTION adaptive_add_hashed_agg2(counter adaptive_estimator, hash bytea) RETURNS adaptive_estimator
+     AS '$libdir/adaptive_counter', 'adaptive_add_hashed_agg2'
+     LANGUAGE C;
+
+CREATE FUNCTION adaptive_add_hashed_agg2(counter adaptive_estimator, hash bigint) RETURNS adaptive_estimator
+     AS '$libdir/adaptive_counter', 'adaptive_add_hashed_agg2'
+     LANGUAGE C;
+
+CREATE AGGREGATE adaptive_distinct_hashed(bytea, real, int)
+(
+    sfunc = adaptive_add_hashed_agg,
+    stype = adaptive_estimator,
+    finalfunc = adaptive_get_estimate,
+    finalfunc_modify = read_only
+);
+
+CREATE AGGREGATE adaptive_distinct_hashed(bytea)
+(
+    sfunc = adaptive_add_hashed_agg2,
+    stype = adaptive_estimator,
+    finalfunc = adaptive_get_estimate,
+    finalfunc_modify = read_only
+);
+
+CREATE AGGREGATE adaptive_accum_hashed(bytea, real, int)
+(
+    sfunc = adaptive_add_hashed_agg,
+    stype = adaptive_estimator
+);
+
+CREATE AGGREGATE adaptive_accum_hashed(bytea)
+(
+    sfunc = adaptive_add_hashed_agg2,
+    stype = adaptive_estimator
+);
+
+CREATE AGGREGATE adaptive_distinct_hashed(bigint, real, int)
+(
+    sfunc = adaptive_add_hashed_agg,
+    stype = adaptive_estimator,
+    finalfunc = adaptive_get_estimate,
+    finalfunc_modify = read_only
+);
+
+CREATE AGGREGATE adaptive_distinct_hashed(bigint)
+(
+    sfunc = adaptive_add_hashed_agg2,
+    stype = adaptive_estimator,
+    finalfunc = adaptive_get_estimate,
+    finalfunc_modify = read_only
+);
+
+CREATE AGGREGATE adaptive_accum_hashed(bigint, real, int)
+(
+    sfunc = adaptive_add_hashed_agg,
+    stype = adaptive_estimator
+);
+
+CREATE AGGREGATE adaptive_accum_hashed(bigint)
+(
+    sfunc = adaptive_add_hashed_agg2,
+    stype = adaptive_estimator
+);
+
+-- multi-column keys, e.g. adaptive_distinct_multi(user_id, device_id) (keys with any NULL value are skipped)
+CREATE FUNCTION adaptive_add_item_multi(counter adaptive_estimator, VARIADIC items "any") RETURNS void
+     AS '$libdir/adaptive_counter', 'adaptive_add_item_multi'
+     LANGUAGE C;
+
+CREATE FUNCTION adaptive_add_item_multi_agg(counter adaptive_estimator, VARIADIC items "any") RETURNS adaptive_estimator
+     AS '$libdir/adaptive_counter', 'adaptive_add_item_multi_agg'
+     LANGUAGE C PARALLEL SAFE;
+
+CREATE AGGREGATE adaptive_distinct_multi(VARIADIC "any")
+(
+    sfunc = adaptive_add_item_multi_agg,
+    stype = adaptive_estimator,
+    finalfunc = adaptive_get_estimate,
+    finalfunc_modify = read_only
+);
+
+CREATE AGGREGATE adaptive_accum_multi(VARIADIC "any")
+(
+    sfunc = adaptive_add_item_multi_agg,
+    stype = adaptive_estimator
+);
+
+-- adaptive_distinct for smallint, integer, bigint and uuid values (without md5)
+CREATE FUNCTION adaptive_add_int2_agg(counter adaptive_estimator, item smallint, error_rate real, ndistinct int) RETURNS adaptive_estimator
+     AS '$libdir/adaptive_counter', 'adaptive_add_int2_agg'
+     LANGUAGE C PARALLEL SAFE;
+
+CREATE FUNCTION adaptive_add_int2_agg(counter adaptive_estimator, item smallint) RETURNS adaptive_estimator
+     AS '$libdir/adaptive_counter', 'adaptive_add_int2_agg'
+     LANGUAGE C PARALLEL SAFE;
+
+CREATE FUNCTION adaptive_add_int4_agg(counter adaptive_estimator, item integer, error_rate real, ndistinct int) RETURNS adaptive_estimator
+     AS '$libdir/adaptive_counter', 'adaptive_add_int4_agg'
+     LANGUAGE C PARALLEL SAFE;
+
+CREATE FUNCTION adaptive_add_int4_agg(counter adaptive_estimator, item integer) RETURNS adaptive_estimator
+     AS '$libdir/adaptive_counter', 'adaptive_add_int4_agg'
+     LANGUAGE C PARALLEL SAFE;
+
+CREATE FUNCTION adaptive_add_int8_agg(counter adaptive_estimator, item bigint, error_rate real, ndistinct int) RETURNS adaptive_estimator
+     AS '$libdir/adaptive_counter', 'adaptive_add_int8_agg'
+     LANGUAGE C PARALLEL SAFE;
+
+CREATE FUNCTION adaptive_add_int8_agg(counter adaptive_estimator, item bigint) RETURNS adaptive_estimator
+     AS '$libdir/adaptive_counter', 'adaptive_add_int8_agg'
+     LANGUAGE C PARALLEL SAFE;
+
+CREATE FUNCTION adaptive_add_uuid_agg(counter adaptive_estimator, item uuid, error_rate real, ndistinct int) RETURNS adaptive_estimator
+     AS '$libdir/adaptive_counter', 'adaptive_add_uuid_agg'
+     LANGUAGE C PARALLEL SAFE;
+
+CREATE FUNCTION adaptive_add_uuid_agg(counter adaptive_estimator, item uuid) RETURNS adaptive_estimator
+     AS '$libdir/adaptive_counter', 'adaptive_add_uuid_agg'
+     LANGUAGE C PARALLEL SAFE;
+
+CREATE AGGREGATE adaptive_distinct(smallint, real, int)
+(
+    sfunc = adaptive_add_int2_agg,
+    stype = adaptive_estimator,
+    finalfunc = adaptive_get_estimate,
+    finalfunc_modify = read_only
+);
+
+CREATE AGGREGATE adaptive_distinct(smallint)
+(
+    sfunc = adaptive_add_int2_agg,
+    stype = adaptive_estimator,
+    finalfunc = adaptive_get_estimate,
+    finalfunc_modify = read_only
+);
+
+CREATE AGGREGATE adaptive_distinct(integer, real, int)
+(
+    sfunc = adaptive_add_int4_agg,
+    stype = adaptive_estimator,
+    finalfunc = adaptive_get_estimate,
+    finalfunc_modify = read_only
+);
+
+CREATE AGGREGATE adaptive_distinct(integer)
+(
+    sfunc = adaptive_add_int4_agg,
+    stype = adaptive_estimator,
+    finalfunc = adaptive_get_estimate,
+    finalfunc_modify = read_only
+);
+
+CREATE AGGREGATE adaptive_distinct(bigint, real, int)
+(
+    sfunc = adaptive_add_int8_agg,
+    stype = adaptive_estimator,
+    finalfunc = adaptive_get_estimate,
+    finalfunc_modify = read_only
+);
+
+CREATE AGGREGATE adaptive_distinct(bigint)
+(
+    sfunc = adaptive_add_int8_agg,
+    stype = adaptive_estimator,
+    finalfunc = adaptive_get_estimate,
+    finalfunc_modify = read_only
+);
+
+CREATE AGGREGATE adaptive_distinct(uuid, real, int)
+(
+    sfunc = adaptive_add_uuid_agg,
+    stype = adaptive_estimator,
+    finalfunc = adaptive_get_estimate,
+    finalfunc_modify = read_only
+);
+
+CREATE AGGREGATE adaptive_distinct(uuid)
+(
+    sfunc = adaptive_add_uuid_agg,
+    stype = adaptive_estimator,
+    finalfunc = adaptive_get_estimate,
+    finalfunc_modify = read_only
+);
+
+-- Instrumentation (collected only with adaptive.track_stats enabled, per backend)
+
+-- statistics of the estimators (times in milliseconds)
+CREATE FUNCTION adaptive_estimator_stats(OUT elements bigint, OUT hashes bigint, OUT updates bigint,
+                                         OUT splits bigint, OUT max_level integer,
+                                         OUT merges bigint, OUT allocated bigint,
+                                         OUT hash_time double precision, OUT update_time double precision)
+     AS '$libdir/adaptive_counter', 'adaptive_estimator_stats'
+     LANGUAGE C STRICT;
+
+-- reset the statistics collected in this backend
+CREATE FUNCTION adaptive_estimator_stats_reset() RETURNS void
+     AS '$libdir/adaptive_counter', 'adaptive_estimator_stats_reset'
+     LANGUAGE C;
+
+-- Incremental refresh of rollup tables
+
+-- watermarks of the rollups, i.e. the last value of the watermark column already merged into
+-- the rollup, for each (rollup, source) pair (as text, written with DateStyle ISO and TimeZone
+-- UTC, so that the session settings do not matter)
+CREATE TABLE adaptive_rollup_watermarks (
+    rollup_table    regclass NOT NULL,
+    source_table    regclass NOT NULL,
+    watermark       text,
+    PRIMARY KEY (rollup_table, source_table)
+);
+
+-- include the watermarks in dumps (only in CREATE EXTENSION, the script may be loaded directly)
+DO $$
+BEGIN
+    IF EXISTS (SELECT 1 FROM pg_depend
+                WHERE classid = 'pg_class'::regclass AND objid = 'adaptive_rollup_watermarks'::regclass
+                  AND deptype = 'e') THEN
+        PERFORM pg_catalog.pg_extension_config_dump('adaptive_rollup_watermarks', '');
+    END IF;
+END$$;
+
+-- Merges rows of the source table newer than the stored watermark into the rollup table, with
+-- an estimator of the item expression for each group. The rollup needs a unique index on the
+-- group columns, computed by group_exprs (expressions on the source table, the same names by
+-- default). The watermark column has to grow with the commits (rows committed later with a
+-- lower value are not counted). Returns the number of rollup rows inserted or updated.
+CREATE FUNCTION adaptive_rollup_refresh(rollup regclass, counter_column name, source regclass,
+                                        watermark_column name, item text, group_columns name[],
+                                        group_exprs text[] DEFAULT NULL, error_rate real DEFAULT 0.025,
+                                        ndistinct int DEFAULT 1000000)
+    RETURNS bigint
+    AS '$libdir/adaptive_counter', 'adaptive_rollup_refresh'
+    LANGUAGE C;
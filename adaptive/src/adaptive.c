@@ -8,7 +8,8 @@
 
 #define HASH_LENGTH 16
 
-#include "libpq/md5.h"
+#include "distinct_md5.h"
+#include "adaptive_probes.h"
 
 /* internal hash operations */
 void ac_hash_text(unsigned char * buffer, const char * element, int elen);
@@ -16,7 +17,9 @@ void ac_hash_int(unsigned char * buffer, int element);
 int  ac_hash_matches(const unsigned char * hash, int level);
 void ac_split(AdaptiveCounter ac);
 int  ac_in_list(AdaptiveCounter ac, unsigned char * hash);
-void ac_add_hash(AdaptiveCounter ac, unsigned char * hash);
+
+/* instrumentation (NULL unless enabled, see adaptive.h) */
+AdaptiveStats * adaptive_stats = NULL;
 
 /* allocate adaptive counter with a given error rate */
 AdaptiveCounter ac_init(float error, int ndistinct) {
@@ -81,6 +84,9 @@ AdaptiveCounter ac_init(float error, int ndistinct) {
     
     p->level = 0;
     p->items = 0;
+
+    if (adaptive_stats != NULL)
+        adaptive_stats->allocated += length;
     
     return p;
 
@@ -99,6 +105,9 @@ AdaptiveCounter ac_copy(AdaptiveCounter src) {
     
     memcpy(dest, src, VARSIZE(src));
 
+    if (adaptive_stats != NULL)
+        adaptive_stats->allocated += VARSIZE(src);
+
     return dest;
     
 }
@@ -106,7 +115,13 @@ AdaptiveCounter ac_copy(AdaptiveCounter src) {
 /* get the current estimate */
 int ac_estimate(AdaptiveCounter ac) {
     
-    int estimate = powf(2, ac->level) * ac->items;
+    int estimate;
+
+    ADAPTIVE_ESTIMATE_START(ac->level, ac->items);
+
+    estimate = powf(2, ac->level) * ac->items;
+
+    ADAPTIVE_ESTIMATE_DONE(ac->level, ac->items, estimate);
     
     return estimate;
   
@@ -115,14 +130,14 @@ int ac_estimate(AdaptiveCounter ac) {
 /* compute hash of the text element (and stores it in the buffer) */
 void ac_hash_text(unsigned char * buffer, const char * element, int elen) {
 
-    pg_md5_binary(element, elen, buffer);
+    distinct_md5(element, elen, buffer);
 
 }
 
 /* computes a hash of the int element (and stores it in the buffer) */
 void ac_hash_int(unsigned char * buffer, int element) {
 
-    pg_md5_binary(&element, sizeof(int), buffer);
+    distinct_md5(&element, sizeof(int), buffer);
 
 }
 
@@ -161,42 +176,52 @@ void ac_split(AdaptiveCounter ac) {
             ac->items, ac->maxItems
         );
     }
-    
-    /* check if we can split (when level reaches itemSize*8, we're can't split further) */
-    if (ac->itemSize*8 == ac->level) {
-        elog(ERROR, "The counter capacity is exhausted, can't split further (level = %d, item size = %d bits)",
-            ac->level, ac->itemSize*8
-        );
-    }
   
-    /* increment the level */
-    ac->level = ac->level + 1;
+    ADAPTIVE_SPLIT_START(ac->level, ac->items, ac->maxItems);
+
+    /* There's very small probability that the split does not remove any item (all items
+     * already match the new level) -> split again (in a loop, so that the probes fire
+     * only once for the whole split) */
+    do {
+
+        /* check if we can split (when level reaches itemSize*8, we're can't split further) */
+        if (ac->itemSize*8 == ac->level) {
+            elog(ERROR, "The counter capacity is exhausted, can't split further (level = %d, item size = %d bits)",
+                ac->level, ac->itemSize*8
+            );
+        }
+
+        /* increment the level */
+        ac->level = ac->level + 1;
+
+        if (adaptive_stats != NULL) {
+            adaptive_stats->splits++;
+            adaptive_stats->max_level = Max(adaptive_stats->max_level, ac->level);
+        }
   
-    /* remove the items that do not match the new level */
-    for (itemIdx = 0; itemIdx < ac->items; itemIdx++) {
+        /* remove the items that do not match the new level */
+        for (itemIdx = 0; itemIdx < ac->items; itemIdx++) {
     
-        /* if the hash does not matches the current level, find a replacement */
-        if (! ac_hash_matches(&(ac->bitmap[itemIdx*ac->itemSize]), ac->level)) {
+            /* if the hash does not matches the current level, find a replacement */
+            if (! ac_hash_matches(&(ac->bitmap[itemIdx*ac->itemSize]), ac->level)) {
         
-            /* look for the last matching item (reverse) */
-            while (! ac_hash_matches(&(ac->bitmap[(ac->items-1)*ac->itemSize]), ac->level)) {
-                ac->items = ac->items - 1;
-            }
+                /* look for the last matching item (reverse) */
+                while (! ac_hash_matches(&(ac->bitmap[(ac->items-1)*ac->itemSize]), ac->level)) {
+                    ac->items = ac->items - 1;
+                }
             
-            /* there is a matching item, so let's swap it */
-            if ((ac->items - 1) > itemIdx) {
-                memcpy(&(ac->bitmap[itemIdx*ac->itemSize]), &(ac->bitmap[(ac->items-1)*ac->itemSize]), ac->itemSize);
-                ac->items = ac->items - 1;
-            }
+                /* there is a matching item, so let's swap it */
+                if ((ac->items - 1) > itemIdx) {
+                    memcpy(&(ac->bitmap[itemIdx*ac->itemSize]), &(ac->bitmap[(ac->items-1)*ac->itemSize]), ac->itemSize);
+                    ac->items = ac->items - 1;
+                }
             
+            }
         }
-    }
-  
-    /* There's very small probability that the split does not remove any item (all items
-     * already match the new level) -> run the split again */
-    if (ac->items == ac->maxItems) {
-        ac_split(ac);
-    }
+
+    } while (ac->items == ac->maxItems);
+
+    ADAPTIVE_SPLIT_DONE(ac->level, ac->items);
   
 }
 
@@ -218,6 +243,9 @@ int ac_in_list(AdaptiveCounter ac, unsigned char * hash) {
 /* FIXME The split is executed after the insertion, not before it (as described in the
  * paper). Not sure if this may change the precision or something like that. */
 void ac_add_hash(AdaptiveCounter ac, unsigned char * hash) {
+
+    if (adaptive_stats != NULL)
+        adaptive_stats->hashes++;
   
     /* check if the hash matches the level or the item is already in the list */
     if ((! ac_hash_matches(hash, ac->level)) || (ac_in_list(ac, hash))) {
@@ -227,6 +255,9 @@ void ac_add_hash(AdaptiveCounter ac, unsigned char * hash) {
     /* add the hash into the list */
     memcpy(&(ac->bitmap[ac->items * ac->itemSize]), hash, ac->itemSize);
     ac->items += 1;
+
+    if (adaptive_stats != NULL)
+        adaptive_stats->updates++;
   
     /* check if the list is full - if yes, split (increment the level and remove items
      * that do not match the current state) */
@@ -244,11 +275,28 @@ void ac_add_item(AdaptiveCounter ac, const char * element, int elen) {
   
     /* get the hash */
     unsigned char hash[HASH_LENGTH];
-  
-    /* compute the hash */
+    instr_time start, hashed, end;
+
+    if (adaptive_stats == NULL) {
+
+        /* compute the hash */
+        ac_hash_text(hash, element, elen);
+
+        ac_add_hash(ac, hash);
+
+        return;
+    }
+
+    /* the same, but with instrumentation */
+    INSTR_TIME_SET_CURRENT(start);
     ac_hash_text(hash, element, elen);
-  
+    INSTR_TIME_SET_CURRENT(hashed);
     ac_add_hash(ac, hash);
+    INSTR_TIME_SET_CURRENT(end);
+
+    adaptive_stats->elements++;
+    INSTR_TIME_ACCUM_DIFF(adaptive_stats->hash_time, hashed, start);
+    INSTR_TIME_ACCUM_DIFF(adaptive_stats->update_time, end, hashed);
   
 }
 
@@ -298,6 +346,8 @@ AdaptiveCounter ac_merge(AdaptiveCounter dest, AdaptiveCounter src, bool inplace
             dest->itemSize, src->itemSize);
     }
 
+    ADAPTIVE_MERGE_START(dest->level, dest->items, src->level, src->items);
+
     /* allocate space for the destination counter (mergeable -> same size) */
     if (inplace)
         result = dest;
@@ -308,6 +358,11 @@ AdaptiveCounter ac_merge(AdaptiveCounter dest, AdaptiveCounter src, bool inplace
     for (i = 0; i < src->items; i++) {
         ac_add_hash(result, &(src->bitmap[i*src->itemSize]));
     }
+
+    if (adaptive_stats != NULL)
+        adaptive_stats->merges++;
+
+    ADAPTIVE_MERGE_DONE(result->level, result->items);
   
     return result;
   
@@ -1,6 +1,7 @@
 /* A header file for the AdaptiveCounter implementation. */
 
 #include "postgres.h"
+#include "portability/instr_time.h"
 
 /* This is an implementation of Adaptive Sampling algorithm presented in
  * paper "On Adaptive Sampling" published in 1990 (written by P. Flajolet).
@@ -51,6 +52,9 @@ AdaptiveCounter ac_copy(AdaptiveCounter src);
 /* add element into the counter */
 void ac_add_item(AdaptiveCounter ac, const char * element, int elen);
 
+/* add a hash (HASH_LENGTH bytes) directly, without hashing */
+void ac_add_hash(AdaptiveCounter ac, unsigned char * hash);
+
 /* print info about the counter */
 void ac_print_info(AdaptiveCounter ac);
 
@@ -59,3 +63,21 @@ int ac_estimate(AdaptiveCounter ac);
 
 /* merge two adaptive counters */
 AdaptiveCounter ac_merge(AdaptiveCounter dest, AdaptiveCounter src, bool inplace);
+
+/* Instrumentation of the counter (per backend), collected only while the
+ * adaptive_stats pointer is set - the SQL-facing part sets it when the
+ * adaptive.track_stats option is enabled, so by default the overhead is
+ * just a branch. */
+typedef struct AdaptiveStats {
+    int64       elements;       /* elements hashed (using md5) */
+    int64       hashes;         /* hashes added to counters (including merges) */
+    int64       updates;        /* hashes actually added to the list */
+    int64       splits;         /* splits (increments of the level) */
+    int32       max_level;      /* highest level reached by a split */
+    int64       merges;         /* counters merged */
+    int64       allocated;      /* bytes allocated for new counters */
+    instr_time  hash_time;      /* time spent hashing the elements */
+    instr_time  update_time;    /* time spent updating the list (including splits) */
+} AdaptiveStats;
+
+extern AdaptiveStats * adaptive_stats;
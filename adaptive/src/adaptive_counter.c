@@ -5,10 +5,18 @@
 
 #include "postgres.h"
 #include "fmgr.h"
+#include "funcapi.h"
+#include "access/htup_details.h"
+#include "catalog/pg_type.h"
 #include "adaptive.h"
+#include "distinct_hash.h"
+#include "distinct_multi.h"
+#include "distinct_rollup.h"
 #include "utils/builtins.h"
 #include "utils/bytea.h"
+#include "utils/guc.h"
 #include "utils/lsyscache.h"
+#include "utils/uuid.h"
 #include "lib/stringinfo.h"
 #include "libpq/pqformat.h"
 
@@ -16,18 +24,33 @@
 PG_MODULE_MAGIC;
 #endif
 
+void _PG_init(void);
+
 #define VAL(CH)			((CH) - '0')
 #define DIG(VAL)		((VAL) + '0')
 
+/* we're using md5, which produces 16B (128-bit) values */
+#define HASH_LENGTH 16
+
 #define DEFAULT_ERROR       0.025
 #define DEFAULT_NDISTINCT   1000000
 
 PG_FUNCTION_INFO_V1(adaptive_add_item);
 PG_FUNCTION_INFO_V1(adaptive_add_item_agg);
 PG_FUNCTION_INFO_V1(adaptive_add_item_agg2);
+PG_FUNCTION_INFO_V1(adaptive_add_hashed);
+PG_FUNCTION_INFO_V1(adaptive_add_hashed_agg);
+PG_FUNCTION_INFO_V1(adaptive_add_hashed_agg2);
+PG_FUNCTION_INFO_V1(adaptive_add_item_multi);
+PG_FUNCTION_INFO_V1(adaptive_add_item_multi_agg);
+PG_FUNCTION_INFO_V1(adaptive_add_int2_agg);
+PG_FUNCTION_INFO_V1(adaptive_add_int4_agg);
+PG_FUNCTION_INFO_V1(adaptive_add_int8_agg);
+PG_FUNCTION_INFO_V1(adaptive_add_uuid_agg);
 
 PG_FUNCTION_INFO_V1(adaptive_merge_simple);
 PG_FUNCTION_INFO_V1(adaptive_merge_agg);
+PG_FUNCTION_INFO_V1(adaptive_rollup_refresh);
 PG_FUNCTION_INFO_V1(adaptive_get_estimate);
 PG_FUNCTION_INFO_V1(adaptive_get_ndistinct);
 PG_FUNCTION_INFO_V1(adaptive_size);
@@ -41,12 +64,29 @@ PG_FUNCTION_INFO_V1(adaptive_rect);
 PG_FUNCTION_INFO_V1(adaptive_send);
 PG_FUNCTION_INFO_V1(adaptive_length);
 
+PG_FUNCTION_INFO_V1(adaptive_estimator_stats);
+PG_FUNCTION_INFO_V1(adaptive_estimator_stats_reset);
+
 Datum adaptive_add_item(PG_FUNCTION_ARGS);
 Datum adaptive_add_item_agg(PG_FUNCTION_ARGS);
 Datum adaptive_add_item_agg2(PG_FUNCTION_ARGS);
+Datum adaptive_add_hashed(PG_FUNCTION_ARGS);
+Datum adaptive_add_hashed_agg(PG_FUNCTION_ARGS);
+Datum adaptive_add_hashed_agg2(PG_FUNCTION_ARGS);
+Datum adaptive_add_item_multi(PG_FUNCTION_ARGS);
+Datum adaptive_add_item_multi_agg(PG_FUNCTION_ARGS);
+Datum adaptive_add_int2_agg(PG_FUNCTION_ARGS);
+Datum adaptive_add_int4_agg(PG_FUNCTION_ARGS);
+Datum adaptive_add_int8_agg(PG_FUNCTION_ARGS);
+Datum adaptive_add_uuid_agg(PG_FUNCTION_ARGS);
+
+static void adaptive_get_hash(FunctionCallInfo fcinfo, int argno, unsigned char * hash);
+static AdaptiveCounter adaptive_get_agg_counter(FunctionCallInfo fcinfo);
+static void adaptive_add_varlena(AdaptiveCounter acounter, Datum element);
 
 Datum adaptive_merge_simple(PG_FUNCTION_ARGS);
 Datum adaptive_merge_agg(PG_FUNCTION_ARGS);
+Datum adaptive_rollup_refresh(PG_FUNCTION_ARGS);
 Datum adaptive_get_estimate(PG_FUNCTION_ARGS);
 Datum adaptive_get_ndistinct(PG_FUNCTION_ARGS);
 Datum adaptive_size(PG_FUNCTION_ARGS);
@@ -60,6 +100,30 @@ Datum adaptive_recv(PG_FUNCTION_ARGS);
 Datum adaptive_send(PG_FUNCTION_ARGS);
 Datum adaptive_length(PG_FUNCTION_ARGS);
 
+Datum adaptive_estimator_stats(PG_FUNCTION_ARGS);
+Datum adaptive_estimator_stats_reset(PG_FUNCTION_ARGS);
+
+/* Instrumentation of the counters (see adaptive.h), collected only while the
+ * adaptive.track_stats option is enabled. The statistics are per backend, and
+ * do not include work done by parallel workers. */
+static bool adaptive_track_stats = false;
+static AdaptiveStats adaptive_stats_data;
+
+static void adaptive_track_stats_assign(bool newval, void *extra);
+
+/* module initialization (GUC options) */
+void
+_PG_init(void)
+{
+    DefineCustomBoolVariable("adaptive.track_stats",
+                             "Collect statistics about the adaptive estimators.",
+                             "See adaptive_estimator_stats().",
+                             &adaptive_track_stats,
+                             false,
+                             PGC_USERSET, 0,
+                             NULL, adaptive_track_stats_assign, NULL);
+}
+
 Datum
 adaptive_add_item(PG_FUNCTION_ARGS)
 {
@@ -91,7 +155,7 @@ adaptive_add_item(PG_FUNCTION_ARGS)
         /* it this a varlena type, passed by reference or by value ? */
         if (typlen == -1) {
             /* varlena */
-            ac_add_item(acounter, VARDATA(element), VARSIZE(element) - VARHDRSZ);
+            adaptive_add_varlena(acounter, element);
         } else if (typbyval) {
             /* fixed-length, passed by value */
             ac_add_item(acounter, (char*)&element, typlen);
@@ -153,7 +217,7 @@ adaptive_add_item_agg(PG_FUNCTION_ARGS)
         /* it this a varlena type, passed by reference or by value ? */
         if (typlen == -1) {
             /* varlena */
-            ac_add_item(acounter, VARDATA(element), VARSIZE(element) - VARHDRSZ);
+            adaptive_add_varlena(acounter, element);
         } else if (typbyval) {
             /* fixed-length, passed by value */
             ac_add_item(acounter, (char*)&element, typlen);
@@ -202,7 +266,7 @@ adaptive_add_item_agg2(PG_FUNCTION_ARGS)
         /* it this a varlena type, passed by reference or by value ? */
         if (typlen == -1) {
             /* varlena */
-            ac_add_item(acounter, VARDATA(element), VARSIZE(element) - VARHDRSZ);
+            adaptive_add_varlena(acounter, element);
         } else if (typbyval) {
             /* fixed-length, passed by value */
             ac_add_item(acounter, (char*)&element, typlen);
@@ -218,6 +282,322 @@ adaptive_add_item_agg2(PG_FUNCTION_ARGS)
 
 }
 
+Datum
+adaptive_add_hashed(PG_FUNCTION_ARGS)
+{
+
+    AdaptiveCounter acounter;
+    unsigned char hash[HASH_LENGTH];
+
+    /* requires the estimator to be already created */
+    if (PG_ARGISNULL(0))
+        elog(ERROR, "adaptive counter must not be NULL");
+
+    /* if the hash is not NULL, add it to the estimator (i.e. skip NULLs) */
+    if (! PG_ARGISNULL(1)) {
+
+        /* estimator (we know it's not a NULL value) */
+        acounter = (AdaptiveCounter)PG_GETARG_BYTEA_P(0);
+
+        adaptive_get_hash(fcinfo, 1, hash);
+
+        ac_add_hash(acounter, hash);
+
+    }
+
+    PG_RETURN_VOID();
+
+}
+
+Datum
+adaptive_add_hashed_agg(PG_FUNCTION_ARGS)
+{
+
+    AdaptiveCounter acounter;
+    float4 errorRate; /* 0 - 1, e.g. 0.01 means 1% */
+    int    ndistinct; /* expected number of distinct values */
+
+    unsigned char hash[HASH_LENGTH];
+
+    /* is the counter created (if not, create it with default parameters) */
+    if (PG_ARGISNULL(0)) {
+        
+        errorRate = PG_GETARG_FLOAT4(2);
+        ndistinct = PG_GETARG_INT32(3);
+
+        /* ndistinct has to be positive, error rate between 0 and 1 (not 0) */
+        if (ndistinct < 1) {
+            elog(ERROR, "ndistinct (expected number of distinct values) has to at least 1");
+        } else if ((errorRate <= 0) || (errorRate > 1)) {
+            elog(ERROR, "error rate has to be between 0 and 1");
+        }
+
+      acounter = ac_init(errorRate, ndistinct);
+
+    } else { /* existing estimator */
+      acounter = (AdaptiveCounter)PG_GETARG_BYTEA_P(0);
+    }
+
+    /* add the hash to the estimator (skip NULLs) */
+    if (! PG_ARGISNULL(1)) {
+        adaptive_get_hash(fcinfo, 1, hash);
+        ac_add_hash(acounter, hash);
+    }
+
+    /* return the updated bytea */
+    PG_RETURN_BYTEA_P(acounter);
+
+}
+
+Datum
+adaptive_add_hashed_agg2(PG_FUNCTION_ARGS)
+{
+
+    AdaptiveCounter acounter;
+
+    unsigned char hash[HASH_LENGTH];
+
+    /* is the counter created (if not, create it with default parameters) */
+    if (PG_ARGISNULL(0)) {
+      acounter = ac_init(DEFAULT_ERROR, DEFAULT_NDISTINCT);
+    } else {
+      acounter = (AdaptiveCounter)PG_GETARG_BYTEA_P(0);
+    }
+
+    /* add the hash to the estimator (skip NULLs) */
+    if (! PG_ARGISNULL(1)) {
+        adaptive_get_hash(fcinfo, 1, hash);
+        ac_add_hash(acounter, hash);
+    }
+
+    /* return the updated bytea */
+    PG_RETURN_BYTEA_P(acounter);
+
+}
+
+Datum
+adaptive_add_item_multi(PG_FUNCTION_ARGS)
+{
+
+    AdaptiveCounter acounter;
+    unsigned char hash[HASH_LENGTH];
+
+    /* requires the estimator to be already created */
+    if (PG_ARGISNULL(0))
+        elog(ERROR, "adaptive counter must not be NULL");
+
+    /* estimator (we know it's not a NULL value) */
+    acounter = (AdaptiveCounter)PG_GETARG_BYTEA_P(0);
+
+    /* add the key to the estimator (skip keys with NULL values) */
+    if (distinct_hash_multi(fcinfo, 1, hash))
+        ac_add_hash(acounter, hash);
+
+    PG_RETURN_VOID();
+
+}
+
+Datum
+adaptive_add_item_multi_agg(PG_FUNCTION_ARGS)
+{
+
+    AdaptiveCounter acounter;
+    unsigned char hash[HASH_LENGTH];
+
+    /* create a new estimator (with default parameters) or reuse the existing one */
+    if (PG_ARGISNULL(0)) {
+        acounter = ac_init(DEFAULT_ERROR, DEFAULT_NDISTINCT);
+    } else {
+        acounter = (AdaptiveCounter)PG_GETARG_BYTEA_P(0);
+    }
+
+    /* add the key to the estimator (skip keys with NULL values) */
+    if (distinct_hash_multi(fcinfo, 1, hash))
+        ac_add_hash(acounter, hash);
+
+    /* return the updated bytea */
+    PG_RETURN_BYTEA_P(acounter);
+
+}
+
+/* Transition functions for the int2, int4, int8 and uuid overloads of the
+ * adaptive_distinct aggregates, without the type lookup and md5 of the generic
+ * (anyelement) ones - integers are expanded into a hash using the same mixing
+ * function as pre-hashed bigint values, uuids are folded into 64 bits first.
+ *
+ * The counters are not compatible with those built from the same values by
+ * adaptive_accum(anyelement), so only the adaptive_distinct aggregates (returning just
+ * the estimate) have such overloads. */
+Datum
+adaptive_add_int2_agg(PG_FUNCTION_ARGS)
+{
+
+    AdaptiveCounter acounter = adaptive_get_agg_counter(fcinfo);
+    unsigned char hash[HASH_LENGTH];
+
+    /* add the value to the estimator (skip NULLs) */
+    if (! PG_ARGISNULL(1)) {
+        distinct_hash_int64(PG_GETARG_INT16(1), hash);
+        ac_add_hash(acounter, hash);
+    }
+
+    /* return the updated bytea */
+    PG_RETURN_BYTEA_P(acounter);
+
+}
+
+Datum
+adaptive_add_int4_agg(PG_FUNCTION_ARGS)
+{
+
+    AdaptiveCounter acounter = adaptive_get_agg_counter(fcinfo);
+    unsigned char hash[HASH_LENGTH];
+
+    /* add the value to the estimator (skip NULLs) */
+    if (! PG_ARGISNULL(1)) {
+        distinct_hash_int64(PG_GETARG_INT32(1), hash);
+        ac_add_hash(acounter, hash);
+    }
+
+    /* return the updated bytea */
+    PG_RETURN_BYTEA_P(acounter);
+
+}
+
+Datum
+adaptive_add_int8_agg(PG_FUNCTION_ARGS)
+{
+
+    AdaptiveCounter acounter = adaptive_get_agg_counter(fcinfo);
+    unsigned char hash[HASH_LENGTH];
+
+    /* add the value to the estimator (skip NULLs) */
+    if (! PG_ARGISNULL(1)) {
+        distinct_hash_int64(PG_GETARG_INT64(1), hash);
+        ac_add_hash(acounter, hash);
+    }
+
+    /* return the updated bytea */
+    PG_RETURN_BYTEA_P(acounter);
+
+}
+
+Datum
+adaptive_add_uuid_agg(PG_FUNCTION_ARGS)
+{
+
+    AdaptiveCounter acounter = adaptive_get_agg_counter(fcinfo);
+    unsigned char hash[HASH_LENGTH];
+
+    /* add the value to the estimator (skip NULLs) */
+    if (! PG_ARGISNULL(1)) {
+
+        pg_uuid_t  *uuid = PG_GETARG_UUID_P(1);
+        uint64      hi, lo;
+
+        memcpy(&hi, uuid->data, sizeof(uint64));
+        memcpy(&lo, uuid->data + sizeof(uint64), sizeof(uint64));
+
+        /* The uuid bits can't be used directly, as time-based uuids (v1, v7)
+         * are not uniform at all. So fold the halves into 64 bits (mixing the
+         * low half first, which is in the first 8 bytes of the hash). */
+        distinct_hash_int64(lo, hash);
+        memcpy(&lo, hash, sizeof(uint64));
+
+        distinct_hash_int64(hi ^ lo, hash);
+        ac_add_hash(acounter, hash);
+    }
+
+    /* return the updated bytea */
+    PG_RETURN_BYTEA_P(acounter);
+
+}
+
+/* Returns the counter passed to the transition function, or creates a new one
+ * (with the parameters passed to the aggregate, or the default ones). */
+static AdaptiveCounter
+adaptive_get_agg_counter(FunctionCallInfo fcinfo)
+{
+
+    float4 errorRate; /* 0 - 1, e.g. 0.01 means 1% */
+    int    ndistinct; /* expected number of distinct values */
+
+    /* existing estimator */
+    if (! PG_ARGISNULL(0))
+        return (AdaptiveCounter)PG_GETARG_BYTEA_P(0);
+
+    /* default parameters */
+    if (PG_NARGS() < 3)
+        return ac_init(DEFAULT_ERROR, DEFAULT_NDISTINCT);
+
+    errorRate = PG_GETARG_FLOAT4(2);
+    ndistinct = PG_GETARG_INT32(3);
+
+    /* ndistinct has to be positive, error rate between 0 and 1 (not 0) */
+    if (ndistinct < 1) {
+        elog(ERROR, "ndistinct (expected number of distinct values) has to at least 1");
+    } else if ((errorRate <= 0) || (errorRate > 1)) {
+        elog(ERROR, "error rate has to be between 0 and 1");
+    }
+
+    return ac_init(errorRate, ndistinct);
+
+}
+
+/* Adds a varlena value (hashed by distinct_hash_varlena). */
+static void
+adaptive_add_varlena(AdaptiveCounter acounter, Datum element)
+{
+
+    unsigned char hash[HASH_LENGTH];
+    instr_time start, hashed, end;
+
+    if (adaptive_stats == NULL) {
+
+        distinct_hash_varlena(element, hash);
+
+        ac_add_hash(acounter, hash);
+
+        return;
+    }
+
+    /* the same, but with instrumentation */
+    INSTR_TIME_SET_CURRENT(start);
+    distinct_hash_varlena(element, hash);
+    INSTR_TIME_SET_CURRENT(hashed);
+    ac_add_hash(acounter, hash);
+    INSTR_TIME_SET_CURRENT(end);
+
+    adaptive_stats->elements++;
+    INSTR_TIME_ACCUM_DIFF(adaptive_stats->hash_time, hashed, start);
+    INSTR_TIME_ACCUM_DIFF(adaptive_stats->update_time, end, hashed);
+
+}
+
+/* Gets the hash from the argument - either the first HASH_LENGTH bytes of a bytea
+ * value (which has to be at least that long), or a bigint value expanded into
+ * HASH_LENGTH bytes. */
+static void
+adaptive_get_hash(FunctionCallInfo fcinfo, int argno, unsigned char * hash)
+{
+
+    if (get_fn_expr_argtype(fcinfo->flinfo, argno) == INT8OID) {
+
+        distinct_hash_int64(PG_GETARG_INT64(argno), hash);
+
+    } else {
+
+        bytea * value = PG_GETARG_BYTEA_PP(argno);
+
+        if (VARSIZE_ANY_EXHDR(value) < HASH_LENGTH)
+            elog(ERROR, "hash has to be at least %d bytes", HASH_LENGTH);
+
+        memcpy(hash, VARDATA_ANY(value), HASH_LENGTH);
+
+    }
+
+}
+
 Datum
 adaptive_merge_simple(PG_FUNCTION_ARGS)
 {
@@ -266,6 +646,26 @@ adaptive_merge_agg(PG_FUNCTION_ARGS)
 
 }
 
+/* Incremental refresh of a rollup table, the error rate and ndistinct (the
+ * last two arguments) are passed to adaptive_accum. See
+ * distinct_rollup_refresh for details. */
+Datum
+adaptive_rollup_refresh(PG_FUNCTION_ARGS)
+{
+
+    Oid     types[2] = {FLOAT4OID, INT4OID};
+    Datum   values[2];
+
+    if (PG_ARGISNULL(7) || PG_ARGISNULL(8))
+        elog(ERROR, "error rate and ndistinct of the rollup counters must not be NULL");
+
+    values[0] = PG_GETARG_DATUM(7);
+    values[1] = PG_GETARG_DATUM(8);
+
+    PG_RETURN_INT64(distinct_rollup_refresh(fcinfo, "adaptive", 2, types, values));
+
+}
+
 Datum
 adaptive_get_estimate(PG_FUNCTION_ARGS)
 {
@@ -581,4 +981,51 @@ adaptive_send(PG_FUNCTION_ARGS)
 	bytea	   *vlena = PG_GETARG_BYTEA_P_COPY(0);
 
 	PG_RETURN_BYTEA_P(vlena);
-}
\ No newline at end of file
+}
+
+/* the counters collect the statistics only while the pointer is set */
+static void
+adaptive_track_stats_assign(bool newval, void *extra)
+{
+    adaptive_stats = newval ? &adaptive_stats_data : NULL;
+}
+
+Datum
+adaptive_estimator_stats(PG_FUNCTION_ARGS)
+{
+
+    TupleDesc   tupdesc;
+    Datum       values[9];
+    bool        nulls[9];
+
+    if (get_call_result_type(fcinfo, NULL, &tupdesc) != TYPEFUNC_COMPOSITE)
+        elog(ERROR, "return type must be a row type");
+
+    memset(nulls, 0, sizeof(nulls));
+
+    values[0] = Int64GetDatum(adaptive_stats_data.elements);
+    values[1] = Int64GetDatum(adaptive_stats_data.hashes);
+    values[2] = Int64GetDatum(adaptive_stats_data.updates);
+    values[3] = Int64GetDatum(adaptive_stats_data.splits);
+    values[4] = Int32GetDatum(adaptive_stats_data.max_level);
+    values[5] = Int64GetDatum(adaptive_stats_data.merges);
+    values[6] = Int64GetDatum(adaptive_stats_data.allocated);
+    values[7] = Float8GetDatum(INSTR_TIME_GET_MILLISEC(adaptive_stats_data.hash_time));
+    values[8] = Float8GetDatum(INSTR_TIME_GET_MILLISEC(adaptive_stats_data.update_time));
+
+    PG_RETURN_DATUM(HeapTupleGetDatum(heap_form_tuple(BlessTupleDesc(tupdesc), values, nulls)));
+
+}
+
+Datum
+adaptive_estimator_stats_reset(PG_FUNCTION_ARGS)
+{
+
+    memset(&adaptive_stats_data, 0, sizeof(AdaptiveStats));
+
+    INSTR_TIME_SET_ZERO(adaptive_stats_data.hash_time);
+    INSTR_TIME_SET_ZERO(adaptive_stats_data.update_time);
+
+    PG_RETURN_VOID();
+
+}
@@ -0,0 +1,26 @@
+/* Static tracepoints in the adaptive estimator (see distinct_probes.h)
+ *
+ *   split__start     (level, items, maxitems)
+ *   split__done      (level, items)
+ *   merge__start     (level, items, srclevel, srcitems)
+ *   merge__done      (level, items)
+ *   estimate__start  (level, items)
+ *   estimate__done   (level, items, estimate)
+ *
+ * Arguments are the level and number of items in the list (and the
+ * capacity of the list / the level and items of the merged counter). The
+ * split probes fire once per split, even if it increases the level repeatedly.
+ */
+#ifndef ADAPTIVE_PROBES_H
+#define ADAPTIVE_PROBES_H
+
+#include "distinct_probes.h"
+
+#define ADAPTIVE_SPLIT_START(level, items, maxitems)           DISTINCT_PROBE3(adaptive, split__start, level, items, maxitems)
+#define ADAPTIVE_SPLIT_DONE(level, items)                      DISTINCT_PROBE2(adaptive, split__done, level, items)
+#define ADAPTIVE_MERGE_START(level, items, srclevel, srcitems) DISTINCT_PROBE4(adaptive, merge__start, level, items, srclevel, srcitems)
+#define ADAPTIVE_MERGE_DONE(level, items)                      DISTINCT_PROBE2(adaptive, merge__done, level, items)
+#define ADAPTIVE_ESTIMATE_START(level, items)                  DISTINCT_PROBE2(adaptive, estimate__start, level, items)
+#define ADAPTIVE_ESTIMATE_DONE(level, items, estimate)         DISTINCT_PROBE3(adaptive, estimate__done, level, items, estimate)
+
+#endif   /* ADAPTIVE_PROBES_H */
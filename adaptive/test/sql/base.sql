@@ -3,7 +3,7 @@ BEGIN;
 
 -- disable the notices for the create script (shell types etc.)
 SET client_min_messages = 'WARNING';
-\i sql/adaptive_counter--1.3.3.sql
+\i sql/adaptive_counter--1.4.0.sql
 SET client_min_messages = 'NOTICE';
 
 \set ECHO all
@@ -12,6 +12,34 @@ SELECT adaptive_distinct(id) BETWEEN 99000 AND 110000 val FROM generate_series(1
 
 SELECT adaptive_distinct(id::text) BETWEEN 99000 AND 110000 val FROM generate_series(1,100000) s(id);
 
+SELECT adaptive_distinct(id::bigint) BETWEEN 95000 AND 110000 val FROM generate_series(1,100000) s(id);
+
+SELECT adaptive_distinct(md5(id::text)::uuid) BETWEEN 95000 AND 110000 val FROM generate_series(1,100000) s(id);
+
+SELECT adaptive_distinct((id % 30000)::smallint) BETWEEN 28500 AND 31500 val FROM generate_series(1,100000) s(id);
+
+SET adaptive.track_stats = on;
+SELECT adaptive_estimator_stats_reset();
+SELECT adaptive_distinct(id::text) BETWEEN 99000 AND 110000 val FROM generate_series(1,100000) s(id);
+SELECT elements = 100000 AND hashes = 100000 AND updates BETWEEN 2304 AND 100000 AND splits > 0 AND max_level BETWEEN 1 AND 10 AND allocated > 0 val FROM adaptive_estimator_stats();
+RESET adaptive.track_stats;
+
+CREATE TABLE ac_rollup_src AS SELECT i AS id, i % 7 AS dim, i % 5000 AS item FROM generate_series(1,50000) s(i);
+CREATE TABLE ac_rollup (dim int PRIMARY KEY, counter adaptive_estimator);
+SELECT adaptive_rollup_refresh('ac_rollup', 'counter', 'ac_rollup_src', 'id', 'item', ARRAY['dim']) = 7 val;
+INSERT INTO ac_rollup_src SELECT i, i % 9, i % 5000 + 10000 FROM generate_series(50001,60000) s(i);
+SELECT adaptive_rollup_refresh('ac_rollup', 'counter', 'ac_rollup_src', 'id', 'item', ARRAY['dim']) = 9 val;
+SELECT adaptive_rollup_refresh('ac_rollup', 'counter', 'ac_rollup_src', 'id', 'item', ARRAY['dim']) = 0 val;
+SELECT count(*) = 9 AND bool_and(abs((# r.counter) - (# s.counter)) <= 0.05 * (# s.counter)) val FROM ac_rollup r JOIN (SELECT dim, adaptive_accum(item) counter FROM ac_rollup_src GROUP BY dim) s USING (dim);
+
+SELECT adaptive_distinct_multi(id % 1000, id % 99) BETWEEN 90000 AND 110000 val FROM generate_series(1,100000) s(id);
+
+SELECT adaptive_distinct_multi(id % 1000, id % 99) / adaptive_distinct((id % 1000, id % 99)::text) BETWEEN 0.9 AND 1.1 val FROM generate_series(1,100000) s(id);
+
+SELECT (# adaptive_accum_multi(id, CASE WHEN id % 2 = 0 THEN id END)) = adaptive_distinct_multi(id, id) FILTER (WHERE id % 2 = 0) val FROM generate_series(1,100000) s(id);
+
+SELECT adaptive_distinct_multi(a, b) BETWEEN 170000 AND 210000 val FROM (SELECT id % 1000, id % 99 FROM generate_series(1,100000) s(id) UNION ALL SELECT id % 99, id % 1000 FROM generate_series(1,100000) s(id)) foo(a, b);
+
 DO LANGUAGE plpgsql $$
 DECLARE
     v_counter  adaptive_estimator := adaptive_init(0.01,10000);
@@ -0,0 +1,122 @@
+-- the estimate does not modify the aggregate state (e.g. for window aggregates)
+
+CREATE OR REPLACE AGGREGATE bitmap_distinct(anyelement, real, int)
+(
+    sfunc = bitmap_add_item_agg,
+    stype = bitmap_estimator,
+    finalfunc = bitmap_get_estimate,
+    finalfunc_modify = read_only
+);
+
+CREATE OR REPLACE AGGREGATE bitmap_distinct(anyelement)
+(
+    sfunc = bitmap_add_item_agg2,
+    stype = bitmap_estimator,
+    finalfunc = bitmap_get_estimate,
+    finalfunc_modify = read_only
+);
+
+-- pre-hashed values (bytea with at least 16 bytes, or bigint)
+
+CREATE FUNCTION bitmap_add_hash(counter bitmap_estimator, hash bytea) RETURNS void
+     AS 'MODULE_PATHNAME', 'bitmap_add_hashed'
+     LANGUAGE C;
+
+CREATE FUNCTION bitmap_add_hash(counter bitmap_estimator, hash bigint) RETURNS void
+     AS 'MODULE_PATHNAME', 'bitmap_add_hashed'
+     LANGUAGE C;
+
+CREATE FUNCTION bitmap_add_hashed_agg(counter bitmap_estimator, hash bytea, error_rate real, ndistinct integer) RETURNS bitmap_estimator
+     AS 'MODULE_PATHNAME', 'bitmap_add_hashed_agg'
+     LANGUAGE C;
+
+CREATE FUNCTION bitmap_add_hashed_agg(counter bitmap_estimator, hash bigint, error_rate real, ndistinct integer) RETURNS bitmap_estimator
+     AS 'MODULE_PATHNAME', 'bitmap_add_hashed_agg'
+     LANGUAGE C;
+
+CREATE FUNCTION bitmap_add_hashed_agg2(counter bitmap_estimator, hash bytea) RETURNS bitmap_estimator
+     AS 'MODULE_PATHNAME', 'bitmap_add_hashed_agg2'
+     LANGUAGE C;
+
+CREATE FUNCTION bitmap_add_hashed_agg2(counter bitmap_estimator, hash bigint) RETURNS bitmap_estimator
+     AS 'MODULE_PATHNAME', 'bitmap_add_hashed_agg2'
+     LANGUAGE C;
+
+CREATE AGGREGATE bitmap_distinct_hashed(bytea, real, int)
+(
+    sfunc = bitmap_add_hashed_agg,
+    stype = bitmap_estimator,
+    finalfunc = bitmap_get_estimate,
+    finalfunc_modify = read_only
+);
+
+CREATE AGGREGATE bitmap_distinct_hashed(bytea)
+(
+    sfunc = bitmap_add_hashed_agg2,
+    stype = bitmap_estimator,
+    finalfunc = bitmap_get_estimate,
+    finalfunc_modify = read_only
+);
+
+CREATE AGGREGATE bitmap_accum_hashed(bytea, real, int)
+(
+    sfunc = bitmap_add_hashed_agg,
+    stype = bitmap_estimator
+);
+
+CREATE AGGREGATE bitmap_accum_hashed(bytea)
+(
+    sfunc = bitmap_add_hashed_agg2,
+    stype = bitmap_estimator
+);
+
+CREATE AGGREGATE bitmap_distinct_hashed(bigint, real, int)
+(
+    sfunc = bitmap_add_hashed_agg,
+    stype = bitmap_estimator,
+    finalfunc = bitmap_get_estimate,
+    finalfunc_modify = read_only
+);
+
+CREATE AGGREGATE bitmap_distinct_hashed(bigint)
+(
+    sfunc = bitmap_add_hashed_agg2,
+    stype = bitmap_estimator,
+    finalfunc = bitmap_get_estimate,
+    finalfunc_modify = read_only
+);
+
+CREATE AGGREGATE bitmap_accum_hashed(bigint, real, int)
+(
+    sfunc = bitmap_add_hashed_agg,
+    stype = bitmap_estimator
+);
+
+CREATE AGGREGATE bitmap_accum_hashed(bigint)
+(
+    sfunc = bitmap_add_hashed_agg2,
+    stype = bitmap_estimator
+);
+
+-- multi-column keys, e.g. bitmap_distinct_multi(user_id, device_id) (keys with any NULL value are skipped)
+CREATE FUNCTION bitmap_add_item_multi(counter bitmap_estimator, VARIADIC items "any") RETURNS void
+     AS 'MODULE_PATHNAME', 'bitmap_add_item_multi'
+     LANGUAGE C;
+
+CREATE FUNCTION bitmap_add_item_multi_agg(counter bitmap_estimator, VARIADIC items "any") RETURNS bitmap_estimator
+     AS 'MODULE_PATHNAME', 'bitmap_add_item_multi_agg'
+     LANGUAGE C;
+
+CREATE AGGREGATE bitmap_distinct_multi(VARIADIC "any")
+(
+    sfunc = bitmap_add_item_multi_agg,
+    stype = bitmap_estimator,
+    finalfunc = bitmap_get_estimate,
+    finalfunc_modify = read_only
+);
+
+CREATE AGGREGATE bitmap_accum_multi(VARIADIC "any")
+(
+    sfunc = bitmap_add_item_multi_agg,
+    stype = bitmap_estimator
+);
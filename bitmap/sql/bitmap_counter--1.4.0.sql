@@ -75,7 +75,8 @@ CREATE AGGREGATE bitmap_distinct(anyelement, real, int)
 (
     sfunc = bitmap_add_item_agg,
     stype = bitmap_estimator,
-    finalfunc = bitmap_get_estimate
+    finalfunc = bitmap_get_estimate,
+    finalfunc_modify = read_only
 );
 
 -- s-bitmap based aggregate (item)
@@ -83,7 +84,8 @@ CREATE AGGREGATE bitmap_distinct(anyelement)
 (
     sfunc = bitmap_add_item_agg2,
     stype = bitmap_estimator,
-    finalfunc = bitmap_get_estimate
+    finalfunc = bitmap_get_estimate,
+    finalfunc_modify = read_only
 );
 
 -- build the counter(s), but does not perform the final estimation (i.e. can be used to pre-aggregate data)
@@ -106,3 +108,108 @@ CREATE OPERATOR # (
     PROCEDURE = bitmap_get_estimate,
     RIGHTARG = bitmap_estimator
 );
+
+-- pre-hashed values (bytea with at least 16 bytes, or bigint)
+
+CREATE FUNCTION bitmap_add_hash(counter bitmap_estimator, hash bytea) RETURNS void
+     AS '$libdir/bitmap_counter', 'bitmap_add_hashed'
+     LANGUAGE C;
+
+CREATE FUNCTION bitmap_add_hash(counter bitmap_estimator, hash bigint) RETURNS void
+     AS '$libdir/bitmap_counter', 'bitmap_add_hashed'
+     LANGUAGE C;
+
+CREATE FUNCTION bitmap_add_hashed_agg(counter bitmap_estimator, hash bytea, error_rate real, ndistinct integer) RETURNS bitmap_estimator
+     AS '$libdir/bitmap_counter', 'bitmap_add_hashed_agg'
+     LANGUAGE C;
+
+CREATE FUNCTION bitmap_add_hashed_agg(counter bitmap_estimator, hash bigint, error_rate real, ndistinct integer) RETURNS bitmap_estimator
+     AS '$libdir/bitmap_counter', 'bitmap_add_hashed_agg'
+     LANGUAGE C;
+
+CREATE FUNCTION bitmap_add_hashed_agg2(counter bitmap_estimator, hash bytea) RETURNS bitmap_estimator
+     AS '$libdir/bitmap_counter', 'bitmap_add_hashed_agg2'
+     LANGUAGE C;
+
+CREATE FUNCTION bitmap_add_hashed_agg2(counter bitmap_estimator, hash bigint) RETURNS bitmap_estimator
+     AS '$libdir/bitmap_counter', 'bitmap_add_hashed_agg2'
+     LANGUAGE C;
+
+CREATE AGGREGATE bitmap_distinct_hashed(bytea, real, int)
+(
+    sfunc = bitmap_add_hashed_agg,
+    stype = bitmap_estimator,
+    finalfunc = bitmap_get_estimate,
+    finalfunc_modify = read_only
+);
+
+CREATE AGGREGATE bitmap_distinct_hashed(bytea)
+(
+    sfunc = bitmap_add_hashed_agg2,
+    stype = bitmap_estimator,
+    finalfunc = bitmap_get_estimate,
+    finalfunc_modify = read_only
+);
+
+CREATE AGGREGATE bitmap_accum_hashed(bytea, real, int)
+(
+    sfunc = bitmap_add_hashed_agg,
+    stype = bitmap_estimator
+);
+
+CREATE AGGREGATE bitmap_accum_hashed(bytea)
+(
+    sfunc = bitmap_add_hashed_agg2,
+    stype = bitmap_estimator
+);
+
+CREATE AGGREGATE bitmap_distinct_hashed(bigint, real, int)
+(
+    sfunc = bitmap_add_hashed_agg,
+    stype = bitmap_estimator,
+    finalfunc = bitmap_get_estimate,
+    finalfunc_modify = read_only
+);
+
+CREATE AGGREGATE bitmap_distinct_hashed(bigint)
+(
+    sfunc = bitmap_add_hashed_agg2,
+    stype = bitmap_estimator,
+    finalfunc = bitmap_get_estimate,
+    finalfunc_modify = read_only
+);
+
+CREATE AGGREGATE bitmap_accum_hashed(bigint, real, int)
+(
+    sfunc = bitmap_add_hashed_agg,
+    stype = bitmap_estimator
+);
+
+CREATE AGGREGATE bitmap_accum_hashed(bigint)
+(
+    sfunc = bitmap_add_hashed_agg2,
+    stype = bitmap_estimator
+);
+
+-- multi-column keys, e.g. bitmap_distinct_multi(user_id, device_id) (keys with any NULL value are skipped)
+CREATE FUNCTION bitmap_add_item_multi(counter bitmap_estimator, VARIADIC items "any") RETURNS void
+     AS '$libdir/bitmap_counter', 'bitmap_add_item_multi'
+     LANGUAGE C;
+
+CREATE FUNCTION bitmap_add_item_multi_agg(counter bitmap_estimator, VARIADIC items "any") RETURNS bitmap_estimator
+     AS '$libdir/bitmap_counter', 'bitmap_add_item_multi_agg'
+     LANGUAGE C;
+
+CREATE AGGREGATE bitmap_distinct_multi(VARIADIC "any")
+(
+    sfunc = bitmap_add_item_multi_agg,
+    stype = bitmap_estimator,
+    finalfunc = bitmap_get_estimate,
+    finalfunc_modify = read_only
+);
+
+CREATE AGGREGATE bitmap_accum_multi(VARIADIC "any")
+(
+    sfunc = bitmap_add_item_multi_agg,
+    stype = bitmap_estimator
+);
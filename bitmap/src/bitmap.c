@@ -6,7 +6,8 @@
 #include "bitmap.h"
 #include "postgres.h"
 
-#include "libpq/md5.h"
+#include "distinct_md5.h"
+#include "bitmap_probes.h"
 
 #define HASH_LENGTH 16
 
@@ -19,7 +20,6 @@ float bc_p(BitmapCounter bc);
 float bc_q(BitmapCounter bc, int l);
 float bc_t(BitmapCounter bc, int l);
 
-void bc_add_hash(BitmapCounter bc, const unsigned char * hash, int length);
 int bc_estimate(BitmapCounter bc);
 
 /* Create the bitmap counter - compute the optimal bitmap length, etc.  */
@@ -74,7 +74,7 @@ BitmapCounter bc_init(float error, int ndistinct) {
 
 /* Computes an MD5 hash of the input value (with a given length). */
 void bc_hash(unsigned char * buffer, const char * element, int length) {
-    pg_md5_binary(element, length, buffer);
+    distinct_md5(element, length, buffer);
 }
 
 
@@ -155,14 +155,23 @@ float bc_t(BitmapCounter bc, int l) {
 
 int bc_estimate(BitmapCounter bc) {
   
-    float t1 = bc_t(bc, bc->level);
-    float t2 = bc_t(bc, bc->level+1);
+    float t1, t2;
+    int estimate;
+
+    BITMAP_ESTIMATE_START(bc->nbits, bc->level);
+
+    t1 = bc_t(bc, bc->level);
+    t2 = bc_t(bc, bc->level+1);
   
     if ((bc->nbits > bc->level) && (t2 - t1 > 1.5)) {
-        return (int)round(2 * t1 * t2 / (t1 + t2));
+        estimate = (int)round(2 * t1 * t2 / (t1 + t2));
     } else {
-        return (int)t1;
+        estimate = (int)t1;
     }
+
+    BITMAP_ESTIMATE_DONE(bc->nbits, bc->level, estimate);
+
+    return estimate;
   
 }
 
@@ -212,4 +221,4 @@ void bc_reset(BitmapCounter bc) {
     
     bc->level = 0;
     
-}
\ No newline at end of file
+}
@@ -59,6 +59,9 @@ void bc_reset(BitmapCounter bc);
 /* add element into the counter */
 void bc_add_item(BitmapCounter bc, const char * item, int length);
 
+/* add a hash (HASH_LENGTH bytes) directly, without hashing */
+void bc_add_hash(BitmapCounter bc, const unsigned char * hash, int length);
+
 /* print info about the counter */
 void bc_print_info(BitmapCounter ac);
 
@@ -5,7 +5,10 @@
 
 #include "postgres.h"
 #include "fmgr.h"
+#include "catalog/pg_type.h"
 #include "bitmap.h"
+#include "distinct_hash.h"
+#include "distinct_multi.h"
 #include "utils/builtins.h"
 #include "utils/bytea.h"
 #include "utils/lsyscache.h"
@@ -19,12 +22,20 @@ PG_MODULE_MAGIC;
 #define VAL(CH)			((CH) - '0')
 #define DIG(VAL)		((VAL) + '0')
 
+/* we're using md5, which produces 16B (128-bit) values */
+#define HASH_LENGTH 16
+
 #define DEFAULT_ERROR       0.025
 #define DEFAULT_NDISTINCT   1000000
 
 PG_FUNCTION_INFO_V1(bitmap_add_item);
 PG_FUNCTION_INFO_V1(bitmap_add_item_agg);
 PG_FUNCTION_INFO_V1(bitmap_add_item_agg2);
+PG_FUNCTION_INFO_V1(bitmap_add_hashed);
+PG_FUNCTION_INFO_V1(bitmap_add_hashed_agg);
+PG_FUNCTION_INFO_V1(bitmap_add_hashed_agg2);
+PG_FUNCTION_INFO_V1(bitmap_add_item_multi);
+PG_FUNCTION_INFO_V1(bitmap_add_item_multi_agg);
 
 PG_FUNCTION_INFO_V1(bitmap_get_estimate);
 PG_FUNCTION_INFO_V1(bitmap_get_ndistinct);
@@ -41,6 +52,14 @@ PG_FUNCTION_INFO_V1(bitmap_length);
 Datum bitmap_add_item(PG_FUNCTION_ARGS);
 Datum bitmap_add_item_agg(PG_FUNCTION_ARGS);
 Datum bitmap_add_item_agg2(PG_FUNCTION_ARGS);
+Datum bitmap_add_hashed(PG_FUNCTION_ARGS);
+Datum bitmap_add_hashed_agg(PG_FUNCTION_ARGS);
+Datum bitmap_add_hashed_agg2(PG_FUNCTION_ARGS);
+Datum bitmap_add_item_multi(PG_FUNCTION_ARGS);
+Datum bitmap_add_item_multi_agg(PG_FUNCTION_ARGS);
+
+static void bitmap_get_hash(FunctionCallInfo fcinfo, int argno, unsigned char * hash);
+static void bitmap_add_varlena(BitmapCounter bitmap_counter, Datum element);
 
 Datum bitmap_get_estimate(PG_FUNCTION_ARGS);
 Datum bitmap_get_ndistinct(PG_FUNCTION_ARGS);
@@ -86,7 +105,7 @@ bitmap_add_item(PG_FUNCTION_ARGS)
         /* it this a varlena type, passed by reference or by value ? */
         if (typlen == -1) {
             /* varlena */
-            bc_add_item(bitmap_counter, VARDATA(element), VARSIZE(element) - VARHDRSZ);
+            bitmap_add_varlena(bitmap_counter, element);
         } else if (typbyval) {
             /* fixed-length, passed by value */
             bc_add_item(bitmap_counter, (char*)&element, typlen);
@@ -148,7 +167,7 @@ bitmap_add_item_agg(PG_FUNCTION_ARGS)
         /* it this a varlena type, passed by reference or by value ? */
         if (typlen == -1) {
             /* varlena */
-            bc_add_item(bitmap_counter, VARDATA(element), VARSIZE(element) - VARHDRSZ);
+            bitmap_add_varlena(bitmap_counter, element);
         } else if (typbyval) {
             /* fixed-length, passed by value */
             bc_add_item(bitmap_counter, (char*)&element, typlen);
@@ -197,7 +216,7 @@ bitmap_add_item_agg2(PG_FUNCTION_ARGS)
         /* it this a varlena type, passed by reference or by value ? */
         if (typlen == -1) {
             /* varlena */
-            bc_add_item(bitmap_counter, VARDATA(element), VARSIZE(element) - VARHDRSZ);
+            bitmap_add_varlena(bitmap_counter, element);
         } else if (typbyval) {
             /* fixed-length, passed by value */
             bc_add_item(bitmap_counter, (char*)&element, typlen);
@@ -213,6 +232,181 @@ bitmap_add_item_agg2(PG_FUNCTION_ARGS)
 
 }
 
+Datum
+bitmap_add_hashed(PG_FUNCTION_ARGS)
+{
+
+    BitmapCounter bitmap_counter;
+    unsigned char hash[HASH_LENGTH];
+
+    /* requires the estimator to be already created */
+    if (PG_ARGISNULL(0))
+        elog(ERROR, "bitmap counter must not be NULL");
+
+    /* if the hash is not NULL, add it to the estimator (i.e. skip NULLs) */
+    if (! PG_ARGISNULL(1)) {
+
+        /* estimator (we know it's not a NULL value) */
+        bitmap_counter = (BitmapCounter)PG_GETARG_BYTEA_P(0);
+
+        bitmap_get_hash(fcinfo, 1, hash);
+
+        bc_add_hash(bitmap_counter, hash, HASH_LENGTH);
+
+    }
+
+    PG_RETURN_VOID();
+
+}
+
+Datum
+bitmap_add_hashed_agg(PG_FUNCTION_ARGS)
+{
+
+    BitmapCounter bitmap_counter;
+    float4 errorRate; /* 0 - 1, e.g. 0.01 means 1% */
+    int    ndistinct; /* expected number of distinct values */
+
+    unsigned char hash[HASH_LENGTH];
+
+    /* create a new estimator (with requested error rate) or reuse the existing one */
+    if (PG_ARGISNULL(0)) {
+        
+        errorRate = PG_GETARG_FLOAT4(2);
+        ndistinct = PG_GETARG_INT32(3);
+
+        /* ndistinct has to be positive, error rate between 0 and 1 (not 0) */
+        if (ndistinct < 1) {
+            elog(ERROR, "ndistinct (expected number of distinct values) has to at least 1");
+        } else if ((errorRate <= 0) || (errorRate > 1)) {
+            elog(ERROR, "error rate has to be between 0 and 1");
+        }
+        
+        bitmap_counter = bc_init(errorRate, ndistinct);
+
+    } else { /* existing estimator */
+        bitmap_counter = (BitmapCounter)PG_GETARG_BYTEA_P(0);
+    }
+
+    /* add the hash to the estimator (skip NULLs) */
+    if (! PG_ARGISNULL(1)) {
+        bitmap_get_hash(fcinfo, 1, hash);
+        bc_add_hash(bitmap_counter, hash, HASH_LENGTH);
+    }
+
+    /* return the updated bytea */
+    PG_RETURN_BYTEA_P(bitmap_counter);
+    
+}
+
+Datum
+bitmap_add_hashed_agg2(PG_FUNCTION_ARGS)
+{
+
+    BitmapCounter bitmap_counter;
+
+    unsigned char hash[HASH_LENGTH];
+
+    /* create a new estimator (with requested error rate) or reuse the existing one */
+    if (PG_ARGISNULL(0)) {
+        bitmap_counter = bc_init(DEFAULT_ERROR, DEFAULT_NDISTINCT);
+    } else { /* existing estimator */
+        bitmap_counter = (BitmapCounter)PG_GETARG_BYTEA_P(0);
+    }
+
+    /* add the hash to the estimator (skip NULLs) */
+    if (! PG_ARGISNULL(1)) {
+        bitmap_get_hash(fcinfo, 1, hash);
+        bc_add_hash(bitmap_counter, hash, HASH_LENGTH);
+    }
+
+    /* return the updated bytea */
+    PG_RETURN_BYTEA_P(bitmap_counter);
+
+}
+
+Datum
+bitmap_add_item_multi(PG_FUNCTION_ARGS)
+{
+
+    BitmapCounter bitmap_counter;
+    unsigned char hash[HASH_LENGTH];
+
+    /* requires the estimator to be already created */
+    if (PG_ARGISNULL(0))
+        elog(ERROR, "bitmap counter must not be NULL");
+
+    /* estimator (we know it's not a NULL value) */
+    bitmap_counter = (BitmapCounter)PG_GETARG_BYTEA_P(0);
+
+    /* add the key to the estimator (skip keys with NULL values) */
+    if (distinct_hash_multi(fcinfo, 1, hash))
+        bc_add_hash(bitmap_counter, hash, HASH_LENGTH);
+
+    PG_RETURN_VOID();
+
+}
+
+Datum
+bitmap_add_item_multi_agg(PG_FUNCTION_ARGS)
+{
+
+    BitmapCounter bitmap_counter;
+    unsigned char hash[HASH_LENGTH];
+
+    /* create a new estimator (with default parameters) or reuse the existing one */
+    if (PG_ARGISNULL(0)) {
+        bitmap_counter = bc_init(DEFAULT_ERROR, DEFAULT_NDISTINCT);
+    } else {
+        bitmap_counter = (BitmapCounter)PG_GETARG_BYTEA_P(0);
+    }
+
+    /* add the key to the estimator (skip keys with NULL values) */
+    if (distinct_hash_multi(fcinfo, 1, hash))
+        bc_add_hash(bitmap_counter, hash, HASH_LENGTH);
+
+    /* return the updated bytea */
+    PG_RETURN_BYTEA_P(bitmap_counter);
+
+}
+
+/* Adds a varlena value (hashed by distinct_hash_varlena). */
+static void
+bitmap_add_varlena(BitmapCounter bitmap_counter, Datum element)
+{
+
+    unsigned char hash[HASH_LENGTH];
+
+    distinct_hash_varlena(element, hash);
+
+    bc_add_hash(bitmap_counter, hash, HASH_LENGTH);
+
+}
+
+/* Gets the hash from the argument - either the first HASH_LENGTH bytes of a bytea
+ * value (which has to be at least that long), or a bigint value expanded into
+ * HASH_LENGTH bytes. */
+static void
+bitmap_get_hash(FunctionCallInfo fcinfo, int argno, unsigned char * hash)
+{
+
+    if (get_fn_expr_argtype(fcinfo->flinfo, argno) == INT8OID) {
+
+        distinct_hash_int64(PG_GETARG_INT64(argno), hash);
+
+    } else {
+
+        bytea * value = PG_GETARG_BYTEA_PP(argno);
+
+        if (VARSIZE_ANY_EXHDR(value) < HASH_LENGTH)
+            elog(ERROR, "hash has to be at least %d bytes", HASH_LENGTH);
+
+        memcpy(hash, VARDATA_ANY(value), HASH_LENGTH);
+
+    }
+
+}
+
 Datum
 bitmap_get_estimate(PG_FUNCTION_ARGS)
 {
@@ -0,0 +1,17 @@
+/* Static tracepoints in the bitmap estimator (see distinct_probes.h)
+ *
+ *   estimate__start  (nbits, level)
+ *   estimate__done   (nbits, level, estimate)
+ *
+ * Arguments are the size of the bitmap and the number of bits set (the
+ * done probe also gets the estimate). Bitmap counters are not mergeable.
+ */
+#ifndef BITMAP_PROBES_H
+#define BITMAP_PROBES_H
+
+#include "distinct_probes.h"
+
+#define BITMAP_ESTIMATE_START(nbits, level)          DISTINCT_PROBE2(bitmap, estimate__start, nbits, level)
+#define BITMAP_ESTIMATE_DONE(nbits, level, estimate) DISTINCT_PROBE3(bitmap, estimate__done, nbits, level, estimate)
+
+#endif   /* BITMAP_PROBES_H */
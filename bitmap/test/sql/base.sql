@@ -3,7 +3,7 @@ BEGIN;
 
 -- disable the notices for the create script (shell types etc.)
 SET client_min_messages = 'WARNING';
-\i sql/bitmap_counter--1.3.5.sql
+\i sql/bitmap_counter--1.4.0.sql
 SET client_min_messages = 'NOTICE';
 
 \set ECHO all
@@ -13,6 +13,14 @@ SELECT bitmap_distinct(id) BETWEEN 99000 AND 110000 val FROM generate_series(1,1
 
 SELECT bitmap_distinct(id::text) BETWEEN 99000 AND 110000 val FROM generate_series(1,100000) s(id);
 
+SELECT bitmap_distinct_multi(id % 1000, id % 99) BETWEEN 90000 AND 110000 val FROM generate_series(1,100000) s(id);
+
+SELECT bitmap_distinct_multi(id % 1000, id % 99) / bitmap_distinct((id % 1000, id % 99)::text) BETWEEN 0.9 AND 1.1 val FROM generate_series(1,100000) s(id);
+
+SELECT (# bitmap_accum_multi(id, CASE WHEN id % 2 = 0 THEN id END)) = bitmap_distinct_multi(id, id) FILTER (WHERE id % 2 = 0) val FROM generate_series(1,100000) s(id);
+
+SELECT bitmap_distinct_multi(a, b) BETWEEN 170000 AND 210000 val FROM (SELECT id % 1000, id % 99 FROM generate_series(1,100000) s(id) UNION ALL SELECT id % 99, id % 1000 FROM generate_series(1,100000) s(id)) foo(a, b);
+
 DO LANGUAGE plpgsql $$
 DECLARE
     v_counter  bitmap_estimator := bitmap_init(0.01,10000);
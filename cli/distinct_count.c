@@ -0,0 +1,749 @@
+/* Command-line tool building the distinct estimators outside the database.
+ *
+ * Counting distinct values in raw data (e.g. logs) does not need to happen
+ * in the database - the tool reads values from files (or stdin), builds the
+ * counter on the application host and either prints the estimate, or the
+ * counter itself in the text format accepted by the data types, e.g.
+ *
+ *   $ distinct_count -t hyperloglog -x access.log | \
+ *         psql -c "INSERT INTO daily (counter) VALUES ('$(cat)')"
+ *
+ * The estimators come from libdistinct, compiled from the very same sources
+ * as the extensions, so the counters are binary compatible with the ones
+ * built in the database - as long as the tool runs on the same architecture,
+ * of course.
+ *
+ * The input is read by the main thread in large blocks, split at record
+ * boundaries and handed to worker threads. Each worker builds a separate
+ * counter, and the counters are merged at the end. The bitmap estimator
+ * can't be merged, so the workers only compute the hashes and add them into
+ * a single shared counter (which makes the result depend on the order of
+ * the values, just like in the database).
+ *
+ * The values are hashed in batches, and the whole batch is then added to
+ * the counter at once, which allows prefetching the registers of the large
+ * counters (see hyperloglog_add_hashes). The probabilistic estimator hashes
+ * each value multiple times (with different salts), so it's not batched.
+ *
+ * The input formats match hyperloglog_from_file - 'line' (each non-empty
+ * line is a value) and 'csv' (NULL values, i.e. empty unquoted fields, are
+ * skipped). The values are hashed as text, so the counter matches the one
+ * built by the aggregate on the text column.
+ */
+#include <errno.h>
+#include <getopt.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "distinct.h"
+
+#define HASH_LENGTH         DISTINCT_HASH_LENGTH
+
+/* size of the blocks read from the input (grows for longer records) */
+#define BLOCK_SIZE          (1024 * 1024)
+
+/* maximum number of worker threads */
+#define MAX_JOBS            64
+
+typedef enum InputFormat {
+    FORMAT_LINE,
+    FORMAT_CSV
+} InputFormat;
+
+/* a block of complete records, passed from the reader to the workers */
+typedef struct InputBlock {
+    char               *data;
+    size_t              len;
+    struct InputBlock  *next;
+} InputBlock;
+
+/* queue of blocks (bounded, so that the reader does not run too far ahead) */
+typedef struct BlockQueue {
+    pthread_mutex_t     lock;
+    pthread_cond_t      not_empty;
+    pthread_cond_t      not_full;
+    InputBlock         *head;
+    InputBlock         *tail;
+    int                 count;
+    int                 capacity;
+    bool                done;
+} BlockQueue;
+
+typedef struct Worker {
+    pthread_t           thread;
+    distinct_counter   *counter;
+    char               *value;      /* buffer for the parsed value */
+    size_t              maxlen;
+    unsigned char      *hashes;     /* batch of hashes (not added yet) */
+    size_t              nhashes;
+    size_t              maxhashes;
+} Worker;
+
+static distinct_type type;
+static bool mergeable;
+static bool batched;
+
+/* parameters of the estimator (0 means the default of the one-argument
+ * aggregate, e.g. hyperloglog_distinct) */
+static double error_rate = 0;
+static int64_t ndistinct = 0;
+static int nmaps = 64;          /* pcsa */
+static int keysize = 4;         /* pcsa */
+static int nbytes = 4;          /* probabilistic */
+static int nsalts = 32;         /* probabilistic */
+static InputFormat format = FORMAT_LINE;
+static int column = 0;              /* 0-based */
+static bool header = false;
+
+static BlockQueue queue;
+
+/* shared counter (for estimators that can't be merged) */
+static distinct_counter *shared_counter = NULL;
+static pthread_mutex_t shared_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static distinct_counter *create_counter(void);
+static void *worker_main(void *arg);
+static void worker_add_value(Worker * worker, const char * value, int len);
+static void worker_flush_hashes(Worker * worker);
+static void process_block(Worker * worker, const char * data, size_t len);
+static size_t record_end(const char * data, size_t len, bool first);
+static void read_input(FILE * file);
+static void queue_push(char * data, size_t len);
+static InputBlock * queue_pop(void);
+static void print_counter(distinct_counter * counter);
+static void fatal(const char * fmt, ...) __attribute__((format(printf, 1, 2), noreturn));
+static void *xmalloc(size_t size);
+static void *xrealloc(void *ptr, size_t size);
+static void usage(const char * progname);
+
+int
+main(int argc, char **argv)
+{
+
+    static struct option long_options[] = {
+        {"type", required_argument, NULL, 't'},
+        {"error", required_argument, NULL, 'e'},
+        {"ndistinct", required_argument, NULL, 'n'},
+        {"nmaps", required_argument, NULL, 'm'},
+        {"keysize", required_argument, NULL, 'k'},
+        {"nbytes", required_argument, NULL, 'b'},
+        {"nsalts", required_argument, NULL, 's'},
+        {"format", required_argument, NULL, 'f'},
+        {"column", required_argument, NULL, 'c'},
+        {"header", no_argument, NULL, 'H'},
+        {"jobs", required_argument, NULL, 'j'},
+        {"serialize", no_argument, NULL, 'x'},
+        {"help", no_argument, NULL, 'h'},
+        {NULL, 0, NULL, 0}
+    };
+
+    int         c, i;
+    int         njobs = 1;
+    bool        serialize = false;
+    const char *name = "hyperloglog";
+    Worker     *workers;
+    distinct_counter *result;
+
+    while ((c = getopt_long(argc, argv, "t:e:n:m:k:b:s:f:c:Hj:xh", long_options, NULL)) != -1) {
+
+        switch (c) {
+            case 't':
+                name = optarg;
+                break;
+            case 'e':
+                error_rate = atof(optarg);
+                break;
+            case 'n':
+                ndistinct = atoll(optarg);
+                break;
+            case 'm':
+                nmaps = atoi(optarg);
+                break;
+            case 'k':
+                keysize = atoi(optarg);
+                break;
+            case 'b':
+                nbytes = atoi(optarg);
+                break;
+            case 's':
+                nsalts = atoi(optarg);
+                break;
+            case 'f':
+                if (strcmp(optarg, "line") == 0)
+                    format = FORMAT_LINE;
+                else if (strcmp(optarg, "csv") == 0)
+                    format = FORMAT_CSV;
+                else
+                    fatal("unknown input format \"%s\" (use line or csv)", optarg);
+                break;
+            case 'c':
+                column = atoi(optarg) - 1;
+                break;
+            case 'H':
+                header = true;
+                break;
+            case 'j':
+                njobs = atoi(optarg);
+                break;
+            case 'x':
+                serialize = true;
+                break;
+            case 'h':
+                usage(argv[0]);
+                exit(0);
+            default:
+                usage(argv[0]);
+                exit(1);
+        }
+    }
+
+    if ((type = distinct_type_lookup(name)) == 0)
+        fatal("unknown estimator \"%s\"", name);
+
+    mergeable = distinct_type_mergeable(type);
+    batched = (type != DISTINCT_PROBABILISTIC);
+
+    if ((error_rate < 0) || (error_rate >= 1))
+        fatal("error rate has to be between 0 and 1");
+
+    if (column < 0)
+        fatal("column number has to be at least 1");
+
+    if ((format == FORMAT_LINE) && (column != 0))
+        fatal("line format has only a single column");
+
+    if ((njobs < 1) || (njobs > MAX_JOBS))
+        fatal("number of jobs has to be between 1 and %d", MAX_JOBS);
+
+    pthread_mutex_init(&queue.lock, NULL);
+    pthread_cond_init(&queue.not_empty, NULL);
+    pthread_cond_init(&queue.not_full, NULL);
+    queue.capacity = 2 * njobs;
+
+    if (! mergeable)
+        shared_counter = create_counter();
+
+    workers = xmalloc(njobs * sizeof(Worker));
+    memset(workers, 0, njobs * sizeof(Worker));
+
+    for (i = 0; i < njobs; i++) {
+
+        if (mergeable)
+            workers[i].counter = create_counter();
+
+        if (pthread_create(&workers[i].thread, NULL, worker_main, &workers[i]) != 0)
+            fatal("could not create worker thread");
+    }
+
+    if (optind >= argc)
+        read_input(stdin);
+
+    for (i = optind; i < argc; i++) {
+
+        FILE   *file;
+
+        if (strcmp(argv[i], "-") == 0) {
+            read_input(stdin);
+            continue;
+        }
+
+        if ((file = fopen(argv[i], "rb")) == NULL)
+            fatal("could not open file \"%s\": %s", argv[i], strerror(errno));
+
+        read_input(file);
+
+        fclose(file);
+    }
+
+    /* tell the workers there's nothing more to do */
+    pthread_mutex_lock(&queue.lock);
+    queue.done = true;
+    pthread_cond_broadcast(&queue.not_empty);
+    pthread_mutex_unlock(&queue.lock);
+
+    for (i = 0; i < njobs; i++)
+        pthread_join(workers[i].thread, NULL);
+
+    /* merge the per-worker counters (or use the shared one) */
+    if (! mergeable)
+        result = shared_counter;
+    else {
+        result = workers[0].counter;
+        for (i = 1; i < njobs; i++)
+            if (distinct_merge(result, workers[i].counter) != 0)
+                fatal("%s", distinct_last_error());
+    }
+
+    if (serialize)
+        print_counter(result);
+    else
+        printf("%lld\n", (long long) distinct_estimate(result));
+
+    return 0;
+
+}
+
+/* Reads the file in blocks, and passes blocks of complete records to the
+ * workers. Incomplete record at the end of a block is moved to the next one
+ * (and the block grows if a single record does not fit into it). */
+static void
+read_input(FILE * file)
+{
+
+    size_t  size = BLOCK_SIZE;
+    size_t  len = 0;
+    char   *data = xmalloc(size);
+    bool    skip = header;
+
+    while (true) {
+
+        size_t  nread,
+                end;
+        bool    eof;
+
+        /* a single record does not fit into the block */
+        if (len == size) {
+            size *= 2;
+            data = xrealloc(data, size);
+        }
+
+        nread = fread(data + len, 1, size - len, file);
+
+        if (ferror(file))
+            fatal("could not read input: %s", strerror(errno));
+
+        len += nread;
+        eof = (nread == 0);
+
+        /* skip the header line (first record in the file) */
+        if (skip) {
+
+            size_t  first = record_end(data, len, true);
+
+            /* header not complete yet, so read more data */
+            if ((first == 0) && (! eof))
+                continue;
+
+            if (first == 0)
+                first = len;
+
+            memmove(data, data + first, len - first);
+            len -= first;
+            skip = false;
+        }
+
+        /* at the end of file, the remaining data is the last record */
+        end = eof ? len : record_end(data, len, false);
+
+        if (end > 0) {
+
+            char   *next = xmalloc(size);
+
+            memcpy(next, data + end, len - end);
+
+            queue_push(data, end);
+
+            data = next;
+            len -= end;
+        }
+
+        if (eof)
+            break;
+    }
+
+    free(data);
+
+}
+
+/* Returns position right after the last (or first) complete record, i.e. after
+ * a newline outside quotes, or 0 if there's no complete record. */
+static size_t
+record_end(const char * data, size_t len, bool first)
+{
+
+    size_t  i;
+    size_t  end = 0;
+    bool    in_quotes = false;
+
+    if (format == FORMAT_LINE) {
+
+        if (first) {
+            const char *ptr = memchr(data, '\n', len);
+            return (ptr != NULL) ? (ptr - data + 1) : 0;
+        }
+
+        for (i = len; i > 0; i--)
+            if (data[i - 1] == '\n')
+                return i;
+
+        return 0;
+    }
+
+    /* csv - newlines in quoted values don't terminate the record */
+    for (i = 0; i < len; i++) {
+
+        if (data[i] == '"')
+            in_quotes = ! in_quotes;
+        else if ((data[i] == '\n') && (! in_quotes)) {
+            end = i + 1;
+            if (first)
+                break;
+        }
+    }
+
+    return end;
+
+}
+
+static void
+queue_push(char * data, size_t len)
+{
+
+    InputBlock *block = xmalloc(sizeof(InputBlock));
+
+    block->data = data;
+    block->len = len;
+    block->next = NULL;
+
+    pthread_mutex_lock(&queue.lock);
+
+    while (queue.count >= queue.capacity)
+        pthread_cond_wait(&queue.not_full, &queue.lock);
+
+    if (queue.tail != NULL)
+        queue.tail->next = block;
+    else
+        queue.head = block;
+
+    queue.tail = block;
+    queue.count++;
+
+    pthread_cond_signal(&queue.not_empty);
+    pthread_mutex_unlock(&queue.lock);
+
+}
+
+/* Returns the next block, or NULL when there are no more blocks. */
+static InputBlock *
+queue_pop(void)
+{
+
+    InputBlock *block;
+
+    pthread_mutex_lock(&queue.lock);
+
+    while ((queue.head == NULL) && (! queue.done))
+        pthread_cond_wait(&queue.not_empty, &queue.lock);
+
+    block = queue.head;
+
+    if (block != NULL) {
+
+        queue.head = block->next;
+        if (queue.head == NULL)
+            queue.tail = NULL;
+
+        queue.count--;
+        pthread_cond_signal(&queue.not_full);
+    }
+
+    pthread_mutex_unlock(&queue.lock);
+
+    return block;
+
+}
+
+static void *
+worker_main(void *arg)
+{
+
+    Worker     *worker = (Worker *) arg;
+    InputBlock *block;
+
+    worker->maxlen = 1024;
+    worker->value = xmalloc(worker->maxlen);
+
+    if (batched) {
+        worker->maxhashes = 4096;
+        worker->hashes = xmalloc(worker->maxhashes * HASH_LENGTH);
+    }
+
+    while ((block = queue_pop()) != NULL) {
+
+        process_block(worker, block->data, block->len);
+
+        /* the remaining hashes are added once per block */
+        if (batched)
+            worker_flush_hashes(worker);
+
+        free(block->data);
+        free(block);
+    }
+
+    return NULL;
+
+}
+
+/* Parses records in the block, and adds values from the requested column. */
+static void
+process_block(Worker * worker, const char * data, size_t len)
+{
+
+    size_t  i = 0;
+
+    while (i < len) {
+
+        int     field = 0;
+        size_t  vlen = 0;
+        bool    found = false;      /* the column has a (non-NULL) value */
+
+        if (format == FORMAT_LINE) {
+
+            const char *ptr = memchr(data + i, '\n', len - i);
+            size_t      end = (ptr != NULL) ? (ptr - data) : len;
+            size_t      llen = end - i;
+
+            if ((llen > 0) && (data[end - 1] == '\r'))
+                llen--;
+
+            /* empty lines are skipped */
+            if (llen > 0)
+                worker_add_value(worker, data + i, llen);
+
+            i = end + 1;
+            continue;
+        }
+
+        /* csv record, field by field */
+        while (i < len) {
+
+            bool    keep = (field == column);
+            bool    has_value = false;
+
+            if (data[i] == '"') {
+
+                /* quoted field ("" is an escaped quote) */
+                has_value = true;
+                i++;
+
+                while (i < len) {
+
+                    if (data[i] == '"') {
+                        if ((i + 1 < len) && (data[i + 1] == '"'))
+                            i++;
+                        else {
+                            i++;
+                            break;
+                        }
+                    }
+
+                    if (keep) {
+                        if (vlen == worker->maxlen) {
+                            worker->maxlen *= 2;
+                            worker->value = xrealloc(worker->value, worker->maxlen);
+                        }
+                        worker->value[vlen++] = data[i];
+                    }
+
+                    i++;
+                }
+            }
+
+            /* unquoted part (or garbage after the closing quote) */
+            while ((i < len) && (data[i] != ',') && (data[i] != '\n')) {
+
+                if (data[i] != '\r') {
+
+                    has_value = true;
+
+                    if (keep) {
+                        if (vlen == worker->maxlen) {
+                            worker->maxlen *= 2;
+                            worker->value = xrealloc(worker->value, worker->maxlen);
+                        }
+                        worker->value[vlen++] = data[i];
+                    }
+                }
+
+                i++;
+            }
+
+            if (keep)
+                found = has_value;
+
+            field++;
+
+            /* end of the field - either a separator or end of the record */
+            if ((i < len) && (data[i] == ',')) {
+                i++;
+                continue;
+            }
+
+            i++;
+            break;
+        }
+
+        /* NULL values and missing columns are skipped */
+        if (found)
+            worker_add_value(worker, worker->value, vlen);
+    }
+
+}
+
+static void
+worker_add_value(Worker * worker, const char * value, int len)
+{
+
+    /* estimators without batching add the value directly (always mergeable) */
+    if (! batched) {
+        if (distinct_add(worker->counter, value, len) != 0)
+            fatal("%s", distinct_last_error());
+        return;
+    }
+
+    /* otherwise just compute the hash (added to the counter later) */
+    if (worker->nhashes == worker->maxhashes)
+        worker_flush_hashes(worker);
+
+    distinct_hash(value, len, worker->hashes + worker->nhashes * HASH_LENGTH);
+    worker->nhashes++;
+
+}
+
+/* Adds the hashes computed so far into the private counter (or the shared
+ * one, for estimators that can't be merged). */
+static void
+worker_flush_hashes(Worker * worker)
+{
+
+    if (worker->nhashes == 0)
+        return;
+
+    if (mergeable) {
+        if (distinct_add_hashes(worker->counter, worker->hashes, worker->nhashes) != 0)
+            fatal("%s", distinct_last_error());
+    } else {
+        pthread_mutex_lock(&shared_lock);
+
+        if (distinct_add_hashes(shared_counter, worker->hashes, worker->nhashes) != 0)
+            fatal("%s", distinct_last_error());
+
+        pthread_mutex_unlock(&shared_lock);
+    }
+
+    worker->nhashes = 0;
+
+}
+
+/* Prints the counter in the hex format accepted by the input functions of
+ * the data types (e.g. hyperloglog_in), i.e. the same as bytea. */
+static void
+print_counter(distinct_counter * counter)
+{
+
+    size_t          i;
+    size_t          len;
+    const unsigned char *data = distinct_data(counter, &len);
+
+    static const char hextbl[] = "0123456789abcdef";
+
+    fputs("\\x", stdout);
+
+    for (i = 0; i < len; i++) {
+        putchar(hextbl[(data[i] >> 4) & 0xF]);
+        putchar(hextbl[data[i] & 0xF]);
+    }
+
+    putchar('\n');
+
+}
+
+static distinct_counter *
+create_counter(void)
+{
+
+    distinct_counter *counter;
+
+    if (type == DISTINCT_PCSA)
+        counter = distinct_create_pcsa(nmaps, keysize);
+    else if (type == DISTINCT_PROBABILISTIC)
+        counter = distinct_create_probabilistic(nbytes, nsalts);
+    else
+        counter = distinct_create(type, error_rate, ndistinct);
+
+    if (counter == NULL)
+        fatal("%s", distinct_last_error());
+
+    return counter;
+
+}
+
+static void
+fatal(const char * fmt, ...)
+{
+
+    va_list     args;
+
+    fprintf(stderr, "ERROR: ");
+
+    va_start(args, fmt);
+    vfprintf(stderr, fmt, args);
+    va_end(args);
+
+    fputc('\n', stderr);
+
+    exit(1);
+
+}
+
+static void *
+xmalloc(size_t size)
+{
+
+    void   *ptr = malloc(size);
+
+    if (ptr == NULL)
+        fatal("out of memory");
+
+    return ptr;
+
+}
+
+static void *
+xrealloc(void *ptr, size_t size)
+{
+
+    ptr = realloc(ptr, size);
+
+    if (ptr == NULL)
+        fatal("out of memory");
+
+    return ptr;
+
+}
+
+static void
+usage(const char * progname)
+{
+    printf("%s builds a distinct estimator from values in files (or stdin).\n\n", progname);
+    printf("Usage:\n  %s [OPTION]... [FILE]...\n\n", progname);
+    printf("Options:\n");
+    printf("  -t, --type=NAME        estimator (hyperloglog, adaptive, bitmap, loglog,\n"
+           "                         pcsa, probabilistic, superloglog), default hyperloglog\n");
+    printf("  -e, --error=RATE       error rate (default 0.025)\n");
+    printf("  -n, --ndistinct=N      expected number of distinct values\n");
+    printf("  -m, --nmaps=N          number of bitmaps (pcsa, default 64)\n");
+    printf("  -k, --keysize=N        key size (pcsa, default 4)\n");
+    printf("  -b, --nbytes=N         bytes per bitmap (probabilistic, default 4)\n");
+    printf("  -s, --nsalts=N         number of salts (probabilistic, default 32)\n");
+    printf("  -f, --format=FORMAT    input format (line or csv, default line)\n");
+    printf("  -c, --column=N         column to count (csv, default 1)\n");
+    printf("  -H, --header           skip the first line of each file\n");
+    printf("  -j, --jobs=N           number of worker threads (default 1)\n");
+    printf("  -x, --serialize        print the counter instead of the estimate\n");
+    printf("  -h, --help             show this help\n");
+}
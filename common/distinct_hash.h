@@ -0,0 +1,140 @@
+/* Hashing shared by all the estimators (included by the *_counter.c files of
+ * each extension, see PG_CPPFLAGS in the Makefiles). */
+#ifndef DISTINCT_HASH_H
+#define DISTINCT_HASH_H
+
+#include "postgres.h"
+#include "fmgr.h"
+
+#include "distinct_md5.h"
+
+#if PG_VERSION_NUM >= 140000
+#include "access/detoast.h"
+#include "common/cryptohash.h"
+
+/* pg_cryptohash_final got the length of the result in PostgreSQL 15 */
+#if PG_VERSION_NUM >= 150000
+#define distinct_cryptohash_final(ctx, hash)    pg_cryptohash_final(ctx, hash, DISTINCT_HASH_LENGTH)
+#else
+#define distinct_cryptohash_final(ctx, hash)    pg_cryptohash_final(ctx, hash)
+#endif
+#endif
+
+/* we're using md5, which produces 16B (128-bit) values */
+#define DISTINCT_HASH_LENGTH    16
+
+/* large values stored out of line are hashed in chunks of this size */
+#define DISTINCT_HASH_CHUNK_SIZE    (1024 * 1024)
+
+/* Expands a 64-bit value into a DISTINCT_HASH_LENGTH hash, without computing md5.
+ * Meant for values that are already hashes (fingerprints), but the value is
+ * mixed (using the splitmix64 finalizer) so that it works for other values too. */
+static inline void
+distinct_hash_int64(int64 value, unsigned char * hash)
+{
+
+    uint64 x = (uint64) value;
+    int i;
+
+    for (i = 0; i < DISTINCT_HASH_LENGTH / sizeof(uint64); i++) {
+
+        uint64 z = (x += UINT64CONST(0x9E3779B97F4A7C15));
+
+        z = (z ^ (z >> 30)) * UINT64CONST(0xBF58476D1CE4E5B9);
+        z = (z ^ (z >> 27)) * UINT64CONST(0x94D049BB133111EB);
+        z = z ^ (z >> 31);
+
+        memcpy(hash + i * sizeof(uint64), &z, sizeof(uint64));
+
+    }
+
+}
+
+#if PG_VERSION_NUM >= 140000
+/* Size of a large value stored out of line without compression, which can be
+ * hashed in chunks (by distinct_hash_update_chunks), or -1 for other values. */
+static inline int32
+distinct_hash_chunked_size(struct varlena * value)
+{
+
+    struct varatt_external toast;
+
+    if (! VARATT_IS_EXTERNAL_ONDISK(value))
+        return -1;
+
+    VARATT_EXTERNAL_GET_POINTER(toast, value);
+
+    if (VARATT_EXTERNAL_IS_COMPRESSED(toast) ||
+        (VARATT_EXTERNAL_GET_EXTSIZE(toast) <= DISTINCT_HASH_CHUNK_SIZE))
+        return -1;
+
+    return VARATT_EXTERNAL_GET_EXTSIZE(toast);
+
+}
+
+/* Feeds 'size' bytes of an external value into the md5 context, fetching it
+ * in chunks (see distinct_hash_chunked_size). */
+static inline void
+distinct_hash_update_chunks(pg_cryptohash_ctx * ctx, struct varlena * value, int32 size)
+{
+
+    int32   offset;
+
+    for (offset = 0; offset < size; offset += DISTINCT_HASH_CHUNK_SIZE) {
+
+        struct varlena * chunk = detoast_attr_slice(value, offset,
+                                                    Min(DISTINCT_HASH_CHUNK_SIZE, size - offset));
+
+        if (pg_cryptohash_update(ctx, (uint8 *) VARDATA_ANY(chunk), VARSIZE_ANY_EXHDR(chunk)) < 0)
+            elog(ERROR, "could not compute md5 hash");
+
+        pfree(chunk);
+    }
+
+}
+#endif
+
+/* Computes the hash of a varlena value in any form, i.e. md5 of the data
+ * without the header (the same as adding the plain value to the counter).
+ * Short (1-byte) headers are hashed in place, compressed values have to be
+ * decompressed first (the copy is freed right away, so that large values do
+ * not accumulate in the memory context). Large values stored out of line
+ * without compression are hashed in chunks, without fetching the whole value
+ * into memory - that requires PostgreSQL 14+ (incremental md5). */
+static inline void
+distinct_hash_varlena(Datum element, unsigned char * hash)
+{
+
+    struct varlena * value = (struct varlena *) DatumGetPointer(element);
+
+#if PG_VERSION_NUM >= 140000
+    int32   size = distinct_hash_chunked_size(value);
+
+    if (size > 0) {
+
+        pg_cryptohash_ctx * ctx = pg_cryptohash_create(PG_MD5);
+
+        if (pg_cryptohash_init(ctx) < 0)
+            elog(ERROR, "could not initialize md5 context");
+
+        distinct_hash_update_chunks(ctx, value, size);
+
+        if (distinct_cryptohash_final(ctx, hash) < 0)
+            elog(ERROR, "could not compute md5 hash");
+
+        pg_cryptohash_free(ctx);
+
+        return;
+    }
+#endif
+
+    value = PG_DETOAST_DATUM_PACKED(element);
+
+    distinct_md5(VARDATA_ANY(value), VARSIZE_ANY_EXHDR(value), hash);
+
+    if ((Pointer) value != DatumGetPointer(element))
+        pfree(value);
+
+}
+
+#endif   /* DISTINCT_HASH_H */
@@ -0,0 +1,27 @@
+/* md5 of a buffer, used by all the estimators to hash the elements. This is
+ * included by the estimator sources compiled into libdistinct too, so it
+ * only depends on postgres.h and common/md5.h (libdistinct/shim has both). */
+#ifndef DISTINCT_MD5_H
+#define DISTINCT_MD5_H
+
+#include "postgres.h"
+#include "common/md5.h"
+
+/* pg_md5_binary got the 'errstr' argument in PostgreSQL 15 */
+static inline void
+distinct_md5(const void * data, size_t len, unsigned char * hash)
+{
+
+#if PG_VERSION_NUM >= 150000
+    const char *errstr = NULL;
+
+    if (! pg_md5_binary(data, len, hash, &errstr))
+        elog(ERROR, "could not compute md5 hash: %s", errstr);
+#else
+    if (! pg_md5_binary(data, len, hash))
+        elog(ERROR, "could not compute md5 hash");
+#endif
+
+}
+
+#endif   /* DISTINCT_MD5_H */
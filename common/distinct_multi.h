@@ -0,0 +1,216 @@
+/* Keys for the multi-column functions (X_add_item_multi, X_distinct_multi and
+ * X_accum_multi), shared by all the estimators. */
+#ifndef DISTINCT_MULTI_H
+#define DISTINCT_MULTI_H
+
+#include "postgres.h"
+#include "fmgr.h"
+#include "lib/stringinfo.h"
+#include "utils/lsyscache.h"
+
+#include "distinct_hash.h"
+
+/* type info for arguments of the *_multi functions, cached in fn_extra */
+typedef struct DistinctMultiKeyCache {
+    int     nargs;
+    int16   typlen[FUNC_MAX_ARGS];
+    bool    typbyval[FUNC_MAX_ARGS];
+} DistinctMultiKeyCache;
+
+/* md5 over all the values of a key - computed incrementally on PostgreSQL 14+,
+ * older releases have no incremental md5 so the values are copied into a
+ * buffer and hashed at once (the result is the same) */
+typedef struct DistinctMultiHash {
+#if PG_VERSION_NUM >= 140000
+    pg_cryptohash_ctx  *ctx;
+#else
+    StringInfoData      data;
+#endif
+} DistinctMultiHash;
+
+static inline void
+distinct_multi_hash_init(DistinctMultiHash * state)
+{
+
+#if PG_VERSION_NUM >= 140000
+    state->ctx = pg_cryptohash_create(PG_MD5);
+
+    if (pg_cryptohash_init(state->ctx) < 0)
+        elog(ERROR, "could not initialize md5 context");
+#else
+    initStringInfo(&state->data);
+#endif
+
+}
+
+static inline void
+distinct_multi_hash_update(DistinctMultiHash * state, const void * data, int len)
+{
+
+#if PG_VERSION_NUM >= 140000
+    if (pg_cryptohash_update(state->ctx, (const uint8 *) data, len) < 0)
+        elog(ERROR, "could not compute md5 hash");
+#else
+    appendBinaryStringInfo(&state->data, data, len);
+#endif
+
+}
+
+static inline void
+distinct_multi_hash_final(DistinctMultiHash * state, unsigned char * hash)
+{
+
+#if PG_VERSION_NUM >= 140000
+    if (distinct_cryptohash_final(state->ctx, hash) < 0)
+        elog(ERROR, "could not compute md5 hash");
+
+    pg_cryptohash_free(state->ctx);
+#else
+    distinct_md5(state->data.data, state->data.len, hash);
+
+    pfree(state->data.data);
+#endif
+
+}
+
+/* Returns type info for the VARIADIC "any" arguments (starting at 'argno'),
+ * looked up only on the first call. */
+static inline DistinctMultiKeyCache *
+distinct_multi_get_cache(FunctionCallInfo fcinfo, int argno)
+{
+
+    int     i;
+    DistinctMultiKeyCache * cache = (DistinctMultiKeyCache *) fcinfo->flinfo->fn_extra;
+
+    if (cache != NULL)
+        return cache;
+
+    if (get_fn_expr_variadic(fcinfo->flinfo))
+        elog(ERROR, "VARIADIC arrays are not supported, pass the values as separate arguments");
+
+    cache = MemoryContextAllocZero(fcinfo->flinfo->fn_mcxt, sizeof(DistinctMultiKeyCache));
+    cache->nargs = PG_NARGS() - argno;
+
+    for (i = 0; i < cache->nargs; i++) {
+
+        Oid     element_type = get_fn_expr_argtype(fcinfo->flinfo, argno + i);
+        char    typalign;
+
+        if (! OidIsValid(element_type))
+            elog(ERROR, "could not determine data type of argument %d", argno + i + 1);
+
+        get_typlenbyvalalign(element_type, &cache->typlen[i], &cache->typbyval[i], &typalign);
+    }
+
+    fcinfo->flinfo->fn_extra = cache;
+
+    return cache;
+
+}
+
+/* Data of a value of the i-th argument, which is not a varlena. Values passed
+ * by value are used in place, so 'element' has to point to a local copy. */
+static inline const char *
+distinct_multi_get_value(DistinctMultiKeyCache * cache, int i, Datum * element, int * len)
+{
+
+    if (cache->typlen[i] == -2) {
+        /* cstring */
+        *len = strlen(DatumGetCString(*element));
+        return DatumGetCString(*element);
+    } else if (cache->typbyval[i]) {
+        /* fixed-length, passed by value */
+        *len = cache->typlen[i];
+        return (const char *) element;
+    }
+
+    /* fixed-length, passed by reference */
+    *len = cache->typlen[i];
+    return DatumGetPointer(*element);
+
+}
+
+/* Computes the hash of a key from the VARIADIC "any" arguments (starting at
+ * 'argno'). A single value is hashed just like by X_add_item (so the counter
+ * matches the one built from the plain values), multiple values are fed into
+ * a single md5, each prefixed by its length - so ('ab', 'c') and ('a', 'bc')
+ * are different keys, and no copy of the combined key is needed. Large values
+ * stored out of line are hashed in chunks (see distinct_hash_varlena).
+ *
+ * Returns false if any of the values is NULL (the key should be skipped). */
+static inline bool
+distinct_hash_multi(FunctionCallInfo fcinfo, int argno, unsigned char * hash)
+{
+
+    int                 i;
+    DistinctMultiHash   state;
+    DistinctMultiKeyCache * cache = distinct_multi_get_cache(fcinfo, argno);
+
+    for (i = 0; i < cache->nargs; i++)
+        if (PG_ARGISNULL(argno + i))
+            return false;
+
+    if (cache->nargs == 1) {
+
+        Datum       element = PG_GETARG_DATUM(argno);
+        const char *data;
+        int         len;
+
+        if (cache->typlen[0] == -1) {
+            distinct_hash_varlena(element, hash);
+        } else {
+            data = distinct_multi_get_value(cache, 0, &element, &len);
+            distinct_md5(data, len, hash);
+        }
+
+        return true;
+    }
+
+    distinct_multi_hash_init(&state);
+
+    for (i = 0; i < cache->nargs; i++) {
+
+        Datum       element = PG_GETARG_DATUM(argno + i);
+        const char *data;
+        int         len;
+
+        if (cache->typlen[i] == -1) {
+
+            struct varlena * value = (struct varlena *) DatumGetPointer(element);
+
+#if PG_VERSION_NUM >= 140000
+            int32   size = distinct_hash_chunked_size(value);
+
+            if (size > 0) {
+                distinct_multi_hash_update(&state, &size, sizeof(int32));
+                distinct_hash_update_chunks(state.ctx, value, size);
+                continue;
+            }
+#endif
+
+            /* short headers are used in place, other values are detoasted (and freed) */
+            value = PG_DETOAST_DATUM_PACKED(element);
+            len = VARSIZE_ANY_EXHDR(value);
+
+            distinct_multi_hash_update(&state, &len, sizeof(int32));
+            distinct_multi_hash_update(&state, VARDATA_ANY(value), len);
+
+            if ((Pointer) value != DatumGetPointer(element))
+                pfree(value);
+
+            continue;
+        }
+
+        data = distinct_multi_get_value(cache, i, &element, &len);
+
+        distinct_multi_hash_update(&state, &len, sizeof(int32));
+        distinct_multi_hash_update(&state, data, len);
+    }
+
+    distinct_multi_hash_final(&state, hash);
+
+    return true;
+
+}
+
+#endif   /* DISTINCT_MULTI_H */
@@ -0,0 +1,47 @@
+/* Static tracepoints (USDT) in the estimators, so that latency of merges and
+ * estimates may be measured on live systems using bpftrace, perf or SystemTap,
+ * e.g.
+ *
+ *   bpftrace -e 'usdt:/path/to/hyperloglog_counter.so:hyperloglog:estimate__start { ... }'
+ *
+ * Each estimator defines its probes in X_probes.h (the provider is the name
+ * of the estimator), using the DISTINCT_PROBEn macros.
+ *
+ * The probes are compiled in only when the server is built with --enable-dtrace
+ * (ENABLE_DTRACE in pg_config.h), using the sys/sdt.h macros directly (so there
+ * is no dtrace -h / -G step). A probe without a tracer attached is just a nop,
+ * and without ENABLE_DTRACE the macros are empty. libdistinct is built without
+ * the probes, unless built with DTRACE=1.
+ *
+ * libdistinct itself has probes for the batches added by distinct_add_hashes
+ * (provider "distinct"), for all the estimators
+ *
+ *   batch__start     (type, nhashes)
+ *   batch__done      (type, nhashes)
+ *
+ * The estimators adding the batch at once (hyperloglog and pcsa) have their
+ * own batch probes, with the geometry of the counter.
+ */
+#ifndef DISTINCT_PROBES_H
+#define DISTINCT_PROBES_H
+
+#ifdef ENABLE_DTRACE
+
+#include <sys/sdt.h>
+
+#define DISTINCT_PROBE2(provider, name, a1, a2)             DTRACE_PROBE2(provider, name, a1, a2)
+#define DISTINCT_PROBE3(provider, name, a1, a2, a3)         DTRACE_PROBE3(provider, name, a1, a2, a3)
+#define DISTINCT_PROBE4(provider, name, a1, a2, a3, a4)     DTRACE_PROBE4(provider, name, a1, a2, a3, a4)
+
+#else
+
+#define DISTINCT_PROBE2(provider, name, a1, a2)             do {} while (0)
+#define DISTINCT_PROBE3(provider, name, a1, a2, a3)         do {} while (0)
+#define DISTINCT_PROBE4(provider, name, a1, a2, a3, a4)     do {} while (0)
+
+#endif
+
+#define DISTINCT_BATCH_START(type, nhashes)     DISTINCT_PROBE2(distinct, batch__start, type, nhashes)
+#define DISTINCT_BATCH_DONE(type, nhashes)      DISTINCT_PROBE2(distinct, batch__done, type, nhashes)
+
+#endif   /* DISTINCT_PROBES_H */
@@ -0,0 +1,278 @@
+/* Incremental refresh of rollup tables (X_rollup_refresh), shared by the
+ * estimators. */
+#ifndef DISTINCT_ROLLUP_H
+#define DISTINCT_ROLLUP_H
+
+#include "postgres.h"
+#include "fmgr.h"
+#include "catalog/pg_type.h"
+#include "executor/spi.h"
+#include "lib/stringinfo.h"
+#include "utils/array.h"
+#include "utils/builtins.h"
+#include "utils/guc.h"
+#include "utils/lsyscache.h"
+
+/* maximum number of parameters of the accum aggregate (after the item) */
+#define DISTINCT_ROLLUP_MAX_ARGS    4
+
+/* The watermarks are stored as text, so that a single table works for any
+ * type of the watermark column. The conversions use fixed settings (just like
+ * postgres_fdw does for values sent to the remote server), otherwise changing
+ * DateStyle or TimeZone between two refreshes would shift the watermark.
+ * Returns the GUC nest level, to be restored by AtEOXact_GUC. */
+static inline int
+distinct_rollup_set_guc(void)
+{
+
+    int     nestlevel = NewGUCNestLevel();
+
+    (void) set_config_option("datestyle", "ISO, YMD", PGC_USERSET, PGC_S_SESSION,
+                             GUC_ACTION_SAVE, true, 0, false);
+    (void) set_config_option("timezone", "UTC", PGC_USERSET, PGC_S_SESSION,
+                             GUC_ACTION_SAVE, true, 0, false);
+    (void) set_config_option("intervalstyle", "postgres", PGC_USERSET, PGC_S_SESSION,
+                             GUC_ACTION_SAVE, true, 0, false);
+    (void) set_config_option("extra_float_digits", "3", PGC_USERSET, PGC_S_SESSION,
+                             GUC_ACTION_SAVE, true, 0, false);
+
+    return nestlevel;
+
+}
+
+/* schema-qualified (and quoted) name of a relation */
+static inline const char *
+distinct_rollup_relname(Oid relid)
+{
+
+    char   *relname = get_rel_name(relid);
+
+    if (relname == NULL)
+        elog(ERROR, "relation with OID %u does not exist", relid);
+
+    return quote_qualified_identifier(get_namespace_name(get_rel_namespace(relid)), relname);
+
+}
+
+/* Merges rows of the source table newer than the stored watermark into the
+ * rollup table, with an estimator of the item expression for each group.
+ * The arguments of the SQL function are
+ *
+ *     (rollup regclass, counter_column name, source regclass,
+ *      watermark_column name, item text, group_columns name[],
+ *      group_exprs text[], ...)
+ *
+ * followed by parameters of the accum aggregate, passed in 'args' (the
+ * caller knows their types). Only group_exprs may be NULL (the group columns
+ * are used then). Returns the number of rollup rows inserted or updated.
+ *
+ * The watermarks table and the prefix_accum / prefix_merge functions are
+ * qualified with the schema of the calling function, so the search_path
+ * does not matter. The item and group expressions are evaluated with the
+ * caller's settings (e.g. created_at::date depends on TimeZone).
+ *
+ * The watermark row is locked first, so concurrent refreshes of the same
+ * rollup wait for each other, and the new watermark is determined before
+ * reading the rows, so rows arriving during the refresh are left for the
+ * next one. */
+static inline int64
+distinct_rollup_refresh(FunctionCallInfo fcinfo, const char * prefix,
+                        int nargs, Oid * argtypes, Datum * args)
+{
+
+    int         i, ngroups, nexprs;
+    Oid         rollup, source;
+    const char *counter_column, *watermark_column, *item;
+    const char *schema, *watermarks, *source_name;
+    AttrNumber  attnum;
+    Oid         wtype, wcollation, infunc, outfunc, ioparam;
+    int32       wtypmod;
+    bool        isvarlena;
+    Datum      *groups, *exprs;
+    bool       *nulls;
+    Datum       values[3 + DISTINCT_ROLLUP_MAX_ARGS];
+    Oid         types[3 + DISTINCT_ROLLUP_MAX_ARGS];
+    char        valnulls[3 + DISTINCT_ROLLUP_MAX_ARGS];
+    char       *old, *current;
+    bool        isnull;
+    int64       count;
+    int         nestlevel;
+    StringInfoData  columns, query;
+
+    Assert(nargs <= DISTINCT_ROLLUP_MAX_ARGS);
+
+    for (i = 0; i < PG_NARGS(); i++)
+        if ((i != 6) && PG_ARGISNULL(i))
+            elog(ERROR, "only group_exprs may be NULL when refreshing a rollup");
+
+    rollup = PG_GETARG_OID(0);
+    counter_column = NameStr(*PG_GETARG_NAME(1));
+    source = PG_GETARG_OID(2);
+    watermark_column = NameStr(*PG_GETARG_NAME(3));
+    item = text_to_cstring(PG_GETARG_TEXT_PP(4));
+
+    deconstruct_array(PG_GETARG_ARRAYTYPE_P(5), NAMEOID, NAMEDATALEN, false, 'c',
+                      &groups, &nulls, &ngroups);
+
+    for (i = 0; i < ngroups; i++)
+        if (nulls[i])
+            elog(ERROR, "group columns must not be NULL");
+
+    if (ngroups == 0)
+        elog(ERROR, "no group columns for rollup \"%s\"", distinct_rollup_relname(rollup));
+
+    /* the group expressions default to the group columns */
+    initStringInfo(&columns);
+
+    for (i = 0; i < ngroups; i++)
+        appendStringInfo(&columns, "%s%s", (i > 0) ? ", " : "",
+                         quote_identifier(NameStr(*DatumGetName(groups[i]))));
+
+    if (PG_ARGISNULL(6)) {
+        exprs = NULL;
+        nexprs = ngroups;
+    } else {
+
+        deconstruct_array(PG_GETARG_ARRAYTYPE_P(6), TEXTOID, -1, false, 'i',
+                          &exprs, &nulls, &nexprs);
+
+        for (i = 0; i < nexprs; i++)
+            if (nulls[i])
+                elog(ERROR, "group expressions must not be NULL");
+    }
+
+    if (nexprs != ngroups)
+        elog(ERROR, "number of group expressions does not match the group columns");
+
+    if (get_attnum(rollup, counter_column) == InvalidAttrNumber)
+        elog(ERROR, "column \"%s\" does not exist in \"%s\"",
+             counter_column, distinct_rollup_relname(rollup));
+
+    /* type of the watermark column, and the I/O functions to store it */
+    source_name = distinct_rollup_relname(source);
+    attnum = get_attnum(source, watermark_column);
+
+    if (attnum == InvalidAttrNumber)
+        elog(ERROR, "column \"%s\" does not exist in \"%s\"", watermark_column, source_name);
+
+    get_atttypetypmodcoll(source, attnum, &wtype, &wtypmod, &wcollation);
+    getTypeInputInfo(wtype, &infunc, &ioparam);
+    getTypeOutputInfo(wtype, &outfunc, &isvarlena);
+
+    /* objects of the extension, in the schema of this function */
+    schema = quote_identifier(get_namespace_name(get_func_namespace(fcinfo->flinfo->fn_oid)));
+    watermarks = psprintf("%s.%s_rollup_watermarks", schema, prefix);
+
+    if (SPI_connect() != SPI_OK_CONNECT)
+        elog(ERROR, "SPI_connect failed");
+
+    /* lock the watermark, so that concurrent refreshes of the rollup wait for each other */
+    types[0] = REGCLASSOID;
+    types[1] = REGCLASSOID;
+    values[0] = ObjectIdGetDatum(rollup);
+    values[1] = ObjectIdGetDatum(source);
+
+    if (SPI_execute_with_args(psprintf("INSERT INTO %s (rollup_table, source_table) VALUES ($1, $2) "
+                                       "ON CONFLICT DO NOTHING", watermarks),
+                              2, types, values, NULL, false, 0) != SPI_OK_INSERT)
+        elog(ERROR, "failed to create the watermark of rollup \"%s\"", distinct_rollup_relname(rollup));
+
+    if ((SPI_execute_with_args(psprintf("SELECT watermark FROM %s WHERE rollup_table = $1 "
+                                        "AND source_table = $2 FOR UPDATE", watermarks),
+                               2, types, values, NULL, false, 0) != SPI_OK_SELECT) ||
+        (SPI_processed != 1))
+        elog(ERROR, "failed to lock the watermark of rollup \"%s\"", distinct_rollup_relname(rollup));
+
+    old = SPI_getvalue(SPI_tuptable->vals[0], SPI_tuptable->tupdesc, 1);
+
+    /* the rows are compared with the typed watermark ($1), NULL on the first refresh */
+    types[0] = wtype;
+    values[0] = (Datum) 0;
+    valnulls[0] = 'n';
+
+    if (old != NULL) {
+        nestlevel = distinct_rollup_set_guc();
+        values[0] = OidInputFunctionCall(infunc, old, ioparam, wtypmod);
+        valnulls[0] = ' ';
+        AtEOXact_GUC(true, nestlevel);
+    }
+
+    /* the new watermark (rows arriving during the refresh are left for the next one) */
+    if (SPI_execute_with_args(psprintf("SELECT max(%s) FROM %s WHERE $1 IS NULL OR %s > $1",
+                                       quote_identifier(watermark_column), source_name,
+                                       quote_identifier(watermark_column)),
+                              1, types, values, valnulls, false, 0) != SPI_OK_SELECT)
+        elog(ERROR, "failed to get the watermark of \"%s\"", source_name);
+
+    values[1] = SPI_getbinval(SPI_tuptable->vals[0], SPI_tuptable->tupdesc, 1, &isnull);
+
+    if (isnull) {
+        SPI_finish();
+        return 0;
+    }
+
+    types[1] = wtype;
+    valnulls[1] = ' ';
+
+    /* parameters of the accum aggregate */
+    for (i = 0; i < nargs; i++) {
+        types[2 + i] = argtypes[i];
+        values[2 + i] = args[i];
+        valnulls[2 + i] = ' ';
+    }
+
+    /* build the estimators for the new rows, and merge them into the rollup in one statement */
+    initStringInfo(&query);
+
+    appendStringInfo(&query, "WITH merged AS (INSERT INTO %s AS r (%s, %s) SELECT ",
+                     distinct_rollup_relname(rollup), columns.data, quote_identifier(counter_column));
+
+    for (i = 0; i < ngroups; i++)
+        appendStringInfo(&query, "%s, ", (exprs != NULL) ? TextDatumGetCString(exprs[i]) :
+                         quote_identifier(NameStr(*DatumGetName(groups[i]))));
+
+    appendStringInfo(&query, "%s.%s_accum(%s", schema, prefix, item);
+
+    for (i = 0; i < nargs; i++)
+        appendStringInfo(&query, ", $%d", 3 + i);
+
+    appendStringInfo(&query, ") FROM %s WHERE ($1 IS NULL OR %s > $1) AND %s <= $2 GROUP BY ",
+                     source_name, quote_identifier(watermark_column), quote_identifier(watermark_column));
+
+    for (i = 0; i < ngroups; i++)
+        appendStringInfo(&query, "%s%d", (i > 0) ? ", " : "", i + 1);
+
+    appendStringInfo(&query, " ON CONFLICT (%s) DO UPDATE SET %s = %s.%s_merge(r.%s, EXCLUDED.%s) "
+                     "RETURNING 1) SELECT count(*) FROM merged",
+                     columns.data, quote_identifier(counter_column), schema, prefix,
+                     quote_identifier(counter_column), quote_identifier(counter_column));
+
+    if (SPI_execute_with_args(query.data, 2 + nargs, types, values, valnulls, false, 0) != SPI_OK_SELECT)
+        elog(ERROR, "failed to refresh rollup \"%s\"", distinct_rollup_relname(rollup));
+
+    count = DatumGetInt64(SPI_getbinval(SPI_tuptable->vals[0], SPI_tuptable->tupdesc, 1, &isnull));
+
+    /* store the new watermark (as text, see distinct_rollup_set_guc) */
+    nestlevel = distinct_rollup_set_guc();
+    current = OidOutputFunctionCall(outfunc, values[1]);
+    AtEOXact_GUC(true, nestlevel);
+
+    types[0] = REGCLASSOID;
+    types[1] = REGCLASSOID;
+    types[2] = TEXTOID;
+    values[0] = ObjectIdGetDatum(rollup);
+    values[1] = ObjectIdGetDatum(source);
+    values[2] = CStringGetTextDatum(current);
+
+    if (SPI_execute_with_args(psprintf("UPDATE %s SET watermark = $3 WHERE rollup_table = $1 "
+                                       "AND source_table = $2", watermarks),
+                              3, types, values, NULL, false, 0) != SPI_OK_UPDATE)
+        elog(ERROR, "failed to update the watermark of rollup \"%s\"", distinct_rollup_relname(rollup));
+
+    SPI_finish();
+
+    return count;
+
+}
+
+#endif
@@ -0,0 +1,709 @@
+-- Sliding-window HyperLogLog
+
+-- sliding-window HyperLogLog counter (shell type)
+CREATE TYPE hyperloglog_window_estimator;
+
+-- get estimator size for the requested error rate / number of slots per bin
+CREATE FUNCTION hyperloglog_window_size(error_rate real, nslots int) RETURNS int
+     AS 'MODULE_PATHNAME', 'hyperloglog_window_size'
+     LANGUAGE C;
+
+-- creates a new sliding-window estimator with a given error rate / number of slots per bin
+CREATE FUNCTION hyperloglog_window_init(error_rate real, nslots int) RETURNS hyperloglog_window_estimator
+     AS 'MODULE_PATHNAME', 'hyperloglog_window_init'
+     LANGUAGE C;
+
+-- merges the two estimators, creates a new one
+CREATE FUNCTION hyperloglog_window_merge(estimator1 hyperloglog_window_estimator, estimator2 hyperloglog_window_estimator) RETURNS hyperloglog_window_estimator
+     AS 'MODULE_PATHNAME', 'hyperloglog_window_merge_simple'
+     LANGUAGE C;
+
+-- merges the second estimator into the first one
+CREATE FUNCTION hyperloglog_window_merge_agg(estimator1 hyperloglog_window_estimator, estimator2 hyperloglog_window_estimator) RETURNS hyperloglog_window_estimator
+     AS 'MODULE_PATHNAME', 'hyperloglog_window_merge_agg'
+     LANGUAGE C;
+
+-- add an item (seen at the given time) to the estimator
+CREATE FUNCTION hyperloglog_window_add_item(counter hyperloglog_window_estimator, item anyelement, ts timestamptz) RETURNS void
+     AS 'MODULE_PATHNAME', 'hyperloglog_window_add_item'
+     LANGUAGE C;
+
+-- get estimate of distinct values in the window of the given length (ending now)
+CREATE FUNCTION hyperloglog_window_get_estimate(counter hyperloglog_window_estimator, window_length interval) RETURNS real
+     AS 'MODULE_PATHNAME', 'hyperloglog_window_get_estimate'
+     LANGUAGE C STABLE STRICT;
+
+-- get estimate of distinct values seen since the given timestamp
+CREATE FUNCTION hyperloglog_window_get_estimate(counter hyperloglog_window_estimator, since timestamptz) RETURNS real
+     AS 'MODULE_PATHNAME', 'hyperloglog_window_get_estimate_since'
+     LANGUAGE C IMMUTABLE STRICT;
+
+-- regular estimator for the window of the given length (ending now)
+CREATE FUNCTION hyperloglog_window_snapshot(counter hyperloglog_window_estimator, window_length interval) RETURNS hyperloglog_estimator
+     AS 'MODULE_PATHNAME', 'hyperloglog_window_snapshot_window'
+     LANGUAGE C STABLE STRICT;
+
+-- reset the estimator (start counting from the beginning)
+CREATE FUNCTION hyperloglog_window_reset(counter hyperloglog_window_estimator) RETURNS void
+     AS 'MODULE_PATHNAME', 'hyperloglog_window_reset'
+     LANGUAGE C STRICT;
+
+-- length of the estimator (about the same as hyperloglog_window_size with existing estimator)
+CREATE FUNCTION length(counter hyperloglog_window_estimator) RETURNS int
+     AS 'MODULE_PATHNAME', 'hyperloglog_length'
+     LANGUAGE C STRICT;
+
+/* functions for aggregate functions */
+
+CREATE FUNCTION hyperloglog_window_add_item_agg(counter hyperloglog_window_estimator, item anyelement, ts timestamptz, error_rate real, nslots int) RETURNS hyperloglog_window_estimator
+     AS 'MODULE_PATHNAME', 'hyperloglog_window_add_item_agg'
+     LANGUAGE C;
+
+CREATE FUNCTION hyperloglog_window_add_item_agg2(counter hyperloglog_window_estimator, item anyelement, ts timestamptz) RETURNS hyperloglog_window_estimator
+     AS 'MODULE_PATHNAME', 'hyperloglog_window_add_item_agg2'
+     LANGUAGE C;
+
+/* input/output functions */
+
+CREATE FUNCTION hyperloglog_window_in(value cstring) RETURNS hyperloglog_window_estimator
+     AS 'MODULE_PATHNAME', 'hyperloglog_in'
+     LANGUAGE C IMMUTABLE STRICT;
+
+CREATE FUNCTION hyperloglog_window_out(counter hyperloglog_window_estimator) RETURNS cstring
+     AS 'MODULE_PATHNAME', 'hyperloglog_out'
+     LANGUAGE C IMMUTABLE STRICT;
+
+-- actual sliding-window counter data type
+CREATE TYPE hyperloglog_window_estimator (
+    INPUT = hyperloglog_window_in,
+    OUTPUT = hyperloglog_window_out,
+    LIKE  = bytea
+);
+
+-- build the sliding-window counter (item, timestamp, error rate, slots per bin)
+CREATE AGGREGATE hyperloglog_window_accum(anyelement, timestamptz, real, int)
+(
+    sfunc = hyperloglog_window_add_item_agg,
+    stype = hyperloglog_window_estimator
+);
+
+-- build the sliding-window counter (item, timestamp)
+CREATE AGGREGATE hyperloglog_window_accum(anyelement, timestamptz)
+(
+    sfunc = hyperloglog_window_add_item_agg2,
+    stype = hyperloglog_window_estimator
+);
+
+-- merges all the counters into just a single one (e.g. after running hyperloglog_window_accum)
+CREATE AGGREGATE hyperloglog_window_merge(hyperloglog_window_estimator)
+(
+    sfunc = hyperloglog_window_merge_agg,
+    stype = hyperloglog_window_estimator
+);
+
+-- merges two estimators into a new one
+CREATE OPERATOR || (
+    PROCEDURE = hyperloglog_window_merge,
+    LEFTARG  = hyperloglog_window_estimator,
+    RIGHTARG = hyperloglog_window_estimator,
+    COMMUTATOR = ||
+);
+
+-- Shared-memory counters (require hyperloglog_counter in shared_preload_libraries)
+
+-- add an item to the named shared counter (created on the first add)
+CREATE FUNCTION hyperloglog_shared_add_item(counter_name text, item anyelement) RETURNS void
+     AS 'MODULE_PATHNAME', 'hyperloglog_shared_add_item'
+     LANGUAGE C;
+
+-- merges the estimator into the named shared counter (created if needed)
+CREATE FUNCTION hyperloglog_shared_merge(counter_name text, counter hyperloglog_estimator) RETURNS void
+     AS 'MODULE_PATHNAME', 'hyperloglog_shared_merge'
+     LANGUAGE C;
+
+-- get current estimate of the named shared counter (NULL if it does not exist)
+CREATE FUNCTION hyperloglog_shared_get_estimate(counter_name text) RETURNS real
+     AS 'MODULE_PATHNAME', 'hyperloglog_shared_get_estimate'
+     LANGUAGE C STRICT;
+
+-- copy the named shared counter into a regular estimator (NULL if it does not exist)
+CREATE FUNCTION hyperloglog_shared_snapshot(counter_name text) RETURNS hyperloglog_estimator
+     AS 'MODULE_PATHNAME', 'hyperloglog_shared_snapshot'
+     LANGUAGE C STRICT;
+
+-- reset the named shared counter (start counting from the beginning)
+CREATE FUNCTION hyperloglog_shared_reset(counter_name text) RETURNS void
+     AS 'MODULE_PATHNAME', 'hyperloglog_shared_reset'
+     LANGUAGE C STRICT;
+
+-- finishes the counter built by the _accum aggregates (caches the estimate in it)
+CREATE FUNCTION hyperloglog_accum_final(counter hyperloglog_estimator) RETURNS hyperloglog_estimator
+     AS 'MODULE_PATHNAME', 'hyperloglog_accum_final'
+     LANGUAGE C PARALLEL SAFE;
+
+-- parallel aggregation (partial counters combined using hyperloglog_merge_agg)
+
+ALTER FUNCTION hyperloglog_merge_agg(hyperloglog_estimator, hyperloglog_estimator) PARALLEL SAFE;
+ALTER FUNCTION hyperloglog_get_estimate(hyperloglog_estimator) PARALLEL SAFE;
+ALTER FUNCTION hyperloglog_add_item_agg(hyperloglog_estimator, anyelement, real) PARALLEL SAFE;
+ALTER FUNCTION hyperloglog_add_item_agg2(hyperloglog_estimator, anyelement) PARALLEL SAFE;
+
+CREATE OR REPLACE AGGREGATE hyperloglog_distinct(anyelement, real)
+(
+    sfunc = hyperloglog_add_item_agg,
+    stype = hyperloglog_estimator,
+    finalfunc = hyperloglog_get_estimate,
+    combinefunc = hyperloglog_merge_agg,
+    parallel = safe,
+    finalfunc_modify = read_only
+);
+
+CREATE OR REPLACE AGGREGATE hyperloglog_distinct(anyelement)
+(
+    sfunc = hyperloglog_add_item_agg2,
+    stype = hyperloglog_estimator,
+    finalfunc = hyperloglog_get_estimate,
+    combinefunc = hyperloglog_merge_agg,
+    parallel = safe,
+    finalfunc_modify = read_only
+);
+
+CREATE OR REPLACE AGGREGATE hyperloglog_accum(anyelement, real)
+(
+    sfunc = hyperloglog_add_item_agg,
+    stype = hyperloglog_estimator,
+    finalfunc = hyperloglog_accum_final,
+    combinefunc = hyperloglog_merge_agg,
+    parallel = safe,
+    finalfunc_modify = read_only
+);
+
+CREATE OR REPLACE AGGREGATE hyperloglog_accum(anyelement)
+(
+    sfunc = hyperloglog_add_item_agg2,
+    stype = hyperloglog_estimator,
+    finalfunc = hyperloglog_accum_final,
+    combinefunc = hyperloglog_merge_agg,
+    parallel = safe,
+    finalfunc_modify = read_only
+);
+
+CREATE OR REPLACE AGGREGATE hyperloglog_merge(hyperloglog_estimator)
+(
+    sfunc = hyperloglog_merge_agg,
+    stype = hyperloglog_estimator,
+    finalfunc = hyperloglog_accum_final,
+    combinefunc = hyperloglog_merge_agg,
+    parallel = safe,
+    finalfunc_modify = read_only
+);
+
+-- COUNT(DISTINCT x) rewrite (see hyperloglog.rewrite_count_distinct)
+
+-- get current estimate of the distinct values (as a bigint, 0 for empty input)
+CREATE FUNCTION hyperloglog_get_estimate_bigint(counter hyperloglog_estimator) RETURNS bigint
+     AS 'MODULE_PATHNAME', 'hyperloglog_get_estimate_bigint'
+     LANGUAGE C PARALLEL SAFE;
+
+-- drop-in replacement for count(DISTINCT item)
+CREATE AGGREGATE hyperloglog_count_distinct(anyelement, real)
+(
+    sfunc = hyperloglog_add_item_agg,
+    stype = hyperloglog_estimator,
+    finalfunc = hyperloglog_get_estimate_bigint,
+    combinefunc = hyperloglog_merge_agg,
+    parallel = safe,
+    finalfunc_modify = read_only
+);
+
+-- ANALYZE using HyperLogLog
+
+-- Computes the number of distinct values for the columns (all columns by default)
+-- in a single pass over the table, and stores it as the n_distinct override for
+-- the columns, so that ANALYZE uses it instead of the sample-based estimate. The
+-- estimate is stored as a fraction of rows (negative value) when it exceeds 10%
+-- of the rows, just like ANALYZE does, so that it scales as the table grows.
+CREATE FUNCTION hyperloglog_analyze(rel regclass, columns name[] DEFAULT NULL, error_rate real DEFAULT 0.01, run_analyze bool DEFAULT true)
+    RETURNS TABLE (attname name, n_distinct real) AS $$
+DECLARE
+    v_columns   name[];
+    v_exprs     text[];
+    v_rows      float8;
+    v_estimates real[];
+    v_ndistinct real;
+BEGIN
+
+    SELECT array_agg(a.attname ORDER BY a.attnum) INTO v_columns
+      FROM pg_attribute a
+     WHERE a.attrelid = rel AND a.attnum > 0 AND NOT a.attisdropped
+       AND (columns IS NULL OR a.attname = ANY (columns));
+
+    IF (v_columns IS NULL) THEN
+        RAISE EXCEPTION 'no columns to analyze in "%"', rel;
+    ELSIF (columns IS NOT NULL AND array_length(v_columns, 1) <> array_length(columns, 1)) THEN
+        RAISE EXCEPTION 'some of the columns do not exist in "%"', rel;
+    END IF;
+
+    SELECT array_agg(format('hyperloglog_distinct(%I, $1)', c)) INTO v_exprs
+      FROM unnest(v_columns) c;
+
+    -- a single pass over the table, estimating all the columns at once
+    EXECUTE format('SELECT count(*)::float8, ARRAY[%s]::real[] FROM %s',
+                   array_to_string(v_exprs, ', '), rel)
+       INTO v_rows, v_estimates
+      USING error_rate;
+
+    FOR i IN 1..array_length(v_columns, 1) LOOP
+
+        attname := v_columns[i];
+        v_ndistinct := coalesce(v_estimates[i], 0);
+
+        -- nothing to base the estimate on
+        IF (v_rows = 0) THEN
+            CONTINUE;
+        END IF;
+
+        -- the estimate can't exceed the number of rows
+        v_ndistinct := least(v_ndistinct, v_rows);
+
+        IF (v_ndistinct > 0.1 * v_rows) THEN
+            n_distinct := - (v_ndistinct / v_rows);
+        ELSE
+            n_distinct := round(v_ndistinct);
+        END IF;
+
+        EXECUTE format('ALTER TABLE %s ALTER COLUMN %I SET (n_distinct = %s)',
+                       rel, attname, n_distinct);
+
+        RETURN NEXT;
+
+    END LOOP;
+
+    IF (run_analyze) THEN
+        EXECUTE format('ANALYZE %s (%s)', rel,
+                       (SELECT string_agg(quote_ident(c), ', ') FROM unnest(v_columns) c));
+    END IF;
+
+END;
+$$ LANGUAGE plpgsql;
+
+-- pre-hashed values (bytea with at least 16 bytes, or bigint)
+
+CREATE FUNCTION hyperloglog_add_hash(counter hyperloglog_estimator, hash bytea) RETURNS void
+     AS 'MODULE_PATHNAME', 'hyperloglog_add_hashed'
+     LANGUAGE C;
+
+CREATE FUNCTION hyperloglog_add_hash(counter hyperloglog_estimator, hash bigint) RETURNS void
+     AS 'MODULE_PATHNAME', 'hyperloglog_add_hashed'
+     LANGUAGE C;
+
+CREATE FUNCTION hyperloglog_add_hashed_agg(counter hyperloglog_estimator, hash bytea, error_rate real) RETURNS hyperloglog_estimator
+     AS 'MODULE_PATHNAME', 'hyperloglog_add_hashed_agg'
+     LANGUAGE C PARALLEL SAFE;
+
+CREATE FUNCTION hyperloglog_add_hashed_agg(counter hyperloglog_estimator, hash bigint, error_rate real) RETURNS hyperloglog_estimator
+     AS 'MODULE_PATHNAME', 'hyperloglog_add_hashed_agg'
+     LANGUAGE C PARALLEL SAFE;
+
+CREATE FUNCTION hyperloglog_add_hashed_agg2(counter hyperloglog_estimator, hash bytea) RETURNS hyperloglog_estimator
+     AS 'MODULE_PATHNAME', 'hyperloglog_add_hashed_agg2'
+     LANGUAGE C PARALLEL SAFE;
+
+CREATE FUNCTION hyperloglog_add_hashed_agg2(counter hyperloglog_estimator, hash bigint) RETURNS hyperloglog_estimator
+     AS 'MODULE_PATHNAME', 'hyperloglog_add_hashed_agg2'
+     LANGUAGE C PARALLEL SAFE;
+
+CREATE AGGREGATE hyperloglog_distinct_hashed(bytea, real)
+(
+    sfunc = hyperloglog_add_hashed_agg,
+    stype = hyperloglog_estimator,
+    finalfunc = hyperloglog_get_estimate,
+    combinefunc = hyperloglog_merge_agg,
+    parallel = safe,
+    finalfunc_modify = read_only
+);
+
+CREATE AGGREGATE hyperloglog_distinct_hashed(bytea)
+(
+    sfunc = hyperloglog_add_hashed_agg2,
+    stype = hyperloglog_estimator,
+    finalfunc = hyperloglog_get_estimate,
+    combinefunc = hyperloglog_merge_agg,
+    parallel = safe,
+    finalfunc_modify = read_only
+);
+
+CREATE AGGREGATE hyperloglog_accum_hashed(bytea, real)
+(
+    sfunc = hyperloglog_add_hashed_agg,
+    stype = hyperloglog_estimator,
+    finalfunc = hyperloglog_accum_final,
+    combinefunc = hyperloglog_merge_agg,
+    parallel = safe,
+    finalfunc_modify = read_only
+);
+
+CREATE AGGREGATE hyperloglog_accum_hashed(bytea)
+(
+    sfunc = hyperloglog_add_hashed_agg2,
+    stype = hyperloglog_estimator,
+    finalfunc = hyperloglog_accum_final,
+    combinefunc = hyperloglog_merge_agg,
+    parallel = safe,
+    finalfunc_modify = read_only
+);
+
+CREATE AGGREGATE hyperloglog_distinct_hashed(bigint, real)
+(
+    sfunc = hyperloglog_add_hashed_agg,
+    stype = hyperloglog_estimator,
+    finalfunc = hyperloglog_get_estimate,
+    combinefunc = hyperloglog_merge_agg,
+    parallel = safe,
+    finalfunc_modify = read_only
+);
+
+CREATE AGGREGATE hyperloglog_distinct_hashed(bigint)
+(
+    sfunc = hyperloglog_add_hashed_agg2,
+    stype = hyperloglog_estimator,
+    finalfunc = hyperloglog_get_estimate,
+    combinefunc = hyperloglog_merge_agg,
+    parallel = safe,
+    finalfunc_modify = read_only
+);
+
+CREATE AGGREGATE hyperloglog_accum_hashed(bigint, real)
+(
+    sfunc = hyperloglog_add_hashed_agg,
+    stype = hyperloglog_estimator,
+    finalfunc = hyperloglog_accum_final,
+    combinefunc = hyperloglog_merge_agg,
+    parallel = safe,
+    finalfunc_modify = read_only
+);
+
+CREATE AGGREGATE hyperloglog_accum_hashed(bigint)
+(
+    sfunc = hyperloglog_add_hashed_agg2,
+    stype = hyperloglog_estimator,
+    finalfunc = hyperloglog_accum_final,
+    combinefunc = hyperloglog_merge_agg,
+    parallel = safe,
+    finalfunc_modify = read_only
+);
+
+-- build a counter from a server-side file (csv, text or line format)
+CREATE FUNCTION hyperloglog_from_file(path text, col int DEFAULT 1, format text DEFAULT 'csv', error_rate real DEFAULT 0.025, header bool DEFAULT false)
+     RETURNS hyperloglog_estimator
+     AS 'MODULE_PATHNAME', 'hyperloglog_from_file'
+     LANGUAGE C STRICT;
+
+-- stores of many counters in a memory-mapped file (for offline rollups)
+CREATE FUNCTION hyperloglog_store_create(path text, error_rate real DEFAULT 0.025, capacity bigint DEFAULT 1000000, keysize int DEFAULT 64)
+     RETURNS void
+     AS 'MODULE_PATHNAME', 'hyperloglog_store_create_file'
+     LANGUAGE C STRICT;
+
+CREATE FUNCTION hyperloglog_store_merge(path text, key text, counter hyperloglog_estimator)
+     RETURNS void
+     AS 'MODULE_PATHNAME', 'hyperloglog_store_merge_counter'
+     LANGUAGE C STRICT;
+
+CREATE FUNCTION hyperloglog_store_get(path text, key text)
+     RETURNS hyperloglog_estimator
+     AS 'MODULE_PATHNAME', 'hyperloglog_store_get_counter'
+     LANGUAGE C STRICT;
+
+CREATE FUNCTION hyperloglog_store_get_estimate(path text, key text)
+     RETURNS real
+     AS 'MODULE_PATHNAME', 'hyperloglog_store_get_estimate'
+     LANGUAGE C STRICT;
+
+CREATE FUNCTION hyperloglog_store_entries(path text)
+     RETURNS TABLE (key text, counter hyperloglog_estimator)
+     AS 'MODULE_PATHNAME', 'hyperloglog_store_entries'
+     LANGUAGE C STRICT;
+
+-- multi-column keys, e.g. hyperloglog_distinct_multi(user_id, device_id) (keys with any NULL value are skipped)
+CREATE FUNCTION hyperloglog_add_item_multi(counter hyperloglog_estimator, VARIADIC items "any") RETURNS void
+     AS 'MODULE_PATHNAME', 'hyperloglog_add_item_multi'
+     LANGUAGE C;
+
+CREATE FUNCTION hyperloglog_add_item_multi_agg(counter hyperloglog_estimator, VARIADIC items "any") RETURNS hyperloglog_estimator
+     AS 'MODULE_PATHNAME', 'hyperloglog_add_item_multi_agg'
+     LANGUAGE C PARALLEL SAFE;
+
+CREATE AGGREGATE hyperloglog_distinct_multi(VARIADIC "any")
+(
+    sfunc = hyperloglog_add_item_multi_agg,
+    stype = hyperloglog_estimator,
+    finalfunc = hyperloglog_get_estimate,
+    combinefunc = hyperloglog_merge_agg,
+    parallel = safe,
+    finalfunc_modify = read_only
+);
+
+CREATE AGGREGATE hyperloglog_accum_multi(VARIADIC "any")
+(
+    sfunc = hyperloglog_add_item_multi_agg,
+    stype = hyperloglog_estimator,
+    finalfunc = hyperloglog_accum_final,
+    combinefunc = hyperloglog_merge_agg,
+    parallel = safe,
+    finalfunc_modify = read_only
+);
+
+-- hyperloglog_distinct for smallint, integer, bigint and uuid values (without md5)
+CREATE FUNCTION hyperloglog_add_int2_agg(counter hyperloglog_estimator, item smallint, error_rate real) RETURNS hyperloglog_estimator
+     AS 'MODULE_PATHNAME', 'hyperloglog_add_int2_agg'
+     LANGUAGE C PARALLEL SAFE;
+
+CREATE FUNCTION hyperloglog_add_int2_agg(counter hyperloglog_estimator, item smallint) RETURNS hyperloglog_estimator
+     AS 'MODULE_PATHNAME', 'hyperloglog_add_int2_agg'
+     LANGUAGE C PARALLEL SAFE;
+
+CREATE FUNCTION hyperloglog_add_int4_agg(counter hyperloglog_estimator, item integer, error_rate real) RETURNS hyperloglog_estimator
+     AS 'MODULE_PATHNAME', 'hyperloglog_add_int4_agg'
+     LANGUAGE C PARALLEL SAFE;
+
+CREATE FUNCTION hyperloglog_add_int4_agg(counter hyperloglog_estimator, item integer) RETURNS hyperloglog_estimator
+     AS 'MODULE_PATHNAME', 'hyperloglog_add_int4_agg'
+     LANGUAGE C PARALLEL SAFE;
+
+CREATE FUNCTION hyperloglog_add_int8_agg(counter hyperloglog_estimator, item bigint, error_rate real) RETURNS hyperloglog_estimator
+     AS 'MODULE_PATHNAME', 'hyperloglog_add_int8_agg'
+     LANGUAGE C PARALLEL SAFE;
+
+CREATE FUNCTION hyperloglog_add_int8_agg(counter hyperloglog_estimator, item bigint) RETURNS hyperloglog_estimator
+     AS 'MODULE_PATHNAME', 'hyperloglog_add_int8_agg'
+     LANGUAGE C PARALLEL SAFE;
+
+CREATE FUNCTION hyperloglog_add_uuid_agg(counter hyperloglog_estimator, item uuid, error_rate real) RETURNS hyperloglog_estimator
+     AS 'MODULE_PATHNAME', 'hyperloglog_add_uuid_agg'
+     LANGUAGE C PARALLEL SAFE;
+
+CREATE FUNCTION hyperloglog_add_uuid_agg(counter hyperloglog_estimator, item uuid) RETURNS hyperloglog_estimator
+     AS 'MODULE_PATHNAME', 'hyperloglog_add_uuid_agg'
+     LANGUAGE C PARALLEL SAFE;
+
+CREATE AGGREGATE hyperloglog_distinct(smallint, real)
+(
+    sfunc = hyperloglog_add_int2_agg,
+    stype = hyperloglog_estimator,
+    finalfunc = hyperloglog_get_estimate,
+    combinefunc = hyperloglog_merge_agg,
+    parallel = safe,
+    finalfunc_modify = read_only
+);
+
+CREATE AGGREGATE hyperloglog_distinct(smallint)
+(
+    sfunc = hyperloglog_add_int2_agg,
+    stype = hyperloglog_estimator,
+    finalfunc = hyperloglog_get_estimate,
+    combinefunc = hyperloglog_merge_agg,
+    parallel = safe,
+    finalfunc_modify = read_only
+);
+
+CREATE AGGREGATE hyperloglog_distinct(integer, real)
+(
+    sfunc = hyperloglog_add_int4_agg,
+    stype = hyperloglog_estimator,
+    finalfunc = hyperloglog_get_estimate,
+    combinefunc = hyperloglog_merge_agg,
+    parallel = safe,
+    finalfunc_modify = read_only
+);
+
+CREATE AGGREGATE hyperloglog_distinct(integer)
+(
+    sfunc = hyperloglog_add_int4_agg,
+    stype = hyperloglog_estimator,
+    finalfunc = hyperloglog_get_estimate,
+    combinefunc = hyperloglog_merge_agg,
+    parallel = safe,
+    finalfunc_modify = read_only
+);
+
+CREATE AGGREGATE hyperloglog_distinct(bigint, real)
+(
+    sfunc = hyperloglog_add_int8_agg,
+    stype = hyperloglog_estimator,
+    finalfunc = hyperloglog_get_estimate,
+    combinefunc = hyperloglog_merge_agg,
+    parallel = safe,
+    finalfunc_modify = read_only
+);
+
+CREATE AGGREGATE hyperloglog_distinct(bigint)
+(
+    sfunc = hyperloglog_add_int8_agg,
+    stype = hyperloglog_estimator,
+    finalfunc = hyperloglog_get_estimate,
+    combinefunc = hyperloglog_merge_agg,
+    parallel = safe,
+    finalfunc_modify = read_only
+);
+
+CREATE AGGREGATE hyperloglog_distinct(uuid, real)
+(
+    sfunc = hyperloglog_add_uuid_agg,
+    stype = hyperloglog_estimator,
+    finalfunc = hyperloglog_get_estimate,
+    combinefunc = hyperloglog_merge_agg,
+    parallel = safe,
+    finalfunc_modify = read_only
+);
+
+CREATE AGGREGATE hyperloglog_distinct(uuid)
+(
+    sfunc = hyperloglog_add_uuid_agg,
+    stype = hyperloglog_estimator,
+    finalfunc = hyperloglog_get_estimate,
+    combinefunc = hyperloglog_merge_agg,
+    parallel = safe,
+    finalfunc_modify = read_only
+);
+
+-- Instrumentation (collected only with hyperloglog.track_stats enabled, per backend)
+
+-- statistics of the estimators (times in milliseconds)
+CREATE FUNCTION hyperloglog_estimator_stats(OUT elements bigint, OUT hashes bigint, OUT updates bigint,
+                                            OUT merges bigint, OUT allocated bigint,
+                                            OUT hash_time double precision, OUT update_time double precision)
+     AS 'MODULE_PATHNAME', 'hyperloglog_estimator_stats'
+     LANGUAGE C STRICT;
+
+-- reset the statistics collected in this backend
+CREATE FUNCTION hyperloglog_estimator_stats_reset() RETURNS void
+     AS 'MODULE_PATHNAME', 'hyperloglog_estimator_stats_reset'
+     LANGUAGE C;
+
+-- Union of arrays of estimators (NULL elements are skipped)
+
+-- merges all the estimators in the array into a single one
+CREATE FUNCTION hyperloglog_union(estimators hyperloglog_estimator[]) RETURNS hyperloglog_estimator
+     AS 'MODULE_PATHNAME', 'hyperloglog_union'
+     LANGUAGE C STRICT PARALLEL SAFE;
+
+-- estimate of the union of all the estimators in the array
+CREATE FUNCTION hyperloglog_union_estimate(estimators hyperloglog_estimator[]) RETURNS real
+     AS 'MODULE_PATHNAME', 'hyperloglog_union_estimate'
+     LANGUAGE C STRICT PARALLEL SAFE;
+
+-- unions of sliding windows of 'width' estimators ending at each element of the
+-- (ordered) array, e.g. distinct users over the trailing 7 days from daily estimators
+CREATE FUNCTION hyperloglog_rolling_union(estimators hyperloglog_estimator[], width int)
+     RETURNS TABLE (idx int, counter hyperloglog_estimator)
+     AS 'MODULE_PATHNAME', 'hyperloglog_rolling_union'
+     LANGUAGE C STRICT PARALLEL SAFE;
+
+-- Conversion of LogLog and SuperLogLog estimators (with the same bins, but estimated
+-- using the HyperLogLog formula, and mergeable with other hyperloglog estimators)
+
+-- converts a loglog / superloglog estimator passed as bytea
+CREATE FUNCTION hyperloglog_from_loglog(counter bytea) RETURNS hyperloglog_estimator
+     AS 'MODULE_PATHNAME', 'hyperloglog_from_loglog'
+     LANGUAGE C STRICT PARALLEL SAFE;
+
+-- converts a loglog / superloglog estimator (the argument type is checked when
+-- called, so the other extensions don't need to be installed, or may be installed
+-- later or in another schema)
+CREATE FUNCTION loglog_to_hyperloglog(counter anyelement) RETURNS hyperloglog_estimator
+     AS 'MODULE_PATHNAME', 'hyperloglog_from_loglog_estimator'
+     LANGUAGE C STRICT PARALLEL SAFE;
+
+CREATE FUNCTION superloglog_to_hyperloglog(counter anyelement) RETURNS hyperloglog_estimator
+     AS 'MODULE_PATHNAME', 'hyperloglog_from_loglog_estimator'
+     LANGUAGE C STRICT PARALLEL SAFE;
+
+-- BRIN operator classes, summarizing each block range by an estimator of the indexed
+-- column (requires PostgreSQL 12, the operator classes are not created otherwise)
+
+CREATE FUNCTION hyperloglog_brin_opcinfo(internal) RETURNS internal
+     AS 'MODULE_PATHNAME', 'hyperloglog_brin_opcinfo'
+     LANGUAGE C STRICT;
+
+CREATE FUNCTION hyperloglog_brin_add_value(internal, internal, internal, internal) RETURNS boolean
+     AS 'MODULE_PATHNAME', 'hyperloglog_brin_add_value'
+     LANGUAGE C STRICT;
+
+CREATE FUNCTION hyperloglog_brin_consistent(internal, internal, internal) RETURNS boolean
+     AS 'MODULE_PATHNAME', 'hyperloglog_brin_consistent'
+     LANGUAGE C STRICT;
+
+CREATE FUNCTION hyperloglog_brin_summary_union(internal, internal, internal) RETURNS void
+     AS 'MODULE_PATHNAME', 'hyperloglog_brin_summary_union'
+     LANGUAGE C STRICT;
+
+DO $$
+DECLARE
+    v_type text;
+    v_options text := '';
+BEGIN
+    IF current_setting('server_version_num')::int < 120000 THEN
+        RETURN;
+    END IF;
+
+    -- error rate of the estimators, e.g. (user_id hyperloglog_int4_ops(error = 0.02))
+    IF current_setting('server_version_num')::int >= 130000 THEN
+        CREATE FUNCTION hyperloglog_brin_options(internal) RETURNS void
+             AS 'MODULE_PATHNAME', 'hyperloglog_brin_options'
+             LANGUAGE C;
+        v_options := ', FUNCTION 5 hyperloglog_brin_options(internal)';
+    END IF;
+
+    FOREACH v_type IN ARRAY ARRAY['int4', 'int8', 'text', 'uuid'] LOOP
+        EXECUTE format('CREATE OPERATOR CLASS hyperloglog_%s_ops FOR TYPE %s USING brin AS
+                            FUNCTION 1 hyperloglog_brin_opcinfo(internal),
+                            FUNCTION 2 hyperloglog_brin_add_value(internal, internal, internal, internal),
+                            FUNCTION 3 hyperloglog_brin_consistent(internal, internal, internal),
+                            FUNCTION 4 hyperloglog_brin_summary_union(internal, internal, internal)%s',
+                       v_type, v_type, v_options);
+    END LOOP;
+END$$;
+
+-- estimator of distinct values of the column in rows with range_column between lower and
+-- upper (inclusive), using a BRIN index with a hyperloglog operator class on the column
+-- and a minmax one on range_column (only ranges crossing the bounds are read from the table)
+CREATE FUNCTION hyperloglog_brin_union(brin_index regclass, counter_column name, range_column name,
+                                       lower anyelement, upper anyelement)
+     RETURNS hyperloglog_estimator
+     AS 'MODULE_PATHNAME', 'hyperloglog_brin_union'
+     LANGUAGE C STRICT;
+
+-- Incremental refresh of rollup tables
+
+-- watermarks of the rollups, i.e. the last value of the watermark column already merged into
+-- the rollup, for each (rollup, source) pair (as text, written with DateStyle ISO and TimeZone
+-- UTC, so that the session settings do not matter)
+CREATE TABLE hyperloglog_rollup_watermarks (
+    rollup_table    regclass NOT NULL,
+    source_table    regclass NOT NULL,
+    watermark       text,
+    PRIMARY KEY (rollup_table, source_table)
+);
+
+-- include the watermarks in dumps (only in CREATE EXTENSION, the script may be loaded directly)
+DO $$
+BEGIN
+    IF EXISTS (SELECT 1 FROM pg_depend
+                WHERE classid = 'pg_class'::regclass AND objid = 'hyperloglog_rollup_watermarks'::regclass
+                  AND deptype = 'e') THEN
+        PERFORM pg_catalog.pg_extension_config_dump('hyperloglog_rollup_watermarks', '');
+    END IF;
+END$$;
+
+-- Merges rows of the source table newer than the stored watermark into the rollup table, with
+-- an estimator of the item expression for each group. The rollup needs a unique index on the
+-- group columns, computed by group_exprs (expressions on the source table, the same names by
+-- default). The watermark column has to grow with the commits (rows committed later with a
+-- lower value are not counted). Returns the number of rollup rows inserted or updated.
+CREATE FUNCTION hyperloglog_rollup_refresh(rollup regclass, counter_column name, source regclass,
+                                           watermark_column name, item text, group_columns name[],
+                                           group_exprs text[] DEFAULT NULL, error_rate real DEFAULT 0.025)
+    RETURNS bigint
+    AS 'MODULE_PATHNAME', 'hyperloglog_rollup_refresh'
+    LANGUAGE C;
@@ -5,13 +5,23 @@
 #include <string.h>
 
 #include "postgres.h"
-#include "libpq/md5.h"
+#include "distinct_md5.h"
 
 #include "hyperloglog.h"
+#include "hyperloglog_probes.h"
 
 /* we're using md5, which produces 16B (128-bit) values */
 #define HASH_LENGTH 16
 
+/* number of hashes with bins prefetched at once by hyperloglog_add_hashes */
+#define HLL_BATCH_SIZE 32
+
+#if defined(__GNUC__) || defined(__clang__)
+#define HLL_PREFETCH(addr)  __builtin_prefetch((addr), 1, 3)
+#else
+#define HLL_PREFETCH(addr)  ((void) 0)
+#endif
+
 /* Alpha constants, for various numbers of 'b'.
  * 
  * According to hyperloglog_create the 'b' values are between 4 and 16,
@@ -25,9 +35,174 @@ int hyperloglog_get_min_bit(const unsigned char * buffer, int byteFrom, int byte
 int hyperloglog_get_r(const unsigned char * buffer, int byteFrom, int bytes);
 int hyperloglog_estimate(HyperLogLogCounter hloglog);
 
-void hyperloglog_add_hash(HyperLogLogCounter hloglog, const unsigned char * hash);
 void hyperloglog_reset_internal(HyperLogLogCounter hloglog);
 
+/* Kernels for the loops over bins (adding hashes, merging, estimating).
+ *
+ * All the loops depend on 'b' (number of bins, shift to get the bin index),
+ * and when it's read from the counter, the compiler can't unroll or vectorize
+ * the loops, and has to use variable shifts. So the kernels are generated for
+ * each supported 'b' (4 to 16), with 'b' being a compile-time constant, and
+ * the counter functions pick the kernels from a table indexed by 'b'. The
+ * table only has kernels for 1B bins (binbits=8, the only width used now),
+ * counters with other parameters get the generic kernels. */
+typedef struct HyperLogLogKernels {
+
+    /* add 'nhashes' hashes to the bins, returns number of changed bins */
+    int64   (*add_hashes) (char * data, int b, const unsigned char * hashes, int nhashes);
+
+    /* merge the 'other' bins into 'data' (keeps the higher values) */
+    void    (*merge) (char * data, const char * other, int b);
+
+    /* number of bins for each (unsigned char) value, for the estimate */
+    void    (*histogram) (const char * data, int b, int * counts);
+
+} HyperLogLogKernels;
+
+static const HyperLogLogKernels * hyperloglog_kernels(HyperLogLogCounter hloglog);
+
+/* Counters may come from a table (or a file), so before reading the bins or
+ * the cached estimate make sure the header is consistent and the value is
+ * long enough to hold all the bins. */
+void hyperloglog_check_counter(HyperLogLogCounter hloglog) {
+
+    if (VARSIZE(hloglog) < offsetof(HyperLogLogCounterData, data) ||
+        hloglog->b < 0 || hloglog->b > 30 || hloglog->m != (1 << hloglog->b) ||
+        VARSIZE(hloglog) < HLL_CACHE_OFFSET(hloglog))
+        elog(ERROR, "invalid HyperLogLog counter (length %d)", (int) VARSIZE(hloglog));
+
+}
+
+/* Splits the hash into the bin index and 'rho' - see hyperloglog_hash_bin, this
+ * is the inlined variant so that the shift is a constant in the kernels. */
+static inline void hyperloglog_hash_bin_inline(const unsigned char * hash, int b, unsigned int * idx, char * rho) {
+
+    memcpy(idx, hash, sizeof(int));
+    *idx = *idx >> (32 - b);
+
+    /* needs to be independent from 'idx' */
+    *rho = hyperloglog_get_min_bit(&hash[4], 0, 64); /* 64-bit hash */
+
+}
+
+/* Adds the hashes to the bins - the bins for a block of hashes are computed and
+ * prefetched first, and updated only after that (see hyperloglog_add_hashes). */
+static inline int64 hyperloglog_add_hashes_impl(char * data, int b, const unsigned char * hashes, int nhashes) {
+
+    int i, j;
+    unsigned int idx[HLL_BATCH_SIZE];
+    char rho[HLL_BATCH_SIZE];
+    int64 updates = 0;
+
+    for (i = 0; i < nhashes; i += HLL_BATCH_SIZE) {
+
+        int n = Min(HLL_BATCH_SIZE, nhashes - i);
+
+        for (j = 0; j < n; j++) {
+            hyperloglog_hash_bin_inline(hashes + (i + j) * HASH_LENGTH, b, &idx[j], &rho[j]);
+            HLL_PREFETCH(&data[idx[j]]);
+        }
+
+        /* keep the highest values */
+        for (j = 0; j < n; j++) {
+            if (rho[j] > data[idx[j]]) {
+                data[idx[j]] = rho[j];
+                updates++;
+            }
+        }
+    }
+
+    return updates;
+
+}
+
+static inline void hyperloglog_merge_impl(char * data, const char * other, int b) {
+
+    int i;
+
+    for (i = 0; i < (1 << b); i++)
+        data[i] = (data[i] > other[i]) ? data[i] : other[i];
+
+}
+
+static inline void hyperloglog_histogram_impl(const char * data, int b, int * counts) {
+
+    int i;
+
+    for (i = 0; i < (1 << b); i++)
+        counts[(unsigned char) data[i]]++;
+
+}
+
+/* generic kernels, using 'b' from the counter */
+static int64 hyperloglog_add_hashes_any(char * data, int b, const unsigned char * hashes, int nhashes) {
+
+    return hyperloglog_add_hashes_impl(data, b, hashes, nhashes);
+
+}
+
+static void hyperloglog_merge_any(char * data, const char * other, int b) {
+
+    hyperloglog_merge_impl(data, other, b);
+
+}
+
+static void hyperloglog_histogram_any(const char * data, int b, int * counts) {
+
+    hyperloglog_histogram_impl(data, b, counts);
+
+}
+
+/* kernels with a constant 'b' (the argument is ignored) */
+#define HLL_KERNELS(B) \
+static int64 \
+hyperloglog_add_hashes_##B(char * data, int b, const unsigned char * hashes, int nhashes) \
+{ \
+    return hyperloglog_add_hashes_impl(data, B, hashes, nhashes); \
+} \
+static void \
+hyperloglog_merge_##B(char * data, const char * other, int b) \
+{ \
+    hyperloglog_merge_impl(data, other, B); \
+} \
+static void \
+hyperloglog_histogram_##B(const char * data, int b, int * counts) \
+{ \
+    hyperloglog_histogram_impl(data, B, counts); \
+}
+
+HLL_KERNELS(4)
+HLL_KERNELS(5)
+HLL_KERNELS(6)
+HLL_KERNELS(7)
+HLL_KERNELS(8)
+HLL_KERNELS(9)
+HLL_KERNELS(10)
+HLL_KERNELS(11)
+HLL_KERNELS(12)
+HLL_KERNELS(13)
+HLL_KERNELS(14)
+HLL_KERNELS(15)
+HLL_KERNELS(16)
+
+#define HLL_KERNELS_ENTRY(B) \
+    { hyperloglog_add_hashes_##B, hyperloglog_merge_##B, hyperloglog_histogram_##B }
+
+static const HyperLogLogKernels hyperloglog_kernels_any =
+    { hyperloglog_add_hashes_any, hyperloglog_merge_any, hyperloglog_histogram_any };
+
+/* kernels for b = 4, 5, ..., 16 */
+static const HyperLogLogKernels hyperloglog_kernels_b[] = {
+    HLL_KERNELS_ENTRY(4), HLL_KERNELS_ENTRY(5), HLL_KERNELS_ENTRY(6),
+    HLL_KERNELS_ENTRY(7), HLL_KERNELS_ENTRY(8), HLL_KERNELS_ENTRY(9),
+    HLL_KERNELS_ENTRY(10), HLL_KERNELS_ENTRY(11), HLL_KERNELS_ENTRY(12),
+    HLL_KERNELS_ENTRY(13), HLL_KERNELS_ENTRY(14), HLL_KERNELS_ENTRY(15),
+    HLL_KERNELS_ENTRY(16)
+};
+
+/* instrumentation (NULL unless enabled, see hyperloglog.h) */
+HyperLogLogStats * hyperloglog_stats = NULL;
+
 /* Allocate HLL estimator that can handle the desired cartinality and precision.
  *
  * TODO The ndistinct is not currently used to determine size of the bin (number of
@@ -78,6 +253,47 @@ HyperLogLogCounter hyperloglog_create(int64 ndistinct, float error) {
 
     SET_VARSIZE(p, length);
 
+    /* estimate of an empty counter is 0 */
+    hyperloglog_set_cached_estimate(p, 0);
+
+    if (hyperloglog_stats != NULL)
+        hyperloglog_stats->allocated += length;
+
+    return p;
+
+}
+
+/* Creates a counter from the bins of a LogLog or SuperLogLog counter. Those use
+ * exactly the same hashing (index from the first 'b' bits, rho from the next
+ * 64 bits), and keep the largest rho in each bin, so the bins can be used as
+ * they are - except that empty bins are -1 there (0 here).
+ */
+HyperLogLogCounter hyperloglog_from_bins(int b, const char * bins) {
+
+    int i;
+    int m = (1 << b);
+    size_t length = offsetof(HyperLogLogCounterData,data) + m + sizeof(int32);
+    HyperLogLogCounter p;
+
+    if ((b < 4) || (b > 16))
+        elog(ERROR, "number of index bits has to be between 4 and 16 (counter has %d)", b);
+
+    p = (HyperLogLogCounter)palloc(length);
+
+    SET_VARSIZE(p, length);
+
+    p->b = b;
+    p->m = m;
+    p->binbits = 8;
+
+    for (i = 0; i < m; i++)
+        p->data[i] = Max(bins[i], 0);
+
+    hyperloglog_set_cached_estimate(p, HLL_ESTIMATE_INVALID);
+
+    if (hyperloglog_stats != NULL)
+        hyperloglog_stats->allocated += length;
+
     return p;
 
 }
@@ -90,6 +306,9 @@ HyperLogLogCounter hyperloglog_copy(HyperLogLogCounter counter) {
     HyperLogLogCounter copy = (HyperLogLogCounter)palloc(length);
     
     memcpy(copy, counter, length);
+
+    if (hyperloglog_stats != NULL)
+        hyperloglog_stats->allocated += length;
     
     return copy;
 
@@ -103,19 +322,22 @@ HyperLogLogCounter hyperloglog_copy(HyperLogLogCounter counter) {
  * bin size, ...). If the counters don't match, this throws an ERROR. */
 HyperLogLogCounter hyperloglog_merge(HyperLogLogCounter counter1, HyperLogLogCounter counter2, bool inplace) {
 
-    int i;
     HyperLogLogCounter result;
 
-    /* check compatibility first */
-    if (counter1->length != counter2->length)
-        elog(ERROR, "sizes of estimators differs (%d != %d)", counter1->length, counter2->length);
-    else if (counter1->b != counter2->b)
+    hyperloglog_check_counter(counter1);
+    hyperloglog_check_counter(counter2);
+
+    /* check compatibility first (the lengths may differ, if only one of the
+     * counters has the cached estimate) */
+    if (counter1->b != counter2->b)
         elog(ERROR, "index size of estimators differs (%d != %d)", counter1->b, counter2->b);
     else if (counter1->m != counter2->m)
         elog(ERROR, "bin count of estimators differs (%d != %d)", counter1->m, counter2->m);
     else if (counter1->binbits != counter2->binbits)
         elog(ERROR, "bin size of estimators differs (%d != %d)", counter1->binbits, counter2->binbits);
 
+    HYPERLOGLOG_MERGE_START(counter1->b, counter1->m);
+
     /* shall we create a new estimator, or merge into counter1 */
     if (! inplace)
         result = hyperloglog_copy(counter1);
@@ -123,8 +345,14 @@ HyperLogLogCounter hyperloglog_merge(HyperLogLogCounter counter1, HyperLogLogCou
         result = counter1;
 
     /* copy the state of the estimator */
-    for (i = 0; i < result->m; i++)
-        result->data[i] = (result->data[i] > counter2->data[i]) ? result->data[i] : counter2->data[i];
+    hyperloglog_kernels(result)->merge(result->data, counter2->data, result->b);
+
+    hyperloglog_set_cached_estimate(result, HLL_ESTIMATE_INVALID);
+
+    if (hyperloglog_stats != NULL)
+        hyperloglog_stats->merges++;
+
+    HYPERLOGLOG_MERGE_DONE(result->b, result->m);
 
     return result;
 
@@ -151,7 +379,8 @@ int hyperloglog_get_size(int64 ndistinct, float error) {
   else if (b > 16)
       elog(ERROR, "number of bits in HyperLogLog exceeds 16");
 
-  return offsetof(HyperLogLogCounterData,data) + (int)pow(2, b);
+  /* bins, followed by the cached estimate */
+  return offsetof(HyperLogLogCounterData,data) + (int)pow(2, b) + sizeof(int32);
 
 }
 
@@ -190,20 +419,39 @@ int hyperloglog_estimate(HyperLogLogCounter hloglog) {
 
     double sum = 0, E = 0;
     int j;
+    int32 cached;
+    int counts[256];
+
+    hyperloglog_check_counter(hloglog);
+
+    /* valid cached estimate (the bins did not change since it was computed) */
+    if (HLL_HAS_CACHE(hloglog)) {
+
+        memcpy(&cached, (char *) hloglog + HLL_CACHE_OFFSET(hloglog), sizeof(int32));
+
+        if (cached != HLL_ESTIMATE_INVALID)
+            return cached;
+    }
+
+    HYPERLOGLOG_ESTIMATE_START(hloglog->b, hloglog->m);
+
+    /* count the bins with each value - that's the only loop over all the bins,
+     * and then we only need one power of 2 per distinct value (not per bin) */
+    memset(counts, 0, sizeof(counts));
+    hyperloglog_kernels(hloglog)->histogram(hloglog->data, hloglog->b, counts);
 
     /* compute the sum for the indicator function */
-    for (j = 0; j < hloglog->m; j++)
-        sum += (1.0 / pow(2, hloglog->data[j]));
+    for (j = 0; j < 256; j++)
+        if (counts[j] > 0)
+            sum += ldexp(counts[j], - (int) (char) j);
 
     /* and finally the estimate itself */
     E = alpha[hloglog->b] * pow(hloglog->m, 2) / sum;
 
     if (E <= (5.0 * hloglog->m / 2)) {
 
-        int V = 0;
-        for (j = 0; j < hloglog->m; j++)
-            if (hloglog->data[j] == 0)
-                V += 1;
+        /* number of empty bins */
+        int V = counts[0];
 
         if (V != 0)
             E = hloglog->m * log(hloglog->m / (float)V);
@@ -214,21 +462,60 @@ int hyperloglog_estimate(HyperLogLogCounter hloglog) {
 
     }
 
+    HYPERLOGLOG_ESTIMATE_DONE(hloglog->b, hloglog->m, (int)E);
+
     return (int)E;
 
 }
 
+/* Computes the estimate and stores it in the counter, so that it's not
+ * computed again until the counter changes. Only for counters that may be
+ * modified (e.g. not for values read from a table). */
+void hyperloglog_cache_estimate(HyperLogLogCounter hloglog) {
+
+    hyperloglog_set_cached_estimate(hloglog, hyperloglog_estimate(hloglog));
+
+}
+
+/* The cache may be at any offset (unaligned), so use memcpy. Counters
+ * without the cache are left alone. */
+void hyperloglog_set_cached_estimate(HyperLogLogCounter hloglog, int32 estimate) {
+
+    hyperloglog_check_counter(hloglog);
+
+    if (HLL_HAS_CACHE(hloglog))
+        memcpy((char *) hloglog + HLL_CACHE_OFFSET(hloglog), &estimate, sizeof(int32));
+
+}
+
 
 void hyperloglog_add_element(HyperLogLogCounter hloglog, const char * element, int elen) {
 
     /* get the hash */
     unsigned char hash[HASH_LENGTH];
+    instr_time start, hashed, end;
+
+    if (hyperloglog_stats == NULL) {
+
+        /* compute the hash using the salt */
+        distinct_md5(element, elen, hash);
+
+        /* add the hash to the estimator */
+        hyperloglog_add_hash(hloglog, hash);
 
-    /* compute the hash using the salt */
-    pg_md5_binary(element, elen, hash);
+        return;
+    }
 
-    /* add the hash to the estimator */
+    /* the same, but with instrumentation */
+    INSTR_TIME_SET_CURRENT(start);
+    distinct_md5(element, elen, hash);
+    INSTR_TIME_SET_CURRENT(hashed);
     hyperloglog_add_hash(hloglog, hash);
+    INSTR_TIME_SET_CURRENT(end);
+
+    hyperloglog_stats->elements++;
+    INSTR_TIME_ACCUM_DIFF(hyperloglog_stats->hash_time, hashed, start);
+    INSTR_TIME_ACCUM_DIFF(hyperloglog_stats->update_time, end, hashed);
 
 }
 
@@ -256,21 +543,65 @@ void hyperloglog_add_element(HyperLogLogCounter hloglog, const char * element, i
  */
 void hyperloglog_add_hash(HyperLogLogCounter hloglog, const unsigned char * hash) {
 
-    /* get the hash */
-    unsigned int idx;
-    char rho;
+    /* keep the highest value */
+    if (hyperloglog_kernels(hloglog)->add_hashes(hloglog->data, hloglog->b, hash, 1) > 0) {
 
-    /* which stream is this (keep only the first 'b' bits) */
-    memcpy(&idx, hash, sizeof(int));
-    idx  = idx >> (32 - hloglog->b);
+        hyperloglog_set_cached_estimate(hloglog, HLL_ESTIMATE_INVALID);
 
-    /* get the min bit (but skip the bits used for stream index) */
+        if (hyperloglog_stats != NULL)
+            hyperloglog_stats->updates++;
+    }
 
-    /* needs to be independent from 'idx' */
-    rho = hyperloglog_get_min_bit(&hash[4], 0, 64); /* 64-bit hash */
+    if (hyperloglog_stats != NULL)
+        hyperloglog_stats->hashes++;
 
-    /* keep the highest value */
-    hloglog->data[idx] = (rho > (hloglog->data[idx])) ? rho : hloglog->data[idx];
+}
+
+/*
+ * Adds an array of hashes (HASH_LENGTH bytes each), the same as calling
+ * hyperloglog_add_hash for each of them. With many bins (64kB for b=16) the
+ * update of a random bin usually misses the L1 cache and stalls, so the bins
+ * for a block of hashes are computed and prefetched first, and updated only
+ * after that - the cache misses then overlap, instead of being serialized.
+ */
+void hyperloglog_add_hashes(HyperLogLogCounter hloglog, const unsigned char * hashes, int nhashes) {
+
+    int64 updates;
+
+    HYPERLOGLOG_BATCH_START(hloglog->b, hloglog->m, nhashes);
+
+    updates = hyperloglog_kernels(hloglog)->add_hashes(hloglog->data, hloglog->b, hashes, nhashes);
+
+    HYPERLOGLOG_BATCH_DONE(hloglog->b, hloglog->m, nhashes, updates);
+
+    if (updates > 0)
+        hyperloglog_set_cached_estimate(hloglog, HLL_ESTIMATE_INVALID);
+
+    if (hyperloglog_stats != NULL) {
+        hyperloglog_stats->hashes += nhashes;
+        hyperloglog_stats->updates += updates;
+    }
+
+}
+
+/* Splits the hash into the bin index (first 'b' bits) and 'rho' (computed from the
+ * next 64 bits, so that it's independent from the index - see hyperloglog_add_hash).
+ * Shared by all the counters using the HLL bin layout. */
+void hyperloglog_hash_bin(const unsigned char * hash, int b, unsigned int * idx, char * rho) {
+
+    /* which stream is this (keep only the first 'b' bits), and the min bit
+     * (but skip the bits used for stream index) */
+    hyperloglog_hash_bin_inline(hash, b, idx, rho);
+
+}
+
+/* Kernels for the counter - specialized for the 'b' value if possible. */
+static const HyperLogLogKernels * hyperloglog_kernels(HyperLogLogCounter hloglog) {
+
+    if ((hloglog->b >= 4) && (hloglog->b <= 16) && (hloglog->binbits == 8))
+        return &hyperloglog_kernels_b[hloglog->b - 4];
+
+    return &hyperloglog_kernels_any;
 
 }
 
@@ -279,4 +610,6 @@ void hyperloglog_reset_internal(HyperLogLogCounter hloglog) {
 
     memset(hloglog->data, 0, hloglog->m);
 
+    hyperloglog_set_cached_estimate(hloglog, 0);
+
 }
@@ -1,4 +1,5 @@
 #include "postgres.h"
+#include "portability/instr_time.h"
 
 /* This is an implementation of HyperLogLog algorithm as described in the
  * paper "HyperLogLog: the analysis of near-optimal cardinality estimation
@@ -52,18 +53,182 @@ typedef struct HyperLogLogCounterData {
 
 typedef HyperLogLogCounterData * HyperLogLogCounter;
 
+/* The bins are followed by a cached estimate (int32, -1 if not valid), so that
+ * repeated estimates of finished (e.g. stored) counters don't have to walk all
+ * the bins. It's invalidated whenever a bin changes, and filled when finishing
+ * the _accum aggregates. Counters created by older versions don't have it (the
+ * estimate is then always computed), so check the length before accessing it. */
+#define HLL_CACHE_OFFSET(c)     (offsetof(HyperLogLogCounterData, data) + (c)->m)
+#define HLL_HAS_CACHE(c)        (VARSIZE(c) >= HLL_CACHE_OFFSET(c) + sizeof(int32))
+#define HLL_ESTIMATE_INVALID    (-1)
+
 /* creates an optimal bitmap able to count a multiset with the expected
  * cardinality and the given error rate. */
 HyperLogLogCounter hyperloglog_create(int64 ndistinct, float error);
 int hyperloglog_get_size(int64 ndistinct, float error);
 
 HyperLogLogCounter hyperloglog_copy(HyperLogLogCounter counter);
+
+/* checks the header and length of a counter (e.g. read from a table) */
+void hyperloglog_check_counter(HyperLogLogCounter hloglog);
+
+/* creates a counter from bins of a LogLog / SuperLogLog counter (2^b bins) */
+HyperLogLogCounter hyperloglog_from_bins(int b, const char * bins);
 HyperLogLogCounter hyperloglog_merge(HyperLogLogCounter counter1, HyperLogLogCounter counter2, bool inplace);
 
 /* add element existence */
 void hyperloglog_add_element(HyperLogLogCounter hloglog, const char * element, int elen);
 
-/* get an estimate from the hyperloglog counter */
+/* add a hash (HASH_LENGTH bytes) directly, without hashing */
+void hyperloglog_add_hash(HyperLogLogCounter hloglog, const unsigned char * hash);
+
+/* add an array of hashes, prefetching the bins (faster for large counters) -
+ * used by hyperloglog_from_file and libdistinct, the aggregates get a single
+ * value per call, so there's nothing to batch */
+void hyperloglog_add_hashes(HyperLogLogCounter hloglog, const unsigned char * hashes, int nhashes);
+
+/* get an estimate from the hyperloglog counter (the cached one, if valid) */
 int hyperloglog_estimate(HyperLogLogCounter hloglog);
 
+/* computes the estimate and stores it in the counter (see HLL_HAS_CACHE) */
+void hyperloglog_cache_estimate(HyperLogLogCounter hloglog);
+
+/* sets the cached estimate (HLL_ESTIMATE_INVALID to invalidate it) */
+void hyperloglog_set_cached_estimate(HyperLogLogCounter hloglog, int32 estimate);
+
 void hyperloglog_reset_internal(HyperLogLogCounter hloglog);
+
+/* bin index and 'rho' for a hash (the same split as used by hyperloglog_add_hash) */
+void hyperloglog_hash_bin(const unsigned char * hash, int b, unsigned int * idx, char * rho);
+
+/* Instrumentation of the estimator (per backend), collected only while the
+ * hyperloglog_stats pointer is set - the SQL-facing part sets it when the
+ * hyperloglog.track_stats option is enabled, so by default the overhead is
+ * just a branch. */
+typedef struct HyperLogLogStats {
+    int64       elements;       /* elements hashed (using md5) */
+    int64       hashes;         /* hashes added to counters */
+    int64       updates;        /* hashes that changed a bin */
+    int64       merges;         /* counters merged */
+    int64       allocated;      /* bytes allocated for new counters */
+    instr_time  hash_time;      /* time spent hashing the elements */
+    instr_time  update_time;    /* time spent updating the bins */
+} HyperLogLogStats;
+
+extern HyperLogLogStats * hyperloglog_stats;
+
+/* Sliding-window variant of the HyperLogLog counter, as described in the paper
+ * "Sliding HyperLogLog: Estimating cardinality in a data stream" by Chabchoub
+ * and Hebrail (2010).
+ *
+ * The bins are organized exactly as in HyperLogLogCounterData (the same 'b',
+ * 'm' and hash split), but instead of keeping only the largest 'rho' for each
+ * bin, we keep a short list of (rho, timestamp) pairs - the "list of possible
+ * future maxima". A pair is dropped once there's another pair with both higher
+ * (or equal) 'rho' and newer (or equal) timestamp, because it can't be the
+ * maximum for any window ending now. That means the lists are usually very
+ * short (a few items), so we use a fixed number of slots per bin, and when a
+ * list overflows we simply evict the oldest pair (so only very long windows
+ * are affected).
+ *
+ * The timestamps are opaque 32-bit values - the SQL functions use seconds
+ * since the PostgreSQL epoch (2000-01-01), which works until 2068.
+ */
+typedef struct HyperLogLogWindowCounterData {
+
+    /* length of the structure (varlena) */
+    int32 length;
+
+    /* the same meaning as in HyperLogLogCounterData */
+    int b; /* bits for bin index */
+    int m; /* m = 2^b */
+    int binbits;
+
+    /* number of (rho, timestamp) slots for each bin */
+    int nslots;
+
+    /* timestamps for all the slots (m * nslots int32 values), followed by the
+     * 'rho' values (m * nslots chars, 0 means the slot is empty) */
+    char data[1];
+
+} HyperLogLogWindowCounterData;
+
+typedef HyperLogLogWindowCounterData * HyperLogLogWindowCounter;
+
+#define HLLW_TIMES(counter)     ((int32 *) (counter)->data)
+#define HLLW_RHOS(counter)      ((counter)->data + sizeof(int32) * (counter)->m * (counter)->nslots)
+
+HyperLogLogWindowCounter hyperloglog_window_create(float error, int nslots);
+int hyperloglog_window_get_size(float error, int nslots);
+
+void hyperloglog_window_check_counter(HyperLogLogWindowCounter counter);
+HyperLogLogWindowCounter hyperloglog_window_copy(HyperLogLogWindowCounter counter);
+HyperLogLogWindowCounter hyperloglog_window_merge(HyperLogLogWindowCounter counter1, HyperLogLogWindowCounter counter2, bool inplace);
+
+/* add element (seen at the given time) */
+void hyperloglog_window_add_element(HyperLogLogWindowCounter counter, const char * element, int elen, int32 timestamp);
+void hyperloglog_window_add_hash(HyperLogLogWindowCounter counter, const unsigned char * hash, int32 timestamp);
+
+/* regular HLL counter / estimate for the window starting at 'since' (and ending now) */
+HyperLogLogCounter hyperloglog_window_snapshot(HyperLogLogWindowCounter counter, int32 since);
+int hyperloglog_window_estimate(HyperLogLogWindowCounter counter, int32 since);
+
+void hyperloglog_window_reset_internal(HyperLogLogWindowCounter counter);
+
+/* Store of many HLL counters in a single file, meant for offline rollups of
+ * (key, counter) pairs. All the counters in the store have the same geometry
+ * (error rate), so the file is simply a fixed-size header followed by an
+ * open-addressing hash table of fixed-size slots, each with a key (up to
+ * 'keysize' bytes) and a complete counter (including the varlena header).
+ *
+ * The file is memory-mapped, so the counters may be read (and estimated)
+ * directly, without copying, and incoming counters are merged in place.
+ * The capacity is fixed when creating the store - the table is not resized.
+ *
+ * The file is in the native byte order (just like the data files), and
+ * there's no locking - only a single process should modify the store.
+ */
+#define HLL_STORE_MAGIC         0x53484C4C  /* 'LLHS' */
+#define HLL_STORE_VERSION       1
+
+typedef struct HyperLogLogStoreHeader {
+
+    uint32  magic;
+    uint32  version;
+
+    uint32  keysize;        /* maximum key length (bytes) */
+    uint32  slotsize;       /* size of a slot (key + counter, aligned) */
+    uint32  countersize;    /* size of the counter (including varlena header) */
+    uint32  b;              /* bits for bin index (as in the counters) */
+
+    uint64  capacity;       /* number of slots (keys / fill factor, rounded up) */
+    uint64  nentries;       /* number of used slots */
+
+    uint64  reserved[3];
+
+} HyperLogLogStoreHeader;
+
+/* an opened (memory-mapped) store */
+typedef struct HyperLogLogStoreData {
+
+    HyperLogLogStoreHeader *header;
+    char   *slots;          /* first slot (right after the header) */
+    size_t  length;         /* length of the mapping */
+    bool    readonly;
+
+} HyperLogLogStoreData;
+
+typedef HyperLogLogStoreData * HyperLogLogStore;
+
+HyperLogLogStore hyperloglog_store_create(const char * path, float error, uint64 capacity, int keysize);
+HyperLogLogStore hyperloglog_store_open(const char * path, bool readonly);
+void hyperloglog_store_close(HyperLogLogStore store);
+
+/* counter for the key (pointing into the mapping), NULL if not found */
+HyperLogLogCounter hyperloglog_store_get(HyperLogLogStore store, const char * key, int keylen);
+
+/* merges the counter into the counter for the key (adds the key if needed) */
+void hyperloglog_store_merge(HyperLogLogStore store, const char * key, int keylen, HyperLogLogCounter counter);
+
+/* counter in the slot (and it's key), NULL for empty slots */
+HyperLogLogCounter hyperloglog_store_entry(HyperLogLogStore store, uint64 slot, const char ** key, int * keylen);
@@ -0,0 +1,602 @@
+/* BRIN operator classes with HyperLogLog summaries of block ranges.
+ *
+ * The summary of each block range is a hyperloglog estimator of the indexed
+ * column, which is useless for filtering (there are no operators), but it
+ * allows computing approximate distinct counts without reading the heap.
+ * Combined with a minmax column in the same index, e.g.
+ *
+ *   CREATE INDEX events_brin ON events
+ *    USING brin (created_at, user_id hyperloglog_int4_ops);
+ *
+ * hyperloglog_brin_union merges the summaries of ranges where all the rows
+ * match the condition on the minmax column (min and max are both between the
+ * bounds), skips ranges without any matching rows, and scans only the heap
+ * pages of the remaining ranges (overlapping the bounds, or not summarized).
+ *
+ * The values are hashed just like in hyperloglog_accum, so the result can be
+ * merged with other estimators of the same column (with the same error rate).
+ * Similarly to other BRIN summaries, the estimators are never shrunk, so they
+ * still include deleted rows (until the range gets summarized again). That's
+ * not an issue for append-only tables, which are the main use case.
+ *
+ * This requires PostgreSQL 12 or newer (the operator classes are not created
+ * on older versions).
+ */
+#include "postgres.h"
+#include "fmgr.h"
+#include "miscadmin.h"
+#include "distinct_md5.h"
+
+#if PG_VERSION_NUM >= 120000
+#include "access/brin_internal.h"
+#include "access/brin_revmap.h"
+#include "access/brin_tuple.h"
+#include "access/genam.h"
+#include "access/heapam.h"
+#include "access/table.h"
+#include "access/tableam.h"
+#include "catalog/index.h"
+#include "catalog/pg_am.h"
+#include "catalog/pg_type.h"
+#include "executor/tuptable.h"
+#include "storage/bufmgr.h"
+#include "utils/acl.h"
+#include "utils/builtins.h"
+#include "utils/fmgroids.h"
+#include "utils/lsyscache.h"
+#include "utils/memutils.h"
+#include "utils/rel.h"
+#include "utils/snapmgr.h"
+#include "utils/typcache.h"
+#endif
+
+#if PG_VERSION_NUM >= 130000
+#include "access/reloptions.h"
+#endif
+
+#include "hyperloglog.h"
+#include "hyperloglog_counter.h"
+#include "distinct_hash.h"
+
+/* we're using md5, which produces 16B (128-bit) values */
+#define HASH_LENGTH 16
+
+#define DEFAULT_NDISTINCT   1000000000
+
+/* The summaries have to fit into a BRIN tuple (on a single page), so with
+ * 0.02 the largest summary is 4kB (2^12 bins). The default 5% is 512B. */
+#define BRIN_DEFAULT_ERROR  0.05
+#define BRIN_MIN_ERROR      0.02
+#define BRIN_MAX_ERROR      0.5
+
+PG_FUNCTION_INFO_V1(hyperloglog_brin_opcinfo);
+PG_FUNCTION_INFO_V1(hyperloglog_brin_add_value);
+PG_FUNCTION_INFO_V1(hyperloglog_brin_consistent);
+PG_FUNCTION_INFO_V1(hyperloglog_brin_summary_union);
+PG_FUNCTION_INFO_V1(hyperloglog_brin_union);
+
+Datum hyperloglog_brin_opcinfo(PG_FUNCTION_ARGS);
+Datum hyperloglog_brin_add_value(PG_FUNCTION_ARGS);
+Datum hyperloglog_brin_consistent(PG_FUNCTION_ARGS);
+Datum hyperloglog_brin_summary_union(PG_FUNCTION_ARGS);
+Datum hyperloglog_brin_union(PG_FUNCTION_ARGS);
+
+#if PG_VERSION_NUM >= 130000
+PG_FUNCTION_INFO_V1(hyperloglog_brin_options);
+
+Datum hyperloglog_brin_options(PG_FUNCTION_ARGS);
+
+/* options of the operator classes (error rate of the summaries) */
+typedef struct HyperLogLogBrinOptions {
+    int32   vl_len_;
+    double  error;
+} HyperLogLogBrinOptions;
+#endif
+
+#if PG_VERSION_NUM >= 120000
+
+/* state of hyperloglog_brin_union, needed to scan the boundary ranges */
+typedef struct HyperLogLogBrinScan {
+    Relation        heap;
+    Snapshot        snapshot;
+    AttrNumber      attnum;         /* counted column (in the table) */
+    int16           typlen;
+    bool            typbyval;
+    AttrNumber      range_attnum;   /* column with the bounds (in the table) */
+    FmgrInfo       *cmp;            /* comparison function for the bounds */
+    Oid             collation;
+    Datum           lower;
+    Datum           upper;
+    MemoryContext   tmpcxt;         /* reset for each row */
+} HyperLogLogBrinScan;
+
+static float hyperloglog_brin_error(Relation index, AttrNumber attno);
+static HyperLogLogCounter hyperloglog_brin_summary(BrinValues *column);
+static void hyperloglog_brin_hash(Datum value, int16 typlen, bool typbyval, unsigned char * hash);
+static AttrNumber hyperloglog_brin_attno(Relation index, Relation heap, Name column);
+static int hyperloglog_brin_compare(HyperLogLogBrinScan *state, Datum a, Datum b);
+static bool hyperloglog_brin_getnextslot(TableScanDesc scan, TupleTableSlot *slot);
+static void hyperloglog_brin_scan_range(HyperLogLogBrinScan *state, BlockNumber start,
+                                        BlockNumber nblocks, HyperLogLogCounter counter);
+
+/* The summary is a single estimator, stored as bytea. */
+Datum
+hyperloglog_brin_opcinfo(PG_FUNCTION_ARGS)
+{
+
+    BrinOpcInfo *result = (BrinOpcInfo *) palloc0(SizeofBrinOpcInfo(1));
+
+    result->oi_nstored = 1;
+#if PG_VERSION_NUM >= 140000
+    result->oi_regular_nulls = true;
+#endif
+    result->oi_opaque = NULL;
+    result->oi_typcache[0] = lookup_type_cache(BYTEAOID, 0);
+
+    PG_RETURN_POINTER(result);
+
+}
+
+/* Adds the value to the summary, and returns true if the summary changed
+ * (i.e. it created the estimator or updated a bin). */
+Datum
+hyperloglog_brin_add_value(PG_FUNCTION_ARGS)
+{
+
+    BrinDesc   *bdesc = (BrinDesc *) PG_GETARG_POINTER(0);
+    BrinValues *column = (BrinValues *) PG_GETARG_POINTER(1);
+    Datum       newval = PG_GETARG_DATUM(2);
+    bool        isnull = PG_GETARG_BOOL(3);
+    Form_pg_attribute attr = TupleDescAttr(bdesc->bd_tupdesc, column->bv_attno - 1);
+    HyperLogLogCounter counter;
+    unsigned char hash[HASH_LENGTH];
+    unsigned int idx;
+    char        rho;
+    bool        modified = false;
+
+    /* NULLs are handled by BRIN itself since PostgreSQL 14 */
+    if (isnull) {
+
+        if (column->bv_hasnulls)
+            PG_RETURN_BOOL(false);
+
+        column->bv_hasnulls = true;
+        PG_RETURN_BOOL(true);
+    }
+
+    if (column->bv_allnulls) {
+
+        float error = hyperloglog_brin_error(bdesc->bd_index, column->bv_attno);
+
+        column->bv_values[0] = PointerGetDatum(hyperloglog_create(DEFAULT_NDISTINCT, error));
+        column->bv_allnulls = false;
+        modified = true;
+    }
+
+    counter = hyperloglog_brin_summary(column);
+
+    hyperloglog_brin_hash(newval, attr->attlen, attr->attbyval, hash);
+
+    /* does the value update a bin? */
+    hyperloglog_hash_bin(hash, counter->b, &idx, &rho);
+
+    if (rho <= counter->data[idx])
+        PG_RETURN_BOOL(modified);
+
+    hyperloglog_add_hash(counter, hash);
+
+    PG_RETURN_BOOL(true);
+
+}
+
+/* There are no operators, so this is never called (but BRIN requires it). */
+Datum
+hyperloglog_brin_consistent(PG_FUNCTION_ARGS)
+{
+    PG_RETURN_BOOL(true);
+}
+
+/* Merges the summary of range B into summary of range A. */
+Datum
+hyperloglog_brin_summary_union(PG_FUNCTION_ARGS)
+{
+
+    BrinValues *col_a = (BrinValues *) PG_GETARG_POINTER(1);
+    BrinValues *col_b = (BrinValues *) PG_GETARG_POINTER(2);
+
+    if (col_b->bv_hasnulls)
+        col_a->bv_hasnulls = true;
+
+    /* nothing to add from B */
+    if (col_b->bv_allnulls)
+        PG_RETURN_VOID();
+
+    if (col_a->bv_allnulls) {
+        /* B is not needed after this, but it's in a different memory context */
+        col_a->bv_values[0] = PointerGetDatum(hyperloglog_copy(hyperloglog_brin_summary(col_b)));
+        col_a->bv_allnulls = false;
+        PG_RETURN_VOID();
+    }
+
+    hyperloglog_merge(hyperloglog_brin_summary(col_a), hyperloglog_brin_summary(col_b), true);
+
+    PG_RETURN_VOID();
+
+}
+
+#if PG_VERSION_NUM >= 130000
+/* The error rate of the summaries, e.g. (user_id hyperloglog_int4_ops(error = 0.02)) */
+Datum
+hyperloglog_brin_options(PG_FUNCTION_ARGS)
+{
+
+    local_relopts *relopts = (local_relopts *) PG_GETARG_POINTER(0);
+
+    init_local_reloptions(relopts, sizeof(HyperLogLogBrinOptions));
+
+    add_local_real_reloption(relopts, "error", "error rate of the estimators",
+                             BRIN_DEFAULT_ERROR, BRIN_MIN_ERROR, BRIN_MAX_ERROR,
+                             offsetof(HyperLogLogBrinOptions, error));
+
+    PG_RETURN_VOID();
+
+}
+#endif
+
+/* Returns estimator of distinct values of the column in rows with the range
+ * column between the lower and upper bound (inclusive), using the summaries
+ * in the BRIN index. Ranges fully within the bounds are not scanned at all,
+ * only the ranges crossing the bounds (and ranges not summarized yet). */
+Datum
+hyperloglog_brin_union(PG_FUNCTION_ARGS)
+{
+
+    Oid         indexoid = PG_GETARG_OID(0);
+    Name        column = PG_GETARG_NAME(1);
+    Name        range_column = PG_GETARG_NAME(2);
+    Oid         heapoid;
+    Relation    index;
+    AttrNumber  attno;
+    AttrNumber  range_attno;
+    Oid         range_type;
+    TypeCacheEntry *typentry;
+    Form_pg_attribute attr;
+    BrinDesc   *bdesc;
+    BrinRevmap *revmap;
+    BlockNumber pagesPerRange;
+    BlockNumber nblocks;
+    BlockNumber heapBlk;
+    Buffer      buf = InvalidBuffer;
+    BrinTuple  *btup = NULL;
+    Size        btupsz = 0;
+    BrinMemTuple *dtup = NULL;
+    HyperLogLogBrinScan state;
+    HyperLogLogCounter counter;
+
+    /* lock the table first, like the other functions working with BRIN */
+    heapoid = IndexGetRelation(indexoid, true);
+
+    if (! OidIsValid(heapoid))
+        elog(ERROR, "\"%s\" is not an index", get_rel_name(indexoid));
+
+    if (pg_class_aclcheck(heapoid, GetUserId(), ACL_SELECT) != ACLCHECK_OK)
+        aclcheck_error(ACLCHECK_NO_PRIV, OBJECT_TABLE, get_rel_name(heapoid));
+
+    state.heap = table_open(heapoid, AccessShareLock);
+    index = index_open(indexoid, AccessShareLock);
+
+    if ((index->rd_rel->relkind != RELKIND_INDEX) || (index->rd_rel->relam != BRIN_AM_OID))
+        elog(ERROR, "\"%s\" is not a BRIN index", RelationGetRelationName(index));
+
+#if PG_VERSION_NUM < 140000
+    /* the block ranges are scanned using heap_setscanlimits */
+    if (state.heap->rd_rel->relam != HEAP_TABLE_AM_OID)
+        elog(ERROR, "table \"%s\" does not use the heap access method",
+             RelationGetRelationName(state.heap));
+#endif
+
+    attno = hyperloglog_brin_attno(index, state.heap, column);
+    range_attno = hyperloglog_brin_attno(index, state.heap, range_column);
+
+    if (index_getprocinfo(index, attno, BRIN_PROCNUM_OPCINFO)->fn_addr != hyperloglog_brin_opcinfo)
+        elog(ERROR, "column \"%s\" of index \"%s\" does not use a hyperloglog operator class",
+             NameStr(*column), RelationGetRelationName(index));
+
+    if (index_getprocid(index, range_attno, BRIN_PROCNUM_OPCINFO) != F_BRIN_MINMAX_OPCINFO)
+        elog(ERROR, "column \"%s\" of index \"%s\" does not use a minmax operator class",
+             NameStr(*range_column), RelationGetRelationName(index));
+
+    range_type = TupleDescAttr(RelationGetDescr(index), range_attno - 1)->atttypid;
+
+    if (get_fn_expr_argtype(fcinfo->flinfo, 3) != range_type)
+        elog(ERROR, "bounds have to be of the same type as column \"%s\" (%s)",
+             NameStr(*range_column), format_type_be(range_type));
+
+    typentry = lookup_type_cache(range_type, TYPECACHE_CMP_PROC_FINFO);
+
+    if (! OidIsValid(typentry->cmp_proc_finfo.fn_oid))
+        elog(ERROR, "could not identify a comparison function for type %s",
+             format_type_be(range_type));
+
+    attr = TupleDescAttr(RelationGetDescr(state.heap), index->rd_index->indkey.values[attno - 1] - 1);
+
+    state.snapshot = RegisterSnapshot(GetActiveSnapshot());
+    state.attnum = attr->attnum;
+    state.typlen = attr->attlen;
+    state.typbyval = attr->attbyval;
+    state.range_attnum = index->rd_index->indkey.values[range_attno - 1];
+    state.cmp = &typentry->cmp_proc_finfo;
+    state.collation = index->rd_indcollation[range_attno - 1];
+    state.lower = PG_GETARG_DATUM(3);
+    state.upper = PG_GETARG_DATUM(4);
+    state.tmpcxt = AllocSetContextCreate(CurrentMemoryContext, "hyperloglog brin union",
+                                         ALLOCSET_DEFAULT_SIZES);
+
+    counter = hyperloglog_create(DEFAULT_NDISTINCT, hyperloglog_brin_error(index, attno));
+
+    bdesc = brin_build_desc(index);
+#if PG_VERSION_NUM >= 170000
+    revmap = brinRevmapInitialize(index, &pagesPerRange);
+#else
+    revmap = brinRevmapInitialize(index, &pagesPerRange, state.snapshot);
+#endif
+
+    nblocks = RelationGetNumberOfBlocks(state.heap);
+
+    for (heapBlk = 0; heapBlk < nblocks; heapBlk += pagesPerRange) {
+
+        BrinTuple  *tup;
+        OffsetNumber off;
+        Size        size;
+
+        CHECK_FOR_INTERRUPTS();
+
+#if PG_VERSION_NUM >= 170000
+        tup = brinGetTupleForHeapBlock(revmap, heapBlk, &buf, &off, &size, BUFFER_LOCK_SHARE);
+#else
+        tup = brinGetTupleForHeapBlock(revmap, heapBlk, &buf, &off, &size, BUFFER_LOCK_SHARE,
+                                       state.snapshot);
+#endif
+
+        if (tup != NULL) {
+
+            btup = brin_copy_tuple(tup, size, btup, &btupsz);
+            LockBuffer(buf, BUFFER_LOCK_UNLOCK);
+
+            dtup = brin_deform_tuple(bdesc, btup, dtup);
+        }
+
+        /* summarized range, so maybe we can use (or skip) it entirely */
+        if ((tup != NULL) && (! dtup->bt_placeholder)) {
+
+            BrinValues *range = &dtup->bt_columns[range_attno - 1];
+            BrinValues *summary = &dtup->bt_columns[attno - 1];
+
+            /* no rows with a value in the range column */
+            if (range->bv_allnulls)
+                continue;
+
+            /* all rows out of bounds */
+            if ((hyperloglog_brin_compare(&state, range->bv_values[1], state.lower) < 0) ||
+                (hyperloglog_brin_compare(&state, range->bv_values[0], state.upper) > 0))
+                continue;
+
+            /* all rows within bounds (rows with NULL in the range column do not
+             * match, but they are included in the summary) */
+            if ((hyperloglog_brin_compare(&state, range->bv_values[0], state.lower) >= 0) &&
+                (hyperloglog_brin_compare(&state, range->bv_values[1], state.upper) <= 0) &&
+                (! range->bv_hasnulls)) {
+
+                if (! summary->bv_allnulls)
+                    hyperloglog_merge(counter, hyperloglog_brin_summary(summary), true);
+
+                continue;
+            }
+        }
+
+        /* range crossing the bounds, or not summarized yet */
+        hyperloglog_brin_scan_range(&state, heapBlk, Min(pagesPerRange, nblocks - heapBlk), counter);
+    }
+
+    if (BufferIsValid(buf))
+        ReleaseBuffer(buf);
+
+    brinRevmapTerminate(revmap);
+    brin_free_desc(bdesc);
+
+    UnregisterSnapshot(state.snapshot);
+
+    MemoryContextDelete(state.tmpcxt);
+
+    index_close(index, AccessShareLock);
+    table_close(state.heap, AccessShareLock);
+
+    PG_RETURN_BYTEA_P(counter);
+
+}
+
+/* Error rate of the summaries in the index column (the option, or default). */
+static float
+hyperloglog_brin_error(Relation index, AttrNumber attno)
+{
+#if PG_VERSION_NUM >= 130000
+    bytea **options = RelationGetIndexAttOptions(index, false);
+
+    if (options[attno - 1] != NULL)
+        return ((HyperLogLogBrinOptions *) options[attno - 1])->error;
+#endif
+
+    return BRIN_DEFAULT_ERROR;
+}
+
+/* Returns the summary estimator, replacing the stored value by a detoasted
+ * copy if needed (short values get a 1-byte header on disk), so that it can
+ * be modified in place. */
+static HyperLogLogCounter
+hyperloglog_brin_summary(BrinValues *column)
+{
+
+    HyperLogLogCounter counter = (HyperLogLogCounter) PG_DETOAST_DATUM(column->bv_values[0]);
+
+    column->bv_values[0] = PointerGetDatum(counter);
+
+    return counter;
+
+}
+
+/* The same hash as used by hyperloglog_accum (for the same type). */
+static void
+hyperloglog_brin_hash(Datum value, int16 typlen, bool typbyval, unsigned char * hash)
+{
+    if (typlen == -1)
+        distinct_hash_varlena(value, hash);
+    else if (typbyval)
+        distinct_md5((char *) &value, typlen, hash);
+    else
+        distinct_md5((char *) DatumGetPointer(value), typlen, hash);
+}
+
+/* Finds the index column (attribute number) for the table column. */
+static AttrNumber
+hyperloglog_brin_attno(Relation index, Relation heap, Name column)
+{
+
+    int i;
+
+    for (i = 0; i < IndexRelationGetNumberOfKeyAttributes(index); i++) {
+
+        AttrNumber attnum = index->rd_index->indkey.values[i];
+
+        /* expressions are not supported */
+        if (attnum <= 0)
+            continue;
+
+        if (strcmp(NameStr(TupleDescAttr(RelationGetDescr(heap), attnum - 1)->attname),
+                   NameStr(*column)) == 0)
+            return i + 1;
+    }
+
+    elog(ERROR, "column \"%s\" is not in index \"%s\"",
+         NameStr(*column), RelationGetRelationName(index));
+
+    return InvalidAttrNumber;   /* keep the compiler quiet */
+
+}
+
+static int
+hyperloglog_brin_compare(HyperLogLogBrinScan *state, Datum a, Datum b)
+{
+    return DatumGetInt32(FunctionCall2Coll(state->cmp, state->collation, a, b));
+}
+
+/* Returns the next row of the block range scan (see hyperloglog_brin_scan_range). */
+static bool
+hyperloglog_brin_getnextslot(TableScanDesc scan, TupleTableSlot *slot)
+{
+#if PG_VERSION_NUM >= 140000
+    return table_scan_getnextslot_tidrange(scan, ForwardScanDirection, slot);
+#else
+    return table_scan_getnextslot(scan, ForwardScanDirection, slot);
+#endif
+}
+
+/* Adds values from rows within the bounds, in the given block range. The rows
+ * are read through the table AM, so only rows visible to the snapshot of the
+ * query are counted. On PostgreSQL 14+ this is a TID range scan, older
+ * releases have no such scan, so the heap scan is limited to the blocks (and
+ * only heap tables are supported, see hyperloglog_brin_union). */
+static void
+hyperloglog_brin_scan_range(HyperLogLogBrinScan *state, BlockNumber start,
+                            BlockNumber nblocks, HyperLogLogCounter counter)
+{
+
+    TableScanDesc   scan;
+    TupleTableSlot *slot = table_slot_create(state->heap, NULL);
+
+#if PG_VERSION_NUM >= 140000
+    ItemPointerData mintid, maxtid;
+
+    ItemPointerSet(&mintid, start, FirstOffsetNumber);
+    ItemPointerSet(&maxtid, start + nblocks - 1, MaxOffsetNumber);
+
+    scan = table_beginscan_tidrange(state->heap, state->snapshot, &mintid, &maxtid);
+#else
+    /* no synchronized scans, the scan has to start at the first block */
+    scan = table_beginscan_strat(state->heap, state->snapshot, 0, NULL, true, false);
+    heap_setscanlimits(scan, start, nblocks);
+#endif
+
+    while (hyperloglog_brin_getnextslot(scan, slot)) {
+
+        Datum       value;
+        bool        isnull;
+        MemoryContext oldcxt;
+
+        CHECK_FOR_INTERRUPTS();
+
+        oldcxt = MemoryContextSwitchTo(state->tmpcxt);
+
+        value = slot_getattr(slot, state->range_attnum, &isnull);
+
+        if ((! isnull) &&
+            (hyperloglog_brin_compare(state, value, state->lower) >= 0) &&
+            (hyperloglog_brin_compare(state, value, state->upper) <= 0)) {
+
+            value = slot_getattr(slot, state->attnum, &isnull);
+
+            if (! isnull) {
+
+                unsigned char hash[HASH_LENGTH];
+
+                hyperloglog_brin_hash(value, state->typlen, state->typbyval, hash);
+                hyperloglog_add_hash(counter, hash);
+            }
+        }
+
+        MemoryContextSwitchTo(oldcxt);
+        MemoryContextReset(state->tmpcxt);
+    }
+
+    table_endscan(scan);
+    ExecDropSingleTupleTableSlot(slot);
+
+}
+
+#else
+
+Datum
+hyperloglog_brin_opcinfo(PG_FUNCTION_ARGS)
+{
+    elog(ERROR, "BRIN summaries require PostgreSQL 12 or newer");
+    PG_RETURN_NULL();
+}
+
+Datum
+hyperloglog_brin_add_value(PG_FUNCTION_ARGS)
+{
+    elog(ERROR, "BRIN summaries require PostgreSQL 12 or newer");
+    PG_RETURN_NULL();
+}
+
+Datum
+hyperloglog_brin_consistent(PG_FUNCTION_ARGS)
+{
+    elog(ERROR, "BRIN summaries require PostgreSQL 12 or newer");
+    PG_RETURN_NULL();
+}
+
+Datum
+hyperloglog_brin_summary_union(PG_FUNCTION_ARGS)
+{
+    elog(ERROR, "BRIN summaries require PostgreSQL 12 or newer");
+    PG_RETURN_NULL();
+}
+
+Datum
+hyperloglog_brin_union(PG_FUNCTION_ARGS)
+{
+    elog(ERROR, "BRIN summaries require PostgreSQL 12 or newer");
+    PG_RETURN_NULL();
+}
+
+#endif
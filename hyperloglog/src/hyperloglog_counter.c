@@ -5,10 +5,20 @@
 
 #include "postgres.h"
 #include "fmgr.h"
+#include "access/htup_details.h"
+#include "catalog/pg_type.h"
 #include "hyperloglog.h"
+#include "hyperloglog_counter.h"
+#include "distinct_hash.h"
+#include "distinct_multi.h"
+#include "distinct_rollup.h"
 #include "utils/builtins.h"
+#include "utils/array.h"
 #include "utils/bytea.h"
 #include "utils/lsyscache.h"
+#include "utils/syscache.h"
+#include "utils/uuid.h"
+#include "utils/timestamp.h"
 #include "lib/stringinfo.h"
 #include "libpq/pqformat.h"
 
@@ -16,20 +26,45 @@
 PG_MODULE_MAGIC;
 #endif
 
+void _PG_init(void);
+
 #define VAL(CH)         ((CH) - '0')
 #define DIG(VAL)        ((VAL) + '0')
 
+/* we're using md5, which produces 16B (128-bit) values */
+#define HASH_LENGTH 16
+
 /* shoot for 10^9 distinct items and 2.5% error rate by default */
 #define DEFAULT_NDISTINCT   1000000000
 #define DEFAULT_ERROR       0.025
 
+/* number of (rho, timestamp) slots per bin for the sliding-window counter */
+#define DEFAULT_WINDOW_SLOTS    8
+#define MAX_WINDOW_SLOTS        64
+
 PG_FUNCTION_INFO_V1(hyperloglog_add_item);
 PG_FUNCTION_INFO_V1(hyperloglog_add_item_agg);
 PG_FUNCTION_INFO_V1(hyperloglog_add_item_agg2);
+PG_FUNCTION_INFO_V1(hyperloglog_add_hashed);
+PG_FUNCTION_INFO_V1(hyperloglog_add_hashed_agg);
+PG_FUNCTION_INFO_V1(hyperloglog_add_hashed_agg2);
+PG_FUNCTION_INFO_V1(hyperloglog_add_item_multi);
+PG_FUNCTION_INFO_V1(hyperloglog_add_item_multi_agg);
+PG_FUNCTION_INFO_V1(hyperloglog_add_int2_agg);
+PG_FUNCTION_INFO_V1(hyperloglog_add_int4_agg);
+PG_FUNCTION_INFO_V1(hyperloglog_add_int8_agg);
+PG_FUNCTION_INFO_V1(hyperloglog_add_uuid_agg);
 
 PG_FUNCTION_INFO_V1(hyperloglog_merge_simple);
 PG_FUNCTION_INFO_V1(hyperloglog_merge_agg);
+PG_FUNCTION_INFO_V1(hyperloglog_union);
+PG_FUNCTION_INFO_V1(hyperloglog_union_estimate);
+PG_FUNCTION_INFO_V1(hyperloglog_rollup_refresh);
 PG_FUNCTION_INFO_V1(hyperloglog_get_estimate);
+PG_FUNCTION_INFO_V1(hyperloglog_get_estimate_bigint);
+PG_FUNCTION_INFO_V1(hyperloglog_accum_final);
+PG_FUNCTION_INFO_V1(hyperloglog_from_loglog);
+PG_FUNCTION_INFO_V1(hyperloglog_from_loglog_estimator);
 
 PG_FUNCTION_INFO_V1(hyperloglog_size);
 PG_FUNCTION_INFO_V1(hyperloglog_init);
@@ -40,13 +75,45 @@ PG_FUNCTION_INFO_V1(hyperloglog_rect);
 PG_FUNCTION_INFO_V1(hyperloglog_send);
 PG_FUNCTION_INFO_V1(hyperloglog_length);
 
+PG_FUNCTION_INFO_V1(hyperloglog_window_add_item);
+PG_FUNCTION_INFO_V1(hyperloglog_window_add_item_agg);
+PG_FUNCTION_INFO_V1(hyperloglog_window_add_item_agg2);
+PG_FUNCTION_INFO_V1(hyperloglog_window_merge_simple);
+PG_FUNCTION_INFO_V1(hyperloglog_window_merge_agg);
+PG_FUNCTION_INFO_V1(hyperloglog_window_get_estimate);
+PG_FUNCTION_INFO_V1(hyperloglog_window_get_estimate_since);
+PG_FUNCTION_INFO_V1(hyperloglog_window_snapshot_window);
+PG_FUNCTION_INFO_V1(hyperloglog_window_size);
+PG_FUNCTION_INFO_V1(hyperloglog_window_init);
+PG_FUNCTION_INFO_V1(hyperloglog_window_reset);
+
 Datum hyperloglog_add_item(PG_FUNCTION_ARGS);
 Datum hyperloglog_add_item_agg(PG_FUNCTION_ARGS);
 Datum hyperloglog_add_item_agg2(PG_FUNCTION_ARGS);
+Datum hyperloglog_add_hashed(PG_FUNCTION_ARGS);
+Datum hyperloglog_add_hashed_agg(PG_FUNCTION_ARGS);
+Datum hyperloglog_add_hashed_agg2(PG_FUNCTION_ARGS);
+Datum hyperloglog_add_item_multi(PG_FUNCTION_ARGS);
+Datum hyperloglog_add_item_multi_agg(PG_FUNCTION_ARGS);
+Datum hyperloglog_add_int2_agg(PG_FUNCTION_ARGS);
+Datum hyperloglog_add_int4_agg(PG_FUNCTION_ARGS);
+Datum hyperloglog_add_int8_agg(PG_FUNCTION_ARGS);
+Datum hyperloglog_add_uuid_agg(PG_FUNCTION_ARGS);
+
+static void hyperloglog_get_hash(FunctionCallInfo fcinfo, int argno, unsigned char * hash);
+static HyperLogLogCounter hyperloglog_get_agg_counter(FunctionCallInfo fcinfo);
+static void hyperloglog_add_varlena(HyperLogLogCounter hyperloglog, Datum element);
 
 Datum hyperloglog_get_estimate(PG_FUNCTION_ARGS);
+Datum hyperloglog_get_estimate_bigint(PG_FUNCTION_ARGS);
+Datum hyperloglog_accum_final(PG_FUNCTION_ARGS);
+Datum hyperloglog_from_loglog(PG_FUNCTION_ARGS);
+Datum hyperloglog_from_loglog_estimator(PG_FUNCTION_ARGS);
 Datum hyperloglog_merge_simple(PG_FUNCTION_ARGS);
 Datum hyperloglog_merge_agg(PG_FUNCTION_ARGS);
+Datum hyperloglog_union(PG_FUNCTION_ARGS);
+Datum hyperloglog_union_estimate(PG_FUNCTION_ARGS);
+Datum hyperloglog_rollup_refresh(PG_FUNCTION_ARGS);
 
 Datum hyperloglog_size(PG_FUNCTION_ARGS);
 Datum hyperloglog_init(PG_FUNCTION_ARGS);
@@ -57,6 +124,31 @@ Datum hyperloglog_recv(PG_FUNCTION_ARGS);
 Datum hyperloglog_send(PG_FUNCTION_ARGS);
 Datum hyperloglog_length(PG_FUNCTION_ARGS);
 
+Datum hyperloglog_window_add_item(PG_FUNCTION_ARGS);
+Datum hyperloglog_window_add_item_agg(PG_FUNCTION_ARGS);
+Datum hyperloglog_window_add_item_agg2(PG_FUNCTION_ARGS);
+Datum hyperloglog_window_merge_simple(PG_FUNCTION_ARGS);
+Datum hyperloglog_window_merge_agg(PG_FUNCTION_ARGS);
+Datum hyperloglog_window_get_estimate(PG_FUNCTION_ARGS);
+Datum hyperloglog_window_get_estimate_since(PG_FUNCTION_ARGS);
+Datum hyperloglog_window_snapshot_window(PG_FUNCTION_ARGS);
+Datum hyperloglog_window_size(PG_FUNCTION_ARGS);
+Datum hyperloglog_window_init(PG_FUNCTION_ARGS);
+Datum hyperloglog_window_reset(PG_FUNCTION_ARGS);
+
+static int32 hyperloglog_window_time(TimestampTz timestamp);
+static int32 hyperloglog_window_start(Interval * window);
+static void hyperloglog_window_check_params(float errorRate, int nslots);
+
+/* module initialization (GUC options, hooks) */
+void
+_PG_init(void)
+{
+    hyperloglog_shmem_init();
+    hyperloglog_rewrite_init();
+    hyperloglog_stats_init();
+}
+
 Datum
 hyperloglog_add_item(PG_FUNCTION_ARGS)
 {
@@ -89,7 +181,7 @@ hyperloglog_add_item(PG_FUNCTION_ARGS)
         /* it this a varlena type, passed by reference or by value ? */
         if (typlen == -1) {
             /* varlena */
-            hyperloglog_add_element(hyperloglog, VARDATA(element), VARSIZE(element) - VARHDRSZ);
+            hyperloglog_add_varlena(hyperloglog, element);
         } else if (typbyval) {
             /* fixed-length, passed by value */
             hyperloglog_add_element(hyperloglog, (char*)&element, typlen);
@@ -146,7 +238,7 @@ hyperloglog_add_item_agg(PG_FUNCTION_ARGS)
         /* it this a varlena type, passed by reference or by value ? */
         if (typlen == -1) {
             /* varlena */
-            hyperloglog_add_element(hyperloglog, VARDATA(element), VARSIZE(element) - VARHDRSZ);
+            hyperloglog_add_varlena(hyperloglog, element);
         } else if (typbyval) {
             /* fixed-length, passed by value */
             hyperloglog_add_element(hyperloglog, (char*)&element, typlen);
@@ -194,7 +286,7 @@ hyperloglog_add_item_agg2(PG_FUNCTION_ARGS)
         /* it this a varlena type, passed by reference or by value ? */
         if (typlen == -1) {
             /* varlena */
-            hyperloglog_add_element(hyperloglog, VARDATA(element), VARSIZE(element) - VARHDRSZ);
+            hyperloglog_add_varlena(hyperloglog, element);
         } else if (typbyval) {
             /* fixed-length, passed by value */
             hyperloglog_add_element(hyperloglog, (char*)&element, typlen);
@@ -210,6 +302,312 @@ hyperloglog_add_item_agg2(PG_FUNCTION_ARGS)
 
 }
 
+Datum
+hyperloglog_add_hashed(PG_FUNCTION_ARGS)
+{
+
+    HyperLogLogCounter hyperloglog;
+    unsigned char hash[HASH_LENGTH];
+
+    /* requires the estimator to be already created */
+    if (PG_ARGISNULL(0))
+        elog(ERROR, "hyperloglog counter must not be NULL");
+
+    /* if the hash is not NULL, add it to the estimator (i.e. skip NULLs) */
+    if (! PG_ARGISNULL(1)) {
+
+        /* estimator (we know it's not a NULL value) */
+        hyperloglog = (HyperLogLogCounter)PG_GETARG_BYTEA_P(0);
+
+        hyperloglog_get_hash(fcinfo, 1, hash);
+
+        hyperloglog_add_hash(hyperloglog, hash);
+
+    }
+
+    PG_RETURN_VOID();
+
+}
+
+Datum
+hyperloglog_add_hashed_agg(PG_FUNCTION_ARGS)
+{
+
+    HyperLogLogCounter hyperloglog;
+    float errorRate; /* required error rate */
+
+    unsigned char hash[HASH_LENGTH];
+
+    /* create a new estimator (with requested error rate) or reuse the existing one */
+    if (PG_ARGISNULL(0)) {
+
+        errorRate = PG_GETARG_FLOAT4(2);
+
+        /* error rate between 0 and 1 (not 0) */
+        if ((errorRate <= 0) || (errorRate > 1))
+            elog(ERROR, "error rate has to be between 0 and 1");
+
+        hyperloglog = hyperloglog_create(DEFAULT_NDISTINCT, errorRate);
+
+    } else { /* existing estimator */
+        hyperloglog = (HyperLogLogCounter)PG_GETARG_BYTEA_P(0);
+    }
+
+    /* add the hash to the estimator (skip NULLs) */
+    if (! PG_ARGISNULL(1)) {
+        hyperloglog_get_hash(fcinfo, 1, hash);
+        hyperloglog_add_hash(hyperloglog, hash);
+    }
+
+    /* return the updated bytea */
+    PG_RETURN_BYTEA_P(hyperloglog);
+
+}
+
+Datum
+hyperloglog_add_hashed_agg2(PG_FUNCTION_ARGS)
+{
+
+    HyperLogLogCounter hyperloglog;
+
+    unsigned char hash[HASH_LENGTH];
+
+    /* is the counter created (if not, create it - error 1%, 10mil items) */
+    if (PG_ARGISNULL(0)) {
+      hyperloglog = hyperloglog_create(DEFAULT_NDISTINCT, DEFAULT_ERROR);
+    } else {
+      hyperloglog = (HyperLogLogCounter)PG_GETARG_BYTEA_P(0);
+    }
+
+    /* add the hash to the estimator (skip NULLs) */
+    if (! PG_ARGISNULL(1)) {
+        hyperloglog_get_hash(fcinfo, 1, hash);
+        hyperloglog_add_hash(hyperloglog, hash);
+    }
+
+    /* return the updated bytea */
+    PG_RETURN_BYTEA_P(hyperloglog);
+
+}
+
+Datum
+hyperloglog_add_item_multi(PG_FUNCTION_ARGS)
+{
+
+    HyperLogLogCounter hyperloglog;
+    unsigned char hash[HASH_LENGTH];
+
+    /* requires the estimator to be already created */
+    if (PG_ARGISNULL(0))
+        elog(ERROR, "hyperloglog counter must not be NULL");
+
+    /* estimator (we know it's not a NULL value) */
+    hyperloglog = (HyperLogLogCounter)PG_GETARG_BYTEA_P(0);
+
+    /* add the key to the estimator (skip keys with NULL values) */
+    if (distinct_hash_multi(fcinfo, 1, hash))
+        hyperloglog_add_hash(hyperloglog, hash);
+
+    PG_RETURN_VOID();
+
+}
+
+Datum
+hyperloglog_add_item_multi_agg(PG_FUNCTION_ARGS)
+{
+
+    HyperLogLogCounter hyperloglog;
+    unsigned char hash[HASH_LENGTH];
+
+    /* create a new estimator (with default parameters) or reuse the existing one */
+    if (PG_ARGISNULL(0)) {
+        hyperloglog = hyperloglog_create(DEFAULT_NDISTINCT, DEFAULT_ERROR);
+    } else {
+        hyperloglog = (HyperLogLogCounter)PG_GETARG_BYTEA_P(0);
+    }
+
+    /* add the key to the estimator (skip keys with NULL values) */
+    if (distinct_hash_multi(fcinfo, 1, hash))
+        hyperloglog_add_hash(hyperloglog, hash);
+
+    /* return the updated bytea */
+    PG_RETURN_BYTEA_P(hyperloglog);
+
+}
+
+/* Transition functions for the int2, int4, int8 and uuid overloads of the
+ * hyperloglog_distinct aggregates, without the type lookup and md5 of the generic
+ * (anyelement) ones - integers are expanded into a hash using the same mixing
+ * function as pre-hashed bigint values, uuids are folded into 64 bits first.
+ *
+ * The counters are not compatible with those built from the same values by
+ * hyperloglog_accum(anyelement), so only the hyperloglog_distinct aggregates (returning just
+ * the estimate) have such overloads. */
+Datum
+hyperloglog_add_int2_agg(PG_FUNCTION_ARGS)
+{
+
+    HyperLogLogCounter hyperloglog = hyperloglog_get_agg_counter(fcinfo);
+    unsigned char hash[HASH_LENGTH];
+
+    /* add the value to the estimator (skip NULLs) */
+    if (! PG_ARGISNULL(1)) {
+        distinct_hash_int64(PG_GETARG_INT16(1), hash);
+        hyperloglog_add_hash(hyperloglog, hash);
+    }
+
+    /* return the updated bytea */
+    PG_RETURN_BYTEA_P(hyperloglog);
+
+}
+
+Datum
+hyperloglog_add_int4_agg(PG_FUNCTION_ARGS)
+{
+
+    HyperLogLogCounter hyperloglog = hyperloglog_get_agg_counter(fcinfo);
+    unsigned char hash[HASH_LENGTH];
+
+    /* add the value to the estimator (skip NULLs) */
+    if (! PG_ARGISNULL(1)) {
+        distinct_hash_int64(PG_GETARG_INT32(1), hash);
+        hyperloglog_add_hash(hyperloglog, hash);
+    }
+
+    /* return the updated bytea */
+    PG_RETURN_BYTEA_P(hyperloglog);
+
+}
+
+Datum
+hyperloglog_add_int8_agg(PG_FUNCTION_ARGS)
+{
+
+    HyperLogLogCounter hyperloglog = hyperloglog_get_agg_counter(fcinfo);
+    unsigned char hash[HASH_LENGTH];
+
+    /* add the value to the estimator (skip NULLs) */
+    if (! PG_ARGISNULL(1)) {
+        distinct_hash_int64(PG_GETARG_INT64(1), hash);
+        hyperloglog_add_hash(hyperloglog, hash);
+    }
+
+    /* return the updated bytea */
+    PG_RETURN_BYTEA_P(hyperloglog);
+
+}
+
+Datum
+hyperloglog_add_uuid_agg(PG_FUNCTION_ARGS)
+{
+
+    HyperLogLogCounter hyperloglog = hyperloglog_get_agg_counter(fcinfo);
+    unsigned char hash[HASH_LENGTH];
+
+    /* add the value to the estimator (skip NULLs) */
+    if (! PG_ARGISNULL(1)) {
+
+        pg_uuid_t  *uuid = PG_GETARG_UUID_P(1);
+        uint64      hi, lo;
+
+        memcpy(&hi, uuid->data, sizeof(uint64));
+        memcpy(&lo, uuid->data + sizeof(uint64), sizeof(uint64));
+
+        /* The uuid bits can't be used directly, as time-based uuids (v1, v7)
+         * are not uniform at all. So fold the halves into 64 bits (mixing the
+         * low half first, which is in the first 8 bytes of the hash). */
+        distinct_hash_int64(lo, hash);
+        memcpy(&lo, hash, sizeof(uint64));
+
+        distinct_hash_int64(hi ^ lo, hash);
+        hyperloglog_add_hash(hyperloglog, hash);
+    }
+
+    /* return the updated bytea */
+    PG_RETURN_BYTEA_P(hyperloglog);
+
+}
+
+/* Returns the counter passed to the transition function, or creates a new one
+ * (with the parameters passed to the aggregate, or the default ones). */
+static HyperLogLogCounter
+hyperloglog_get_agg_counter(FunctionCallInfo fcinfo)
+{
+
+    float   errorRate; /* required error rate */
+
+    /* existing estimator */
+    if (! PG_ARGISNULL(0))
+        return (HyperLogLogCounter)PG_GETARG_BYTEA_P(0);
+
+    /* default parameters */
+    if (PG_NARGS() < 3)
+        return hyperloglog_create(DEFAULT_NDISTINCT, DEFAULT_ERROR);
+
+    errorRate = PG_GETARG_FLOAT4(2);
+
+    /* error rate between 0 and 1 (not 0) */
+    if ((errorRate <= 0) || (errorRate > 1))
+        elog(ERROR, "error rate has to be between 0 and 1");
+
+    return hyperloglog_create(DEFAULT_NDISTINCT, errorRate);
+
+}
+
+/* Adds a varlena value (hashed by distinct_hash_varlena). */
+static void
+hyperloglog_add_varlena(HyperLogLogCounter hyperloglog, Datum element)
+{
+
+    unsigned char hash[HASH_LENGTH];
+    instr_time start, hashed, end;
+
+    if (hyperloglog_stats == NULL) {
+
+        distinct_hash_varlena(element, hash);
+
+        hyperloglog_add_hash(hyperloglog, hash);
+
+        return;
+    }
+
+    /* the same, but with instrumentation (see hyperloglog_stats.c) */
+    INSTR_TIME_SET_CURRENT(start);
+    distinct_hash_varlena(element, hash);
+    INSTR_TIME_SET_CURRENT(hashed);
+    hyperloglog_add_hash(hyperloglog, hash);
+    INSTR_TIME_SET_CURRENT(end);
+
+    hyperloglog_stats->elements++;
+    INSTR_TIME_ACCUM_DIFF(hyperloglog_stats->hash_time, hashed, start);
+    INSTR_TIME_ACCUM_DIFF(hyperloglog_stats->update_time, end, hashed);
+
+}
+
+/* Gets the hash from the argument - either the first HASH_LENGTH bytes of a bytea
+ * value (which has to be at least that long), or a bigint value expanded into
+ * HASH_LENGTH bytes. */
+static void
+hyperloglog_get_hash(FunctionCallInfo fcinfo, int argno, unsigned char * hash)
+{
+
+    if (get_fn_expr_argtype(fcinfo->flinfo, argno) == INT8OID) {
+
+        distinct_hash_int64(PG_GETARG_INT64(argno), hash);
+
+    } else {
+
+        bytea * value = PG_GETARG_BYTEA_PP(argno);
+
+        if (VARSIZE_ANY_EXHDR(value) < HASH_LENGTH)
+            elog(ERROR, "hash has to be at least %d bytes", HASH_LENGTH);
+
+        memcpy(hash, VARDATA_ANY(value), HASH_LENGTH);
+
+    }
+
+}
+
 Datum
 hyperloglog_merge_simple(PG_FUNCTION_ARGS)
 {
@@ -235,7 +633,16 @@ hyperloglog_merge_agg(PG_FUNCTION_ARGS)
 {
 
     HyperLogLogCounter counter1;
-    HyperLogLogCounter counter2 = (HyperLogLogCounter)PG_GETARG_BYTEA_P(1);
+    HyperLogLogCounter counter2;
+
+    /* nothing to merge (e.g. when combining an empty partial aggregate) */
+    if (PG_ARGISNULL(1)) {
+        if (PG_ARGISNULL(0))
+            PG_RETURN_NULL();
+        PG_RETURN_DATUM(PG_GETARG_DATUM(0));
+    }
+
+    counter2 = (HyperLogLogCounter)PG_GETARG_BYTEA_P(1);
 
     /* is the counter created (if not, create it - error 1%, 10mil items) */
     if (PG_ARGISNULL(0)) {
@@ -259,6 +666,112 @@ hyperloglog_merge_agg(PG_FUNCTION_ARGS)
 }
 
 
+/* Merges all the counters in the array into a single new counter, allocated
+ * only once (merging them one by one using || allocates a new counter for
+ * each step). NULL elements are skipped, returns NULL if there are no other
+ * elements in the array. */
+static HyperLogLogCounter
+hyperloglog_union_array(ArrayType * counters)
+{
+
+    int i;
+    int nelems;
+    Datum *elems;
+    bool *nulls;
+    int16 typlen;
+    bool typbyval;
+    char typalign;
+    HyperLogLogCounter result = NULL;
+
+    get_typlenbyvalalign(ARR_ELEMTYPE(counters), &typlen, &typbyval, &typalign);
+
+    deconstruct_array(counters, ARR_ELEMTYPE(counters), typlen, typbyval, typalign,
+                      &elems, &nulls, &nelems);
+
+    for (i = 0; i < nelems; i++) {
+
+        HyperLogLogCounter counter;
+
+        if (nulls[i])
+            continue;
+
+        /* the elements may have short headers, or be compressed */
+        counter = (HyperLogLogCounter)PG_DETOAST_DATUM(elems[i]);
+
+        if (result == NULL) {
+            /* the first counter - reuse the detoasted copy if there is one */
+            if ((Pointer)counter != DatumGetPointer(elems[i]))
+                result = counter;
+            else
+                result = hyperloglog_copy(counter);
+            continue;
+        }
+
+        hyperloglog_merge(result, counter, true);
+
+        if ((Pointer)counter != DatumGetPointer(elems[i]))
+            pfree(counter);
+
+    }
+
+    pfree(elems);
+    pfree(nulls);
+
+    return result;
+
+}
+
+Datum
+hyperloglog_union(PG_FUNCTION_ARGS)
+{
+
+    HyperLogLogCounter result = hyperloglog_union_array(PG_GETARG_ARRAYTYPE_P(0));
+
+    if (result == NULL)
+        PG_RETURN_NULL();
+
+    PG_RETURN_BYTEA_P(result);
+
+}
+
+/* Estimate of the union of all the counters in the array, without returning
+ * the merged counter. */
+Datum
+hyperloglog_union_estimate(PG_FUNCTION_ARGS)
+{
+
+    int estimate;
+    HyperLogLogCounter result = hyperloglog_union_array(PG_GETARG_ARRAYTYPE_P(0));
+
+    if (result == NULL)
+        PG_RETURN_NULL();
+
+    estimate = hyperloglog_estimate(result);
+
+    pfree(result);
+
+    PG_RETURN_FLOAT4(estimate);
+
+}
+
+/* Incremental refresh of a rollup table, the error rate (the last argument)
+ * is passed to hyperloglog_accum. See distinct_rollup_refresh for details. */
+Datum
+hyperloglog_rollup_refresh(PG_FUNCTION_ARGS)
+{
+
+    Oid     types[1] = {FLOAT4OID};
+    Datum   values[1];
+
+    if (PG_ARGISNULL(7))
+        elog(ERROR, "error rate of the rollup counters must not be NULL");
+
+    values[0] = PG_GETARG_DATUM(7);
+
+    PG_RETURN_INT64(distinct_rollup_refresh(fcinfo, "hyperloglog", 1, types, values));
+
+}
+
 Datum
 hyperloglog_get_estimate(PG_FUNCTION_ARGS)
 {
@@ -274,6 +787,114 @@ hyperloglog_get_estimate(PG_FUNCTION_ARGS)
 
 }
 
+/* Estimate as bigint, with 0 for empty input (i.e. exactly like count), used
+ * by the COUNT(DISTINCT) rewrite. */
+Datum
+hyperloglog_get_estimate_bigint(PG_FUNCTION_ARGS)
+{
+
+    HyperLogLogCounter hyperloglog;
+
+    if (PG_ARGISNULL(0))
+        PG_RETURN_INT64(0);
+
+    hyperloglog = (HyperLogLogCounter)PG_GETARG_BYTEA_P(0);
+
+    PG_RETURN_INT64(hyperloglog_estimate(hyperloglog));
+
+}
+
+/* Final function of the _accum (and merge) aggregates. Returns a copy of the
+ * counter with the estimate cached in it, so that estimating the counter later
+ * (e.g. after storing it in a table) does not need to walk the bins. The state
+ * itself is not modified (it may still be used by a window aggregate). */
+Datum
+hyperloglog_accum_final(PG_FUNCTION_ARGS)
+{
+
+    HyperLogLogCounter hyperloglog;
+
+    if (PG_ARGISNULL(0))
+        PG_RETURN_NULL();
+
+    hyperloglog = hyperloglog_copy((HyperLogLogCounter)PG_GETARG_BYTEA_P(0));
+
+    hyperloglog_cache_estimate(hyperloglog);
+
+    PG_RETURN_BYTEA_P(hyperloglog);
+
+}
+
+/* Converts a LogLog or SuperLogLog counter (passed as bytea, so that this does
+ * not depend on the other extensions) into a HyperLogLog one. Both have the
+ * same layout - length, number of index bits, number of bins and the bins,
+ * and SuperLogLog counters may be followed by a cached estimate. */
+Datum
+hyperloglog_from_loglog(PG_FUNCTION_ARGS)
+{
+
+    bytea  *counter = PG_GETARG_BYTEA_PP(0);
+    char   *data = VARDATA_ANY(counter);
+    int     len = VARSIZE_ANY_EXHDR(counter);
+    int32   bits;
+    int32   m;
+
+    if (len < 2 * sizeof(int32))
+        elog(ERROR, "invalid LogLog counter (length %d)", len);
+
+    /* the fields may not be aligned (short varlena header) */
+    memcpy(&bits, data, sizeof(int32));
+    memcpy(&m, data + sizeof(int32), sizeof(int32));
+
+    if ((bits < 1) || (bits > 30) || (m != (1 << bits)) ||
+        ((len != 2 * sizeof(int32) + m) && (len != 3 * sizeof(int32) + m)))
+        elog(ERROR, "invalid LogLog counter (length %d, %d bits, %d bins)", len, bits, m);
+
+    PG_RETURN_BYTEA_P(hyperloglog_from_bins(bits, data + 2 * sizeof(int32)));
+
+}
+
+/* Converts a loglog_estimator or superloglog_estimator value. The argument is
+ * declared as anyelement, and the type is checked by name when called, so
+ * that the function may be created without the other extensions (in any
+ * schema). The checked type is cached in fn_extra. */
+Datum
+hyperloglog_from_loglog_estimator(PG_FUNCTION_ARGS)
+{
+
+    Oid     typid = get_fn_expr_argtype(fcinfo->flinfo, 0);
+
+    if ((fcinfo->flinfo->fn_extra == NULL) ||
+        (*(Oid *) fcinfo->flinfo->fn_extra != typid)) {
+
+        HeapTuple   tuple;
+        const char *typname;
+        bool        valid;
+
+        tuple = SearchSysCache1(TYPEOID, ObjectIdGetDatum(typid));
+
+        if (! HeapTupleIsValid(tuple))
+            elog(ERROR, "cache lookup failed for type %u", typid);
+
+        typname = NameStr(((Form_pg_type) GETSTRUCT(tuple))->typname);
+        valid = (strcmp(typname, "loglog_estimator") == 0) ||
+                (strcmp(typname, "superloglog_estimator") == 0);
+
+        ReleaseSysCache(tuple);
+
+        if (! valid)
+            elog(ERROR, "%s is not a LogLog or SuperLogLog estimator", format_type_be(typid));
+
+        if (fcinfo->flinfo->fn_extra == NULL)
+            fcinfo->flinfo->fn_extra = MemoryContextAlloc(fcinfo->flinfo->fn_mcxt, sizeof(Oid));
+
+        *(Oid *) fcinfo->flinfo->fn_extra = typid;
+    }
+
+    return hyperloglog_from_loglog(fcinfo);
+
+}
+
 Datum
 hyperloglog_init(PG_FUNCTION_ARGS)
 {
@@ -323,6 +944,345 @@ hyperloglog_reset(PG_FUNCTION_ARGS)
 }
 
 
+/* Converts the timestamp into the 32-bit value stored in the sliding-window counter,
+ * i.e. seconds since the PostgreSQL epoch (rounded down, clamped to the int32 range). */
+static int32
+hyperloglog_window_time(TimestampTz timestamp)
+{
+    int64 seconds = timestamp / USECS_PER_SEC;
+
+    /* round towards minus infinity (timestamps before 2000) */
+    if ((timestamp < 0) && (timestamp % USECS_PER_SEC != 0))
+        seconds -= 1;
+
+    if (seconds > PG_INT32_MAX)
+        return PG_INT32_MAX;
+    else if (seconds < -PG_INT32_MAX)
+        return -PG_INT32_MAX;
+
+    return (int32)seconds;
+}
+
+/* Start of a window of the given length, ending at the current transaction
+ * timestamp (i.e. now() - window). */
+static int32
+hyperloglog_window_start(Interval * window)
+{
+    Datum since = DirectFunctionCall2(timestamptz_mi_interval,
+                                      TimestampTzGetDatum(GetCurrentTransactionStartTimestamp()),
+                                      PointerGetDatum(window));
+
+    return hyperloglog_window_time(DatumGetTimestampTz(since));
+}
+
+static void
+hyperloglog_window_check_params(float errorRate, int nslots)
+{
+    /* error rate between 0 and 1 (not 0) */
+    if ((errorRate <= 0) || (errorRate > 1))
+        elog(ERROR, "error rate has to be between 0 and 1");
+
+    if ((nslots < 1) || (nslots > MAX_WINDOW_SLOTS))
+        elog(ERROR, "number of slots has to be between 1 and %d", MAX_WINDOW_SLOTS);
+}
+
+Datum
+hyperloglog_window_add_item(PG_FUNCTION_ARGS)
+{
+
+    HyperLogLogWindowCounter counter;
+
+    /* requires the estimator to be already created */
+    if (PG_ARGISNULL(0))
+        elog(ERROR, "hyperloglog window counter must not be NULL");
+
+    /* if the element and timestamp are not NULL, add it to the estimator (i.e. skip NULLs) */
+    if (! PG_ARGISNULL(1) && ! PG_ARGISNULL(2)) {
+
+        Oid         element_type = get_fn_expr_argtype(fcinfo->flinfo, 1);
+        Datum       element = PG_GETARG_DATUM(1);
+        int32       timestamp = hyperloglog_window_time(PG_GETARG_TIMESTAMPTZ(2));
+        int16       typlen;
+        bool        typbyval;
+        char        typalign;
+
+        /* estimator (we know it's not a NULL value) */
+        counter = (HyperLogLogWindowCounter)PG_GETARG_BYTEA_P(0);
+        hyperloglog_window_check_counter(counter);
+
+        /* get type information for the second parameter (anyelement item) */
+        get_typlenbyvalalign(element_type, &typlen, &typbyval, &typalign);
+
+        /* it this a varlena type, passed by reference or by value ? */
+        if (typlen == -1) {
+            /* varlena */
+            unsigned char hash[HASH_LENGTH];
+
+            distinct_hash_varlena(element, hash);
+            hyperloglog_window_add_hash(counter, hash, timestamp);
+        } else if (typbyval) {
+            /* fixed-length, passed by value */
+            hyperloglog_window_add_element(counter, (char*)&element, typlen, timestamp);
+        } else {
+            /* fixed-length, passed by reference */
+            hyperloglog_window_add_element(counter, (char*)element, typlen, timestamp);
+        }
+
+    }
+
+    PG_RETURN_VOID();
+
+}
+
+Datum
+hyperloglog_window_add_item_agg(PG_FUNCTION_ARGS)
+{
+
+    HyperLogLogWindowCounter counter;
+    float errorRate; /* required error rate */
+    int   nslots;    /* slots per bin */
+
+    /* info for anyelement */
+    Oid         element_type = get_fn_expr_argtype(fcinfo->flinfo, 1);
+    Datum       element = PG_GETARG_DATUM(1);
+    int16       typlen;
+    bool        typbyval;
+    char        typalign;
+
+    /* create a new estimator (with requested error rate / slots) or reuse the existing one */
+    if (PG_ARGISNULL(0)) {
+
+        errorRate = PG_GETARG_FLOAT4(3);
+        nslots = PG_GETARG_INT32(4);
+
+        hyperloglog_window_check_params(errorRate, nslots);
+
+        counter = hyperloglog_window_create(errorRate, nslots);
+
+    } else { /* existing estimator */
+        counter = (HyperLogLogWindowCounter)PG_GETARG_BYTEA_P(0);
+        hyperloglog_window_check_counter(counter);
+    }
+
+    /* add the item to the estimator (skip NULLs) */
+    if (! PG_ARGISNULL(1) && ! PG_ARGISNULL(2)) {
+
+        int32 timestamp = hyperloglog_window_time(PG_GETARG_TIMESTAMPTZ(2));
+
+        /* get type information for the second parameter (anyelement item) */
+        get_typlenbyvalalign(element_type, &typlen, &typbyval, &typalign);
+
+        /* it this a varlena type, passed by reference or by value ? */
+        if (typlen == -1) {
+            /* varlena */
+            unsigned char hash[HASH_LENGTH];
+
+            distinct_hash_varlena(element, hash);
+            hyperloglog_window_add_hash(counter, hash, timestamp);
+        } else if (typbyval) {
+            /* fixed-length, passed by value */
+            hyperloglog_window_add_element(counter, (char*)&element, typlen, timestamp);
+        } else {
+            /* fixed-length, passed by reference */
+            hyperloglog_window_add_element(counter, (char*)element, typlen, timestamp);
+        }
+    }
+
+    /* return the updated bytea */
+    PG_RETURN_BYTEA_P(counter);
+
+}
+
+Datum
+hyperloglog_window_add_item_agg2(PG_FUNCTION_ARGS)
+{
+
+    HyperLogLogWindowCounter counter;
+
+    /* info for anyelement */
+    Oid         element_type = get_fn_expr_argtype(fcinfo->flinfo, 1);
+    Datum       element = PG_GETARG_DATUM(1);
+    int16       typlen;
+    bool        typbyval;
+    char        typalign;
+
+    /* is the counter created (if not, create it with default parameters) */
+    if (PG_ARGISNULL(0)) {
+        counter = hyperloglog_window_create(DEFAULT_ERROR, DEFAULT_WINDOW_SLOTS);
+    } else {
+        counter = (HyperLogLogWindowCounter)PG_GETARG_BYTEA_P(0);
+        hyperloglog_window_check_counter(counter);
+    }
+
+    /* add the item to the estimator (skip NULLs) */
+    if (! PG_ARGISNULL(1) && ! PG_ARGISNULL(2)) {
+
+        int32 timestamp = hyperloglog_window_time(PG_GETARG_TIMESTAMPTZ(2));
+
+        /* get type information for the second parameter (anyelement item) */
+        get_typlenbyvalalign(element_type, &typlen, &typbyval, &typalign);
+
+        /* it this a varlena type, passed by reference or by value ? */
+        if (typlen == -1) {
+            /* varlena */
+            unsigned char hash[HASH_LENGTH];
+
+            distinct_hash_varlena(element, hash);
+            hyperloglog_window_add_hash(counter, hash, timestamp);
+        } else if (typbyval) {
+            /* fixed-length, passed by value */
+            hyperloglog_window_add_element(counter, (char*)&element, typlen, timestamp);
+        } else {
+            /* fixed-length, passed by reference */
+            hyperloglog_window_add_element(counter, (char*)element, typlen, timestamp);
+        }
+
+    }
+
+    /* return the updated bytea */
+    PG_RETURN_BYTEA_P(counter);
+
+}
+
+Datum
+hyperloglog_window_merge_simple(PG_FUNCTION_ARGS)
+{
+
+    HyperLogLogWindowCounter counter1;
+    HyperLogLogWindowCounter counter2;
+
+    if (PG_ARGISNULL(0) && PG_ARGISNULL(1)) {
+        PG_RETURN_NULL();
+    } else if (PG_ARGISNULL(0)) {
+        counter2 = (HyperLogLogWindowCounter)PG_GETARG_BYTEA_P(1);
+        hyperloglog_window_check_counter(counter2);
+        PG_RETURN_BYTEA_P(hyperloglog_window_copy(counter2));
+    } else if (PG_ARGISNULL(1)) {
+        counter1 = (HyperLogLogWindowCounter)PG_GETARG_BYTEA_P(0);
+        hyperloglog_window_check_counter(counter1);
+        PG_RETURN_BYTEA_P(hyperloglog_window_copy(counter1));
+    }
+
+    counter1 = (HyperLogLogWindowCounter)PG_GETARG_BYTEA_P(0);
+    counter2 = (HyperLogLogWindowCounter)PG_GETARG_BYTEA_P(1);
+
+    hyperloglog_window_check_counter(counter1);
+    hyperloglog_window_check_counter(counter2);
+
+    PG_RETURN_BYTEA_P(hyperloglog_window_merge(counter1, counter2, false));
+
+}
+
+Datum
+hyperloglog_window_merge_agg(PG_FUNCTION_ARGS)
+{
+
+    HyperLogLogWindowCounter counter1;
+    HyperLogLogWindowCounter counter2;
+
+    /* skip NULL estimators */
+    if (PG_ARGISNULL(1)) {
+        if (PG_ARGISNULL(0))
+            PG_RETURN_NULL();
+        PG_RETURN_BYTEA_P(PG_GETARG_BYTEA_P(0));
+    }
+
+    counter2 = (HyperLogLogWindowCounter)PG_GETARG_BYTEA_P(1);
+    hyperloglog_window_check_counter(counter2);
+
+    if (PG_ARGISNULL(0)) {
+
+        /* just copy the second estimator into the first one */
+        counter1 = hyperloglog_window_copy(counter2);
+
+    } else {
+
+        /* ok, we already have the estimator - merge the second one into it (in place) */
+        counter1 = (HyperLogLogWindowCounter)PG_GETARG_BYTEA_P(0);
+        hyperloglog_window_check_counter(counter1);
+        counter1 = hyperloglog_window_merge(counter1, counter2, true);
+
+    }
+
+    /* return the updated bytea */
+    PG_RETURN_BYTEA_P(counter1);
+
+}
+
+/* estimate for a window of the given length, ending now */
+Datum
+hyperloglog_window_get_estimate(PG_FUNCTION_ARGS)
+{
+
+    HyperLogLogWindowCounter counter = (HyperLogLogWindowCounter)PG_GETARG_BYTEA_P(0);
+    Interval * window = PG_GETARG_INTERVAL_P(1);
+
+    hyperloglog_window_check_counter(counter);
+
+    PG_RETURN_FLOAT4(hyperloglog_window_estimate(counter, hyperloglog_window_start(window)));
+
+}
+
+/* estimate for a window starting at the given timestamp (and ending now) */
+Datum
+hyperloglog_window_get_estimate_since(PG_FUNCTION_ARGS)
+{
+
+    HyperLogLogWindowCounter counter = (HyperLogLogWindowCounter)PG_GETARG_BYTEA_P(0);
+    int32 since = hyperloglog_window_time(PG_GETARG_TIMESTAMPTZ(1));
+
+    hyperloglog_window_check_counter(counter);
+
+    PG_RETURN_FLOAT4(hyperloglog_window_estimate(counter, since));
+
+}
+
+/* regular hyperloglog_estimator for a window of the given length, ending now */
+Datum
+hyperloglog_window_snapshot_window(PG_FUNCTION_ARGS)
+{
+
+    HyperLogLogWindowCounter counter = (HyperLogLogWindowCounter)PG_GETARG_BYTEA_P(0);
+    Interval * window = PG_GETARG_INTERVAL_P(1);
+
+    hyperloglog_window_check_counter(counter);
+
+    PG_RETURN_BYTEA_P(hyperloglog_window_snapshot(counter, hyperloglog_window_start(window)));
+
+}
+
+Datum
+hyperloglog_window_init(PG_FUNCTION_ARGS)
+{
+      float errorRate = PG_GETARG_FLOAT4(0);
+      int   nslots = PG_GETARG_INT32(1);
+
+      hyperloglog_window_check_params(errorRate, nslots);
+
+      PG_RETURN_BYTEA_P(hyperloglog_window_create(errorRate, nslots));
+}
+
+Datum
+hyperloglog_window_size(PG_FUNCTION_ARGS)
+{
+      float errorRate = PG_GETARG_FLOAT4(0);
+      int   nslots = PG_GETARG_INT32(1);
+
+      hyperloglog_window_check_params(errorRate, nslots);
+
+      PG_RETURN_INT32(hyperloglog_window_get_size(errorRate, nslots));
+}
+
+Datum
+hyperloglog_window_reset(PG_FUNCTION_ARGS)
+{
+	HyperLogLogWindowCounter counter = (HyperLogLogWindowCounter)PG_GETARG_BYTEA_P(0);
+
+	hyperloglog_window_check_counter(counter);
+	hyperloglog_window_reset_internal(counter);
+	PG_RETURN_VOID();
+}
+
 /*
  *		byteain			- converts from printable representation of byte array
  *
@@ -0,0 +1,16 @@
+/* Declarations shared by the SQL-facing parts of the extension (i.e. not the
+ * estimator itself, see hyperloglog.h for that). */
+
+#include "postgres.h"
+
+/* shared-memory counters (hyperloglog_shmem.c), called from _PG_init */
+void hyperloglog_shmem_init(void);
+
+/* COUNT(DISTINCT) rewrite (hyperloglog_rewrite.c), called from _PG_init */
+void hyperloglog_rewrite_init(void);
+
+/* instrumentation (hyperloglog_stats.c), called from _PG_init */
+void hyperloglog_stats_init(void);
+
+/* permission check for server-side files (hyperloglog_file.c) */
+void hyperloglog_check_file_access(bool write);
@@ -0,0 +1,373 @@
+/* Building HyperLogLog counters directly from server-side files.
+ *
+ * Counting distinct values in a large export (e.g. a log file) would normally
+ * require loading it into a table using COPY first, and then running the
+ * aggregate on it - writing the data into the heap (and WAL), and deforming
+ * all the tuples again. hyperloglog_from_file reads the file using large
+ * buffered reads, extracts the requested column and adds the values into the
+ * counter, so the data is read just once and never written anywhere.
+ *
+ * Supported formats are
+ *
+ *   csv  - comma-separated values, with optional quoting (as in COPY csv)
+ *   text - tab-separated values, with backslash escapes (as in COPY text)
+ *   line - each line is a single value
+ *
+ * The values are added as text, so the result matches the counter built
+ * by hyperloglog_accum(column::text). NULL values (empty unquoted field in
+ * csv, \N in text) are skipped.
+ *
+ * Accessing files on the server is restricted to superusers and members of
+ * pg_read_server_files (or pg_write_server_files), just like COPY.
+ */
+#include <stdio.h>
+#include <string.h>
+
+#include "postgres.h"
+#include "fmgr.h"
+#include "miscadmin.h"
+#include "lib/stringinfo.h"
+#include "distinct_md5.h"
+#include "storage/fd.h"
+#include "utils/acl.h"
+#include "utils/builtins.h"
+#if PG_VERSION_NUM >= 110000
+#include "catalog/pg_authid.h"
+#endif
+
+/* the default roles were renamed in PostgreSQL 14 */
+#if PG_VERSION_NUM >= 140000
+#define READ_SERVER_FILES_ROLE  ROLE_PG_READ_SERVER_FILES
+#define WRITE_SERVER_FILES_ROLE ROLE_PG_WRITE_SERVER_FILES
+#elif PG_VERSION_NUM >= 110000
+#define READ_SERVER_FILES_ROLE  DEFAULT_ROLE_READ_SERVER_FILES
+#define WRITE_SERVER_FILES_ROLE DEFAULT_ROLE_WRITE_SERVER_FILES
+#endif
+
+#include "hyperloglog.h"
+#include "hyperloglog_counter.h"
+
+/* size of the buffer used to read the file */
+#define FILE_BUFFER_SIZE    (1024 * 1024)
+
+/* the values are hashed first, and added to the counter in batches of hashes */
+#define FILE_HASH_BATCH     1024
+
+/* we're using md5, which produces 16B (128-bit) values */
+#define HASH_LENGTH 16
+
+#define DEFAULT_NDISTINCT   1000000000
+
+typedef enum HyperLogLogFileFormat {
+    FORMAT_CSV,
+    FORMAT_TEXT,
+    FORMAT_LINE
+} HyperLogLogFileFormat;
+
+/* state of the parser (needs to survive across buffers, as lines may span them) */
+typedef struct HyperLogLogFileParser {
+
+    HyperLogLogCounter      counter;
+    HyperLogLogFileFormat   format;
+    int                     column;     /* 0-based */
+    bool                    skip;       /* skip the current line (header) */
+
+    int                     field;      /* current field (0-based) */
+    bool                    in_quotes;  /* inside a quoted csv field */
+    bool                    has_value;  /* the current field is not NULL */
+    bool                    value_null; /* the requested column is NULL */
+    bool                    after_quote;/* closing quote (or first half of "") */
+    bool                    escape;     /* after backslash (text format) */
+    bool                    empty;      /* nothing on the line so far */
+
+    StringInfoData          value;      /* value of the requested column */
+
+    unsigned char          *hashes;     /* hashes not added to the counter yet */
+    int                     nhashes;
+
+} HyperLogLogFileParser;
+
+PG_FUNCTION_INFO_V1(hyperloglog_from_file);
+
+Datum hyperloglog_from_file(PG_FUNCTION_ARGS);
+
+static void hyperloglog_file_parse(HyperLogLogFileParser * parser, const char * data, int len);
+static void hyperloglog_file_end_line(HyperLogLogFileParser * parser);
+static void hyperloglog_file_next_field(HyperLogLogFileParser * parser);
+static void hyperloglog_file_reset_line(HyperLogLogFileParser * parser);
+static void hyperloglog_file_flush(HyperLogLogFileParser * parser);
+
+Datum
+hyperloglog_from_file(PG_FUNCTION_ARGS)
+{
+
+    char   *path = text_to_cstring(PG_GETARG_TEXT_PP(0));
+    int     column = PG_GETARG_INT32(1);
+    char   *format = text_to_cstring(PG_GETARG_TEXT_PP(2));
+    float   errorRate = PG_GETARG_FLOAT4(3);
+    bool    header = PG_GETARG_BOOL(4);
+
+    HyperLogLogFileParser parser;
+    FILE   *file;
+    char   *buffer;
+    size_t  len;
+
+    hyperloglog_check_file_access(false);
+
+    /* error rate between 0 and 1 (not 0) */
+    if ((errorRate <= 0) || (errorRate > 1))
+        elog(ERROR, "error rate has to be between 0 and 1");
+
+    if (column < 1)
+        elog(ERROR, "column number has to be at least 1");
+
+    memset(&parser, 0, sizeof(HyperLogLogFileParser));
+
+    if (strcmp(format, "csv") == 0)
+        parser.format = FORMAT_CSV;
+    else if (strcmp(format, "text") == 0)
+        parser.format = FORMAT_TEXT;
+    else if (strcmp(format, "line") == 0)
+        parser.format = FORMAT_LINE;
+    else
+        elog(ERROR, "unknown file format \"%s\" (use csv, text or line)", format);
+
+    if ((parser.format == FORMAT_LINE) && (column != 1))
+        elog(ERROR, "line format has only a single column");
+
+    parser.counter = hyperloglog_create(DEFAULT_NDISTINCT, errorRate);
+    parser.column = column - 1;
+    parser.skip = header;
+    parser.hashes = palloc(FILE_HASH_BATCH * HASH_LENGTH);
+    initStringInfo(&parser.value);
+    hyperloglog_file_reset_line(&parser);
+
+    file = AllocateFile(path, PG_BINARY_R);
+    if (file == NULL)
+        ereport(ERROR,
+                (errcode_for_file_access(),
+                 errmsg("could not open file \"%s\" for reading: %m", path)));
+
+    buffer = palloc(FILE_BUFFER_SIZE);
+
+    while ((len = fread(buffer, 1, FILE_BUFFER_SIZE, file)) > 0) {
+        CHECK_FOR_INTERRUPTS();
+        hyperloglog_file_parse(&parser, buffer, len);
+    }
+
+    if (ferror(file))
+        ereport(ERROR,
+                (errcode_for_file_access(),
+                 errmsg("could not read file \"%s\": %m", path)));
+
+    FreeFile(file);
+
+    /* checked before the last line is added (which resets the flag) */
+    if (parser.in_quotes)
+        elog(ERROR, "unterminated CSV quoted field");
+
+    /* the last line may not be terminated by a newline */
+    if (! parser.empty)
+        hyperloglog_file_end_line(&parser);
+
+    hyperloglog_file_flush(&parser);
+
+    pfree(buffer);
+    pfree(parser.hashes);
+    pfree(parser.value.data);
+
+    /* the counter is complete, so keep the estimate in it */
+    hyperloglog_cache_estimate(parser.counter);
+
+    PG_RETURN_BYTEA_P(parser.counter);
+
+}
+
+/* Processes a chunk of the file, adding values for all lines completed in it. */
+static void
+hyperloglog_file_parse(HyperLogLogFileParser * parser, const char * data, int len)
+{
+
+    int     i;
+
+    for (i = 0; i < len; i++) {
+
+        char    c = data[i];
+        bool    keep = (parser->field == parser->column) && (! parser->skip);
+
+        /* newline (outside quotes) terminates the line in all formats */
+        if ((c == '\n') && (! parser->in_quotes)) {
+            hyperloglog_file_end_line(parser);
+            continue;
+        }
+
+        parser->empty = false;
+
+        if (parser->format == FORMAT_LINE) {
+
+            if (keep && (c != '\r'))
+                appendStringInfoChar(&parser->value, c);
+
+        } else if (parser->format == FORMAT_TEXT) {
+
+            if (parser->escape) {
+
+                parser->escape = false;
+
+                if (c == 'N') {
+                    /* \N means NULL (we don't really check it's the whole field) */
+                    parser->has_value = false;
+                    continue;
+                }
+
+                if (c == 'n')
+                    c = '\n';
+                else if (c == 't')
+                    c = '\t';
+                else if (c == 'r')
+                    c = '\r';
+
+                if (keep)
+                    appendStringInfoChar(&parser->value, c);
+
+            } else if (c == '\\') {
+                parser->escape = true;
+            } else if (c == '\t') {
+                hyperloglog_file_next_field(parser);
+            } else if (c != '\r') {
+                if (keep)
+                    appendStringInfoChar(&parser->value, c);
+            }
+
+        } else if (parser->in_quotes) {
+
+            /* csv, inside a quoted field */
+            if (c == '"') {
+                parser->in_quotes = false;
+                parser->after_quote = true;
+            } else if (keep)
+                appendStringInfoChar(&parser->value, c);
+
+        } else {
+
+            /* csv, outside quotes */
+            if (c == '"') {
+
+                /* "" inside a quoted field is an escaped quote */
+                if (parser->after_quote && keep)
+                    appendStringInfoChar(&parser->value, '"');
+
+                parser->in_quotes = true;
+                parser->has_value = true;
+                parser->after_quote = false;
+
+            } else if (c == ',') {
+                hyperloglog_file_next_field(parser);
+            } else if (c != '\r') {
+                parser->has_value = true;
+                parser->after_quote = false;
+                if (keep)
+                    appendStringInfoChar(&parser->value, c);
+            }
+
+        }
+
+    }
+
+}
+
+/* Adds the value of the requested column (unless NULL or missing) and resets the
+ * state for the next line. */
+static void
+hyperloglog_file_end_line(HyperLogLogFileParser * parser)
+{
+
+    bool    isnull;
+
+    /* still in the requested column, or the line has fewer columns */
+    if (parser->field == parser->column)
+        isnull = (! parser->has_value);
+    else if (parser->field < parser->column)
+        isnull = true;
+    else
+        isnull = parser->value_null;
+
+    /* empty lines are skipped (even in the line format) */
+    if (parser->empty)
+        isnull = true;
+
+    if (parser->skip)
+        parser->skip = false;
+    else if (! isnull) {
+
+        distinct_md5(parser->value.data, parser->value.len,
+                      parser->hashes + parser->nhashes * HASH_LENGTH);
+
+        if (++parser->nhashes == FILE_HASH_BATCH)
+            hyperloglog_file_flush(parser);
+    }
+
+    hyperloglog_file_reset_line(parser);
+
+}
+
+/* Adds the hashes collected so far to the counter (prefetching the bins). */
+static void
+hyperloglog_file_flush(HyperLogLogFileParser * parser)
+{
+
+    hyperloglog_add_hashes(parser->counter, parser->hashes, parser->nhashes);
+
+    if (hyperloglog_stats != NULL)
+        hyperloglog_stats->elements += parser->nhashes;
+
+    parser->nhashes = 0;
+
+}
+
+static void
+hyperloglog_file_reset_line(HyperLogLogFileParser * parser)
+{
+    parser->field = 0;
+    parser->in_quotes = false;
+    parser->has_value = (parser->format != FORMAT_CSV);
+    parser->value_null = true;
+    parser->after_quote = false;
+    parser->escape = false;
+    parser->empty = true;
+    resetStringInfo(&parser->value);
+}
+
+/* Moves to the next field, remembering whether the requested column is NULL. */
+static void
+hyperloglog_file_next_field(HyperLogLogFileParser * parser)
+{
+    if (parser->field == parser->column)
+        parser->value_null = (! parser->has_value);
+
+    parser->field++;
+    parser->has_value = (parser->format != FORMAT_CSV);
+    parser->after_quote = false;
+}
+
+/* Checks the user may read (or write) files on the server, like COPY does. */
+void
+hyperloglog_check_file_access(bool write)
+{
+#if PG_VERSION_NUM >= 110000
+    if (write && ! superuser() && ! has_privs_of_role(GetUserId(), WRITE_SERVER_FILES_ROLE))
+        ereport(ERROR,
+                (errcode(ERRCODE_INSUFFICIENT_PRIVILEGE),
+                 errmsg("must be superuser or a member of the pg_write_server_files role to write files")));
+
+    if (! write && ! superuser() && ! has_privs_of_role(GetUserId(), READ_SERVER_FILES_ROLE))
+        ereport(ERROR,
+                (errcode(ERRCODE_INSUFFICIENT_PRIVILEGE),
+                 errmsg("must be superuser or a member of the pg_read_server_files role to read files")));
+#else
+    if (! superuser())
+        ereport(ERROR,
+                (errcode(ERRCODE_INSUFFICIENT_PRIVILEGE),
+                 errmsg("must be superuser to access files")));
+#endif
+}
@@ -0,0 +1,28 @@
+/* Static tracepoints in the hyperloglog estimator (see distinct_probes.h)
+ *
+ *   merge__start     (b, m)
+ *   merge__done      (b, m)
+ *   estimate__start  (b, m)
+ *   estimate__done   (b, m, estimate)
+ *   batch__start     (b, m, nhashes)
+ *   batch__done      (b, m, nhashes, updates)
+ *
+ * Arguments are the geometry of the counter (number of index bits and bins),
+ * the estimate for estimate__done, and the number of hashes (and of updated
+ * bins) for the batches added by hyperloglog_add_hashes - that includes the
+ * batches from hyperloglog_from_file and from libdistinct.
+ */
+#ifndef HYPERLOGLOG_PROBES_H
+#define HYPERLOGLOG_PROBES_H
+
+#include "distinct_probes.h"
+
+#define HYPERLOGLOG_MERGE_START(b, m)             DISTINCT_PROBE2(hyperloglog, merge__start, b, m)
+#define HYPERLOGLOG_MERGE_DONE(b, m)              DISTINCT_PROBE2(hyperloglog, merge__done, b, m)
+#define HYPERLOGLOG_ESTIMATE_START(b, m)          DISTINCT_PROBE2(hyperloglog, estimate__start, b, m)
+#define HYPERLOGLOG_ESTIMATE_DONE(b, m, estimate) DISTINCT_PROBE3(hyperloglog, estimate__done, b, m, estimate)
+#define HYPERLOGLOG_BATCH_START(b, m, nhashes)    DISTINCT_PROBE3(hyperloglog, batch__start, b, m, nhashes)
+#define HYPERLOGLOG_BATCH_DONE(b, m, nhashes, updates) \
+    DISTINCT_PROBE4(hyperloglog, batch__done, b, m, nhashes, updates)
+
+#endif   /* HYPERLOGLOG_PROBES_H */
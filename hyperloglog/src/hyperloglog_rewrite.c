@@ -0,0 +1,326 @@
+/* Transparent rewrite of COUNT(DISTINCT x) into a HyperLogLog aggregate.
+ *
+ * Exact COUNT(DISTINCT x) has to sort (or hash) all the input values, and it
+ * can't be executed in parallel. When enabled, this post-parse-analysis hook
+ * replaces the aggregate with hyperloglog_count_distinct(x, error_rate), which
+ * needs only a small fixed amount of memory and supports parallel aggregation.
+ * The result is an estimate, of course, so this is opt-in:
+ *
+ *   hyperloglog.rewrite_count_distinct - enable the rewrite (default off)
+ *   hyperloglog.rewrite_error_rate     - error rate of the counters (default 0.025)
+ *
+ * The estimator compares the binary representation of the values, so the rewrite
+ * is only done for data types where that matches the equality operator (e.g. not
+ * for numeric, where 1.0 = 1.00), and for deterministic collations. The aggregate
+ * is looked up in the schema of the extension (not using search_path, so that a
+ * function with the same name can't hijack the rewrite), and the OID is cached
+ * until pg_proc changes. If the extension is not installed, the queries are left
+ * alone.
+ *
+ * The rewrite happens after parse analysis, i.e. before the query is stored in
+ * views, rules or SQL functions. So objects created while the rewrite is enabled
+ * keep using the estimate, even after the rewrite gets disabled (and vice versa).
+ * Queries in EXPLAIN, CREATE TABLE AS and DECLARE CURSOR are rewritten too, so
+ * EXPLAIN shows the plan the query itself would use.
+ *
+ * The library has to be loaded before the query is parsed, so it should be added
+ * to session_preload_libraries (or shared_preload_libraries).
+ */
+#include "postgres.h"
+#include "fmgr.h"
+#include "access/genam.h"
+#include "access/htup_details.h"
+#include "catalog/indexing.h"
+#include "catalog/namespace.h"
+#include "catalog/pg_aggregate.h"
+#include "catalog/pg_collation.h"
+#include "catalog/pg_extension.h"
+#include "catalog/pg_type.h"
+#include "commands/extension.h"
+#include "nodes/makefuncs.h"
+#include "nodes/nodeFuncs.h"
+#include "parser/analyze.h"
+#include "parser/parse_func.h"
+#include "utils/fmgroids.h"
+#include "utils/guc.h"
+#include "utils/inval.h"
+#include "utils/lsyscache.h"
+#include "utils/rel.h"
+#include "utils/syscache.h"
+
+#if PG_VERSION_NUM >= 120000
+#include "access/table.h"
+#else
+#include "access/heapam.h"
+#define table_open(r, l)    heap_open(r, l)
+#define table_close(r, l)   heap_close(r, l)
+#endif
+
+#include "hyperloglog_counter.h"
+
+#define REWRITE_EXTENSION   "hyperloglog_counter"
+#define REWRITE_AGGREGATE   "hyperloglog_count_distinct"
+
+/* count(any) - fmgroids.h only has a symbol for it since PG14 (the OID is fixed) */
+#if PG_VERSION_NUM < 140000
+#define F_COUNT_ANY         2147
+#endif
+
+/* GUC variables */
+static bool     hyperloglog_rewrite_enabled = false;
+static double   hyperloglog_rewrite_error_rate = 0.025;
+
+static post_parse_analyze_hook_type prev_post_parse_analyze_hook = NULL;
+
+/* OID of the aggregate in the extension schema (valid only if aggfnoid_valid) */
+static Oid      hyperloglog_rewrite_aggfnoid = InvalidOid;
+static bool     hyperloglog_rewrite_aggfnoid_valid = false;
+
+#if PG_VERSION_NUM >= 140000
+static void hyperloglog_post_parse_analyze(ParseState *pstate, Query *query, JumbleState *jstate);
+#else
+static void hyperloglog_post_parse_analyze(ParseState *pstate, Query *query);
+#endif
+
+static Query *hyperloglog_rewrite_utility_query(Node *stmt);
+static bool hyperloglog_rewrite_walker(Node *node, Oid *aggfnoid);
+static bool hyperloglog_rewrite_allowed(Aggref *aggref);
+static Oid hyperloglog_rewrite_lookup(void);
+static void hyperloglog_rewrite_invalidate(Datum arg, int cacheid, uint32 hashvalue);
+
+void
+hyperloglog_rewrite_init(void)
+{
+    DefineCustomBoolVariable("hyperloglog.rewrite_count_distinct",
+                             "Rewrite COUNT(DISTINCT x) to use a HyperLogLog estimator.",
+                             NULL,
+                             &hyperloglog_rewrite_enabled,
+                             false,
+                             PGC_USERSET, 0,
+                             NULL, NULL, NULL);
+
+    DefineCustomRealVariable("hyperloglog.rewrite_error_rate",
+                             "Error rate of estimators used for rewritten COUNT(DISTINCT x).",
+                             NULL,
+                             &hyperloglog_rewrite_error_rate,
+                             0.025, 0.004, 0.5,
+                             PGC_USERSET, 0,
+                             NULL, NULL, NULL);
+
+    prev_post_parse_analyze_hook = post_parse_analyze_hook;
+    post_parse_analyze_hook = hyperloglog_post_parse_analyze;
+
+    /* forget the aggregate OID whenever pg_proc changes (e.g. DROP EXTENSION) */
+    CacheRegisterSyscacheCallback(PROCOID, hyperloglog_rewrite_invalidate, (Datum) 0);
+}
+
+#if PG_VERSION_NUM >= 140000
+static void
+hyperloglog_post_parse_analyze(ParseState *pstate, Query *query, JumbleState *jstate)
+#else
+static void
+hyperloglog_post_parse_analyze(ParseState *pstate, Query *query)
+#endif
+{
+    Oid     aggfnoid;
+
+    if (prev_post_parse_analyze_hook)
+#if PG_VERSION_NUM >= 140000
+        prev_post_parse_analyze_hook(pstate, query, jstate);
+#else
+        prev_post_parse_analyze_hook(pstate, query);
+#endif
+
+    if (! hyperloglog_rewrite_enabled)
+        return;
+
+    /* EXPLAIN, CREATE TABLE AS and DECLARE CURSOR contain an analyzed query,
+     * so that EXPLAIN shows the plan the query would actually use */
+    while ((query != NULL) && (query->commandType == CMD_UTILITY))
+        query = hyperloglog_rewrite_utility_query(query->utilityStmt);
+
+    /* other utility statements */
+    if (query == NULL)
+        return;
+
+    /* extension not installed, so leave it alone */
+    aggfnoid = hyperloglog_rewrite_lookup();
+    if (! OidIsValid(aggfnoid))
+        return;
+
+    hyperloglog_rewrite_walker((Node *) query, &aggfnoid);
+}
+
+/* The query of a utility statement (already analyzed), or NULL if there's none. */
+static Query *
+hyperloglog_rewrite_utility_query(Node *stmt)
+{
+    Node   *query = NULL;
+
+    if (stmt == NULL)
+        return NULL;
+
+    if (IsA(stmt, ExplainStmt))
+        query = ((ExplainStmt *) stmt)->query;
+    else if (IsA(stmt, CreateTableAsStmt))
+        query = ((CreateTableAsStmt *) stmt)->query;
+    else if (IsA(stmt, DeclareCursorStmt))
+        query = ((DeclareCursorStmt *) stmt)->query;
+
+    /* e.g. CREATE TABLE AS EXECUTE has a (not analyzed) ExecuteStmt */
+    if ((query == NULL) || ! IsA(query, Query))
+        return NULL;
+
+    return (Query *) query;
+}
+
+/* Looks up the aggregate in the schema of the extension (cached). */
+static Oid
+hyperloglog_rewrite_lookup(void)
+{
+    Oid         extoid;
+    Oid         nspoid = InvalidOid;
+    Oid         argtypes[2] = {ANYELEMENTOID, FLOAT4OID};
+    Relation    rel;
+    ScanKeyData key;
+    SysScanDesc scan;
+    HeapTuple   tuple;
+
+    if (hyperloglog_rewrite_aggfnoid_valid)
+        return hyperloglog_rewrite_aggfnoid;
+
+    hyperloglog_rewrite_aggfnoid = InvalidOid;
+
+    extoid = get_extension_oid(REWRITE_EXTENSION, true);
+
+    if (OidIsValid(extoid)) {
+
+        /* schema of the extension (there's no syscache on pg_extension) */
+        rel = table_open(ExtensionRelationId, AccessShareLock);
+
+#if PG_VERSION_NUM >= 120000
+        ScanKeyInit(&key, Anum_pg_extension_oid,
+                    BTEqualStrategyNumber, F_OIDEQ, ObjectIdGetDatum(extoid));
+#else
+        ScanKeyInit(&key, ObjectIdAttributeNumber,
+                    BTEqualStrategyNumber, F_OIDEQ, ObjectIdGetDatum(extoid));
+#endif
+
+        scan = systable_beginscan(rel, ExtensionOidIndexId, true, NULL, 1, &key);
+
+        tuple = systable_getnext(scan);
+        if (HeapTupleIsValid(tuple))
+            nspoid = ((Form_pg_extension) GETSTRUCT(tuple))->extnamespace;
+
+        systable_endscan(scan);
+        table_close(rel, AccessShareLock);
+    }
+
+    if (OidIsValid(nspoid))
+        hyperloglog_rewrite_aggfnoid =
+            LookupFuncName(list_make2(makeString(get_namespace_name(nspoid)),
+                                      makeString(REWRITE_AGGREGATE)),
+                           2, argtypes, true);
+
+    hyperloglog_rewrite_aggfnoid_valid = true;
+
+    return hyperloglog_rewrite_aggfnoid;
+}
+
+/* syscache callback - the aggregate has to be looked up again */
+static void
+hyperloglog_rewrite_invalidate(Datum arg, int cacheid, uint32 hashvalue)
+{
+    hyperloglog_rewrite_aggfnoid_valid = false;
+}
+
+/* Walks the whole query tree (including sublinks, subqueries and CTEs) and
+ * rewrites the COUNT(DISTINCT x) aggregates in place. */
+static bool
+hyperloglog_rewrite_walker(Node *node, Oid *aggfnoid)
+{
+    if (node == NULL)
+        return false;
+
+    if (IsA(node, Query))
+        return query_tree_walker((Query *) node, hyperloglog_rewrite_walker,
+                                 (void *) aggfnoid, 0);
+
+    if (IsA(node, Aggref)) {
+
+        Aggref     *aggref = (Aggref *) node;
+
+        if (hyperloglog_rewrite_allowed(aggref)) {
+
+            TargetEntry *arg = (TargetEntry *) linitial(aggref->args);
+            Const       *error;
+
+            error = makeConst(FLOAT4OID, -1, InvalidOid, sizeof(float4),
+                              Float4GetDatum((float4) hyperloglog_rewrite_error_rate),
+                              false, true);
+
+            /* the argument is no longer referenced by the DISTINCT clause */
+            arg->ressortgroupref = 0;
+
+            aggref->aggfnoid = *aggfnoid;
+            aggref->aggdistinct = NIL;
+            aggref->args = lappend(aggref->args,
+                                   makeTargetEntry((Expr *) error, 2, NULL, false));
+#if PG_VERSION_NUM >= 110000
+            aggref->aggargtypes = lappend_oid(aggref->aggargtypes, FLOAT4OID);
+#endif
+
+            /* the aggregate returns bigint, just like count, so aggtype is fine */
+        }
+
+        /* the arguments / filter might contain other aggregates (in subqueries) */
+    }
+
+    return expression_tree_walker(node, hyperloglog_rewrite_walker, (void *) aggfnoid);
+}
+
+/* Is this a COUNT(DISTINCT x) we know how to rewrite? */
+static bool
+hyperloglog_rewrite_allowed(Aggref *aggref)
+{
+    TargetEntry *arg;
+    Oid          argtype;
+    Oid          collation;
+
+    /* count(any), with DISTINCT and a single argument, but no ORDER BY */
+    if ((aggref->aggfnoid != F_COUNT_ANY) || (aggref->aggdistinct == NIL) ||
+        (aggref->aggorder != NIL) || (aggref->aggkind != AGGKIND_NORMAL) ||
+        (list_length(aggref->args) != 1))
+        return false;
+
+    arg = (TargetEntry *) linitial(aggref->args);
+    argtype = exprType((Node *) arg->expr);
+    collation = exprCollation((Node *) arg->expr);
+
+    /* only collations where equal strings are equal byte-wise */
+    if (OidIsValid(collation) &&
+        (collation != DEFAULT_COLLATION_OID) && (collation != C_COLLATION_OID) &&
+        (collation != POSIX_COLLATION_OID))
+        return false;
+
+    /* only types where equality means binary equality */
+    switch (argtype) {
+        case BOOLOID:
+        case CHAROID:
+        case INT2OID:
+        case INT4OID:
+        case INT8OID:
+        case OIDOID:
+        case DATEOID:
+        case TIMEOID:
+        case TIMESTAMPOID:
+        case TIMESTAMPTZOID:
+        case UUIDOID:
+        case BYTEAOID:
+        case TEXTOID:
+        case VARCHAROID:
+            return true;
+        default:
+            return false;
+    }
+}
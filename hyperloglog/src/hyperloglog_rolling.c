@@ -0,0 +1,173 @@
+/* Rolling (sliding window) unions over an ordered array of counters.
+ *
+ * A typical use is computing the number of distinct users over the trailing
+ * 7 or 30 days for each day, from a table with one counter per day. Merging
+ * the whole window for each output row needs (width - 1) merges per row, so
+ * instead the array is split into blocks of 'width' counters, and we keep a
+ * prefix union of the current block (from the block start) and suffix unions
+ * of the previous block (to the block end). Each window spans at most two
+ * adjacent blocks, so it's a union of a suffix of the previous block and the
+ * prefix of the current one - i.e. a constant number of merges per row (on
+ * average), no matter how wide the window is.
+ *
+ * This is the same idea as a queue built from two stacks, but as the window
+ * has a fixed width, the "stacks" are simply rebuilt at block boundaries.
+ */
+#include "postgres.h"
+#include "fmgr.h"
+#include "funcapi.h"
+#include "miscadmin.h"
+#include "utils/array.h"
+#include "utils/lsyscache.h"
+#include "utils/tuplestore.h"
+
+#include "hyperloglog.h"
+
+PG_FUNCTION_INFO_V1(hyperloglog_rolling_union);
+
+Datum hyperloglog_rolling_union(PG_FUNCTION_ARGS);
+
+static HyperLogLogCounter hyperloglog_union_into(HyperLogLogCounter result, HyperLogLogCounter counter);
+
+/* Returns union of the window of 'width' counters ending at each element of
+ * the array (the first width-1 windows are shorter), with the subscript of
+ * the element. NULL elements are treated as empty counters, and the union is
+ * NULL if there are only NULL elements in the window. */
+Datum
+hyperloglog_rolling_union(PG_FUNCTION_ARGS)
+{
+
+    ArrayType      *array = PG_GETARG_ARRAYTYPE_P(0);
+    int32           width = PG_GETARG_INT32(1);
+    ReturnSetInfo  *rsinfo = (ReturnSetInfo *) fcinfo->resultinfo;
+    TupleDesc       tupdesc;
+    Tuplestorestate *tupstore;
+    MemoryContext   oldcontext;
+    Datum          *elems;
+    bool           *elemnulls;
+    int             nelems;
+    int16           typlen;
+    bool            typbyval;
+    char            typalign;
+    int             lbound;
+    int             i, j;
+    HyperLogLogCounter *counters;
+    HyperLogLogCounter *suffix;         /* suffix unions of the previous block */
+    HyperLogLogCounter  prefix = NULL;  /* prefix union of the current block */
+
+    if (width < 1)
+        elog(ERROR, "window width has to be at least 1 (%d)", width);
+
+    if (ARR_NDIM(array) > 1)
+        elog(ERROR, "array of counters has to be one-dimensional");
+
+    if ((rsinfo == NULL) || ! IsA(rsinfo, ReturnSetInfo) ||
+        ! (rsinfo->allowedModes & SFRM_Materialize))
+        ereport(ERROR,
+                (errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+                 errmsg("set-valued function called in context that cannot accept a set")));
+
+    if (get_call_result_type(fcinfo, NULL, &tupdesc) != TYPEFUNC_COMPOSITE)
+        elog(ERROR, "return type must be a row type");
+
+    oldcontext = MemoryContextSwitchTo(rsinfo->econtext->ecxt_per_query_memory);
+
+    tupstore = tuplestore_begin_heap(true, false, work_mem);
+    rsinfo->returnMode = SFRM_Materialize;
+    rsinfo->setResult = tupstore;
+    rsinfo->setDesc = tupdesc;
+
+    MemoryContextSwitchTo(oldcontext);
+
+    lbound = (ARR_NDIM(array) == 1) ? ARR_LBOUND(array)[0] : 1;
+
+    get_typlenbyvalalign(ARR_ELEMTYPE(array), &typlen, &typbyval, &typalign);
+
+    deconstruct_array(array, ARR_ELEMTYPE(array), typlen, typbyval, typalign,
+                      &elems, &elemnulls, &nelems);
+
+    /* detoast the counters just once (each one is used up to three times) */
+    counters = (HyperLogLogCounter *) palloc(sizeof(HyperLogLogCounter) * Max(nelems, 1));
+
+    for (i = 0; i < nelems; i++)
+        counters[i] = elemnulls[i] ? NULL : (HyperLogLogCounter) PG_DETOAST_DATUM(elems[i]);
+
+    /* the suffixes are only built for complete blocks (i.e. width <= nelems) */
+    suffix = (HyperLogLogCounter *) palloc0(sizeof(HyperLogLogCounter) * Max(Min(width, nelems), 1));
+
+    for (i = 0; i < nelems; i++) {
+
+        Datum       values[2];
+        bool        nulls[2] = {false, false};
+        int         blockstart = (i / width) * width;
+        int         start = Max(0, i - width + 1);
+        HyperLogLogCounter result;
+
+        CHECK_FOR_INTERRUPTS();
+
+        /* first element of a block - build suffix unions of the previous one */
+        if ((i == blockstart) && (i > 0)) {
+
+            HyperLogLogCounter union_counter = NULL;
+
+            for (j = width - 1; j >= 0; j--) {
+
+                if (suffix[j] != NULL)
+                    pfree(suffix[j]);
+
+                union_counter = hyperloglog_union_into(union_counter, counters[i - width + j]);
+
+                suffix[j] = (union_counter != NULL) ? hyperloglog_copy(union_counter) : NULL;
+            }
+
+            if (union_counter != NULL)
+                pfree(union_counter);
+
+            if (prefix != NULL)
+                pfree(prefix);
+
+            prefix = NULL;
+        }
+
+        prefix = hyperloglog_union_into(prefix, counters[i]);
+
+        if (start == blockstart) {
+            /* the window is the whole prefix of the current block */
+            result = (prefix != NULL) ? hyperloglog_copy(prefix) : NULL;
+        } else {
+            /* suffix of the previous block, and prefix of the current one */
+            HyperLogLogCounter s = suffix[start - (blockstart - width)];
+
+            result = (s != NULL) ? hyperloglog_copy(s) : NULL;
+            result = hyperloglog_union_into(result, prefix);
+        }
+
+        values[0] = Int32GetDatum(lbound + i);
+        values[1] = PointerGetDatum(result);
+        nulls[1] = (result == NULL);
+
+        tuplestore_putvalues(tupstore, tupdesc, values, nulls);
+
+        if (result != NULL)
+            pfree(result);
+    }
+
+    return (Datum) 0;
+
+}
+
+/* Merges the counter into the result (in place), returns the result - or a
+ * copy of the counter if there's no result yet. NULL counters are ignored. */
+static HyperLogLogCounter
+hyperloglog_union_into(HyperLogLogCounter result, HyperLogLogCounter counter)
+{
+
+    if (counter == NULL)
+        return result;
+
+    if (result == NULL)
+        return hyperloglog_copy(counter);
+
+    return hyperloglog_merge(result, counter, true);
+
+}
@@ -0,0 +1,520 @@
+/* Named HyperLogLog counters living in shared memory.
+ *
+ * Regular counters are values (a variable in a PL/pgSQL procedure, or a column
+ * in a table), so updating a counter from many sessions means updating the
+ * same row over and over, rewriting the whole counter every time. The shared
+ * counters are allocated in shared memory when the server starts (so the
+ * library needs to be in shared_preload_libraries), and any backend may add
+ * items into them concurrently.
+ *
+ * The number of counters and the error rate (i.e. number of bins) is set by
+ * GUC options, and can't be changed without a restart:
+ *
+ *   hyperloglog.shared_counters   - number of named counters (default 16)
+ *   hyperloglog.shared_error_rate - error rate of the counters (default 0.025)
+ *
+ * The bins are packed into 32-bit words (4 bins per word) and updated using
+ * a compare-and-swap loop implementing 'atomic max', so adding items does not
+ * need any locks at all. The lock is only needed to create a new counter (on
+ * the first add into a counter with a new name). Counters can't be dropped -
+ * once created, the name is allocated until a restart.
+ */
+#include <math.h>
+#include <string.h>
+
+#include "postgres.h"
+#include "fmgr.h"
+#include "miscadmin.h"
+#include "distinct_md5.h"
+#include "port/atomics.h"
+#include "storage/ipc.h"
+#include "storage/lwlock.h"
+#include "storage/shmem.h"
+#include "utils/builtins.h"
+#include "utils/guc.h"
+#include "utils/lsyscache.h"
+
+#include "hyperloglog.h"
+#include "hyperloglog_counter.h"
+#include "distinct_hash.h"
+
+/* we're using md5, which produces 16B (128-bit) values */
+#define HASH_LENGTH 16
+
+#define SHMEM_NAME          "hyperloglog_counter"
+
+/* number of bins packed into a single 32-bit word */
+#define BINS_PER_WORD       4
+
+typedef struct HyperLogLogSharedCounterData {
+
+    /* is the slot used (set only after the name is written) */
+    pg_atomic_uint32    used;
+
+    /* name of the counter */
+    NameData            name;
+
+    /* bins, BINS_PER_WORD in each word (m / BINS_PER_WORD words) */
+    pg_atomic_uint32    bins[FLEXIBLE_ARRAY_MEMBER];
+
+} HyperLogLogSharedCounterData;
+
+typedef HyperLogLogSharedCounterData * HyperLogLogSharedCounter;
+
+typedef struct HyperLogLogSharedState {
+
+    /* protects creation of new counters */
+    LWLock *lock;
+
+    /* number of counters, and size of each of them */
+    int     ncounters;
+    int     b;
+    int     m;
+    Size    counter_size;
+
+    /* the counters themselves (ncounters * counter_size bytes) */
+    char    counters[FLEXIBLE_ARRAY_MEMBER];
+
+} HyperLogLogSharedState;
+
+/* cache of the counter lookup (and type info for the item), stored in fn_extra */
+typedef struct HyperLogLogSharedCache {
+    NameData    name;
+    int         slot;
+    Oid         element_type;
+    int16       typlen;
+    bool        typbyval;
+} HyperLogLogSharedCache;
+
+#define SHARED_COUNTER(state, slot) \
+    ((HyperLogLogSharedCounter) ((state)->counters + (slot) * (state)->counter_size))
+
+/* GUC variables */
+static int      hyperloglog_shared_counters = 16;
+static double   hyperloglog_shared_error_rate = 0.025;
+
+/* pointer to the shared state (NULL when not loaded in shared_preload_libraries) */
+static HyperLogLogSharedState * shared_state = NULL;
+
+#if PG_VERSION_NUM >= 150000
+static shmem_request_hook_type prev_shmem_request_hook = NULL;
+#endif
+static shmem_startup_hook_type prev_shmem_startup_hook = NULL;
+
+static int  hyperloglog_shared_bits(void);
+static Size hyperloglog_shared_counter_size(void);
+static Size hyperloglog_shared_size(void);
+static void hyperloglog_shmem_request(void);
+static void hyperloglog_shmem_startup(void);
+
+static HyperLogLogSharedCache * hyperloglog_shared_cache(FunctionCallInfo fcinfo);
+static int  hyperloglog_shared_lookup(HyperLogLogSharedCache * cache, text * name, bool create);
+static void hyperloglog_shared_update(HyperLogLogSharedCounter counter, unsigned int idx, uint8 rho);
+static HyperLogLogCounter hyperloglog_shared_copy(HyperLogLogSharedCounter counter);
+
+PG_FUNCTION_INFO_V1(hyperloglog_shared_add_item);
+PG_FUNCTION_INFO_V1(hyperloglog_shared_merge);
+PG_FUNCTION_INFO_V1(hyperloglog_shared_get_estimate);
+PG_FUNCTION_INFO_V1(hyperloglog_shared_snapshot);
+PG_FUNCTION_INFO_V1(hyperloglog_shared_reset);
+
+Datum hyperloglog_shared_add_item(PG_FUNCTION_ARGS);
+Datum hyperloglog_shared_merge(PG_FUNCTION_ARGS);
+Datum hyperloglog_shared_get_estimate(PG_FUNCTION_ARGS);
+Datum hyperloglog_shared_snapshot(PG_FUNCTION_ARGS);
+Datum hyperloglog_shared_reset(PG_FUNCTION_ARGS);
+
+/* Defines the GUC options and requests the shared memory - only when loaded from
+ * shared_preload_libraries, otherwise the shared counters are not available. */
+void
+hyperloglog_shmem_init(void)
+{
+    if (! process_shared_preload_libraries_in_progress)
+        return;
+
+    DefineCustomIntVariable("hyperloglog.shared_counters",
+                            "Number of named HyperLogLog counters in shared memory.",
+                            NULL,
+                            &hyperloglog_shared_counters,
+                            16, 0, 1024,
+                            PGC_POSTMASTER, 0,
+                            NULL, NULL, NULL);
+
+    DefineCustomRealVariable("hyperloglog.shared_error_rate",
+                             "Error rate of the HyperLogLog counters in shared memory.",
+                             NULL,
+                             &hyperloglog_shared_error_rate,
+                             0.025, 0.004, 0.5,
+                             PGC_POSTMASTER, 0,
+                             NULL, NULL, NULL);
+
+#if PG_VERSION_NUM >= 150000
+    prev_shmem_request_hook = shmem_request_hook;
+    shmem_request_hook = hyperloglog_shmem_request;
+#else
+    hyperloglog_shmem_request();
+#endif
+
+    prev_shmem_startup_hook = shmem_startup_hook;
+    shmem_startup_hook = hyperloglog_shmem_startup;
+}
+
+/* number of index bits for the configured error rate (the same as in hyperloglog_create) */
+static int
+hyperloglog_shared_bits(void)
+{
+    int b = (int)ceil(log2(1.04 / (hyperloglog_shared_error_rate * hyperloglog_shared_error_rate)));
+
+    return (b < 4) ? 4 : b;
+}
+
+static Size
+hyperloglog_shared_counter_size(void)
+{
+    int m = (int)pow(2, hyperloglog_shared_bits());
+
+    return MAXALIGN(offsetof(HyperLogLogSharedCounterData, bins) +
+                    (m / BINS_PER_WORD) * sizeof(pg_atomic_uint32));
+}
+
+static Size
+hyperloglog_shared_size(void)
+{
+    return add_size(offsetof(HyperLogLogSharedState, counters),
+                    mul_size(hyperloglog_shared_counters, hyperloglog_shared_counter_size()));
+}
+
+static void
+hyperloglog_shmem_request(void)
+{
+#if PG_VERSION_NUM >= 150000
+    if (prev_shmem_request_hook)
+        prev_shmem_request_hook();
+#endif
+
+    RequestAddinShmemSpace(hyperloglog_shared_size());
+    RequestNamedLWLockTranche(SHMEM_NAME, 1);
+}
+
+static void
+hyperloglog_shmem_startup(void)
+{
+    bool    found;
+
+    if (prev_shmem_startup_hook)
+        prev_shmem_startup_hook();
+
+    LWLockAcquire(AddinShmemInitLock, LW_EXCLUSIVE);
+
+    shared_state = ShmemInitStruct(SHMEM_NAME, hyperloglog_shared_size(), &found);
+
+    if (! found) {
+
+        int i, j;
+
+        shared_state->lock = &(GetNamedLWLockTranche(SHMEM_NAME))->lock;
+        shared_state->ncounters = hyperloglog_shared_counters;
+        shared_state->b = hyperloglog_shared_bits();
+        shared_state->m = (int)pow(2, shared_state->b);
+        shared_state->counter_size = hyperloglog_shared_counter_size();
+
+        for (i = 0; i < shared_state->ncounters; i++) {
+
+            HyperLogLogSharedCounter counter = SHARED_COUNTER(shared_state, i);
+
+            pg_atomic_init_u32(&counter->used, 0);
+            memset(&counter->name, 0, sizeof(NameData));
+
+            for (j = 0; j < shared_state->m / BINS_PER_WORD; j++)
+                pg_atomic_init_u32(&counter->bins[j], 0);
+
+        }
+    }
+
+    LWLockRelease(AddinShmemInitLock);
+}
+
+/* fetch (or initialize) the lookup cache for the function call */
+static HyperLogLogSharedCache *
+hyperloglog_shared_cache(FunctionCallInfo fcinfo)
+{
+    HyperLogLogSharedCache * cache = (HyperLogLogSharedCache *) fcinfo->flinfo->fn_extra;
+
+    if (shared_state == NULL)
+        ereport(ERROR,
+                (errcode(ERRCODE_OBJECT_NOT_IN_PREREQUISITE_STATE),
+                 errmsg("shared hyperloglog counters are not available"),
+                 errhint("Add hyperloglog_counter to shared_preload_libraries and restart the server.")));
+
+    if (cache == NULL) {
+        cache = MemoryContextAllocZero(fcinfo->flinfo->fn_mcxt, sizeof(HyperLogLogSharedCache));
+        cache->slot = -1;
+        fcinfo->flinfo->fn_extra = cache;
+    }
+
+    return cache;
+}
+
+/* Finds slot of the counter with the given name, and optionally creates it when
+ * it does not exist yet. Returns -1 when the counter does not exist. The lookup
+ * itself is lock-free, the lock is acquired only when creating the counter. */
+static int
+hyperloglog_shared_lookup(HyperLogLogSharedCache * cache, text * name, bool create)
+{
+    int     i;
+    int     slot = -1;
+    char   *str = text_to_cstring(name);
+
+    if (strlen(str) >= NAMEDATALEN)
+        ereport(ERROR,
+                (errcode(ERRCODE_INVALID_NAME),
+                 errmsg("shared counter name \"%s\" is too long", str)));
+
+    /* same name as the last time? */
+    if ((cache->slot != -1) && (strcmp(NameStr(cache->name), str) == 0)) {
+        pfree(str);
+        return cache->slot;
+    }
+
+    for (i = 0; i < shared_state->ncounters; i++) {
+
+        HyperLogLogSharedCounter counter = SHARED_COUNTER(shared_state, i);
+
+        /* slots are allocated in order, so the first unused slot ends the search */
+        if (pg_atomic_read_u32(&counter->used) == 0)
+            break;
+
+        pg_read_barrier();
+
+        if (strcmp(NameStr(counter->name), str) == 0) {
+            slot = i;
+            break;
+        }
+    }
+
+    if ((slot == -1) && create) {
+
+        LWLockAcquire(shared_state->lock, LW_EXCLUSIVE);
+
+        /* search again, somebody might have created it in the meantime */
+        for (i = 0; i < shared_state->ncounters; i++) {
+
+            HyperLogLogSharedCounter counter = SHARED_COUNTER(shared_state, i);
+
+            if (pg_atomic_read_u32(&counter->used) == 0) {
+
+                /* not found, so use this slot (the bins are still zeroed) */
+                strlcpy(NameStr(counter->name), str, NAMEDATALEN);
+
+                pg_write_barrier();
+
+                pg_atomic_write_u32(&counter->used, 1);
+                slot = i;
+                break;
+
+            } else if (strcmp(NameStr(counter->name), str) == 0) {
+                slot = i;
+                break;
+            }
+        }
+
+        LWLockRelease(shared_state->lock);
+
+        if (slot == -1)
+            ereport(ERROR,
+                    (errcode(ERRCODE_PROGRAM_LIMIT_EXCEEDED),
+                     errmsg("no free shared hyperloglog counter for \"%s\"", str),
+                     errhint("Increase hyperloglog.shared_counters (currently %d).",
+                             shared_state->ncounters)));
+    }
+
+    if (slot != -1) {
+        strlcpy(NameStr(cache->name), str, NAMEDATALEN);
+        cache->slot = slot;
+    }
+
+    pfree(str);
+
+    return slot;
+}
+
+/* atomic max on a single bin (packed in a 32-bit word with other bins) */
+static void
+hyperloglog_shared_update(HyperLogLogSharedCounter counter, unsigned int idx, uint8 rho)
+{
+    pg_atomic_uint32 * word = &counter->bins[idx / BINS_PER_WORD];
+    int     shift = (idx % BINS_PER_WORD) * 8;
+    uint32  oldval = pg_atomic_read_u32(word);
+
+    /* on failure, the compare-exchange stores the current value into 'oldval' */
+    while (((oldval >> shift) & 0xFF) < rho) {
+
+        uint32 newval = (oldval & ~((uint32)0xFF << shift)) | ((uint32)rho << shift);
+
+        if (pg_atomic_compare_exchange_u32(word, &oldval, newval))
+            break;
+    }
+}
+
+Datum
+hyperloglog_shared_add_item(PG_FUNCTION_ARGS)
+{
+    HyperLogLogSharedCache * cache = hyperloglog_shared_cache(fcinfo);
+    HyperLogLogSharedCounter counter;
+    unsigned char hash[HASH_LENGTH];
+    unsigned int idx;
+    char    rho;
+    int     slot;
+    Datum   element;
+
+    if (PG_ARGISNULL(0))
+        elog(ERROR, "shared counter name must not be NULL");
+
+    /* skip NULL items */
+    if (PG_ARGISNULL(1))
+        PG_RETURN_VOID();
+
+    element = PG_GETARG_DATUM(1);
+
+    /* get type information for the second parameter (anyelement item) */
+    if (cache->element_type == InvalidOid) {
+        cache->element_type = get_fn_expr_argtype(fcinfo->flinfo, 1);
+        get_typlenbyval(cache->element_type, &cache->typlen, &cache->typbyval);
+    }
+
+    /* the same hashing as in hyperloglog_add_element (so the counters are compatible) */
+    if (cache->typlen == -1) {
+        /* varlena */
+        distinct_hash_varlena(element, hash);
+    } else if (cache->typbyval) {
+        /* fixed-length, passed by value */
+        distinct_md5((char*)&element, cache->typlen, hash);
+    } else {
+        /* fixed-length, passed by reference */
+        distinct_md5((char*)element, cache->typlen, hash);
+    }
+
+    slot = hyperloglog_shared_lookup(cache, PG_GETARG_TEXT_PP(0), true);
+    counter = SHARED_COUNTER(shared_state, slot);
+
+    hyperloglog_hash_bin(hash, shared_state->b, &idx, &rho);
+    hyperloglog_shared_update(counter, idx, rho);
+
+    PG_RETURN_VOID();
+}
+
+/* merges a regular counter into the shared one (the counter must have the same size) */
+Datum
+hyperloglog_shared_merge(PG_FUNCTION_ARGS)
+{
+    HyperLogLogSharedCache * cache = hyperloglog_shared_cache(fcinfo);
+    HyperLogLogSharedCounter counter;
+    HyperLogLogCounter hloglog;
+    int     i;
+
+    if (PG_ARGISNULL(0))
+        elog(ERROR, "shared counter name must not be NULL");
+
+    if (PG_ARGISNULL(1))
+        PG_RETURN_VOID();
+
+    hloglog = (HyperLogLogCounter)PG_GETARG_BYTEA_P(1);
+
+    /* check the counter before the lookup, which locks the shared state */
+    hyperloglog_check_counter(hloglog);
+
+    if (hloglog->b != shared_state->b)
+        elog(ERROR, "index size of estimators differs (%d != %d)", hloglog->b, shared_state->b);
+    else if (hloglog->binbits != 8)
+        elog(ERROR, "bin size of estimators differs (%d != %d)", hloglog->binbits, 8);
+
+    counter = SHARED_COUNTER(shared_state,
+                             hyperloglog_shared_lookup(cache, PG_GETARG_TEXT_PP(0), true));
+
+    for (i = 0; i < hloglog->m; i++)
+        if (hloglog->data[i] > 0)
+            hyperloglog_shared_update(counter, i, hloglog->data[i]);
+
+    PG_RETURN_VOID();
+}
+
+/* copies the shared counter into a regular hyperloglog_estimator */
+static HyperLogLogCounter
+hyperloglog_shared_copy(HyperLogLogSharedCounter counter)
+{
+    HyperLogLogCounter result;
+    size_t  length;
+    int     i, j;
+
+    /* bins, followed by the cached estimate (see HLL_HAS_CACHE) */
+    length = offsetof(HyperLogLogCounterData, data) + shared_state->m + sizeof(int32);
+    result = (HyperLogLogCounter)palloc(length);
+
+    result->b = shared_state->b;
+    result->m = shared_state->m;
+    result->binbits = 8;
+
+    for (i = 0; i < shared_state->m / BINS_PER_WORD; i++) {
+
+        uint32 word = pg_atomic_read_u32(&counter->bins[i]);
+
+        for (j = 0; j < BINS_PER_WORD; j++)
+            result->data[i * BINS_PER_WORD + j] = (word >> (j * 8)) & 0xFF;
+    }
+
+    SET_VARSIZE(result, length);
+
+    hyperloglog_set_cached_estimate(result, HLL_ESTIMATE_INVALID);
+
+    return result;
+}
+
+Datum
+hyperloglog_shared_snapshot(PG_FUNCTION_ARGS)
+{
+    HyperLogLogSharedCache * cache = hyperloglog_shared_cache(fcinfo);
+    int     slot = hyperloglog_shared_lookup(cache, PG_GETARG_TEXT_PP(0), false);
+
+    if (slot == -1)
+        PG_RETURN_NULL();
+
+    PG_RETURN_BYTEA_P(hyperloglog_shared_copy(SHARED_COUNTER(shared_state, slot)));
+}
+
+Datum
+hyperloglog_shared_get_estimate(PG_FUNCTION_ARGS)
+{
+    HyperLogLogSharedCache * cache = hyperloglog_shared_cache(fcinfo);
+    HyperLogLogCounter snapshot;
+    int     estimate;
+    int     slot = hyperloglog_shared_lookup(cache, PG_GETARG_TEXT_PP(0), false);
+
+    if (slot == -1)
+        PG_RETURN_NULL();
+
+    snapshot = hyperloglog_shared_copy(SHARED_COUNTER(shared_state, slot));
+    estimate = hyperloglog_estimate(snapshot);
+    pfree(snapshot);
+
+    PG_RETURN_FLOAT4(estimate);
+}
+
+Datum
+hyperloglog_shared_reset(PG_FUNCTION_ARGS)
+{
+    HyperLogLogSharedCache * cache = hyperloglog_shared_cache(fcinfo);
+    HyperLogLogSharedCounter counter;
+    int     slot, i;
+
+    slot = hyperloglog_shared_lookup(cache, PG_GETARG_TEXT_PP(0), false);
+
+    if (slot != -1) {
+
+        counter = SHARED_COUNTER(shared_state, slot);
+
+        for (i = 0; i < shared_state->m / BINS_PER_WORD; i++)
+            pg_atomic_write_u32(&counter->bins[i], 0);
+    }
+
+    PG_RETURN_VOID();
+}
@@ -0,0 +1,93 @@
+/* Instrumentation of the estimator, exposed through a statistics function.
+ *
+ * When enabled, the estimator (hyperloglog.c) counts the elements and hashes
+ * added to counters, how many of them actually changed a bin, merges and bytes
+ * allocated for counters, and measures time spent hashing and updating bins.
+ * This is meant for diagnosing slow aggregations (e.g. large values where the
+ * hashing dominates), so it's disabled by default:
+ *
+ *   hyperloglog.track_stats - collect the statistics (default off)
+ *
+ * The statistics are per backend (not shared), accumulated until reset using
+ * hyperloglog_estimator_stats_reset(). Work done by parallel workers is not
+ * included. With the option disabled, the only overhead is a branch.
+ */
+#include "postgres.h"
+#include "fmgr.h"
+#include "funcapi.h"
+#include "access/htup_details.h"
+#include "utils/guc.h"
+
+#include "hyperloglog.h"
+#include "hyperloglog_counter.h"
+
+PG_FUNCTION_INFO_V1(hyperloglog_estimator_stats);
+PG_FUNCTION_INFO_V1(hyperloglog_estimator_stats_reset);
+
+Datum hyperloglog_estimator_stats(PG_FUNCTION_ARGS);
+Datum hyperloglog_estimator_stats_reset(PG_FUNCTION_ARGS);
+
+/* GUC variables */
+static bool     hyperloglog_track_stats = false;
+
+/* the statistics collected in this backend */
+static HyperLogLogStats hyperloglog_stats_data;
+
+static void hyperloglog_track_stats_assign(bool newval, void *extra);
+
+void
+hyperloglog_stats_init(void)
+{
+    DefineCustomBoolVariable("hyperloglog.track_stats",
+                             "Collect statistics about the HyperLogLog estimators.",
+                             "See hyperloglog_estimator_stats().",
+                             &hyperloglog_track_stats,
+                             false,
+                             PGC_USERSET, 0,
+                             NULL, hyperloglog_track_stats_assign, NULL);
+}
+
+/* the estimator collects the statistics only while the pointer is set */
+static void
+hyperloglog_track_stats_assign(bool newval, void *extra)
+{
+    hyperloglog_stats = newval ? &hyperloglog_stats_data : NULL;
+}
+
+Datum
+hyperloglog_estimator_stats(PG_FUNCTION_ARGS)
+{
+
+    TupleDesc   tupdesc;
+    Datum       values[7];
+    bool        nulls[7];
+
+    if (get_call_result_type(fcinfo, NULL, &tupdesc) != TYPEFUNC_COMPOSITE)
+        elog(ERROR, "return type must be a row type");
+
+    memset(nulls, 0, sizeof(nulls));
+
+    values[0] = Int64GetDatum(hyperloglog_stats_data.elements);
+    values[1] = Int64GetDatum(hyperloglog_stats_data.hashes);
+    values[2] = Int64GetDatum(hyperloglog_stats_data.updates);
+    values[3] = Int64GetDatum(hyperloglog_stats_data.merges);
+    values[4] = Int64GetDatum(hyperloglog_stats_data.allocated);
+    values[5] = Float8GetDatum(INSTR_TIME_GET_MILLISEC(hyperloglog_stats_data.hash_time));
+    values[6] = Float8GetDatum(INSTR_TIME_GET_MILLISEC(hyperloglog_stats_data.update_time));
+
+    PG_RETURN_DATUM(HeapTupleGetDatum(heap_form_tuple(BlessTupleDesc(tupdesc), values, nulls)));
+
+}
+
+Datum
+hyperloglog_estimator_stats_reset(PG_FUNCTION_ARGS)
+{
+
+    memset(&hyperloglog_stats_data, 0, sizeof(HyperLogLogStats));
+
+    INSTR_TIME_SET_ZERO(hyperloglog_stats_data.hash_time);
+    INSTR_TIME_SET_ZERO(hyperloglog_stats_data.update_time);
+
+    PG_RETURN_VOID();
+
+}
@@ -0,0 +1,299 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "postgres.h"
+
+#include "hyperloglog.h"
+
+/* slots (and the counters in them) are aligned to 8 bytes */
+#define STORE_ALIGN(len)    (((len) + 7) & ~((size_t) 7))
+
+/* maximum fraction of used slots (so that the probe sequences stay short) */
+#define STORE_FILL_FACTOR   0.9
+
+/* Each slot starts with this, followed by the key and the counter. */
+typedef struct HyperLogLogStoreSlot {
+    uint32  used;
+    uint32  keylen;
+    char    key[1];
+} HyperLogLogStoreSlot;
+
+#define SLOT_HEADER_SIZE    offsetof(HyperLogLogStoreSlot, key)
+
+#define STORE_SLOT(store, idx) \
+    ((HyperLogLogStoreSlot *) ((store)->slots + (idx) * (store)->header->slotsize))
+
+#define SLOT_COUNTER(store, slot) \
+    ((HyperLogLogCounter) ((char *) (slot) + STORE_ALIGN(SLOT_HEADER_SIZE + (store)->header->keysize)))
+
+static HyperLogLogStore hyperloglog_store_map(const char * path, int fd, size_t length, bool readonly);
+static HyperLogLogStoreSlot * hyperloglog_store_lookup(HyperLogLogStore store, const char * key, int keylen);
+static uint64 hyperloglog_store_hash(const char * key, int keylen);
+
+/* Creates a new store file, with slots for 'capacity' keys and counters
+ * with the requested error rate. Fails if the file already exists.
+ *
+ * The file is created sparse, so the unused slots do not occupy any disk
+ * space (but the address space still needs to be available).
+ */
+HyperLogLogStore hyperloglog_store_create(const char * path, float error, uint64 capacity, int keysize) {
+
+    int fd;
+    size_t length;
+    uint64 nslots;
+    HyperLogLogCounter counter;
+    HyperLogLogStore store;
+    HyperLogLogStoreHeader header;
+
+    if (capacity < 1)
+        elog(ERROR, "capacity of the store has to be at least 1");
+
+    if ((keysize < 1) || (keysize > 1024))
+        elog(ERROR, "key size has to be between 1 and 1024");
+
+    /* geometry of the counters (the ndistinct is not used for the size) */
+    counter = hyperloglog_create(1, error);
+
+    nslots = (uint64) ceil(capacity / STORE_FILL_FACTOR);
+
+    memset(&header, 0, sizeof(HyperLogLogStoreHeader));
+
+    header.magic = HLL_STORE_MAGIC;
+    header.version = HLL_STORE_VERSION;
+    header.keysize = keysize;
+    header.countersize = VARSIZE(counter);
+    header.slotsize = STORE_ALIGN(SLOT_HEADER_SIZE + keysize) + STORE_ALIGN(VARSIZE(counter));
+    header.b = counter->b;
+    header.capacity = nslots;
+    header.nentries = 0;
+
+    pfree(counter);
+
+    if (nslots > (SIZE_MAX - sizeof(HyperLogLogStoreHeader)) / header.slotsize)
+        elog(ERROR, "store with %lu slots is too large", (unsigned long) nslots);
+
+    length = sizeof(HyperLogLogStoreHeader) + nslots * header.slotsize;
+
+    fd = open(path, O_RDWR | O_CREAT | O_EXCL, S_IRUSR | S_IWUSR);
+    if (fd < 0)
+        elog(ERROR, "could not create store file \"%s\": %s", path, strerror(errno));
+
+    /* extends the file with zeroes (i.e. empty slots) */
+    if (ftruncate(fd, length) != 0) {
+        int save_errno = errno;
+        close(fd);
+        unlink(path);
+        elog(ERROR, "could not resize store file \"%s\": %s", path, strerror(save_errno));
+    }
+
+    store = hyperloglog_store_map(path, fd, length, false);
+
+    memcpy(store->header, &header, sizeof(HyperLogLogStoreHeader));
+
+    return store;
+
+}
+
+/* Opens (maps) an existing store file. */
+HyperLogLogStore hyperloglog_store_open(const char * path, bool readonly) {
+
+    int fd;
+    struct stat st;
+    HyperLogLogStore store;
+    HyperLogLogStoreHeader *header;
+
+    fd = open(path, readonly ? O_RDONLY : O_RDWR);
+    if (fd < 0)
+        elog(ERROR, "could not open store file \"%s\": %s", path, strerror(errno));
+
+    if (fstat(fd, &st) != 0) {
+        int save_errno = errno;
+        close(fd);
+        elog(ERROR, "could not stat store file \"%s\": %s", path, strerror(save_errno));
+    }
+
+    if (st.st_size < sizeof(HyperLogLogStoreHeader)) {
+        close(fd);
+        elog(ERROR, "file \"%s\" is not a HyperLogLog store (too short)", path);
+    }
+
+    store = hyperloglog_store_map(path, fd, st.st_size, readonly);
+    header = store->header;
+
+    /* check that the header matches the file */
+    if ((header->magic != HLL_STORE_MAGIC) || (header->version != HLL_STORE_VERSION) ||
+        (header->keysize < 1) || (header->countersize < offsetof(HyperLogLogCounterData, data)) ||
+        (header->slotsize != STORE_ALIGN(SLOT_HEADER_SIZE + header->keysize) + STORE_ALIGN(header->countersize)) ||
+        (header->capacity > (st.st_size - sizeof(HyperLogLogStoreHeader)) / header->slotsize) ||
+        (st.st_size != sizeof(HyperLogLogStoreHeader) + header->capacity * header->slotsize)) {
+        hyperloglog_store_close(store);
+        elog(ERROR, "file \"%s\" is not a valid HyperLogLog store", path);
+    }
+
+    return store;
+
+}
+
+/* Unmaps the store (the changes are flushed to the file first). */
+void hyperloglog_store_close(HyperLogLogStore store) {
+
+    if (! store->readonly)
+        msync(store->header, store->length, MS_SYNC);
+
+    munmap(store->header, store->length);
+
+    pfree(store);
+
+}
+
+HyperLogLogCounter hyperloglog_store_get(HyperLogLogStore store, const char * key, int keylen) {
+
+    HyperLogLogStoreSlot *slot = hyperloglog_store_lookup(store, key, keylen);
+
+    if ((slot == NULL) || (! slot->used))
+        return NULL;
+
+    return SLOT_COUNTER(store, slot);
+
+}
+
+/* Merges the counter into the store, either into an existing counter for the
+ * key (in place), or by copying it into a new slot. */
+void hyperloglog_store_merge(HyperLogLogStore store, const char * key, int keylen, HyperLogLogCounter counter) {
+
+    HyperLogLogStoreSlot *slot;
+    HyperLogLogStoreHeader *header = store->header;
+
+    if (store->readonly)
+        elog(ERROR, "store is opened read-only");
+
+    /* The bins have to match, but the counters may differ in the cached
+     * estimate (counters created by older versions don't have it). */
+    if ((counter->b != header->b) || (VARSIZE(counter) < HLL_CACHE_OFFSET(counter)) ||
+        (header->countersize < HLL_CACHE_OFFSET(counter)))
+        elog(ERROR, "counter does not match the store (size %d, %d bits, expected %d, %d bits)",
+             (int) VARSIZE(counter), counter->b, header->countersize, header->b);
+
+    slot = hyperloglog_store_lookup(store, key, keylen);
+
+    if ((slot != NULL) && slot->used) {
+        hyperloglog_merge(SLOT_COUNTER(store, slot), counter, true);
+        return;
+    }
+
+    if ((slot == NULL) || (header->nentries >= header->capacity * STORE_FILL_FACTOR))
+        elog(ERROR, "store is full (%lu keys)", (unsigned long) header->nentries);
+
+    slot->used = 1;
+    slot->keylen = keylen;
+    memcpy(slot->key, key, keylen);
+    memcpy(SLOT_COUNTER(store, slot), counter, Min(VARSIZE(counter), header->countersize));
+
+    SET_VARSIZE(SLOT_COUNTER(store, slot), header->countersize);
+    hyperloglog_set_cached_estimate(SLOT_COUNTER(store, slot), HLL_ESTIMATE_INVALID);
+
+    header->nentries++;
+
+}
+
+/* Returns the counter in a slot (with the key), or NULL if the slot is empty.
+ * Used to walk through all the counters in the store. */
+HyperLogLogCounter hyperloglog_store_entry(HyperLogLogStore store, uint64 idx, const char ** key, int * keylen) {
+
+    HyperLogLogStoreSlot *slot;
+
+    if (idx >= store->header->capacity)
+        return NULL;
+
+    slot = STORE_SLOT(store, idx);
+
+    if (! slot->used)
+        return NULL;
+
+    *key = slot->key;
+    *keylen = slot->keylen;
+
+    return SLOT_COUNTER(store, slot);
+
+}
+
+/* Maps the whole file (and closes the descriptor, the mapping remains valid). */
+static HyperLogLogStore hyperloglog_store_map(const char * path, int fd, size_t length, bool readonly) {
+
+    void *ptr;
+    HyperLogLogStore store;
+
+    ptr = mmap(NULL, length, readonly ? PROT_READ : (PROT_READ | PROT_WRITE), MAP_SHARED, fd, 0);
+
+    if (ptr == MAP_FAILED) {
+        int save_errno = errno;
+        close(fd);
+        elog(ERROR, "could not map store file \"%s\": %s", path, strerror(save_errno));
+    }
+
+    close(fd);
+
+    store = (HyperLogLogStore) palloc(sizeof(HyperLogLogStoreData));
+
+    store->header = (HyperLogLogStoreHeader *) ptr;
+    store->slots = (char *) ptr + sizeof(HyperLogLogStoreHeader);
+    store->length = length;
+    store->readonly = readonly;
+
+    return store;
+
+}
+
+/* Finds the slot for the key (linear probing) - either the slot with the key,
+ * or the first empty slot. NULL means the key is not there and there's no
+ * empty slot (which does not happen thanks to the fill factor). */
+static HyperLogLogStoreSlot *
+hyperloglog_store_lookup(HyperLogLogStore store, const char * key, int keylen) {
+
+    uint64 i;
+    uint64 capacity = store->header->capacity;
+    uint64 idx;
+
+    if ((keylen < 0) || (keylen > store->header->keysize))
+        elog(ERROR, "key is too long (%d bytes, maximum is %d)", keylen, store->header->keysize);
+
+    idx = hyperloglog_store_hash(key, keylen) % capacity;
+
+    for (i = 0; i < capacity; i++) {
+
+        HyperLogLogStoreSlot *slot = STORE_SLOT(store, idx);
+
+        if (! slot->used)
+            return slot;
+
+        if ((slot->keylen == keylen) && (memcmp(slot->key, key, keylen) == 0))
+            return slot;
+
+        idx = (idx + 1) % capacity;
+    }
+
+    return NULL;
+
+}
+
+/* FNV-1a (the keys are usually short, so this is good enough) */
+static uint64
+hyperloglog_store_hash(const char * key, int keylen) {
+
+    int i;
+    uint64 hash = UINT64CONST(0xcbf29ce484222325);
+
+    for (i = 0; i < keylen; i++) {
+        hash ^= (unsigned char) key[i];
+        hash *= UINT64CONST(0x100000001b3);
+    }
+
+    return hash;
+
+}
@@ -0,0 +1,252 @@
+/* SQL access to the counter stores (see hyperloglog.h and hyperloglog_store.c),
+ * i.e. files with many (key, counter) pairs used by offline rollups. The last
+ * store used by the backend remains mapped, so that merging counters one by
+ * one does not need to map the file over and over. Changes of the store are
+ * not transactional - merged counters stay merged even if the transaction
+ * aborts.
+ *
+ * The store code itself does not depend on the server (it's also used by
+ * libdistinct), so the SQL functions are here.
+ *
+ * Accessing the stores is restricted just like hyperloglog_from_file (see
+ * hyperloglog_check_file_access).
+ */
+#include <string.h>
+
+#include <sys/stat.h>
+
+#include "postgres.h"
+#include "fmgr.h"
+#include "funcapi.h"
+#include "miscadmin.h"
+#include "utils/builtins.h"
+#include "utils/memutils.h"
+#include "utils/tuplestore.h"
+
+#include "hyperloglog.h"
+#include "hyperloglog_counter.h"
+
+/* the store mapped by this backend (kept open between calls) */
+typedef struct HyperLogLogStoreCache {
+
+    HyperLogLogStore    store;
+    char               *path;
+    dev_t               dev;    /* to notice the file was replaced */
+    ino_t               ino;
+
+} HyperLogLogStoreCache;
+
+static HyperLogLogStoreCache store_cache = {NULL, NULL, 0, 0};
+
+PG_FUNCTION_INFO_V1(hyperloglog_store_create_file);
+PG_FUNCTION_INFO_V1(hyperloglog_store_merge_counter);
+PG_FUNCTION_INFO_V1(hyperloglog_store_get_counter);
+PG_FUNCTION_INFO_V1(hyperloglog_store_get_estimate);
+PG_FUNCTION_INFO_V1(hyperloglog_store_entries);
+
+Datum hyperloglog_store_create_file(PG_FUNCTION_ARGS);
+Datum hyperloglog_store_merge_counter(PG_FUNCTION_ARGS);
+Datum hyperloglog_store_get_counter(PG_FUNCTION_ARGS);
+Datum hyperloglog_store_get_estimate(PG_FUNCTION_ARGS);
+Datum hyperloglog_store_entries(PG_FUNCTION_ARGS);
+
+static HyperLogLogStore hyperloglog_store_cached(const char * path);
+static void hyperloglog_store_uncache(void);
+
+/* Creates a new (empty) store file. */
+Datum
+hyperloglog_store_create_file(PG_FUNCTION_ARGS)
+{
+
+    char   *path = text_to_cstring(PG_GETARG_TEXT_PP(0));
+    float   errorRate = PG_GETARG_FLOAT4(1);
+    int64   capacity = PG_GETARG_INT64(2);
+    int     keysize = PG_GETARG_INT32(3);
+
+    hyperloglog_check_file_access(true);
+
+    /* error rate between 0 and 1 (not 0) */
+    if ((errorRate <= 0) || (errorRate > 1))
+        elog(ERROR, "error rate has to be between 0 and 1");
+
+    if (capacity < 1)
+        elog(ERROR, "capacity of the store has to be at least 1");
+
+    /* if we have the file mapped, it's being replaced */
+    if ((store_cache.path != NULL) && (strcmp(store_cache.path, path) == 0))
+        hyperloglog_store_uncache();
+
+    hyperloglog_store_close(hyperloglog_store_create(path, errorRate, capacity, keysize));
+
+    PG_RETURN_VOID();
+
+}
+
+/* Merges a counter into the store, for the given key. */
+Datum
+hyperloglog_store_merge_counter(PG_FUNCTION_ARGS)
+{
+
+    char   *path = text_to_cstring(PG_GETARG_TEXT_PP(0));
+    text   *key = PG_GETARG_TEXT_PP(1);
+    HyperLogLogCounter counter = (HyperLogLogCounter) PG_GETARG_BYTEA_P(2);
+
+    hyperloglog_check_file_access(true);
+
+    hyperloglog_store_merge(hyperloglog_store_cached(path),
+                            VARDATA_ANY(key), VARSIZE_ANY_EXHDR(key), counter);
+
+    PG_RETURN_VOID();
+
+}
+
+/* Returns a copy of the counter for the key (NULL if there's no such key). */
+Datum
+hyperloglog_store_get_counter(PG_FUNCTION_ARGS)
+{
+
+    char   *path = text_to_cstring(PG_GETARG_TEXT_PP(0));
+    text   *key = PG_GETARG_TEXT_PP(1);
+    HyperLogLogCounter counter;
+
+    hyperloglog_check_file_access(false);
+
+    counter = hyperloglog_store_get(hyperloglog_store_cached(path),
+                                    VARDATA_ANY(key), VARSIZE_ANY_EXHDR(key));
+
+    if (counter == NULL)
+        PG_RETURN_NULL();
+
+    PG_RETURN_BYTEA_P(hyperloglog_copy(counter));
+
+}
+
+/* Estimate for the key, computed directly from the mapped counter. */
+Datum
+hyperloglog_store_get_estimate(PG_FUNCTION_ARGS)
+{
+
+    char   *path = text_to_cstring(PG_GETARG_TEXT_PP(0));
+    text   *key = PG_GETARG_TEXT_PP(1);
+    HyperLogLogCounter counter;
+
+    hyperloglog_check_file_access(false);
+
+    counter = hyperloglog_store_get(hyperloglog_store_cached(path),
+                                    VARDATA_ANY(key), VARSIZE_ANY_EXHDR(key));
+
+    if (counter == NULL)
+        PG_RETURN_NULL();
+
+    PG_RETURN_FLOAT4(hyperloglog_estimate(counter));
+
+}
+
+/* Returns all the (key, counter) pairs in the store. */
+Datum
+hyperloglog_store_entries(PG_FUNCTION_ARGS)
+{
+
+    char           *path = text_to_cstring(PG_GETARG_TEXT_PP(0));
+    ReturnSetInfo  *rsinfo = (ReturnSetInfo *) fcinfo->resultinfo;
+    TupleDesc       tupdesc;
+    Tuplestorestate *tupstore;
+    MemoryContext   oldcontext;
+    HyperLogLogStore store;
+    uint64          i;
+
+    hyperloglog_check_file_access(false);
+
+    if ((rsinfo == NULL) || ! IsA(rsinfo, ReturnSetInfo) ||
+        ! (rsinfo->allowedModes & SFRM_Materialize))
+        ereport(ERROR,
+                (errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+                 errmsg("set-valued function called in context that cannot accept a set")));
+
+    if (get_call_result_type(fcinfo, NULL, &tupdesc) != TYPEFUNC_COMPOSITE)
+        elog(ERROR, "return type must be a row type");
+
+    oldcontext = MemoryContextSwitchTo(rsinfo->econtext->ecxt_per_query_memory);
+
+    tupstore = tuplestore_begin_heap(true, false, work_mem);
+    rsinfo->returnMode = SFRM_Materialize;
+    rsinfo->setResult = tupstore;
+    rsinfo->setDesc = tupdesc;
+
+    MemoryContextSwitchTo(oldcontext);
+
+    store = hyperloglog_store_cached(path);
+
+    for (i = 0; i < store->header->capacity; i++) {
+
+        Datum       values[2];
+        bool        nulls[2] = {false, false};
+        const char *key;
+        int         keylen;
+        HyperLogLogCounter counter = hyperloglog_store_entry(store, i, &key, &keylen);
+
+        if (counter == NULL)
+            continue;
+
+        CHECK_FOR_INTERRUPTS();
+
+        values[0] = PointerGetDatum(cstring_to_text_with_len(key, keylen));
+        values[1] = PointerGetDatum(counter);
+
+        /* the tuple is formed right away, so the counter is copied from the mapping */
+        tuplestore_putvalues(tupstore, tupdesc, values, nulls);
+
+        pfree(DatumGetPointer(values[0]));
+    }
+
+    return (Datum) 0;
+
+}
+
+/* Returns the store for the path, reusing the mapping from the last call if
+ * it's still the same file. The store is always mapped read-write, so that
+ * it can be used for both reads and merges. */
+static HyperLogLogStore
+hyperloglog_store_cached(const char * path)
+{
+
+    struct stat     st;
+    MemoryContext   oldcontext;
+
+    if (stat(path, &st) != 0)
+        ereport(ERROR,
+                (errcode_for_file_access(),
+                 errmsg("could not stat store file \"%s\": %m", path)));
+
+    if ((store_cache.store != NULL) && (strcmp(store_cache.path, path) == 0) &&
+        (store_cache.dev == st.st_dev) && (store_cache.ino == st.st_ino))
+        return store_cache.store;
+
+    hyperloglog_store_uncache();
+
+    /* the cache has to survive the transaction */
+    oldcontext = MemoryContextSwitchTo(TopMemoryContext);
+
+    store_cache.store = hyperloglog_store_open(path, false);
+    store_cache.path = pstrdup(path);
+
+    MemoryContextSwitchTo(oldcontext);
+    store_cache.dev = st.st_dev;
+    store_cache.ino = st.st_ino;
+
+    return store_cache.store;
+
+}
+
+static void
+hyperloglog_store_uncache(void)
+{
+    if (store_cache.store == NULL)
+        return;
+
+    hyperloglog_store_close(store_cache.store);
+    pfree(store_cache.path);
+
+    store_cache.store = NULL;
+    store_cache.path = NULL;
+}
@@ -0,0 +1,251 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <math.h>
+#include <string.h>
+
+#include "postgres.h"
+#include "distinct_md5.h"
+
+#include "hyperloglog.h"
+
+/* we're using md5, which produces 16B (128-bit) values */
+#define HASH_LENGTH 16
+
+static void hyperloglog_window_insert(HyperLogLogWindowCounter counter, unsigned int idx, char rho, int32 timestamp);
+
+/* Allocate sliding-window HLL estimator with the desired precision, keeping
+ * 'nslots' (rho, timestamp) pairs for each bin.
+ *
+ * The number of bins is computed exactly as in hyperloglog_create, so the
+ * snapshots may be merged with regular counters created with the same error.
+ */
+HyperLogLogWindowCounter hyperloglog_window_create(float error, int nslots) {
+
+    float m;
+    size_t length = hyperloglog_window_get_size(error, nslots);
+
+    HyperLogLogWindowCounter p = (HyperLogLogWindowCounter)palloc(length);
+
+    m = 1.04 / (error * error);
+
+    p->b = (int)ceil(log2(m));
+
+    if (p->b < 4)   /* we want at least 2^4 (=16) bins */
+        p->b = 4;
+
+    p->m = (int)pow(2, p->b);
+    p->binbits = 8;
+    p->nslots = nslots;
+
+    /* zero timestamps and rho values (0 means 'empty slot') */
+    memset(p->data, 0, (sizeof(int32) + 1) * p->m * p->nslots);
+
+    SET_VARSIZE(p, length);
+
+    return p;
+
+}
+
+/* Computes size of the structure, depending on the requested error rate and
+ * number of slots for each bin. */
+int hyperloglog_window_get_size(float error, int nslots) {
+
+    int b;
+    float m;
+
+    if (error <= 0 || error >= 1)
+        elog(ERROR, "invalid error rate requested");
+
+    if (nslots < 1)
+        elog(ERROR, "number of slots has to be at least 1");
+
+    m = 1.04 / (error * error);
+    b = (int)ceil(log2(m));
+
+    if (b < 4)
+        b = 4;
+    else if (b > 16)
+        elog(ERROR, "number of bits in HyperLogLog exceeds 16");
+
+    return offsetof(HyperLogLogWindowCounterData,data) + (sizeof(int32) + 1) * (int)pow(2, b) * nslots;
+
+}
+
+/* Counters may come from a table (or a cast from bytea), so before reading the
+ * slots make sure the header is consistent and the value is long enough to hold
+ * all of them (see hyperloglog_check_counter). */
+void hyperloglog_window_check_counter(HyperLogLogWindowCounter counter) {
+
+    if (VARSIZE(counter) < offsetof(HyperLogLogWindowCounterData, data) ||
+        counter->b < 4 || counter->b > 16 || counter->m != (1 << counter->b) ||
+        counter->nslots < 1 ||
+        VARSIZE(counter) < offsetof(HyperLogLogWindowCounterData, data) +
+                           (int64) (sizeof(int32) + 1) * counter->m * counter->nslots)
+        elog(ERROR, "invalid HyperLogLog window counter (length %d)", (int) VARSIZE(counter));
+
+}
+
+HyperLogLogWindowCounter hyperloglog_window_copy(HyperLogLogWindowCounter counter) {
+
+    size_t length = VARSIZE(counter);
+    HyperLogLogWindowCounter copy = (HyperLogLogWindowCounter)palloc(length);
+
+    memcpy(copy, counter, length);
+
+    return copy;
+
+}
+
+/* Merges the two estimators, by inserting all the pairs from the second counter
+ * into the first one (so that only the non-dominated pairs survive). Only counters
+ * with the same number of bins and slots may be merged. */
+HyperLogLogWindowCounter hyperloglog_window_merge(HyperLogLogWindowCounter counter1, HyperLogLogWindowCounter counter2, bool inplace) {
+
+    int i, j;
+    HyperLogLogWindowCounter result;
+    int32 * times;
+    char  * rhos;
+
+    /* check compatibility first */
+    if (counter1->length != counter2->length)
+        elog(ERROR, "sizes of estimators differs (%d != %d)", counter1->length, counter2->length);
+    else if (counter1->b != counter2->b)
+        elog(ERROR, "index size of estimators differs (%d != %d)", counter1->b, counter2->b);
+    else if (counter1->nslots != counter2->nslots)
+        elog(ERROR, "slot count of estimators differs (%d != %d)", counter1->nslots, counter2->nslots);
+
+    if (! inplace)
+        result = hyperloglog_window_copy(counter1);
+    else
+        result = counter1;
+
+    times = HLLW_TIMES(counter2);
+    rhos  = HLLW_RHOS(counter2);
+
+    for (i = 0; i < counter2->m; i++)
+        for (j = 0; j < counter2->nslots; j++)
+            if (rhos[i * counter2->nslots + j] != 0)
+                hyperloglog_window_insert(result, i, rhos[i * counter2->nslots + j],
+                                          times[i * counter2->nslots + j]);
+
+    return result;
+
+}
+
+void hyperloglog_window_add_element(HyperLogLogWindowCounter counter, const char * element, int elen, int32 timestamp) {
+
+    /* get the hash */
+    unsigned char hash[HASH_LENGTH];
+
+    /* compute the hash */
+    distinct_md5(element, elen, hash);
+
+    /* add the hash to the estimator */
+    hyperloglog_window_add_hash(counter, hash, timestamp);
+
+}
+
+void hyperloglog_window_add_hash(HyperLogLogWindowCounter counter, const unsigned char * hash, int32 timestamp) {
+
+    unsigned int idx;
+    char rho;
+
+    /* the same bin / rho as for the regular counter */
+    hyperloglog_hash_bin(hash, counter->b, &idx, &rho);
+
+    hyperloglog_window_insert(counter, idx, rho, timestamp);
+
+}
+
+/* Inserts the (rho, timestamp) pair into the list for the bin. The pair is ignored
+ * if it's dominated by an existing pair (i.e. there's a pair with higher or equal
+ * rho that is not older), and existing pairs dominated by the new one are removed.
+ * If there's no free slot, the oldest pair is evicted. */
+static void
+hyperloglog_window_insert(HyperLogLogWindowCounter counter, unsigned int idx, char rho, int32 timestamp) {
+
+    int     i;
+    int     slot = -1;
+    int     oldest = -1;
+
+    int32 * times = HLLW_TIMES(counter) + idx * counter->nslots;
+    char  * rhos  = HLLW_RHOS(counter) + idx * counter->nslots;
+
+    /* is the new pair dominated by one of the existing pairs? */
+    for (i = 0; i < counter->nslots; i++)
+        if ((rhos[i] != 0) && (rhos[i] >= rho) && (times[i] >= timestamp))
+            return;
+
+    /* remove pairs dominated by the new one, and look for a free slot */
+    for (i = 0; i < counter->nslots; i++) {
+
+        if ((rhos[i] != 0) && (rhos[i] <= rho) && (times[i] <= timestamp))
+            rhos[i] = 0;
+
+        if (rhos[i] == 0) {
+            if (slot == -1)
+                slot = i;
+        } else if ((oldest == -1) || (times[i] < times[oldest]))
+            oldest = i;
+
+    }
+
+    /* no free slot, so evict the oldest pair */
+    if (slot == -1)
+        slot = oldest;
+
+    rhos[slot] = rho;
+    times[slot] = timestamp;
+
+}
+
+/* Builds a regular HLL counter for the window starting at 'since' (inclusive),
+ * i.e. for each bin keeps the highest 'rho' of pairs not older than 'since'. */
+HyperLogLogCounter hyperloglog_window_snapshot(HyperLogLogWindowCounter counter, int32 since) {
+
+    int i, j;
+    size_t length = offsetof(HyperLogLogCounterData,data) + counter->m;
+    HyperLogLogCounter result = (HyperLogLogCounter)palloc(length);
+
+    int32 * times = HLLW_TIMES(counter);
+    char  * rhos  = HLLW_RHOS(counter);
+
+    result->b = counter->b;
+    result->m = counter->m;
+    result->binbits = counter->binbits;
+
+    memset(result->data, 0, result->m);
+
+    for (i = 0; i < counter->m; i++) {
+        for (j = i * counter->nslots; j < (i+1) * counter->nslots; j++) {
+            if ((rhos[j] > result->data[i]) && (times[j] >= since))
+                result->data[i] = rhos[j];
+        }
+    }
+
+    SET_VARSIZE(result, length);
+
+    return result;
+
+}
+
+/* Computes the HLL estimate for the window starting at 'since' (and ending now). */
+int hyperloglog_window_estimate(HyperLogLogWindowCounter counter, int32 since) {
+
+    int estimate;
+    HyperLogLogCounter snapshot = hyperloglog_window_snapshot(counter, since);
+
+    estimate = hyperloglog_estimate(snapshot);
+
+    pfree(snapshot);
+
+    return estimate;
+
+}
+
+void hyperloglog_window_reset_internal(HyperLogLogWindowCounter counter) {
+
+    memset(counter->data, 0, (sizeof(int32) + 1) * counter->m * counter->nslots);
+
+}
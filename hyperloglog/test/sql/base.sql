@@ -3,7 +3,7 @@ BEGIN;
 
 -- disable the notices for the create script (shell types etc.)
 SET client_min_messages = 'WARNING';
-\i sql/hyperloglog_counter--1.2.6.sql
+\i sql/hyperloglog_counter--1.3.0.sql
 SET client_min_messages = 'NOTICE';
 
 \set ECHO all
@@ -12,6 +12,104 @@ SELECT hyperloglog_distinct(id, 0.02) BETWEEN 95000 AND 105000 val FROM generate
 
 SELECT hyperloglog_distinct(id::text, 0.02) BETWEEN 95000 AND 105000 val FROM generate_series(1,100000) s(id);
 
+SELECT hyperloglog_distinct(id::bigint, 0.02) BETWEEN 95000 AND 105000 val FROM generate_series(1,100000) s(id);
+
+SELECT hyperloglog_distinct(md5(id::text)::uuid, 0.02) BETWEEN 95000 AND 105000 val FROM generate_series(1,100000) s(id);
+
+SELECT hyperloglog_distinct((id % 30000)::smallint, 0.02) BETWEEN 28500 AND 31500 val FROM generate_series(1,100000) s(id);
+
+SELECT hyperloglog_distinct_hashed(id::bigint, 0.02) BETWEEN 95000 AND 105000 val FROM generate_series(1,100000) s(id);
+
+SELECT hyperloglog_distinct_hashed(uuid_send(md5(id::text)::uuid), 0.02) BETWEEN 95000 AND 105000 val FROM generate_series(1,100000) s(id);
+
+SELECT (# hyperloglog_accum(id::text, 0.02)) = hyperloglog_distinct(id::text, 0.02) val FROM generate_series(1,100000) s(id);
+
+SELECT (# hyperloglog_merge(a, b)) BETWEEN 95000 AND 105000 val FROM (SELECT hyperloglog_accum(id, 0.02) a FROM generate_series(1,50000) s(id)) x, (SELECT hyperloglog_accum(id, 0.02) b FROM generate_series(50001,100000) s(id)) y;
+
+SELECT hyperloglog_union_estimate(array_agg(c)) = (# hyperloglog_union(array_append(array_agg(c), NULL))) AND hyperloglog_union_estimate(array_agg(c)) = (# hyperloglog_merge(c)) AND hyperloglog_union_estimate(array_agg(c)) BETWEEN 95000 AND 105000 val FROM (SELECT hyperloglog_accum(id, 0.02) c FROM generate_series(1,100000) s(id) GROUP BY id % 10) foo;
+
+SELECT count(*) = 10 AND bool_and((# r.counter) = hyperloglog_union_estimate(a[greatest(1, r.idx - 2):r.idx])) AND bool_and(r.idx < 3 OR (# r.counter) BETWEEN 28500 AND 31500) val FROM (SELECT array_agg(c ORDER BY d) a FROM (SELECT id / 10000 d, hyperloglog_accum(id, 0.02) c FROM generate_series(0,99999) s(id) GROUP BY 1) x) y, hyperloglog_rolling_union(a, 3) r;
+
+SELECT (# hyperloglog_from_loglog(substring(c::text::bytea from 1 for 8) || substring(c::text::bytea from 13 for 4096))) = (# c) val FROM (SELECT hyperloglog_accum(id, 0.02) c FROM generate_series(1,100000) s(id)) foo;
+
+SELECT hyperloglog_window_get_estimate(hyperloglog_window_accum(id, now() - (id % 100) * interval '1 minute', 0.02, 8), interval '1 day') BETWEEN 95000 AND 105000 val FROM generate_series(1,100000) s(id);
+
+SELECT hyperloglog_window_get_estimate(hyperloglog_window_accum(id, now() - (id % 100) * interval '1 minute', 0.02, 8), interval '30 minutes') BETWEEN 29000 AND 33000 val FROM generate_series(1,100000) s(id);
+
+CREATE TABLE hll_analyze_test AS SELECT i AS a, i % 100 AS b FROM generate_series(1,100000) s(i);
+
+SELECT attname, (CASE WHEN attname = 'a' THEN n_distinct BETWEEN -1 AND -0.95 ELSE n_distinct BETWEEN 95 AND 105 END) AS val FROM hyperloglog_analyze('hll_analyze_test');
+
+CREATE TABLE hll_brin_test AS SELECT i AS ts, i % 20000 AS id FROM generate_series(1,100000) s(i);
+CREATE INDEX hll_brin_test_idx ON hll_brin_test USING brin (ts, id hyperloglog_int4_ops) WITH (pages_per_range = 4);
+INSERT INTO hll_brin_test SELECT i, i % 30000 FROM generate_series(100001,110000) s(i);
+SELECT (# hyperloglog_brin_union('hll_brin_test_idx', 'id', 'ts', 10000, 105000)) = (SELECT # hyperloglog_accum(id, 0.05) FROM hll_brin_test WHERE ts BETWEEN 10000 AND 105000) val;
+
+CREATE TABLE hll_rollup_src AS SELECT i AS id, i % 7 AS dim, i % 5000 AS item FROM generate_series(1,50000) s(i);
+CREATE TABLE hll_rollup (dim int PRIMARY KEY, counter hyperloglog_estimator);
+SELECT hyperloglog_rollup_refresh('hll_rollup', 'counter', 'hll_rollup_src', 'id', 'item', ARRAY['dim']) = 7 val;
+INSERT INTO hll_rollup_src SELECT i, i % 9, i % 5000 + 10000 FROM generate_series(50001,60000) s(i);
+SELECT hyperloglog_rollup_refresh('hll_rollup', 'counter', 'hll_rollup_src', 'id', 'item', ARRAY['dim']) = 9 val;
+SELECT hyperloglog_rollup_refresh('hll_rollup', 'counter', 'hll_rollup_src', 'id', 'item', ARRAY['dim']) = 0 val;
+SELECT count(*) = 9 AND bool_and((# r.counter) = (# s.counter)) val FROM hll_rollup r JOIN (SELECT dim, hyperloglog_accum(item) counter FROM hll_rollup_src GROUP BY dim) s USING (dim);
+CREATE TABLE hll_rollup_ts_src AS SELECT timestamptz '2024-01-01 00:00:00+00' + i * interval '1 second' AS ts, i % 3 AS dim, i AS item FROM generate_series(1,1000) s(i);
+CREATE TABLE hll_rollup_ts (dim int PRIMARY KEY, counter hyperloglog_estimator);
+SET TimeZone = 'America/New_York';
+SET DateStyle = 'SQL, DMY';
+SELECT hyperloglog_rollup_refresh('hll_rollup_ts', 'counter', 'hll_rollup_ts_src', 'ts', 'item', ARRAY['dim']) = 3 val;
+SET TimeZone = 'Asia/Tokyo';
+SET DateStyle = 'German';
+SELECT hyperloglog_rollup_refresh('hll_rollup_ts', 'counter', 'hll_rollup_ts_src', 'ts', 'item', ARRAY['dim']) = 0 val;
+INSERT INTO hll_rollup_ts_src SELECT timestamptz '2024-01-01 00:00:00+00' + i * interval '1 second', 3, i FROM generate_series(1001,1100) s(i);
+SET search_path = pg_catalog;
+SELECT public.hyperloglog_rollup_refresh('public.hll_rollup_ts', 'counter', 'public.hll_rollup_ts_src', 'ts', 'item', ARRAY['dim']) = 1 val;
+RESET search_path;
+RESET TimeZone;
+RESET DateStyle;
+SELECT watermark = '2024-01-01 00:18:20+00' val FROM hyperloglog_rollup_watermarks WHERE rollup_table = 'hll_rollup_ts'::regclass;
+
+SET hyperloglog.rewrite_count_distinct = on;
+SELECT count(DISTINCT id) = 100000 val FROM generate_series(1,100000) s(id);
+SET client_min_messages = 'WARNING';
+CREATE SCHEMA hll_rewrite;
+CREATE EXTENSION hyperloglog_counter SCHEMA hll_rewrite;
+SET client_min_messages = 'NOTICE';
+SELECT count(DISTINCT id) <> 100000 AND count(DISTINCT id) BETWEEN 95000 AND 105000 val FROM generate_series(1,100000) s(id);
+EXPLAIN (COSTS OFF, VERBOSE) SELECT count(DISTINCT id) FROM generate_series(1,100000) s(id);
+CREATE TEMP TABLE hll_rewrite_ctas AS SELECT count(DISTINCT id) c FROM generate_series(1,100000) s(id);
+SELECT c <> 100000 AND c BETWEEN 95000 AND 105000 val FROM hll_rewrite_ctas;
+DECLARE hll_rewrite_cursor CURSOR FOR SELECT count(DISTINCT id) <> 100000 AND count(DISTINCT id) BETWEEN 95000 AND 105000 val FROM generate_series(1,100000) s(id);
+FETCH hll_rewrite_cursor;
+CLOSE hll_rewrite_cursor;
+RESET hyperloglog.rewrite_count_distinct;
+
+SET hyperloglog.track_stats = on;
+SELECT hyperloglog_estimator_stats_reset();
+SELECT hyperloglog_distinct(id::text, 0.02) BETWEEN 95000 AND 105000 val FROM generate_series(1,100000) s(id);
+SELECT elements = 100000 AND hashes = 100000 AND updates BETWEEN 1 AND 100000 AND merges = 0 AND allocated > 0 val FROM hyperloglog_estimator_stats();
+RESET hyperloglog.track_stats;
+
+SELECT e = (SELECT hyperloglog_distinct(id, 0.05) FROM generate_series(1,10000) s(id)) val FROM (SELECT id, hyperloglog_distinct(id, 0.05) OVER (ORDER BY id) e FROM generate_series(1,10000) s(id)) foo ORDER BY id DESC LIMIT 1;
+
+SELECT hyperloglog_distinct_multi(id % 1000, id % 99) BETWEEN 94000 AND 104000 val FROM generate_series(1,100000) s(id);
+
+SELECT hyperloglog_distinct_multi(id % 1000, id % 99) / hyperloglog_distinct((id % 1000, id % 99)::text) BETWEEN 0.95 AND 1.05 val FROM generate_series(1,100000) s(id);
+
+SELECT (# hyperloglog_accum_multi(id, CASE WHEN id % 2 = 0 THEN id END)) = hyperloglog_distinct_multi(id, id) FILTER (WHERE id % 2 = 0) val FROM generate_series(1,100000) s(id);
+
+SELECT hyperloglog_distinct_multi(a, b) BETWEEN 178000 AND 198000 val FROM (SELECT id % 1000, id % 99 FROM generate_series(1,100000) s(id) UNION ALL SELECT id % 99, id % 1000 FROM generate_series(1,100000) s(id)) foo(a, b);
+
+-- truncated counters
+SAVEPOINT s;
+SELECT # (substring(hyperloglog_init(0.02)::text from 1 for 100))::hyperloglog_estimator;
+ROLLBACK TO s;
+SELECT hyperloglog_merge(hyperloglog_init(0.02), (substring(hyperloglog_init(0.02)::text from 1 for 100))::hyperloglog_estimator);
+ROLLBACK TO s;
+SELECT hyperloglog_window_get_estimate((substring(hyperloglog_window_init(0.02, 8)::text from 1 for 100))::hyperloglog_window_estimator, interval '1 day');
+ROLLBACK TO s;
+SELECT hyperloglog_window_merge(hyperloglog_window_init(0.02, 8), (substring(hyperloglog_window_init(0.02, 8)::text from 1 for 100))::hyperloglog_window_estimator);
+ROLLBACK TO s;
+
 DO LANGUAGE plpgsql $$
 DECLARE
     v_counter  hyperloglog_estimator := hyperloglog_init(0.02);
@@ -0,0 +1,23 @@
+\set ECHO none
+BEGIN;
+
+-- disable the notices for the create script (shell types etc.)
+SET client_min_messages = 'WARNING';
+\i sql/hyperloglog_counter--1.3.0.sql
+SET client_min_messages = 'NOTICE';
+
+\set ECHO all
+
+-- relative paths are in the data directory (for both COPY and hyperloglog_from_file)
+COPY (SELECT id, 'value ' || id FROM generate_series(1,10000) s(id)) TO 'regress_hll_file.csv' (FORMAT csv);
+
+SELECT hyperloglog_get_estimate(hyperloglog_from_file('regress_hll_file.csv', 1)) = (SELECT hyperloglog_get_estimate(hyperloglog_accum(id::text)) FROM generate_series(1,10000) s(id)) val;
+
+SELECT hyperloglog_get_estimate(hyperloglog_from_file('regress_hll_file.csv', 2)) = (SELECT hyperloglog_get_estimate(hyperloglog_accum('value ' || id)) FROM generate_series(1,10000) s(id)) val;
+
+-- a quoted value spanning two lines, and a quote not terminated at the end of the file
+COPY (VALUES ('1,"a'), ('b"'), ('2,"c')) TO 'regress_hll_quote.csv';
+
+SELECT hyperloglog_from_file('regress_hll_quote.csv', 2) IS NOT NULL val;
+
+ROLLBACK;
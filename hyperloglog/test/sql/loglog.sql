@@ -0,0 +1,26 @@
+\set ECHO none
+BEGIN;
+
+-- disable the notices for the create script (shell types etc.)
+SET client_min_messages = 'WARNING';
+\i sql/hyperloglog_counter--1.3.0.sql
+\i ../loglog/sql/loglog_counter--1.3.0.sql
+\i ../superloglog/sql/superloglog_counter--1.3.0.sql
+SET client_min_messages = 'NOTICE';
+
+\set ECHO all
+
+-- conversion of LogLog / SuperLogLog estimators (needs the loglog_counter and
+-- superloglog_counter libraries installed too), the bins are the same
+SELECT (# loglog_to_hyperloglog(loglog_accum(id, 0.02))) = (# hyperloglog_accum(id, 0.02)) val FROM generate_series(1,100000) s(id);
+
+SELECT (# superloglog_to_hyperloglog(superloglog_accum(id, 0.02))) = (# hyperloglog_accum(id, 0.02)) val FROM generate_series(1,100000) s(id);
+
+SELECT (# hyperloglog_merge(loglog_to_hyperloglog(a), b)) = (SELECT # hyperloglog_accum(id, 0.02) FROM generate_series(1,100000) s(id)) val FROM (SELECT loglog_accum(id, 0.02) a FROM generate_series(1,50000) s(id)) x, (SELECT hyperloglog_accum(id, 0.02) b FROM generate_series(50001,100000) s(id)) y;
+
+-- other types are rejected
+SAVEPOINT s;
+SELECT loglog_to_hyperloglog(hyperloglog_init(0.02));
+ROLLBACK TO s;
+
+ROLLBACK;
@@ -0,0 +1,41 @@
+\set ECHO none
+BEGIN;
+
+-- disable the notices for the create script (shell types etc.)
+SET client_min_messages = 'WARNING';
+\i sql/hyperloglog_counter--1.3.0.sql
+SET client_min_messages = 'NOTICE';
+
+\set ECHO all
+
+-- the shared counters require hyperloglog_counter in shared_preload_libraries
+-- (shared_1.out is the output without it), and the counters can't be dropped,
+-- so start by resetting the counter (possibly left by a previous run)
+SELECT count(hyperloglog_shared_reset('regress_shared')) val;
+
+SELECT count(hyperloglog_shared_add_item('regress_shared', id)) val FROM generate_series(1,100000) s(id);
+
+SELECT hyperloglog_shared_get_estimate('regress_shared') BETWEEN 95000 AND 105000 val;
+
+SELECT hyperloglog_shared_get_estimate('regress_shared') = (SELECT hyperloglog_get_estimate(hyperloglog_accum(id, 0.025)) FROM generate_series(1,100000) s(id)) val;
+
+SELECT hyperloglog_get_estimate(hyperloglog_shared_snapshot('regress_shared')) = hyperloglog_shared_get_estimate('regress_shared') val;
+
+SELECT count(hyperloglog_shared_merge('regress_shared', c)) val FROM (SELECT hyperloglog_accum(id, 0.025) c FROM generate_series(50001,150000) s(id)) foo;
+
+SELECT hyperloglog_shared_get_estimate('regress_shared') = (SELECT hyperloglog_get_estimate(hyperloglog_accum(id, 0.025)) FROM generate_series(1,150000) s(id)) val;
+
+SELECT count(hyperloglog_shared_reset('regress_shared')) val;
+
+SELECT hyperloglog_shared_get_estimate('regress_shared') val;
+
+SELECT hyperloglog_shared_get_estimate('regress_shared_missing') IS NULL val;
+
+-- counters of a different size, and truncated counters
+SAVEPOINT s;
+SELECT hyperloglog_shared_merge('regress_shared', hyperloglog_init(0.01));
+ROLLBACK TO s;
+SELECT hyperloglog_shared_merge('regress_shared', (substring(hyperloglog_init(0.025)::text from 1 for 100))::hyperloglog_estimator);
+ROLLBACK TO s;
+
+ROLLBACK;
@@ -0,0 +1,31 @@
+\set ECHO none
+BEGIN;
+
+-- disable the notices for the create script (shell types etc.)
+SET client_min_messages = 'WARNING';
+\i sql/hyperloglog_counter--1.3.0.sql
+SET client_min_messages = 'NOTICE';
+
+\set ECHO all
+
+-- relative paths are in the data directory, and an existing store can't be
+-- created again (nor dropped), so use a new file for each run
+SELECT 'regress_hll_store_' || md5(random()::text || clock_timestamp()::text) AS store \gset
+
+SELECT count(hyperloglog_store_create(:'store', 0.025, 100, 16)) val;
+
+SELECT count(hyperloglog_store_merge(:'store', k, c)) val FROM (SELECT 'key' || (id % 10) k, hyperloglog_accum(id) c FROM generate_series(1,10000) s(id) GROUP BY 1) foo;
+
+SELECT count(hyperloglog_store_merge(:'store', k, c)) val FROM (SELECT 'key' || (id % 10) k, hyperloglog_accum(id) c FROM generate_series(5001,15000) s(id) GROUP BY 1) foo;
+
+SELECT count(*) val FROM hyperloglog_store_entries(:'store');
+
+SELECT hyperloglog_store_get_estimate(:'store', 'key1') = (SELECT hyperloglog_get_estimate(hyperloglog_accum(id)) FROM generate_series(1,15000) s(id) WHERE id % 10 = 1) val;
+
+SELECT hyperloglog_get_estimate(hyperloglog_store_get(:'store', 'key1')) = hyperloglog_store_get_estimate(:'store', 'key1') val;
+
+SELECT hyperloglog_get_estimate(hyperloglog_merge(counter)) = (SELECT hyperloglog_get_estimate(hyperloglog_accum(id)) FROM generate_series(1,15000) s(id)) val FROM hyperloglog_store_entries(:'store');
+
+SELECT hyperloglog_store_get(:'store', 'missing') IS NULL AND hyperloglog_store_get_estimate(:'store', 'missing') IS NULL val;
+
+ROLLBACK;
@@ -0,0 +1,837 @@
+/* Public API of libdistinct (see distinct.h), mapping the calls to the
+ * estimators compiled from the extension sources.
+ *
+ * Each entry point calling into the estimators is wrapped in SHIM_TRY, so
+ * that elog(ERROR) in the estimator code returns an error from the entry
+ * point instead of terminating the process. Memory allocated before the
+ * error is not released (there are no memory contexts), but the errors are
+ * only possible for invalid parameters or counters, or out-of-memory.
+ */
+#include "shim.h"
+#include "distinct_md5.h"
+#include "distinct_probes.h"
+
+#include "hyperloglog.h"
+#include "adaptive.h"
+#include "bitmap.h"
+#include "loglog.h"
+#include "pcsa.h"
+#include "probabilistic.h"
+#include "superloglog.h"
+
+#include "distinct.h"
+
+/* defaults of the one-argument aggregates (e.g. hyperloglog_distinct) */
+#define DEFAULT_ERROR               0.025
+#define DEFAULT_NDISTINCT           1000000
+#define DEFAULT_NDISTINCT_HLL       1000000000
+#define DEFAULT_NBITMAPS            64
+#define DEFAULT_KEYSIZE             4
+#define DEFAULT_NBYTES              4
+#define DEFAULT_NSALTS              32
+
+/* limits, as checked by pcsa_init / probabilistic_init */
+#define MAX_KEYSIZE                 4
+#define MAX_BITMAPS                 2048
+#define MAX_NBYTES                  16
+#define MAX_NSALTS                  1024
+
+struct distinct_counter {
+    distinct_type   type;
+    void           *data;       /* the varlena counter, as in the database */
+};
+
+static const char *type_names[] = {
+    NULL,
+    "hyperloglog",
+    "adaptive",
+    "bitmap",
+    "loglog",
+    "pcsa",
+    "probabilistic",
+    "superloglog"
+};
+
+static distinct_counter *counter_wrap(distinct_type type, void *data);
+static bool counter_valid(const distinct_counter *counter);
+
+int
+distinct_abi_version(void)
+{
+    return DISTINCT_ABI_VERSION;
+}
+
+void
+distinct_set_allocator(distinct_malloc_fn malloc_fn, distinct_realloc_fn realloc_fn,
+                       distinct_free_fn free_fn)
+{
+    shim_malloc = (malloc_fn != NULL) ? malloc_fn : malloc;
+    shim_realloc = (realloc_fn != NULL) ? realloc_fn : realloc;
+    shim_free = (free_fn != NULL) ? free_fn : free;
+}
+
+void
+distinct_set_error_handler(distinct_error_fn handler, void *arg)
+{
+    shim_error_handler = handler;
+    shim_error_arg = arg;
+}
+
+const char *
+distinct_last_error(void)
+{
+    return shim_error_message;
+}
+
+distinct_type
+distinct_type_lookup(const char *name)
+{
+    int     i;
+
+    for (i = DISTINCT_HYPERLOGLOG; i <= DISTINCT_SUPERLOGLOG; i++)
+        if (strcmp(type_names[i], name) == 0)
+            return (distinct_type) i;
+
+    return (distinct_type) 0;
+}
+
+const char *
+distinct_type_name(distinct_type type)
+{
+    if ((type < DISTINCT_HYPERLOGLOG) || (type > DISTINCT_SUPERLOGLOG))
+        return NULL;
+
+    return type_names[type];
+}
+
+int
+distinct_type_mergeable(distinct_type type)
+{
+    /* the self-learning bitmap depends on the order of items */
+    return (type != DISTINCT_BITMAP);
+}
+
+distinct_counter *
+distinct_create(distinct_type type, double error, int64_t ndistinct)
+{
+
+    void   *data = NULL;
+
+    SHIM_TRY(NULL);
+
+    if (error <= 0)
+        error = DEFAULT_ERROR;
+
+    if (ndistinct <= 0)
+        ndistinct = (type == DISTINCT_HYPERLOGLOG) ? DEFAULT_NDISTINCT_HLL : DEFAULT_NDISTINCT;
+
+    if (error > 1)
+        elog(ERROR, "error rate has to be between 0 and 1");
+
+    switch (type) {
+        case DISTINCT_HYPERLOGLOG:
+            data = hyperloglog_create(ndistinct, error);
+            break;
+        case DISTINCT_ADAPTIVE:
+            data = ac_init(error, (int) Min(ndistinct, INT32_MAX));
+            break;
+        case DISTINCT_BITMAP:
+            data = bc_init(error, (int) Min(ndistinct, INT32_MAX));
+            break;
+        case DISTINCT_LOGLOG:
+            data = loglog_create(error);
+            break;
+        case DISTINCT_PCSA:
+            data = pcsa_create(DEFAULT_NBITMAPS, DEFAULT_KEYSIZE, PCSA_DEFAULT_WIDTH);
+            break;
+        case DISTINCT_PROBABILISTIC:
+            data = pc_create(DEFAULT_NBYTES, DEFAULT_NSALTS);
+            break;
+        case DISTINCT_SUPERLOGLOG:
+            data = superloglog_create(error);
+            break;
+        default:
+            elog(ERROR, "unknown estimator type %d", (int) type);
+    }
+
+    SHIM_END();
+
+    return counter_wrap(type, data);
+
+}
+
+distinct_counter *
+distinct_create_pcsa(int nmaps, int keysize)
+{
+
+    void   *data;
+
+    SHIM_TRY(NULL);
+
+    if ((keysize < 1) || (keysize > MAX_KEYSIZE))
+        elog(ERROR, "key size has to be between 1 and %d", MAX_KEYSIZE);
+    else if ((nmaps < 1) || (nmaps > MAX_BITMAPS))
+        elog(ERROR, "number of bitmaps has to be between 1 and %d", MAX_BITMAPS);
+
+    data = pcsa_create(nmaps, keysize, PCSA_DEFAULT_WIDTH);
+
+    SHIM_END();
+
+    return counter_wrap(DISTINCT_PCSA, data);
+
+}
+
+distinct_counter *
+distinct_create_probabilistic(int nbytes, int nsalts)
+{
+
+    void   *data;
+
+    SHIM_TRY(NULL);
+
+    if ((nbytes < 1) || (nbytes > MAX_NBYTES))
+        elog(ERROR, "number of bytes per bitmap has to be between 1 and %d", MAX_NBYTES);
+    else if ((nsalts < 1) || (nsalts > MAX_NSALTS))
+        elog(ERROR, "number salts has to be between 1 and %d", MAX_NSALTS);
+
+    data = pc_create(nbytes, nsalts);
+
+    SHIM_END();
+
+    return counter_wrap(DISTINCT_PROBABILISTIC, data);
+
+}
+
+distinct_counter *
+distinct_load(distinct_type type, const void *data, size_t len)
+{
+
+    void               *copy;
+    distinct_counter    loaded;
+
+    SHIM_TRY(NULL);
+
+    if (distinct_type_name(type) == NULL)
+        elog(ERROR, "unknown estimator type %d", (int) type);
+
+    /* the data has to contain at least the header fields (checked again for
+     * each type once the counter is loaded, see counter_valid) */
+    if ((len < 2 * sizeof(int32)) || (len > 0x3FFFFFFF - VARHDRSZ))
+        elog(ERROR, "invalid length of serialized counter (%zu bytes)", len);
+
+    copy = palloc(len + VARHDRSZ);
+
+    memcpy(VARDATA(copy), data, len);
+    SET_VARSIZE(copy, len + VARHDRSZ);
+
+    /* pcsa counters from older versions are converted to the current format */
+    if ((type == DISTINCT_PCSA) && (len >= offsetof(PCSACounterData, bitmap) - VARHDRSZ)) {
+        void   *upgraded = pcsa_upgrade(copy);
+
+        if (upgraded != copy) {
+            pfree(copy);
+            copy = upgraded;
+        }
+    }
+
+    /* the same for probabilistic counters (with nbytes not dividing 16) */
+    if ((type == DISTINCT_PROBABILISTIC) && (len >= offsetof(ProbabilisticCounterData, bitmap) - VARHDRSZ)) {
+        void   *upgraded = pc_upgrade(copy);
+
+        if (upgraded != copy) {
+            pfree(copy);
+            copy = upgraded;
+        }
+    }
+
+    loaded.type = type;
+    loaded.data = copy;
+
+    if (! counter_valid(&loaded)) {
+        pfree(copy);
+        elog(ERROR, "invalid serialized %s counter (%zu bytes)", type_names[type], len);
+    }
+
+    SHIM_END();
+
+    return counter_wrap(type, copy);
+
+}
+
+distinct_counter *
+distinct_copy(const distinct_counter *counter)
+{
+
+    void   *copy;
+
+    SHIM_TRY(NULL);
+
+    if (! counter_valid(counter))
+        elog(ERROR, "invalid counter");
+
+    copy = palloc(VARSIZE(counter->data));
+    memcpy(copy, counter->data, VARSIZE(counter->data));
+
+    SHIM_END();
+
+    return counter_wrap(counter->type, copy);
+
+}
+
+void
+distinct_free(distinct_counter *counter)
+{
+    if (counter == NULL)
+        return;
+
+    pfree(counter->data);
+    pfree(counter);
+}
+
+distinct_type
+distinct_counter_type(const distinct_counter *counter)
+{
+    return counter->type;
+}
+
+int
+distinct_add(distinct_counter *counter, const void *value, size_t len)
+{
+
+    SHIM_TRY(-1);
+
+    if (! counter_valid(counter))
+        elog(ERROR, "invalid counter");
+
+    if (len > INT32_MAX)
+        elog(ERROR, "value too long (%zu bytes)", len);
+
+    switch (counter->type) {
+        case DISTINCT_HYPERLOGLOG:
+            hyperloglog_add_element(counter->data, value, (int) len);
+            break;
+        case DISTINCT_ADAPTIVE:
+            ac_add_item(counter->data, value, (int) len);
+            break;
+        case DISTINCT_BITMAP:
+            bc_add_item(counter->data, value, (int) len);
+            break;
+        case DISTINCT_LOGLOG:
+            loglog_add_element(counter->data, value, (int) len);
+            break;
+        case DISTINCT_PCSA:
+            pcsa_add_element(counter->data, value, (int) len);
+            break;
+        case DISTINCT_PROBABILISTIC:
+            pc_add_element(counter->data, (char *) value, (int) len);
+            break;
+        case DISTINCT_SUPERLOGLOG:
+            superloglog_add_element(counter->data, value, (int) len);
+            break;
+    }
+
+    SHIM_END();
+
+    return 0;
+
+}
+
+int
+distinct_add_hash(distinct_counter *counter, const unsigned char *hash)
+{
+
+    SHIM_TRY(-1);
+
+    if (! counter_valid(counter))
+        elog(ERROR, "invalid counter");
+
+    switch (counter->type) {
+        case DISTINCT_HYPERLOGLOG:
+            hyperloglog_add_hash(counter->data, hash);
+            break;
+        case DISTINCT_ADAPTIVE:
+            ac_add_hash(counter->data, (unsigned char *) hash);
+            break;
+        case DISTINCT_BITMAP:
+            bc_add_hash(counter->data, hash, DISTINCT_HASH_LENGTH);
+            break;
+        case DISTINCT_LOGLOG:
+            loglog_add_hash(counter->data, hash);
+            break;
+        case DISTINCT_PCSA:
+            pcsa_add_hash(counter->data, hash);
+            break;
+        case DISTINCT_PROBABILISTIC:
+            /* uses multiple salted hashes for each value */
+            elog(ERROR, "probabilistic counters don't support adding hashes");
+            break;
+        case DISTINCT_SUPERLOGLOG:
+            superloglog_add_hash(counter->data, hash);
+            break;
+    }
+
+    SHIM_END();
+
+    return 0;
+
+}
+
+int
+distinct_add_hashes(distinct_counter *counter, const unsigned char *hashes, size_t nhashes)
+{
+
+    size_t  i;
+
+    SHIM_TRY(-1);
+
+    if (! counter_valid(counter))
+        elog(ERROR, "invalid counter");
+
+    if (nhashes > INT32_MAX)
+        elog(ERROR, "too many hashes (%zu)", nhashes);
+
+    DISTINCT_BATCH_START(counter->type, nhashes);
+
+    /* only some counters prefetch the bins, the rest adds the hashes one by one */
+    switch (counter->type) {
+        case DISTINCT_HYPERLOGLOG:
+            hyperloglog_add_hashes(counter->data, hashes, (int) nhashes);
+            break;
+        case DISTINCT_ADAPTIVE:
+            for (i = 0; i < nhashes; i++)
+                ac_add_hash(counter->data, (unsigned char *) hashes + i * DISTINCT_HASH_LENGTH);
+            break;
+        case DISTINCT_BITMAP:
+            for (i = 0; i < nhashes; i++)
+                bc_add_hash(counter->data, hashes + i * DISTINCT_HASH_LENGTH, DISTINCT_HASH_LENGTH);
+            break;
+        case DISTINCT_LOGLOG:
+            for (i = 0; i < nhashes; i++)
+                loglog_add_hash(counter->data, hashes + i * DISTINCT_HASH_LENGTH);
+            break;
+        case DISTINCT_PCSA:
+            pcsa_add_hashes(counter->data, hashes, (int) nhashes);
+            break;
+        case DISTINCT_PROBABILISTIC:
+            /* uses multiple salted hashes for each value */
+            elog(ERROR, "probabilistic counters don't support adding hashes");
+            break;
+        case DISTINCT_SUPERLOGLOG:
+            for (i = 0; i < nhashes; i++)
+                superloglog_add_hash(counter->data, hashes + i * DISTINCT_HASH_LENGTH);
+            break;
+    }
+
+    DISTINCT_BATCH_DONE(counter->type, nhashes);
+
+    SHIM_END();
+
+    return 0;
+
+}
+
+void
+distinct_hash(const void *value, size_t len, unsigned char *hash)
+{
+    distinct_md5(value, len, hash);
+}
+
+int
+distinct_merge(distinct_counter *dest, const distinct_counter *src)
+{
+
+    void   *result = NULL;
+
+    SHIM_TRY(-1);
+
+    if (! counter_valid(dest) || ! counter_valid(src))
+        elog(ERROR, "invalid counter");
+
+    if (dest->type != src->type)
+        elog(ERROR, "can't merge counters of different types (%s, %s)",
+             type_names[dest->type], type_names[src->type]);
+
+    switch (dest->type) {
+        case DISTINCT_HYPERLOGLOG:
+            result = hyperloglog_merge(dest->data, src->data, true);
+            break;
+        case DISTINCT_ADAPTIVE:
+        {
+            /* ac_merge may swap the counters (and modify the source) */
+            AdaptiveCounter copy = ac_copy(src->data);
+
+            result = ac_merge(dest->data, copy, true);
+
+            if (result == copy)
+                pfree(dest->data);
+            else
+                pfree(copy);
+
+            break;
+        }
+        case DISTINCT_BITMAP:
+            elog(ERROR, "bitmap counters can't be merged");
+            break;
+        case DISTINCT_LOGLOG:
+            result = loglog_merge(dest->data, src->data, true);
+            break;
+        case DISTINCT_PCSA:
+            result = pcsa_merge(dest->data, src->data, true);
+            break;
+        case DISTINCT_PROBABILISTIC:
+            result = pc_merge(dest->data, src->data, true);
+            break;
+        case DISTINCT_SUPERLOGLOG:
+            result = superloglog_merge(dest->data, src->data, true);
+            break;
+    }
+
+    dest->data = result;
+
+    SHIM_END();
+
+    return 0;
+
+}
+
+int64_t
+distinct_estimate(const distinct_counter *counter)
+{
+
+    int     estimate = 0;
+
+    SHIM_TRY(-1);
+
+    if (! counter_valid(counter))
+        elog(ERROR, "invalid counter");
+
+    switch (counter->type) {
+        case DISTINCT_HYPERLOGLOG:
+            estimate = hyperloglog_estimate(counter->data);
+            break;
+        case DISTINCT_ADAPTIVE:
+            estimate = ac_estimate(counter->data);
+            break;
+        case DISTINCT_BITMAP:
+            estimate = bc_estimate(counter->data);
+            break;
+        case DISTINCT_LOGLOG:
+            estimate = loglog_estimate(counter->data);
+            break;
+        case DISTINCT_PCSA:
+            estimate = pcsa_estimate(counter->data);
+            break;
+        case DISTINCT_PROBABILISTIC:
+            estimate = pc_estimate(counter->data);
+            break;
+        case DISTINCT_SUPERLOGLOG:
+            estimate = superloglog_estimate(counter->data);
+            break;
+    }
+
+    SHIM_END();
+
+    return estimate;
+
+}
+
+const void *
+distinct_data(const distinct_counter *counter, size_t *len)
+{
+    *len = VARSIZE(counter->data) - VARHDRSZ;
+
+    return VARDATA(counter->data);
+}
+
+/* Wraps the varlena counter into the opaque struct (NULL stays NULL). */
+static distinct_counter *
+counter_wrap(distinct_type type, void *data)
+{
+
+    distinct_counter   *counter;
+
+    if (data == NULL)
+        return NULL;
+
+    SHIM_TRY(NULL);
+
+    counter = palloc(sizeof(distinct_counter));
+    counter->type = type;
+    counter->data = data;
+
+    SHIM_END();
+
+    return counter;
+
+}
+
+/* Checks the parameters in the header of the counter, and that the length
+ * matches them exactly (so that the estimators never access memory beyond
+ * the end of the counter, even for corrupted data passed to distinct_load). */
+static bool
+counter_valid(const distinct_counter *counter)
+{
+
+    size_t  size;
+
+    if ((counter == NULL) || (counter->data == NULL))
+        return false;
+
+    size = VARSIZE(counter->data);
+
+    switch (counter->type) {
+        case DISTINCT_HYPERLOGLOG:
+        {
+            HyperLogLogCounter c = counter->data;
+
+            if ((size < offsetof(HyperLogLogCounterData, data)) ||
+                (c->b < 4) || (c->b > 16) || (c->m != (1 << c->b)) || (c->binbits != 8))
+                return false;
+
+            /* the cached estimate is optional (older counters don't have it) */
+            return (size == HLL_CACHE_OFFSET(c)) || (size == HLL_CACHE_OFFSET(c) + sizeof(int32));
+        }
+        case DISTINCT_ADAPTIVE:
+        {
+            AdaptiveCounter c = counter->data;
+
+            if ((size < offsetof(AdaptiveCounterData, bitmap)) ||
+                (c->itemSize < 1) || (c->itemSize > DISTINCT_HASH_LENGTH) ||
+                (c->maxItems < 1) || (c->maxItems > (0x3FFFFFFF / c->itemSize)) ||
+                (c->items < 0) || (c->items > c->maxItems) ||
+                (c->level < 0) || (c->level > c->itemSize * 8))
+                return false;
+
+            return (size == offsetof(AdaptiveCounterData, bitmap) + (size_t) c->itemSize * c->maxItems);
+        }
+        case DISTINCT_BITMAP:
+        {
+            BitmapCounter c = counter->data;
+
+            if ((size < offsetof(BitmapCounterData, bitmap)) ||
+                (c->cbits < 0) || (c->cbits > 29) || (c->nbits != (1 << c->cbits)) ||
+                (c->dbits < 0) || (c->dbits > 32) ||
+                (c->level < 0) || (c->level > c->nbits))
+                return false;
+
+            return (size == offsetof(BitmapCounterData, bitmap) + (size_t) c->nbits);
+        }
+        case DISTINCT_LOGLOG:
+        {
+            LogLogCounter c = counter->data;
+
+            if ((size < offsetof(LogLogCounterData, data)) ||
+                (c->bits < 0) || (c->bits > 29) || (c->m != (1 << c->bits)))
+                return false;
+
+            return (size == offsetof(LogLogCounterData, data) + (size_t) c->m);
+        }
+        case DISTINCT_PCSA:
+        {
+            PCSACounter c = counter->data;
+
+            if ((size < offsetof(PCSACounterData, bitmap)) ||
+                (c->nmaps < 1) || (c->nmaps > MAX_BITMAPS) ||
+                (c->keysize < 1) || (c->keysize > MAX_KEYSIZE) ||
+                ((c->width != 32) && (c->width != 64)))
+                return false;
+
+            return (size == pcsa_get_size(c->nmaps, c->keysize, c->width));
+        }
+        case DISTINCT_PROBABILISTIC:
+        {
+            ProbabilisticCounter c = counter->data;
+
+            if ((size < offsetof(ProbabilisticCounterData, bitmap)) ||
+                (c->nbytes < 1) || (c->nbytes > MAX_NBYTES) ||
+                (c->nsalts < 1) || (c->nsalts > MAX_NSALTS))
+                return false;
+
+            return (size == pc_size(c->nbytes, c->nsalts));
+        }
+        case DISTINCT_SUPERLOGLOG:
+        {
+            SuperLogLogCounter c = counter->data;
+
+            if ((size < offsetof(SuperLogLogCounterData, data)) ||
+                (c->bits < 0) || (c->bits > 29) || (c->m != (1 << c->bits)))
+                return false;
+
+            /* the cached estimate is optional (older counters don't have it) */
+            return (size == SLL_CACHE_OFFSET(c)) || (size == SLL_CACHE_OFFSET(c) + sizeof(int32));
+        }
+    }
+
+    return false;
+
+}
+
+/* The store is simply the HLL store from the extension. */
+distinct_store *
+distinct_store_create(const char *path, double error, uint64_t capacity, int keysize)
+{
+
+    HyperLogLogStore store;
+
+    SHIM_TRY(NULL);
+
+    if (error <= 0)
+        error = DEFAULT_ERROR;
+
+    if (error > 1)
+        elog(ERROR, "error rate has to be between 0 and 1");
+
+    store = hyperloglog_store_create(path, error, capacity, keysize);
+
+    SHIM_END();
+
+    return (distinct_store *) store;
+
+}
+
+distinct_store *
+distinct_store_open(const char *path, int readonly)
+{
+
+    HyperLogLogStore store;
+
+    SHIM_TRY(NULL);
+
+    store = hyperloglog_store_open(path, readonly != 0);
+
+    SHIM_END();
+
+    return (distinct_store *) store;
+
+}
+
+void
+distinct_store_close(distinct_store *store)
+{
+    if (store != NULL)
+        hyperloglog_store_close((HyperLogLogStore) store);
+}
+
+uint64_t
+distinct_store_count(const distinct_store *store)
+{
+    return ((HyperLogLogStore) store)->header->nentries;
+}
+
+int
+distinct_store_merge(distinct_store *store, const void *key, size_t keylen,
+                     const distinct_counter *counter)
+{
+
+    SHIM_TRY(-1);
+
+    if (! counter_valid(counter) || (counter->type != DISTINCT_HYPERLOGLOG))
+        elog(ERROR, "only hyperloglog counters may be merged into a store");
+
+    if (keylen > INT32_MAX)
+        elog(ERROR, "key too long (%zu bytes)", keylen);
+
+    hyperloglog_store_merge((HyperLogLogStore) store, key, (int) keylen, counter->data);
+
+    SHIM_END();
+
+    return 0;
+
+}
+
+int
+distinct_store_merge_store(distinct_store *dest, const distinct_store *src)
+{
+
+    uint64              i;
+    HyperLogLogStore    from = (HyperLogLogStore) src;
+
+    SHIM_TRY(-1);
+
+    for (i = 0; i < from->header->capacity; i++) {
+
+        const char *key;
+        int         keylen;
+        HyperLogLogCounter counter = hyperloglog_store_entry(from, i, &key, &keylen);
+
+        if (counter != NULL)
+            hyperloglog_store_merge((HyperLogLogStore) dest, key, keylen, counter);
+    }
+
+    SHIM_END();
+
+    return 0;
+
+}
+
+const void *
+distinct_store_get(const distinct_store *store, const void *key, size_t keylen, size_t *len)
+{
+
+    HyperLogLogCounter counter;
+
+    SHIM_TRY(NULL);
+
+    if (keylen > INT32_MAX)
+        elog(ERROR, "key too long (%zu bytes)", keylen);
+
+    counter = hyperloglog_store_get((HyperLogLogStore) store, key, (int) keylen);
+
+    SHIM_END();
+
+    if (counter == NULL)
+        return NULL;
+
+    *len = VARSIZE(counter) - VARHDRSZ;
+
+    return VARDATA(counter);
+
+}
+
+int64_t
+distinct_store_estimate(const distinct_store *store, const void *key, size_t keylen)
+{
+
+    int64_t             estimate = 0;
+    HyperLogLogCounter  counter;
+
+    SHIM_TRY(-1);
+
+    if (keylen > INT32_MAX)
+        elog(ERROR, "key too long (%zu bytes)", keylen);
+
+    counter = hyperloglog_store_get((HyperLogLogStore) store, key, (int) keylen);
+
+    if (counter != NULL)
+        estimate = hyperloglog_estimate(counter);
+
+    SHIM_END();
+
+    return estimate;
+
+}
+
+int
+distinct_store_entry(const distinct_store *store, uint64_t slot, const void **key,
+                     size_t *keylen, const void **data, size_t *len)
+{
+
+    const char         *k;
+    int                 klen;
+    HyperLogLogStore    s = (HyperLogLogStore) store;
+    HyperLogLogCounter  counter;
+
+    if (slot >= s->header->capacity)
+        return -1;
+
+    if ((counter = hyperloglog_store_entry(s, slot, &k, &klen)) == NULL)
+        return 0;
+
+    *key = k;
+    *keylen = klen;
+    *data = VARDATA(counter);
+    *len = VARSIZE(counter) - VARHDRSZ;
+
+    return 1;
+
+}
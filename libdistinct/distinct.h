@@ -0,0 +1,189 @@
+/* libdistinct - the distinct estimators as a plain C library.
+ *
+ * The library contains the same estimators as the PostgreSQL extensions,
+ * compiled from the same sources, but without any dependency on PostgreSQL.
+ * The counters are byte-identical to the ones built in the database (on the
+ * same architecture), so applications may pre-aggregate values close to the
+ * data source and ship the compact counters to the database, e.g. as
+ *
+ *     INSERT INTO t (counter) VALUES ($1::bytea::hyperloglog_estimator)
+ *
+ * with the parameter from distinct_data(), or merge counters loaded from the
+ * database using distinct_load().
+ *
+ * All functions reporting errors return NULL (or -1), and the message is
+ * available from distinct_last_error() and is passed to the error handler
+ * (if set). Counters are not thread-safe, but different threads may work
+ * with different counters concurrently.
+ *
+ * Only the functions declared here are exported from the shared library,
+ * and the counter structure is opaque, so that the ABI remains stable.
+ */
+#ifndef DISTINCT_H
+#define DISTINCT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* bumped on incompatible changes (also the soname of the shared library) */
+#define DISTINCT_ABI_VERSION    1
+
+/* length of the hashes accepted by distinct_add_hash (md5) */
+#define DISTINCT_HASH_LENGTH    16
+
+#if defined(__GNUC__)
+#define DISTINCT_API    __attribute__((visibility("default")))
+#else
+#define DISTINCT_API
+#endif
+
+typedef enum distinct_type {
+    DISTINCT_HYPERLOGLOG = 1,
+    DISTINCT_ADAPTIVE = 2,
+    DISTINCT_BITMAP = 3,
+    DISTINCT_LOGLOG = 4,
+    DISTINCT_PCSA = 5,
+    DISTINCT_PROBABILISTIC = 6,
+    DISTINCT_SUPERLOGLOG = 7
+} distinct_type;
+
+/* opaque counter */
+typedef struct distinct_counter distinct_counter;
+
+typedef void *(*distinct_malloc_fn) (size_t size);
+typedef void *(*distinct_realloc_fn) (void *ptr, size_t size);
+typedef void  (*distinct_free_fn) (void *ptr);
+typedef void  (*distinct_error_fn) (const char *message, void *arg);
+
+/* version of the ABI the library was built with (DISTINCT_ABI_VERSION) */
+DISTINCT_API int distinct_abi_version(void);
+
+/* Sets the allocator used for all memory allocated by the library (malloc,
+ * realloc and free by default). Has to be called before creating counters. */
+DISTINCT_API void distinct_set_allocator(distinct_malloc_fn malloc_fn,
+                                         distinct_realloc_fn realloc_fn,
+                                         distinct_free_fn free_fn);
+
+/* Sets handler called for each error (e.g. to log it), NULL to disable. */
+DISTINCT_API void distinct_set_error_handler(distinct_error_fn handler, void *arg);
+
+/* message of the last error in the current thread */
+DISTINCT_API const char *distinct_last_error(void);
+
+/* estimator for a name (e.g. "hyperloglog"), 0 if unknown */
+DISTINCT_API distinct_type distinct_type_lookup(const char *name);
+
+/* name of the estimator (NULL for unknown types) */
+DISTINCT_API const char *distinct_type_name(distinct_type type);
+
+/* Can counters of this type be merged? (all except bitmap) */
+DISTINCT_API int distinct_type_mergeable(distinct_type type);
+
+/* Creates a counter with the requested error rate and expected number of
+ * distinct values (the latter is used by hyperloglog, adaptive and bitmap).
+ * Zero (or negative) values mean defaults of the one-argument aggregates,
+ * e.g. hyperloglog_distinct(x). Counters for pcsa and probabilistic are
+ * always created with the defaults - use the functions below for those. */
+DISTINCT_API distinct_counter *distinct_create(distinct_type type, double error, int64_t ndistinct);
+
+/* pcsa counter, same as pcsa_init(nmaps, keysize) */
+DISTINCT_API distinct_counter *distinct_create_pcsa(int nmaps, int keysize);
+
+/* probabilistic counter, same as probabilistic_init(nbytes, nsalts) */
+DISTINCT_API distinct_counter *distinct_create_probabilistic(int nbytes, int nsalts);
+
+/* Creates a counter from serialized data (e.g. a bytea value fetched from
+ * the database). The data has to come from a counter of the same type, and
+ * is rejected (NULL) if the length does not match the counter parameters. */
+DISTINCT_API distinct_counter *distinct_load(distinct_type type, const void *data, size_t len);
+
+/* independent copy of the counter */
+DISTINCT_API distinct_counter *distinct_copy(const distinct_counter *counter);
+
+DISTINCT_API void distinct_free(distinct_counter *counter);
+
+DISTINCT_API distinct_type distinct_counter_type(const distinct_counter *counter);
+
+/* Adds a value (hashed using md5, just like the extensions do). To match
+ * the counters built in the database, the value has to be in the binary
+ * format of the column type (e.g. the text itself for text columns). */
+DISTINCT_API int distinct_add(distinct_counter *counter, const void *value, size_t len);
+
+/* Adds a hash computed by distinct_hash (not supported by probabilistic). */
+DISTINCT_API int distinct_add_hash(distinct_counter *counter, const unsigned char *hash);
+
+/* Adds an array of hashes (DISTINCT_HASH_LENGTH bytes each), the same as
+ * distinct_add_hash for each of them, but faster for large counters. */
+DISTINCT_API int distinct_add_hashes(distinct_counter *counter, const unsigned char *hashes, size_t nhashes);
+
+/* Computes the hash used by the counters (DISTINCT_HASH_LENGTH bytes). */
+DISTINCT_API void distinct_hash(const void *value, size_t len, unsigned char *hash);
+
+/* Merges 'src' into 'dest' (both have to be of the same type, and created
+ * with the same parameters). The 'src' counter is not modified. */
+DISTINCT_API int distinct_merge(distinct_counter *dest, const distinct_counter *src);
+
+/* current estimate of the number of distinct values (-1 on error) */
+DISTINCT_API int64_t distinct_estimate(const distinct_counter *counter);
+
+/* Returns the serialized counter (valid until the counter is modified or
+ * freed), in the format used by the data types - bytea input / COPY BINARY
+ * of the type, or '\x' followed by the data in hex in text format. */
+DISTINCT_API const void *distinct_data(const distinct_counter *counter, size_t *len);
+
+/* Store of many hyperloglog counters (with the same error rate) in a single
+ * memory-mapped file, for offline rollups of (key, counter) pairs. The file
+ * format is the same as for hyperloglog_store_* functions in the extension
+ * (see hyperloglog/src/hyperloglog.h). Keys are arbitrary byte strings up to
+ * 'keysize' bytes, and the capacity (maximum number of keys) is fixed when
+ * creating the store. Only a single process may modify the store. */
+typedef struct distinct_store distinct_store;
+
+/* creates a new store file (fails if it exists) */
+DISTINCT_API distinct_store *distinct_store_create(const char *path, double error,
+                                                   uint64_t capacity, int keysize);
+
+DISTINCT_API distinct_store *distinct_store_open(const char *path, int readonly);
+
+/* unmaps the store (flushing the changes to the file) */
+DISTINCT_API void distinct_store_close(distinct_store *store);
+
+/* number of keys in the store */
+DISTINCT_API uint64_t distinct_store_count(const distinct_store *store);
+
+/* Merges the counter into the store (in place), adding the key if needed.
+ * The counter has to be a hyperloglog one, with the error rate of the store. */
+DISTINCT_API int distinct_store_merge(distinct_store *store, const void *key, size_t keylen,
+                                      const distinct_counter *counter);
+
+/* merges all counters from 'src' into 'dest' (with the same error rate) */
+DISTINCT_API int distinct_store_merge_store(distinct_store *dest, const distinct_store *src);
+
+/* Serialized counter for the key (as distinct_data, pointing directly into
+ * the mapped file), NULL if the key is not in the store. */
+DISTINCT_API const void *distinct_store_get(const distinct_store *store, const void *key,
+                                            size_t keylen, size_t *len);
+
+/* estimate for the key (0 if not in the store, -1 on error) */
+DISTINCT_API int64_t distinct_store_estimate(const distinct_store *store, const void *key,
+                                             size_t keylen);
+
+/* Returns the key and the counter in a slot (1), or 0 for empty slot and -1
+ * for slots beyond the end, so all counters may be read like this:
+ *
+ *     for (i = 0; (r = distinct_store_entry(store, i, ...)) >= 0; i++)
+ *         if (r > 0) ...
+ */
+DISTINCT_API int distinct_store_entry(const distinct_store *store, uint64_t slot,
+                                      const void **key, size_t *keylen,
+                                      const void **data, size_t *len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif   /* DISTINCT_H */
@@ -0,0 +1,11 @@
+/* MD5 used by the estimators (see shim/md5.c), with the same interface as
+ * the pg_md5_binary() function in the server before PostgreSQL 15 (the shim
+ * does not define PG_VERSION_NUM, see distinct_md5.h). */
+#ifndef DISTINCT_SHIM_MD5_H
+#define DISTINCT_SHIM_MD5_H
+
+#include "postgres.h"
+
+bool pg_md5_binary(const void *buff, size_t len, void *outbuf);
+
+#endif   /* DISTINCT_SHIM_MD5_H */
@@ -0,0 +1,26 @@
+/* Timing macros used by the instrumentation of the estimators, with the same
+ * interface as portability/instr_time.h in the server. The instrumentation is
+ * never enabled in the library, but the estimators need this to compile. */
+#ifndef DISTINCT_SHIM_INSTR_TIME_H
+#define DISTINCT_SHIM_INSTR_TIME_H
+
+#include <time.h>
+
+typedef struct timespec instr_time;
+
+#define INSTR_TIME_SET_ZERO(t)  ((t).tv_sec = 0, (t).tv_nsec = 0)
+
+#define INSTR_TIME_SET_CURRENT(t)   ((void) clock_gettime(CLOCK_MONOTONIC, &(t)))
+
+#define INSTR_TIME_ACCUM_DIFF(x, y, z) \
+    do { \
+        (x).tv_sec += (y).tv_sec - (z).tv_sec; \
+        (x).tv_nsec += (y).tv_nsec - (z).tv_nsec; \
+        while ((x).tv_nsec < 0) { (x).tv_nsec += 1000000000; (x).tv_sec--; } \
+        while ((x).tv_nsec >= 1000000000) { (x).tv_nsec -= 1000000000; (x).tv_sec++; } \
+    } while (0)
+
+#define INSTR_TIME_GET_MILLISEC(t) \
+    (((double) (t).tv_sec * 1000.0) + ((double) (t).tv_nsec) / 1000000.0)
+
+#endif   /* DISTINCT_SHIM_INSTR_TIME_H */
@@ -0,0 +1,71 @@
+/* Minimal replacement of the PostgreSQL headers, so that the estimators
+ * (e.g. hyperloglog/src/hyperloglog.c) can be compiled into libdistinct
+ * without any changes. Only the small subset actually used by the estimator
+ * sources is provided - memory allocation, error reporting and the varlena
+ * header. See shim.c for how those map to the library callbacks.
+ *
+ * The counters are built in exactly the same format as in the server, so
+ * the serialized counters may be loaded into the database directly.
+ */
+#ifndef DISTINCT_SHIM_POSTGRES_H
+#define DISTINCT_SHIM_POSTGRES_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef int8_t      int8;
+typedef int16_t     int16;
+typedef int32_t     int32;
+typedef int64_t     int64;
+typedef uint8_t     uint8;
+typedef uint16_t    uint16;
+typedef uint32_t    uint32;
+typedef uint64_t    uint64;
+
+#define INT64CONST(x)   (x##LL)
+#define UINT64CONST(x)  (x##ULL)
+
+#define Max(x, y)       ((x) > (y) ? (x) : (y))
+#define Min(x, y)       ((x) < (y) ? (x) : (y))
+
+/* error reporting - ERROR jumps back to the library entry point */
+#define DEBUG1      14
+#define NOTICE      18
+#define WARNING     19
+#define ERROR       21
+
+void shim_elog(int elevel, const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+
+#define elog(elevel, ...)   shim_elog(elevel, __VA_ARGS__)
+
+/* memory allocation (there are no memory contexts, using the allocator
+ * configured by distinct_set_allocator) */
+void *palloc(size_t size);
+void *palloc0(size_t size);
+void *repalloc(void *pointer, size_t size);
+void pfree(void *pointer);
+
+/* varlena header - 4B header, in the same format as in the server
+ * (see postgres.h), so the counters are binary compatible */
+#define VARHDRSZ            ((int32) sizeof(int32))
+
+/* pg_config.h defines this on big-endian machines, here we ask the compiler */
+#if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_BIG_ENDIAN__)
+#define WORDS_BIGENDIAN 1
+#endif
+
+#ifdef WORDS_BIGENDIAN
+#define SET_VARSIZE(PTR, len)   (*((uint32 *) (PTR)) = ((uint32) (len)) & 0x3FFFFFFF)
+#define VARSIZE(PTR)            (*((uint32 *) (PTR)) & 0x3FFFFFFF)
+#else
+#define SET_VARSIZE(PTR, len)   (*((uint32 *) (PTR)) = (((uint32) (len)) << 2))
+#define VARSIZE(PTR)            ((*((uint32 *) (PTR)) >> 2) & 0x3FFFFFFF)
+#endif
+
+#define VARDATA(PTR)        (((char *) (PTR)) + VARHDRSZ)
+
+#endif   /* DISTINCT_SHIM_POSTGRES_H */
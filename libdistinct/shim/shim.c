@@ -0,0 +1,77 @@
+/* Implementation of the palloc / elog replacements (see postgres.h), using
+ * the allocator and error handler configured by the application. */
+#include <stdarg.h>
+#include <stdlib.h>
+
+#include "shim.h"
+
+distinct_malloc_fn  shim_malloc = malloc;
+distinct_realloc_fn shim_realloc = realloc;
+distinct_free_fn    shim_free = free;
+
+distinct_error_fn   shim_error_handler = NULL;
+void               *shim_error_arg = NULL;
+
+__thread jmp_buf   *shim_error_jump = NULL;
+__thread char       shim_error_message[256];
+
+void
+shim_elog(int elevel, const char *fmt, ...)
+{
+    va_list     args;
+
+    /* only errors are interesting for the applications */
+    if (elevel < ERROR)
+        return;
+
+    va_start(args, fmt);
+    vsnprintf(shim_error_message, sizeof(shim_error_message), fmt, args);
+    va_end(args);
+
+    if (shim_error_handler != NULL)
+        shim_error_handler(shim_error_message, shim_error_arg);
+
+    /* the estimators expect elog(ERROR) not to return */
+    if (shim_error_jump != NULL)
+        longjmp(*shim_error_jump, 1);
+
+    abort();
+}
+
+void *
+palloc(size_t size)
+{
+    void   *ptr = shim_malloc(size);
+
+    if (ptr == NULL)
+        elog(ERROR, "out of memory (requested %zu bytes)", size);
+
+    return ptr;
+}
+
+void *
+palloc0(size_t size)
+{
+    void   *ptr = palloc(size);
+
+    memset(ptr, 0, size);
+
+    return ptr;
+}
+
+void *
+repalloc(void *pointer, size_t size)
+{
+    void   *ptr = shim_realloc(pointer, size);
+
+    if (ptr == NULL)
+        elog(ERROR, "out of memory (requested %zu bytes)", size);
+
+    return ptr;
+}
+
+void
+pfree(void *pointer)
+{
+    shim_free(pointer);
+}
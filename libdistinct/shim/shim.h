@@ -0,0 +1,47 @@
+/* Interface between the shim (palloc, elog) and the library entry points
+ * in distinct.c - not part of the public API. */
+#ifndef DISTINCT_SHIM_H
+#define DISTINCT_SHIM_H
+
+#include <setjmp.h>
+
+#include "postgres.h"
+#include "distinct.h"
+
+/* allocator used by palloc & co. (malloc/realloc/free by default) */
+extern distinct_malloc_fn   shim_malloc;
+extern distinct_realloc_fn  shim_realloc;
+extern distinct_free_fn     shim_free;
+
+/* error handler, called for each message before jumping out */
+extern distinct_error_fn    shim_error_handler;
+extern void                *shim_error_arg;
+
+/* where to jump on ERROR (set by SHIM_TRY in the entry points) */
+extern __thread jmp_buf    *shim_error_jump;
+
+/* message of the last error in this thread */
+extern __thread char        shim_error_message[256];
+
+/* Entry points of the library wrap the calls into the estimators like this
+ *
+ *     SHIM_TRY(NULL);
+ *     ... calls that may elog(ERROR) ...
+ *     SHIM_END();
+ *
+ * so that ERROR returns the value from the entry point, instead of aborting
+ * the whole process. Just like with PG_TRY, local variables modified after
+ * SHIM_TRY must not be used after the error. */
+#define SHIM_TRY(errvalue) \
+    jmp_buf     shim_jump_; \
+    jmp_buf    *shim_prev_jump_ = shim_error_jump; \
+    if (setjmp(shim_jump_) != 0) { \
+        shim_error_jump = shim_prev_jump_; \
+        return errvalue; \
+    } \
+    shim_error_jump = &shim_jump_
+
+#define SHIM_END() \
+    shim_error_jump = shim_prev_jump_
+
+#endif   /* DISTINCT_SHIM_H */
@@ -0,0 +1,219 @@
+/* Tests of the libdistinct API (run by "make check").
+ *
+ * Builds counters of all types, and checks that the estimates are sensible,
+ * that the serialized counters can be loaded again, that merging counters
+ * matches a counter built from all the values, that adding a batch of hashes
+ * matches adding them one by one, and that corrupted counters are rejected
+ * by distinct_load (instead of crashing later).
+ */
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "distinct.h"
+
+/* number of values added to the counters */
+#define NVALUES     10000
+
+static int failures = 0;
+
+static void
+check(int ok, const char *fmt, ...)
+{
+    va_list     args;
+
+    if (ok)
+        return;
+
+    failures++;
+
+    va_start(args, fmt);
+    fprintf(stderr, "FAILED: ");
+    vfprintf(stderr, fmt, args);
+    fprintf(stderr, " (last error: %s)\n", distinct_last_error());
+    va_end(args);
+}
+
+/* adds values [from, to] as text (just like the aggregates on text columns) */
+static void
+add_values(distinct_counter *counter, int from, int to)
+{
+    int     i;
+    char    value[32];
+
+    for (i = from; i <= to; i++) {
+        int len = snprintf(value, sizeof(value), "%d", i);
+
+        check(distinct_add(counter, value, len) == 0, "distinct_add");
+    }
+}
+
+/* loads a copy of the serialized counter, with a different length (delta)
+ * and the first field of the header replaced (unless 0) */
+static distinct_counter *
+load_modified(distinct_counter *counter, long delta, int first_field)
+{
+    size_t          len;
+    const void     *data = distinct_data(counter, &len);
+    unsigned char  *copy = malloc(len + 1);
+    distinct_counter *result;
+
+    memcpy(copy, data, len);
+    copy[len] = 0;
+
+    if (first_field != 0)
+        memcpy(copy, &first_field, sizeof(int));
+
+    result = distinct_load(distinct_counter_type(counter), copy, len + delta);
+
+    free(copy);
+
+    return result;
+}
+
+static void
+test_type(distinct_type type)
+{
+
+    const char         *name = distinct_type_name(type);
+    distinct_counter   *counter = distinct_create(type, 0, 0);
+    distinct_counter   *loaded, *a, *b;
+    const void         *data, *data2;
+    size_t              len, len2;
+    int64_t             estimate;
+
+    check(counter != NULL, "%s: distinct_create", name);
+    if (counter == NULL)
+        return;
+
+    add_values(counter, 1, NVALUES);
+
+    /* superloglog underestimates a lot with the default parameters */
+    estimate = distinct_estimate(counter);
+    check((estimate > NVALUES * 0.6) && (estimate < NVALUES * 1.4),
+          "%s: estimate %lld for %d values", name, (long long) estimate, NVALUES);
+
+    /* serialized counter loads back into the same counter */
+    data = distinct_data(counter, &len);
+    loaded = distinct_load(type, data, len);
+
+    check(loaded != NULL, "%s: distinct_load", name);
+    if (loaded != NULL) {
+        data2 = distinct_data(loaded, &len2);
+        check((len == len2) && (memcmp(data, data2, len) == 0), "%s: loaded counter differs", name);
+        check(distinct_estimate(loaded) == estimate, "%s: estimate of the loaded counter", name);
+
+        /* adding the same values again does not change the estimate */
+        add_values(loaded, 1, NVALUES);
+        check(distinct_estimate(loaded) == estimate, "%s: estimate after adding duplicates", name);
+
+        distinct_free(loaded);
+    }
+
+    /* merged halves give the same estimate as a counter with all the values
+     * (adaptive counters depend on the order of splits, so only roughly) */
+    if (distinct_type_mergeable(type)) {
+
+        a = distinct_create(type, 0, 0);
+        b = distinct_create(type, 0, 0);
+
+        add_values(a, 1, NVALUES / 2);
+        add_values(b, NVALUES / 2 + 1, NVALUES);
+
+        check(distinct_merge(a, b) == 0, "%s: distinct_merge", name);
+
+        if (type == DISTINCT_ADAPTIVE)
+            check((distinct_estimate(a) > estimate * 0.9) && (distinct_estimate(a) < estimate * 1.1),
+                  "%s: estimate of merged counters", name);
+        else
+            check(distinct_estimate(a) == estimate, "%s: estimate of merged counters", name);
+
+        distinct_free(a);
+        distinct_free(b);
+
+    } else {
+
+        a = distinct_copy(counter);
+        check(distinct_merge(a, counter) == -1, "%s: merge should fail", name);
+        distinct_free(a);
+
+    }
+
+    /* adding hashes in a batch builds the same counter as one by one (the
+     * probabilistic counters hash each value multiple times) */
+    if (type != DISTINCT_PROBABILISTIC) {
+
+        int             i;
+        unsigned char  *hashes = malloc(NVALUES * DISTINCT_HASH_LENGTH);
+        const void     *batch, *single;
+        size_t          batch_len, single_len;
+
+        a = distinct_create(type, 0, 0);
+        b = distinct_create(type, 0, 0);
+
+        for (i = 0; i < NVALUES; i++) {
+            char    value[32];
+            int     len = snprintf(value, sizeof(value), "%d", i + 1);
+
+            distinct_hash(value, len, hashes + i * DISTINCT_HASH_LENGTH);
+            check(distinct_add_hash(a, hashes + i * DISTINCT_HASH_LENGTH) == 0, "%s: distinct_add_hash", name);
+        }
+
+        check(distinct_add_hashes(b, hashes, NVALUES) == 0, "%s: distinct_add_hashes", name);
+
+        batch = distinct_data(b, &batch_len);
+        single = distinct_data(a, &single_len);
+        check((batch_len == single_len) && (memcmp(batch, single, batch_len) == 0),
+              "%s: batch and single hashes differ", name);
+
+        /* and the same as adding the values */
+        check((batch_len == len) && (memcmp(batch, data, len) == 0), "%s: hashes and values differ", name);
+
+        free(hashes);
+        distinct_free(a);
+        distinct_free(b);
+    }
+
+    /* corrupted counters are rejected when loading */
+    check(distinct_load(type, data, 4) == NULL, "%s: loaded counter with only 4 bytes", name);
+    check(load_modified(counter, -1, 0) == NULL, "%s: loaded truncated counter", name);
+    check(load_modified(counter, 1, 0) == NULL, "%s: loaded counter with extra byte", name);
+    check(load_modified(counter, 0, 0x7FFFFFFF) == NULL, "%s: loaded counter with invalid header", name);
+    check(load_modified(counter, 0, -1) == NULL, "%s: loaded counter with negative header", name);
+
+    distinct_free(counter);
+
+}
+
+int
+main(void)
+{
+
+    int                 i;
+    distinct_counter   *a, *b;
+
+    for (i = DISTINCT_HYPERLOGLOG; i <= DISTINCT_SUPERLOGLOG; i++)
+        test_type((distinct_type) i);
+
+    /* counters of different types can't be merged */
+    a = distinct_create(DISTINCT_HYPERLOGLOG, 0, 0);
+    b = distinct_create(DISTINCT_LOGLOG, 0, 0);
+    check(distinct_merge(a, b) == -1, "merge of different types should fail");
+    distinct_free(a);
+    distinct_free(b);
+
+    /* unknown types */
+    check(distinct_create((distinct_type) 100, 0, 0) == NULL, "created counter of unknown type");
+    check(distinct_load((distinct_type) 100, "12345678", 8) == NULL, "loaded counter of unknown type");
+
+    if (failures > 0) {
+        fprintf(stderr, "%d checks failed\n", failures);
+        return 1;
+    }
+
+    printf("all tests passed\n");
+
+    return 0;
+
+}
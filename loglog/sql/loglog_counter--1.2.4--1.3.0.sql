@@ -0,0 +1,134 @@
+-- the estimate does not modify the aggregate state (e.g. for window aggregates)
+
+CREATE OR REPLACE AGGREGATE loglog_distinct(anyelement, real)
+(
+    sfunc = loglog_add_item_agg,
+    stype = loglog_estimator,
+    finalfunc = loglog_get_estimate,
+    finalfunc_modify = read_only
+);
+
+CREATE OR REPLACE AGGREGATE loglog_distinct(anyelement)
+(
+    sfunc = loglog_add_item_agg2,
+    stype = loglog_estimator,
+    finalfunc = loglog_get_estimate,
+    finalfunc_modify = read_only
+);
+
+-- pre-hashed values (bytea with at least 16 bytes, or bigint)
+
+CREATE FUNCTION loglog_add_hash(counter loglog_estimator, hash bytea) RETURNS void
+     AS 'MODULE_PATHNAME', 'loglog_add_hashed'
+     LANGUAGE C;
+
+CREATE FUNCTION loglog_add_hash(counter loglog_estimator, hash bigint) RETURNS void
+     AS 'MODULE_PATHNAME', 'loglog_add_hashed'
+     LANGUAGE C;
+
+CREATE FUNCTION loglog_add_hashed_agg(counter loglog_estimator, hash bytea, errorRate real) RETURNS loglog_estimator
+     AS 'MODULE_PATHNAME', 'loglog_add_hashed_agg'
+     LANGUAGE C;
+
+CREATE FUNCTION loglog_add_hashed_agg(counter loglog_estimator, hash bigint, errorRate real) RETURNS loglog_estimator
+     AS 'MODULE_PATHNAME', 'loglog_add_hashed_agg'
+     LANGUAGE C;
+
+CREATE FUNCTION loglog_add_hashed_agg2(counter loglog_estimator, hash bytea) RETURNS loglog_estimator
+     AS 'MODULE_PATHNAME', 'loglog_add_hashed_agg2'
+     LANGUAGE C;
+
+CREATE FUNCTION loglog_add_hashed_agg2(counter loglog_estimator, hash bigint) RETURNS loglog_estimator
+     AS 'MODULE_PATHNAME', 'loglog_add_hashed_agg2'
+     LANGUAGE C;
+
+CREATE AGGREGATE loglog_distinct_hashed(bytea, real)
+(
+    sfunc = loglog_add_hashed_agg,
+    stype = loglog_estimator,
+    finalfunc = loglog_get_estimate,
+    finalfunc_modify = read_only
+);
+
+CREATE AGGREGATE loglog_distinct_hashed(bytea)
+(
+    sfunc = loglog_add_hashed_agg2,
+    stype = loglog_estimator,
+    finalfunc = loglog_get_estimate,
+    finalfunc_modify = read_only
+);
+
+CREATE AGGREGATE loglog_accum_hashed(bytea, real)
+(
+    sfunc = loglog_add_hashed_agg,
+    stype = loglog_estimator
+);
+
+CREATE AGGREGATE loglog_accum_hashed(bytea)
+(
+    sfunc = loglog_add_hashed_agg2,
+    stype = loglog_estimator
+);
+
+CREATE AGGREGATE loglog_distinct_hashed(bigint, real)
+(
+    sfunc = loglog_add_hashed_agg,
+    stype = loglog_estimator,
+    finalfunc = loglog_get_estimate,
+    finalfunc_modify = read_only
+);
+
+CREATE AGGREGATE loglog_distinct_hashed(bigint)
+(
+    sfunc = loglog_add_hashed_agg2,
+    stype = loglog_estimator,
+    finalfunc = loglog_get_estimate,
+    finalfunc_modify = read_only
+);
+
+CREATE AGGREGATE loglog_accum_hashed(bigint, real)
+(
+    sfunc = loglog_add_hashed_agg,
+    stype = loglog_estimator
+);
+
+CREATE AGGREGATE loglog_accum_hashed(bigint)
+(
+    sfunc = loglog_add_hashed_agg2,
+    stype = loglog_estimator
+);
+
+-- multi-column keys, e.g. loglog_distinct_multi(user_id, device_id) (keys with any NULL value are skipped)
+CREATE FUNCTION loglog_add_item_multi(counter loglog_estimator, VARIADIC items "any") RETURNS void
+     AS 'MODULE_PATHNAME', 'loglog_add_item_multi'
+     LANGUAGE C;
+
+CREATE FUNCTION loglog_add_item_multi_agg(counter loglog_estimator, VARIADIC items "any") RETURNS loglog_estimator
+     AS 'MODULE_PATHNAME', 'loglog_add_item_multi_agg'
+     LANGUAGE C;
+
+CREATE AGGREGATE loglog_distinct_multi(VARIADIC "any")
+(
+    sfunc = loglog_add_item_multi_agg,
+    stype = loglog_estimator,
+    finalfunc = loglog_get_estimate,
+    finalfunc_modify = read_only
+);
+
+CREATE AGGREGATE loglog_accum_multi(VARIADIC "any")
+(
+    sfunc = loglog_add_item_multi_agg,
+    stype = loglog_estimator
+);
+
+-- Union of arrays of estimators (NULL elements are skipped)
+
+-- merges all the estimators in the array into a single one
+CREATE FUNCTION loglog_union(estimators loglog_estimator[]) RETURNS loglog_estimator
+     AS 'MODULE_PATHNAME', 'loglog_union'
+     LANGUAGE C STRICT PARALLEL SAFE;
+
+-- estimate of the union of all the estimators in the array
+CREATE FUNCTION loglog_union_estimate(estimators loglog_estimator[]) RETURNS real
+     AS 'MODULE_PATHNAME', 'loglog_union_estimate'
+     LANGUAGE C STRICT PARALLEL SAFE;
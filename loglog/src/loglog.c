@@ -5,9 +5,10 @@
 #include <string.h>
 
 #include "postgres.h"
-#include "libpq/md5.h"
+#include "distinct_md5.h"
 
 #include "loglog.h"
+#include "loglog_probes.h"
 
 #define HASH_LENGTH 16
 
@@ -17,7 +18,6 @@ int loglog_estimate(LogLogCounter loglog);
 
 void loglog_hash(unsigned char * buffer, const char * element, int length);
 
-void loglog_add_hash(LogLogCounter loglog, const unsigned char * hash);
 void loglog_reset_internal(LogLogCounter loglog);
 
 /* allocate bitmap with a given length (to store the given number of bitmaps) */
@@ -74,14 +74,21 @@ int loglog_get_min_bit(const unsigned char * buffer, int bitfrom, int nbits) {
 int loglog_estimate(LogLogCounter loglog) {
   
     int j;
+    int estimate;
     float sum = 0;
+
+    LOGLOG_ESTIMATE_START(loglog->bits, loglog->m);
     
     /* get the estimate for each bitmap */
     for (j = 0; j < loglog->m; j++) {
         sum += loglog->data[j];
     }
     
-    return 0.39701 * loglog->m * powf(2, sum / loglog->m);
+    estimate = 0.39701 * loglog->m * powf(2, sum / loglog->m);
+
+    LOGLOG_ESTIMATE_DONE(loglog->bits, loglog->m, estimate);
+
+    return estimate;
 
 }
 
@@ -92,7 +99,7 @@ void loglog_add_element(LogLogCounter loglog, const char * element, int elen) {
     unsigned char hash[HASH_LENGTH];
     
     /* compute the hash */
-    pg_md5_binary(element, elen, hash);
+    distinct_md5(element, elen, hash);
     
     /* add the hash into the counter */
     loglog_add_hash(loglog, hash);
@@ -164,6 +171,8 @@ LogLogCounter loglog_merge(LogLogCounter counter1, LogLogCounter counter2, bool
     else if (counter1->m != counter2->m)
         elog(ERROR, "bin count of estimators differs (%d != %d)", counter1->m, counter2->m);
 
+    LOGLOG_MERGE_START(counter1->bits, counter1->m);
+
     /* shall we create a new estimator, or merge into counter1 */
     if (! inplace)
         result = loglog_copy(counter1);
@@ -174,6 +183,8 @@ LogLogCounter loglog_merge(LogLogCounter counter1, LogLogCounter counter2, bool
     for (i = 0; i < result->m; i++)
         result->data[i] = (result->data[i] > counter2->data[i]) ? result->data[i] : counter2->data[i];
 
+    LOGLOG_MERGE_DONE(result->bits, result->m);
+
     return result;
 
-}
\ No newline at end of file
+}
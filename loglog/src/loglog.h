@@ -37,6 +37,9 @@ int loglog_get_size(float error);
 /* add element existence */
 void loglog_add_element(LogLogCounter loglog, const char * element, int elen);
 
+/* add a hash (HASH_LENGTH bytes) directly, without hashing */
+void loglog_add_hash(LogLogCounter loglog, const unsigned char * hash);
+
 /* get an estimate from the loglog counter */
 int loglog_estimate(LogLogCounter loglog);
 
@@ -5,8 +5,12 @@
 
 #include "postgres.h"
 #include "fmgr.h"
+#include "catalog/pg_type.h"
 #include "loglog.h"
+#include "distinct_hash.h"
+#include "distinct_multi.h"
 #include "utils/builtins.h"
+#include "utils/array.h"
 #include "utils/bytea.h"
 #include "utils/lsyscache.h"
 #include "lib/stringinfo.h"
@@ -19,14 +23,24 @@ PG_MODULE_MAGIC;
 #define VAL(CH)         ((CH) - '0')
 #define DIG(VAL)        ((VAL) + '0')
 
+/* we're using md5, which produces 16B (128-bit) values */
+#define HASH_LENGTH 16
+
 #define DEFAULT_ERROR       0.025
 
 PG_FUNCTION_INFO_V1(loglog_add_item);
 PG_FUNCTION_INFO_V1(loglog_add_item_agg);
 PG_FUNCTION_INFO_V1(loglog_add_item_agg2);
+PG_FUNCTION_INFO_V1(loglog_add_hashed);
+PG_FUNCTION_INFO_V1(loglog_add_hashed_agg);
+PG_FUNCTION_INFO_V1(loglog_add_hashed_agg2);
+PG_FUNCTION_INFO_V1(loglog_add_item_multi);
+PG_FUNCTION_INFO_V1(loglog_add_item_multi_agg);
 
 PG_FUNCTION_INFO_V1(loglog_merge_simple);
 PG_FUNCTION_INFO_V1(loglog_merge_agg);
+PG_FUNCTION_INFO_V1(loglog_union);
+PG_FUNCTION_INFO_V1(loglog_union_estimate);
 PG_FUNCTION_INFO_V1(loglog_get_estimate);
 PG_FUNCTION_INFO_V1(loglog_size);
 PG_FUNCTION_INFO_V1(loglog_init);
@@ -40,10 +54,20 @@ PG_FUNCTION_INFO_V1(loglog_length);
 Datum loglog_add_item(PG_FUNCTION_ARGS);
 Datum loglog_add_item_agg(PG_FUNCTION_ARGS);
 Datum loglog_add_item_agg2(PG_FUNCTION_ARGS);
+Datum loglog_add_hashed(PG_FUNCTION_ARGS);
+Datum loglog_add_hashed_agg(PG_FUNCTION_ARGS);
+Datum loglog_add_hashed_agg2(PG_FUNCTION_ARGS);
+Datum loglog_add_item_multi(PG_FUNCTION_ARGS);
+Datum loglog_add_item_multi_agg(PG_FUNCTION_ARGS);
+
+static void loglog_get_hash(FunctionCallInfo fcinfo, int argno, unsigned char * hash);
+static void loglog_add_varlena(LogLogCounter loglog, Datum element);
 
 Datum loglog_get_estimate(PG_FUNCTION_ARGS);
 Datum loglog_merge_simple(PG_FUNCTION_ARGS);
 Datum loglog_merge_agg(PG_FUNCTION_ARGS);
+Datum loglog_union(PG_FUNCTION_ARGS);
+Datum loglog_union_estimate(PG_FUNCTION_ARGS);
 
 Datum loglog_size(PG_FUNCTION_ARGS);
 Datum loglog_init(PG_FUNCTION_ARGS);
@@ -86,7 +110,7 @@ loglog_add_item(PG_FUNCTION_ARGS)
         /* it this a varlena type, passed by reference or by value ? */
         if (typlen == -1) {
             /* varlena */
-            loglog_add_element(loglog, VARDATA(element), VARSIZE(element) - VARHDRSZ);
+            loglog_add_varlena(loglog, element);
         } else if (typbyval) {
             /* fixed-length, passed by value */
             loglog_add_element(loglog, (char*)&element, typlen);
@@ -143,7 +167,7 @@ loglog_add_item_agg(PG_FUNCTION_ARGS)
         /* it this a varlena type, passed by reference or by value ? */
         if (typlen == -1) {
             /* varlena */
-            loglog_add_element(loglog, VARDATA(element), VARSIZE(element) - VARHDRSZ);
+            loglog_add_varlena(loglog, element);
         } else if (typbyval) {
             /* fixed-length, passed by value */
             loglog_add_element(loglog, (char*)&element, typlen);
@@ -191,7 +215,7 @@ loglog_add_item_agg2(PG_FUNCTION_ARGS)
         /* it this a varlena type, passed by reference or by value ? */
         if (typlen == -1) {
             /* varlena */
-            loglog_add_element(loglog, VARDATA(element), VARSIZE(element) - VARHDRSZ);
+            loglog_add_varlena(loglog, element);
         } else if (typbyval) {
             /* fixed-length, passed by value */
             loglog_add_element(loglog, (char*)&element, typlen);
@@ -206,6 +230,176 @@ loglog_add_item_agg2(PG_FUNCTION_ARGS)
 
 }
 
+Datum
+loglog_add_hashed(PG_FUNCTION_ARGS)
+{
+
+    LogLogCounter loglog;
+    unsigned char hash[HASH_LENGTH];
+
+    /* requires the estimator to be already created */
+    if (PG_ARGISNULL(0))
+        elog(ERROR, "loglog counter must not be NULL");
+
+    /* if the hash is not NULL, add it to the estimator (i.e. skip NULLs) */
+    if (! PG_ARGISNULL(1)) {
+
+        /* estimator (we know it's not a NULL value) */
+        loglog = (LogLogCounter)PG_GETARG_BYTEA_P(0);
+
+        loglog_get_hash(fcinfo, 1, hash);
+
+        loglog_add_hash(loglog, hash);
+
+    }
+
+    PG_RETURN_VOID();
+
+}
+
+Datum
+loglog_add_hashed_agg(PG_FUNCTION_ARGS)
+{
+
+    LogLogCounter loglog;
+    float errorRate; /* required error rate */
+
+    unsigned char hash[HASH_LENGTH];
+
+    /* create a new estimator (with requested error rate) or reuse the existing one */
+    if (PG_ARGISNULL(0)) {
+
+        errorRate = PG_GETARG_FLOAT4(2);
+
+        /* error rate between 0 and 1 (not 0) */
+        if ((errorRate <= 0) || (errorRate > 1))
+            elog(ERROR, "error rate has to be between 0 and 1");
+
+        loglog = loglog_create(errorRate);
+
+    } else { /* existing estimator */
+        loglog = (LogLogCounter)PG_GETARG_BYTEA_P(0);
+    }
+
+    /* add the hash to the estimator (skip NULLs) */
+    if (! PG_ARGISNULL(1)) {
+        loglog_get_hash(fcinfo, 1, hash);
+        loglog_add_hash(loglog, hash);
+    }
+
+    /* return the updated bytea */
+    PG_RETURN_BYTEA_P(loglog);
+    
+}
+
+Datum
+loglog_add_hashed_agg2(PG_FUNCTION_ARGS)
+{
+
+    LogLogCounter loglog;
+
+    unsigned char hash[HASH_LENGTH];
+
+    /* create a new estimator (with requested error rate) or reuse the existing one */
+    if (PG_ARGISNULL(0)) {
+        loglog = loglog_create(DEFAULT_ERROR);
+    } else { /* existing estimator */
+        loglog = (LogLogCounter)PG_GETARG_BYTEA_P(0);
+    }
+
+    /* add the hash to the estimator (skip NULLs) */
+    if (! PG_ARGISNULL(1)) {
+        loglog_get_hash(fcinfo, 1, hash);
+        loglog_add_hash(loglog, hash);
+    }
+
+    /* return the updated bytea */
+    PG_RETURN_BYTEA_P(loglog);
+
+}
+
+Datum
+loglog_add_item_multi(PG_FUNCTION_ARGS)
+{
+
+    LogLogCounter loglog;
+    unsigned char hash[HASH_LENGTH];
+
+    /* requires the estimator to be already created */
+    if (PG_ARGISNULL(0))
+        elog(ERROR, "loglog counter must not be NULL");
+
+    /* estimator (we know it's not a NULL value) */
+    loglog = (LogLogCounter)PG_GETARG_BYTEA_P(0);
+
+    /* add the key to the estimator (skip keys with NULL values) */
+    if (distinct_hash_multi(fcinfo, 1, hash))
+        loglog_add_hash(loglog, hash);
+
+    PG_RETURN_VOID();
+
+}
+
+Datum
+loglog_add_item_multi_agg(PG_FUNCTION_ARGS)
+{
+
+    LogLogCounter loglog;
+    unsigned char hash[HASH_LENGTH];
+
+    /* create a new estimator (with default parameters) or reuse the existing one */
+    if (PG_ARGISNULL(0)) {
+        loglog = loglog_create(DEFAULT_ERROR);
+    } else {
+        loglog = (LogLogCounter)PG_GETARG_BYTEA_P(0);
+    }
+
+    /* add the key to the estimator (skip keys with NULL values) */
+    if (distinct_hash_multi(fcinfo, 1, hash))
+        loglog_add_hash(loglog, hash);
+
+    /* return the updated bytea */
+    PG_RETURN_BYTEA_P(loglog);
+
+}
+
+/* Adds a varlena value (hashed by distinct_hash_varlena). */
+static void
+loglog_add_varlena(LogLogCounter loglog, Datum element)
+{
+
+    unsigned char hash[HASH_LENGTH];
+
+    distinct_hash_varlena(element, hash);
+
+    loglog_add_hash(loglog, hash);
+
+}
+
+/* Gets the hash from the argument - either the first HASH_LENGTH bytes of a bytea
+ * value (which has to be at least that long), or a bigint value expanded into
+ * HASH_LENGTH bytes. */
+static void
+loglog_get_hash(FunctionCallInfo fcinfo, int argno, unsigned char * hash)
+{
+
+    if (get_fn_expr_argtype(fcinfo->flinfo, argno) == INT8OID) {
+
+        distinct_hash_int64(PG_GETARG_INT64(argno), hash);
+
+    } else {
+
+        bytea * value = PG_GETARG_BYTEA_PP(argno);
+
+        if (VARSIZE_ANY_EXHDR(value) < HASH_LENGTH)
+            elog(ERROR, "hash has to be at least %d bytes", HASH_LENGTH);
+
+        memcpy(hash, VARDATA_ANY(value), HASH_LENGTH);
+
+    }
+
+}
+
 Datum
 loglog_merge_simple(PG_FUNCTION_ARGS)
 {
@@ -254,6 +448,94 @@ loglog_merge_agg(PG_FUNCTION_ARGS)
 
 }
 
+/* Merges all the counters in the array into a single new counter, allocated
+ * only once (merging them one by one using || allocates a new counter for
+ * each step). NULL elements are skipped, returns NULL if there are no other
+ * elements in the array. */
+static LogLogCounter
+loglog_union_array(ArrayType * counters)
+{
+
+    int i;
+    int nelems;
+    Datum *elems;
+    bool *nulls;
+    int16 typlen;
+    bool typbyval;
+    char typalign;
+    LogLogCounter result = NULL;
+
+    get_typlenbyvalalign(ARR_ELEMTYPE(counters), &typlen, &typbyval, &typalign);
+
+    deconstruct_array(counters, ARR_ELEMTYPE(counters), typlen, typbyval, typalign,
+                      &elems, &nulls, &nelems);
+
+    for (i = 0; i < nelems; i++) {
+
+        LogLogCounter counter;
+
+        if (nulls[i])
+            continue;
+
+        /* the elements may have short headers, or be compressed */
+        counter = (LogLogCounter)PG_DETOAST_DATUM(elems[i]);
+
+        if (result == NULL) {
+            /* the first counter - reuse the detoasted copy if there is one */
+            if ((Pointer)counter != DatumGetPointer(elems[i]))
+                result = counter;
+            else
+                result = loglog_copy(counter);
+            continue;
+        }
+
+        loglog_merge(result, counter, true);
+
+        if ((Pointer)counter != DatumGetPointer(elems[i]))
+            pfree(counter);
+
+    }
+
+    pfree(elems);
+    pfree(nulls);
+
+    return result;
+
+}
+
+Datum
+loglog_union(PG_FUNCTION_ARGS)
+{
+
+    LogLogCounter result = loglog_union_array(PG_GETARG_ARRAYTYPE_P(0));
+
+    if (result == NULL)
+        PG_RETURN_NULL();
+
+    PG_RETURN_BYTEA_P(result);
+
+}
+
+/* Estimate of the union of all the counters in the array, without returning
+ * the merged counter. */
+Datum
+loglog_union_estimate(PG_FUNCTION_ARGS)
+{
+
+    int estimate;
+    LogLogCounter result = loglog_union_array(PG_GETARG_ARRAYTYPE_P(0));
+
+    if (result == NULL)
+        PG_RETURN_NULL();
+
+    estimate = loglog_estimate(result);
+
+    pfree(result);
+
+    PG_RETURN_FLOAT4(estimate);
+
+}
+
 Datum
 loglog_get_estimate(PG_FUNCTION_ARGS)
 {
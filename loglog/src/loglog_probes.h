@@ -0,0 +1,21 @@
+/* Static tracepoints in the loglog estimator (see distinct_probes.h)
+ *
+ *   merge__start     (bits, m)
+ *   merge__done      (bits, m)
+ *   estimate__start  (bits, m)
+ *   estimate__done   (bits, m, estimate)
+ *
+ * Arguments are the geometry of the counter (number of index bits and bins),
+ * and the estimate for estimate__done.
+ */
+#ifndef LOGLOG_PROBES_H
+#define LOGLOG_PROBES_H
+
+#include "distinct_probes.h"
+
+#define LOGLOG_MERGE_START(bits, m)             DISTINCT_PROBE2(loglog, merge__start, bits, m)
+#define LOGLOG_MERGE_DONE(bits, m)              DISTINCT_PROBE2(loglog, merge__done, bits, m)
+#define LOGLOG_ESTIMATE_START(bits, m)          DISTINCT_PROBE2(loglog, estimate__start, bits, m)
+#define LOGLOG_ESTIMATE_DONE(bits, m, estimate) DISTINCT_PROBE3(loglog, estimate__done, bits, m, estimate)
+
+#endif   /* LOGLOG_PROBES_H */
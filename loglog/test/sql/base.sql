@@ -3,7 +3,7 @@ BEGIN;
 
 -- disable the notices for the create script (shell types etc.)
 SET client_min_messages = 'WARNING';
-\i sql/loglog_counter--1.2.4.sql
+\i sql/loglog_counter--1.3.0.sql
 SET client_min_messages = 'NOTICE';
 
 \set ECHO all
@@ -12,6 +12,16 @@ SELECT loglog_distinct(id, 0.02) BETWEEN 90000 AND 110000 val FROM generate_seri
 
 SELECT loglog_distinct(id::text, 0.02) BETWEEN 90000 AND 110000 val FROM generate_series(1,100000) s(id);
 
+SELECT loglog_union_estimate(array_agg(c)) = (# loglog_union(array_append(array_agg(c), NULL))) AND loglog_union_estimate(array_agg(c)) = (# loglog_merge(c)) AND loglog_union_estimate(array_agg(c)) BETWEEN 90000 AND 110000 val FROM (SELECT loglog_accum(id, 0.02) c FROM generate_series(1,100000) s(id) GROUP BY id % 10) foo;
+
+SELECT loglog_distinct_multi(id % 1000, id % 99) BETWEEN 89000 AND 109000 val FROM generate_series(1,100000) s(id);
+
+SELECT loglog_distinct_multi(id % 1000, id % 99) / loglog_distinct((id % 1000, id % 99)::text) BETWEEN 0.9 AND 1.1 val FROM generate_series(1,100000) s(id);
+
+SELECT (# loglog_accum_multi(id, CASE WHEN id % 2 = 0 THEN id END)) = loglog_distinct_multi(id, id) FILTER (WHERE id % 2 = 0) val FROM generate_series(1,100000) s(id);
+
+SELECT loglog_distinct_multi(a, b) BETWEEN 169000 AND 207000 val FROM (SELECT id % 1000, id % 99 FROM generate_series(1,100000) s(id) UNION ALL SELECT id % 99, id % 1000 FROM generate_series(1,100000) s(id)) foo(a, b);
+
 DO LANGUAGE plpgsql $$
 DECLARE
     v_counter  loglog_estimator := loglog_init(0.02);
@@ -0,0 +1,241 @@
+-- the estimate does not modify the aggregate state (e.g. for window aggregates)
+
+CREATE OR REPLACE AGGREGATE pcsa_distinct(anyelement, int, int)
+(
+    sfunc = pcsa_add_item_agg,
+    stype = pcsa_estimator,
+    finalfunc = pcsa_get_estimate,
+    finalfunc_modify = read_only
+);
+
+CREATE OR REPLACE AGGREGATE pcsa_distinct(anyelement)
+(
+    sfunc = pcsa_add_item_agg2,
+    stype = pcsa_estimator,
+    finalfunc = pcsa_get_estimate,
+    finalfunc_modify = read_only
+);
+
+-- pre-hashed values (bytea with at least 16 bytes, or bigint)
+
+CREATE FUNCTION pcsa_add_hash(counter pcsa_estimator, hash bytea) RETURNS void
+     AS 'MODULE_PATHNAME', 'pcsa_add_hashed'
+     LANGUAGE C;
+
+CREATE FUNCTION pcsa_add_hash(counter pcsa_estimator, hash bigint) RETURNS void
+     AS 'MODULE_PATHNAME', 'pcsa_add_hashed'
+     LANGUAGE C;
+
+CREATE FUNCTION pcsa_add_hashed_agg(counter pcsa_estimator, hash bytea, nbitmaps integer, keysize integer) RETURNS pcsa_estimator
+     AS 'MODULE_PATHNAME', 'pcsa_add_hashed_agg'
+     LANGUAGE C;
+
+CREATE FUNCTION pcsa_add_hashed_agg(counter pcsa_estimator, hash bigint, nbitmaps integer, keysize integer) RETURNS pcsa_estimator
+     AS 'MODULE_PATHNAME', 'pcsa_add_hashed_agg'
+     LANGUAGE C;
+
+CREATE FUNCTION pcsa_add_hashed_agg2(counter pcsa_estimator, hash bytea) RETURNS pcsa_estimator
+     AS 'MODULE_PATHNAME', 'pcsa_add_hashed_agg2'
+     LANGUAGE C;
+
+CREATE FUNCTION pcsa_add_hashed_agg2(counter pcsa_estimator, hash bigint) RETURNS pcsa_estimator
+     AS 'MODULE_PATHNAME', 'pcsa_add_hashed_agg2'
+     LANGUAGE C;
+
+CREATE AGGREGATE pcsa_distinct_hashed(bytea, int, int)
+(
+    sfunc = pcsa_add_hashed_agg,
+    stype = pcsa_estimator,
+    finalfunc = pcsa_get_estimate,
+    finalfunc_modify = read_only
+);
+
+CREATE AGGREGATE pcsa_distinct_hashed(bytea)
+(
+    sfunc = pcsa_add_hashed_agg2,
+    stype = pcsa_estimator,
+    finalfunc = pcsa_get_estimate,
+    finalfunc_modify = read_only
+);
+
+CREATE AGGREGATE pcsa_accum_hashed(bytea, int, int)
+(
+    sfunc = pcsa_add_hashed_agg,
+    stype = pcsa_estimator
+);
+
+CREATE AGGREGATE pcsa_accum_hashed(bytea)
+(
+    sfunc = pcsa_add_hashed_agg2,
+    stype = pcsa_estimator
+);
+
+CREATE AGGREGATE pcsa_distinct_hashed(bigint, int, int)
+(
+    sfunc = pcsa_add_hashed_agg,
+    stype = pcsa_estimator,
+    finalfunc = pcsa_get_estimate,
+    finalfunc_modify = read_only
+);
+
+CREATE AGGREGATE pcsa_distinct_hashed(bigint)
+(
+    sfunc = pcsa_add_hashed_agg2,
+    stype = pcsa_estimator,
+    finalfunc = pcsa_get_estimate,
+    finalfunc_modify = read_only
+);
+
+CREATE AGGREGATE pcsa_accum_hashed(bigint, int, int)
+(
+    sfunc = pcsa_add_hashed_agg,
+    stype = pcsa_estimator
+);
+
+CREATE AGGREGATE pcsa_accum_hashed(bigint)
+(
+    sfunc = pcsa_add_hashed_agg2,
+    stype = pcsa_estimator
+);
+
+-- multi-column keys, e.g. pcsa_distinct_multi(user_id, device_id) (keys with any NULL value are skipped)
+CREATE FUNCTION pcsa_add_item_multi(counter pcsa_estimator, VARIADIC items "any") RETURNS void
+     AS 'MODULE_PATHNAME', 'pcsa_add_item_multi'
+     LANGUAGE C;
+
+CREATE FUNCTION pcsa_add_item_multi_agg(counter pcsa_estimator, VARIADIC items "any") RETURNS pcsa_estimator
+     AS 'MODULE_PATHNAME', 'pcsa_add_item_multi_agg'
+     LANGUAGE C PARALLEL SAFE;
+
+CREATE AGGREGATE pcsa_distinct_multi(VARIADIC "any")
+(
+    sfunc = pcsa_add_item_multi_agg,
+    stype = pcsa_estimator,
+    finalfunc = pcsa_get_estimate,
+    finalfunc_modify = read_only
+);
+
+CREATE AGGREGATE pcsa_accum_multi(VARIADIC "any")
+(
+    sfunc = pcsa_add_item_multi_agg,
+    stype = pcsa_estimator
+);
+
+-- pcsa_distinct for smallint, integer, bigint and uuid values (without md5)
+CREATE FUNCTION pcsa_add_int2_agg(counter pcsa_estimator, item smallint, nbitmaps integer, keysize integer) RETURNS pcsa_estimator
+     AS 'MODULE_PATHNAME', 'pcsa_add_int2_agg'
+     LANGUAGE C PARALLEL SAFE;
+
+CREATE FUNCTION pcsa_add_int2_agg(counter pcsa_estimator, item smallint) RETURNS pcsa_estimator
+     AS 'MODULE_PATHNAME', 'pcsa_add_int2_agg'
+     LANGUAGE C PARALLEL SAFE;
+
+CREATE FUNCTION pcsa_add_int4_agg(counter pcsa_estimator, item integer, nbitmaps integer, keysize integer) RETURNS pcsa_estimator
+     AS 'MODULE_PATHNAME', 'pcsa_add_int4_agg'
+     LANGUAGE C PARALLEL SAFE;
+
+CREATE FUNCTION pcsa_add_int4_agg(counter pcsa_estimator, item integer) RETURNS pcsa_estimator
+     AS 'MODULE_PATHNAME', 'pcsa_add_int4_agg'
+     LANGUAGE C PARALLEL SAFE;
+
+CREATE FUNCTION pcsa_add_int8_agg(counter pcsa_estimator, item bigint, nbitmaps integer, keysize integer) RETURNS pcsa_estimator
+     AS 'MODULE_PATHNAME', 'pcsa_add_int8_agg'
+     LANGUAGE C PARALLEL SAFE;
+
+CREATE FUNCTION pcsa_add_int8_agg(counter pcsa_estimator, item bigint) RETURNS pcsa_estimator
+     AS 'MODULE_PATHNAME', 'pcsa_add_int8_agg'
+     LANGUAGE C PARALLEL SAFE;
+
+CREATE FUNCTION pcsa_add_uuid_agg(counter pcsa_estimator, item uuid, nbitmaps integer, keysize integer) RETURNS pcsa_estimator
+     AS 'MODULE_PATHNAME', 'pcsa_add_uuid_agg'
+     LANGUAGE C PARALLEL SAFE;
+
+CREATE FUNCTION pcsa_add_uuid_agg(counter pcsa_estimator, item uuid) RETURNS pcsa_estimator
+     AS 'MODULE_PATHNAME', 'pcsa_add_uuid_agg'
+     LANGUAGE C PARALLEL SAFE;
+
+CREATE AGGREGATE pcsa_distinct(smallint, integer, integer)
+(
+    sfunc = pcsa_add_int2_agg,
+    stype = pcsa_estimator,
+    finalfunc = pcsa_get_estimate,
+    finalfunc_modify = read_only
+);
+
+CREATE AGGREGATE pcsa_distinct(smallint)
+(
+    sfunc = pcsa_add_int2_agg,
+    stype = pcsa_estimator,
+    finalfunc = pcsa_get_estimate,
+    finalfunc_modify = read_only
+);
+
+CREATE AGGREGATE pcsa_distinct(integer, integer, integer)
+(
+    sfunc = pcsa_add_int4_agg,
+    stype = pcsa_estimator,
+    finalfunc = pcsa_get_estimate,
+    finalfunc_modify = read_only
+);
+
+CREATE AGGREGATE pcsa_distinct(integer)
+(
+    sfunc = pcsa_add_int4_agg,
+    stype = pcsa_estimator,
+    finalfunc = pcsa_get_estimate,
+    finalfunc_modify = read_only
+);
+
+CREATE AGGREGATE pcsa_distinct(bigint, integer, integer)
+(
+    sfunc = pcsa_add_int8_agg,
+    stype = pcsa_estimator,
+    finalfunc = pcsa_get_estimate,
+    finalfunc_modify = read_only
+);
+
+CREATE AGGREGATE pcsa_distinct(bigint)
+(
+    sfunc = pcsa_add_int8_agg,
+    stype = pcsa_estimator,
+    finalfunc = pcsa_get_estimate,
+    finalfunc_modify = read_only
+);
+
+CREATE AGGREGATE pcsa_distinct(uuid, integer, integer)
+(
+    sfunc = pcsa_add_uuid_agg,
+    stype = pcsa_estimator,
+    finalfunc = pcsa_get_estimate,
+    finalfunc_modify = read_only
+);
+
+CREATE AGGREGATE pcsa_distinct(uuid)
+(
+    sfunc = pcsa_add_uuid_agg,
+    stype = pcsa_estimator,
+    finalfunc = pcsa_get_estimate,
+    finalfunc_modify = read_only
+);
+
+-- Union of arrays of estimators (NULL elements are skipped)
+
+-- merges all the estimators in the array into a single one
+CREATE FUNCTION pcsa_union(estimators pcsa_estimator[]) RETURNS pcsa_estimator
+     AS 'MODULE_PATHNAME', 'pcsa_union'
+     LANGUAGE C STRICT PARALLEL SAFE;
+
+-- estimate of the union of all the estimators in the array
+CREATE FUNCTION pcsa_union_estimate(estimators pcsa_estimator[]) RETURNS real
+     AS 'MODULE_PATHNAME', 'pcsa_union_estimate'
+     LANGUAGE C STRICT PARALLEL SAFE;
+
+-- size of the estimator with a given bitmap width (32 or 64 bits, the default is 32)
+CREATE FUNCTION pcsa_size(nbitmaps int, keysize int, width int) RETURNS int
+     AS 'MODULE_PATHNAME', 'pcsa_size'
+     LANGUAGE C;
+
+-- creates a new pcsa estimator with a given bitmap width (32 or 64 bits)
+CREATE FUNCTION pcsa_init(nbitmaps int, keysize int, width int) RETURNS pcsa_estimator
+     AS 'MODULE_PATHNAME', 'pcsa_init'
+     LANGUAGE C;
@@ -5,102 +5,84 @@
 #include <string.h>
 
 #include "postgres.h"
-#include "libpq/md5.h"
+#include "distinct_md5.h"
 
 #include "pcsa.h"
+#include "pcsa_probes.h"
 
 #define HASH_LENGTH 16
 
-int pcsa_get_min_bit(const unsigned char * buffer, int byteFrom, int bytes);
-int pcsa_get_r(const unsigned char * buffer, int byteFrom, int bytes);
+/* number of hashes with bitmaps prefetched at once by pcsa_add_hashes */
+#define PCSA_BATCH_SIZE 32
+
+#if defined(__GNUC__) || defined(__clang__)
+#define PCSA_PREFETCH(addr)  __builtin_prefetch((addr), 1, 3)
+#else
+#define PCSA_PREFETCH(addr)  ((void) 0)
+#endif
+
 int pcsa_estimate(PCSACounter pcsa);
 
-void pcsa_add_hash(PCSACounter pcsa, const unsigned char * hash);
 void pcsa_reset_internal(PCSACounter pcsa);
 
+static inline uint64 pcsa_get_word(PCSACounter pcsa, int idx);
+static inline void pcsa_set_word(PCSACounter pcsa, int idx, uint64 word);
+static inline int pcsa_lowest_bit(uint64 word);
+static inline void pcsa_hash_bit(PCSACounter pcsa, const unsigned char * hash, int * idx, int * bit);
+
+/* size of the counter created by older versions (before the width field) */
+#define PCSA_LEGACY_SIZE(nmaps, keysize) \
+    (offsetof(PCSACounterData,width) + (HASH_LENGTH - (keysize)) * (nmaps))
+
 /* allocate bitmap with a given length (to store the given number of bitmaps) */
-PCSACounter pcsa_create(int nmaps, int keysize) {
+PCSACounter pcsa_create(int nmaps, int keysize, int width) {
   
-  /* the bitmap is allocated as part of this memory block (-1 as one char is already in) */
+  /* the bitmap is allocated as part of this memory block */
   PCSACounter p;
-  int i = 0;
-  
-  size_t length = offsetof(PCSACounterData,bitmap) + (HASH_LENGTH - keysize) * nmaps;
-  
-  p = (PCSACounter)palloc(length);
+  size_t length;
+
+  if ((width != 32) && (width != 64))
+      elog(ERROR, "bitmap width has to be 32 or 64 bits");
+
+  length = pcsa_get_size(nmaps, keysize, width);
   
-  for (i = 0; i < (HASH_LENGTH - keysize) * nmaps; i++) {
-      p->bitmap[i] = 0;
-  }
+  p = (PCSACounter)palloc0(length);
 
   SET_VARSIZE(p, length);
   
   p->nmaps = nmaps;
   p->keysize = keysize;
+  p->width = width;
   
   return p;
   
 }
 
-int pcsa_get_size(int nmaps, int keysize) {
-    return offsetof(PCSACounterData,bitmap) + (HASH_LENGTH - keysize) * nmaps;
-}
-
-/* searches for the leftmost 1 */
-int pcsa_get_min_bit(const unsigned char * buffer, int byteFrom, int bytes) {
-  
-    int k = 0;
-    int byteIdx = 0;
-    int bitIdx = 0;
-    
-    for (k = byteFrom * 8; k < ((byteFrom + bytes) * 8); k++) {
-        
-        byteIdx = k / 8;
-        bitIdx=  k % 8;
-        
-        if ((buffer[byteIdx] & (0x1 << bitIdx)) != 0) {
-            return k - byteFrom *8;
-        }
-        
-    }
-    
-    return (HASH_LENGTH*8);
-  
-}
-
-/* searches for the leftmost zero */
-int pcsa_get_r(const unsigned char * buffer, int byteFrom, int bytes) {
-  
-    int k = 0;
-    int byteIdx = 0;
-    int bitIdx = 0;
-    
-    for (k = byteFrom * 8; k < ((byteFrom + bytes) * 8); k++) {
-        
-        byteIdx = k / 8;
-        bitIdx=  k % 8;
-        
-        if ((buffer[byteIdx] & (0x1 << bitIdx)) == 0) {
-            return k - byteFrom*8;
-        }
-        
-    }
-    
-    return (HASH_LENGTH*8);
-  
+int pcsa_get_size(int nmaps, int keysize, int width) {
+    return offsetof(PCSACounterData,bitmap) + (width / 8) * nmaps;
 }
 
 int pcsa_estimate(PCSACounter pcsa) {
   
     float bits = 0;
     int bitmap;
+    int estimate;
+
+    PCSA_ESTIMATE_START(pcsa->nmaps, pcsa->keysize);
     
-    /* get the estimate for each bitmap */
+    /* get the estimate for each bitmap (the lowest zero bit) */
     for (bitmap = 0; bitmap < pcsa->nmaps; bitmap++) {
-        bits += pcsa_get_r(pcsa->bitmap, (bitmap * (HASH_LENGTH - pcsa->keysize)), (HASH_LENGTH - pcsa->keysize));
+
+        uint64 word = pcsa_get_word(pcsa, bitmap);
+
+        bits += (~word == 0) ? 64 : pcsa_lowest_bit(~word);
     }
     
-    return (pcsa->nmaps / 0.77351) * powf(2, bits/pcsa->nmaps);
+    estimate = (pcsa->nmaps / 0.77351) * powf(2, bits/pcsa->nmaps);
+
+    PCSA_ESTIMATE_DONE(pcsa->nmaps, pcsa->keysize, estimate);
+
+    return estimate;
   
 }
 
@@ -110,7 +92,7 @@ void pcsa_add_element(PCSACounter pcsa, const char * element, int elen) {
     unsigned char hash[HASH_LENGTH];
     
     /* compute the hash */
-    pg_md5_binary(element, elen, hash);
+    distinct_md5(element, elen, hash);
     
     /* add the hash to the counter */
     pcsa_add_hash(pcsa, hash);
@@ -119,40 +101,71 @@ void pcsa_add_element(PCSACounter pcsa, const char * element, int elen) {
 
 void pcsa_add_hash(PCSACounter pcsa, const unsigned char * hash) {
   
-    /* get the hash */
-    unsigned int bitmapIdx;
+    int bitmapIdx;
     int bit;
-    int byteIdx;
-    int bitIdx;
     
-    memcpy(&bitmapIdx, hash, pcsa->keysize);
-    
-    bitmapIdx = bitmapIdx % pcsa->nmaps;
+    pcsa_hash_bit(pcsa, hash, &bitmapIdx, &bit);
     
-    /* get the min bit (but skip the bytes used for key) */
-    bit = pcsa_get_min_bit(hash, pcsa->keysize, HASH_LENGTH - pcsa->keysize);
-        
-    /* get the current byte/bit index */
-    byteIdx = (HASH_LENGTH - pcsa->keysize) * bitmapIdx + bit / 8;
-    bitIdx = bit % 8;
-        
     /* set the bit of the bitmap */
-    pcsa->bitmap[byteIdx] = pcsa->bitmap[byteIdx] | (0x1 << bitIdx);
+    pcsa_set_word(pcsa, bitmapIdx, pcsa_get_word(pcsa, bitmapIdx) | (UINT64CONST(1) << bit));
   
 }
 
+/* Adds an array of hashes, the same as pcsa_add_hash for each of them. The
+ * bitmaps for a block of hashes are prefetched before setting the bits, so
+ * that with many bitmaps the cache misses overlap (instead of stalling each
+ * update one by one). */
+void pcsa_add_hashes(PCSACounter pcsa, const unsigned char * hashes, int nhashes) {
+
+    int i, j;
+    int idx[PCSA_BATCH_SIZE];
+    int bit[PCSA_BATCH_SIZE];
+
+    PCSA_BATCH_START(pcsa->nmaps, pcsa->keysize, nhashes);
+
+    for (i = 0; i < nhashes; i += PCSA_BATCH_SIZE) {
+
+        int n = Min(PCSA_BATCH_SIZE, nhashes - i);
+
+        for (j = 0; j < n; j++) {
+            pcsa_hash_bit(pcsa, hashes + (i + j) * HASH_LENGTH, &idx[j], &bit[j]);
+            PCSA_PREFETCH(pcsa->bitmap + idx[j] * (pcsa->width / 8));
+        }
+
+        for (j = 0; j < n; j++)
+            pcsa_set_word(pcsa, idx[j], pcsa_get_word(pcsa, idx[j]) | (UINT64CONST(1) << bit[j]));
+    }
+
+    PCSA_BATCH_DONE(pcsa->nmaps, pcsa->keysize, nhashes);
+
+}
+
+/* The bitmap (from the first keysize bytes) and the bit to set in it. */
+static inline void pcsa_hash_bit(PCSACounter pcsa, const unsigned char * hash, int * idx, int * bit) {
+
+    unsigned int bitmapIdx = 0;
+    uint64 value;
+
+    memcpy(&bitmapIdx, hash, pcsa->keysize);
+
+    *idx = bitmapIdx % pcsa->nmaps;
+
+    /* the lowest 1 in the bytes following the key (keysize is at most 4) */
+    memcpy(&value, hash + pcsa->keysize, sizeof(uint64));
+
+    *bit = (value == 0) ? (pcsa->width - 1) : Min(pcsa_lowest_bit(value), pcsa->width - 1);
+
+}
+
 void pcsa_reset_internal(PCSACounter pcsa) {
     
-    int i;
-    for (i = 0; i < (HASH_LENGTH - pcsa->keysize) * pcsa->nmaps; i++) {
-        pcsa->bitmap[i] = 0;
-    }
+    memset(pcsa->bitmap, 0, (pcsa->width / 8) * pcsa->nmaps);
   
 }
 
 PCSACounter pcsa_copy(PCSACounter counter) {
 
-    size_t length = counter->length;
+    size_t length = VARSIZE(counter);
     PCSACounter copy = (PCSACounter)palloc(length);
 
     memcpy(copy, counter, length);
@@ -168,21 +181,127 @@ PCSACounter pcsa_merge(PCSACounter counter1, PCSACounter counter2, bool inplace)
 
     if ((counter1->length != counter2->length) ||
         (counter1->nmaps  != counter2->nmaps) ||
-        (counter1->keysize != counter2->keysize)) {
+        (counter1->keysize != counter2->keysize) ||
+        (counter1->width != counter2->width)) {
 
         elog(ERROR, "mismatch of PCSA estimator parameters - can't merge");
 
     }
 
+    PCSA_MERGE_START(counter1->nmaps, counter1->keysize);
+
     if (inplace)
         result = counter1;
     else
         result = pcsa_copy(counter1);
 
-    for (i = 0; i < (HASH_LENGTH - result->keysize) * result->nmaps; i++) {
-        result->bitmap[i] |= counter2->bitmap[i];
+    for (i = 0; i < result->nmaps; i++) {
+        pcsa_set_word(result, i, pcsa_get_word(result, i) | pcsa_get_word(counter2, i));
     }
 
+    PCSA_MERGE_DONE(result->nmaps, result->keysize);
+
     return result;
 
 }
+
+/* Counters in the current format have width 32 or 64, matching the length.
+ *
+ * The format is not marked explicitly, so this is not entirely unambiguous.
+ * A legacy counter with 1 bitmap and 4B key has the same length as a current
+ * one with a single 64-bit word, and the "width" is then the lowest 32 bits of
+ * the old bitmap. If those are exactly 0x40 (bit 6 set, bits 0-5 not set), the
+ * counter is treated as a current one. The lowest bits get set first, so this
+ * is extremely unlikely (but not impossible). */
+bool pcsa_is_legacy(PCSACounter counter) {
+
+    return ! (((counter->width == 32) || (counter->width == 64)) &&
+              (VARSIZE(counter) == pcsa_get_size(counter->nmaps, counter->keysize, counter->width)));
+
+}
+
+/* Converts a counter created by an older version (with HASH_LENGTH - keysize
+ * bytes per bitmap) to words of the default width, so that it can be merged
+ * with new counters. The old bitmaps use bit (k % 8) of byte (k / 8) for bit
+ * k, and the bits above the width are folded into the highest bit (just like
+ * in pcsa_add_hash, those are set only with absurd numbers of values). */
+PCSACounter pcsa_upgrade(PCSACounter counter) {
+
+    int i, j;
+    int nmaps = counter->nmaps;
+    int keysize = counter->keysize;
+    int oldbytes = HASH_LENGTH - keysize;
+    PCSACounter result;
+
+    if (! pcsa_is_legacy(counter))
+        return counter;
+
+    if ((keysize < 1) || (keysize > 4) || (nmaps < 1) ||
+        (VARSIZE(counter) != PCSA_LEGACY_SIZE(nmaps, keysize)))
+        elog(ERROR, "invalid PCSA estimator (length %d, %d bitmaps, key size %d)",
+             (int) VARSIZE(counter), nmaps, keysize);
+
+    result = pcsa_create(nmaps, keysize, PCSA_DEFAULT_WIDTH);
+
+    for (i = 0; i < nmaps; i++) {
+
+        /* the bitmaps start where the width is now */
+        const unsigned char *old = (const unsigned char *) &counter->width + i * oldbytes;
+        uint64 word = 0;
+
+        for (j = 0; j < oldbytes * 8; j++) {
+            if (old[j / 8] & (0x1 << (j % 8)))
+                word |= UINT64CONST(1) << Min(j, PCSA_DEFAULT_WIDTH - 1);
+        }
+
+        pcsa_set_word(result, i, word);
+    }
+
+    return result;
+
+}
+
+/* The bitmaps may not be aligned, so the words are accessed using memcpy
+ * (which compiles into a plain load/store). */
+static inline uint64 pcsa_get_word(PCSACounter pcsa, int idx) {
+
+    if (pcsa->width == 32) {
+        uint32 word;
+        memcpy(&word, pcsa->bitmap + idx * sizeof(uint32), sizeof(uint32));
+        return word;
+    } else {
+        uint64 word;
+        memcpy(&word, pcsa->bitmap + idx * sizeof(uint64), sizeof(uint64));
+        return word;
+    }
+
+}
+
+static inline void pcsa_set_word(PCSACounter pcsa, int idx, uint64 word) {
+
+    if (pcsa->width == 32) {
+        uint32 word32 = (uint32) word;
+        memcpy(pcsa->bitmap + idx * sizeof(uint32), &word32, sizeof(uint32));
+    } else {
+        memcpy(pcsa->bitmap + idx * sizeof(uint64), &word, sizeof(uint64));
+    }
+
+}
+
+/* index of the lowest 1 bit (the word must not be 0) */
+static inline int pcsa_lowest_bit(uint64 word) {
+
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_ctzll(word);
+#else
+    int bit = 0;
+
+    while ((word & 1) == 0) {
+        word >>= 1;
+        bit++;
+    }
+
+    return bit;
+#endif
+
+}
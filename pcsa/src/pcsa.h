@@ -7,13 +7,19 @@
  *
  * There is a small change of the implementation - the original algorithm
  * divides the hash value into two parts (hash MOD m) and (hash DIV m), but
- * we do it a bit differently - we use the first 2 bytes (16 bits) to compute
- * the bitmap index, and the remaining bytes.
+ * we do it a bit differently - we use the first keysize bytes to compute
+ * the bitmap index, and the following bytes to pick the bit.
  *
- * FIXME The bitmaps are too big (about 15B each, which is way too much as
- * the length in bits determines the possible number of distict values to be
- * tracked - 4B = 32b makes it possible to track up to 2^32 distinct values).
- * So the bitmaps might be much smaller in reality.
+ * Each bitmap is a 32-bit or 64-bit word (the width is stored in the
+ * counter), which is plenty - the bitmap only needs about log2(n/nmaps)
+ * bits, so 32 bits are enough for billions of distinct values per bitmap.
+ * The words are in native byte order, and may not be aligned (the type
+ * uses int alignment), so they're accessed using memcpy.
+ *
+ * Counters created by older versions use (HASH_LENGTH - keysize) bytes per
+ * bitmap, with the bitmaps starting right after the keysize (there's no
+ * width field). Those are converted by pcsa_upgrade to the default width,
+ * the low bits of the old bitmaps are the same bits as in the words.
  */
 typedef struct PCSACounterData {
     
@@ -25,23 +31,42 @@ typedef struct PCSACounterData {
     
     /* number of bytes used for bitmap index */
     int keysize;
+
+    /* bits per bitmap (32 or 64) */
+    int width;
     
-    /* bitmap used to keep the list of items (uses the very same trick as in
-     * the varlena type in include/c.h */
+    /* bitmaps (nmaps words, each width/8 bytes), uses the very same trick
+     * as the varlena type in include/c.h */
     unsigned char bitmap[1];
     
 } PCSACounterData;
 
 typedef PCSACounterData * PCSACounter;
 
+/* default bits per bitmap */
+#define PCSA_DEFAULT_WIDTH  32
+
 /* creates an optimal bloom filter for the given bitmap size and number of
  * bitmaps (and number of bytes to use for key) */
-PCSACounter pcsa_create(int nmaps, int keysize);
-int pcsa_get_size(int nmaps, int keysize);
+PCSACounter pcsa_create(int nmaps, int keysize, int width);
+int pcsa_get_size(int nmaps, int keysize, int width);
+
+/* converts counter in the format used by older versions (returns a new
+ * counter), counters in the current format are returned as they are */
+PCSACounter pcsa_upgrade(PCSACounter counter);
+
+/* is the counter in the format used by older versions? */
+bool pcsa_is_legacy(PCSACounter counter);
 
 /* add element existence */
 void pcsa_add_element(PCSACounter pcsa, const char * element, int elen);
 
+/* add a hash (HASH_LENGTH bytes) directly, without hashing */
+void pcsa_add_hash(PCSACounter pcsa, const unsigned char * hash);
+
+/* add an array of hashes, prefetching the bitmaps (faster for large counters) */
+void pcsa_add_hashes(PCSACounter pcsa, const unsigned char * hashes, int nhashes);
+
 /* get an estimate from the probabilistic counter */
 int pcsa_estimate(PCSACounter pcsa);
 
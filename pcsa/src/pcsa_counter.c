@@ -5,10 +5,15 @@
 
 #include "postgres.h"
 #include "fmgr.h"
+#include "catalog/pg_type.h"
 #include "pcsa.h"
+#include "distinct_hash.h"
+#include "distinct_multi.h"
 #include "utils/builtins.h"
+#include "utils/array.h"
 #include "utils/bytea.h"
 #include "utils/lsyscache.h"
+#include "utils/uuid.h"
 #include "lib/stringinfo.h"
 #include "libpq/pqformat.h"
 
@@ -19,17 +24,39 @@ PG_MODULE_MAGIC;
 #define VAL(CH)         ((CH) - '0')
 #define DIG(VAL)        ((VAL) + '0')
 
+/* we're using md5, which produces 16B (128-bit) values */
+#define HASH_LENGTH 16
+
 #define DEFAULT_NBITMAPS    64
 #define DEFAULT_KEYSIZE     4
 
 #define MAX_KEYSIZE         4
 #define MAX_BITMAPS         2048
 
+/* counter argument, converted from the old format if needed (the converted
+ * counter is a copy, so only for functions returning the counter or just
+ * reading it) */
+#define PG_GETARG_PCSA(n)   pcsa_upgrade((PCSACounter)PG_GETARG_BYTEA_P(n))
+
+/* counter argument modified in place, has to be in the current format */
+#define PG_GETARG_PCSA_INPLACE(n)   pcsa_check_inplace((PCSACounter)PG_GETARG_BYTEA_P(n))
+
 PG_FUNCTION_INFO_V1(pcsa_add_item);
 PG_FUNCTION_INFO_V1(pcsa_add_item_agg);
 PG_FUNCTION_INFO_V1(pcsa_add_item_agg2);
+PG_FUNCTION_INFO_V1(pcsa_add_hashed);
+PG_FUNCTION_INFO_V1(pcsa_add_hashed_agg);
+PG_FUNCTION_INFO_V1(pcsa_add_hashed_agg2);
+PG_FUNCTION_INFO_V1(pcsa_add_item_multi);
+PG_FUNCTION_INFO_V1(pcsa_add_item_multi_agg);
+PG_FUNCTION_INFO_V1(pcsa_add_int2_agg);
+PG_FUNCTION_INFO_V1(pcsa_add_int4_agg);
+PG_FUNCTION_INFO_V1(pcsa_add_int8_agg);
+PG_FUNCTION_INFO_V1(pcsa_add_uuid_agg);
 
 PG_FUNCTION_INFO_V1(pcsa_merge_agg);
+PG_FUNCTION_INFO_V1(pcsa_union);
+PG_FUNCTION_INFO_V1(pcsa_union_estimate);
 PG_FUNCTION_INFO_V1(pcsa_merge_simple);
 PG_FUNCTION_INFO_V1(pcsa_get_estimate);
 PG_FUNCTION_INFO_V1(pcsa_size);
@@ -44,8 +71,24 @@ PG_FUNCTION_INFO_V1(pcsa_length);
 Datum pcsa_add_item(PG_FUNCTION_ARGS);
 Datum pcsa_add_item_agg(PG_FUNCTION_ARGS);
 Datum pcsa_add_item_agg2(PG_FUNCTION_ARGS);
+Datum pcsa_add_hashed(PG_FUNCTION_ARGS);
+Datum pcsa_add_hashed_agg(PG_FUNCTION_ARGS);
+Datum pcsa_add_hashed_agg2(PG_FUNCTION_ARGS);
+Datum pcsa_add_item_multi(PG_FUNCTION_ARGS);
+Datum pcsa_add_item_multi_agg(PG_FUNCTION_ARGS);
+Datum pcsa_add_int2_agg(PG_FUNCTION_ARGS);
+Datum pcsa_add_int4_agg(PG_FUNCTION_ARGS);
+Datum pcsa_add_int8_agg(PG_FUNCTION_ARGS);
+Datum pcsa_add_uuid_agg(PG_FUNCTION_ARGS);
+
+static void pcsa_get_hash(FunctionCallInfo fcinfo, int argno, unsigned char * hash);
+static PCSACounter pcsa_get_agg_counter(FunctionCallInfo fcinfo);
+static void pcsa_add_varlena(PCSACounter pcsa, Datum element);
+static PCSACounter pcsa_check_inplace(PCSACounter pcsa);
 
 Datum pcsa_merge_agg(PG_FUNCTION_ARGS);
+Datum pcsa_union(PG_FUNCTION_ARGS);
+Datum pcsa_union_estimate(PG_FUNCTION_ARGS);
 Datum pcsa_merge_simple(PG_FUNCTION_ARGS);
 Datum pcsa_get_estimate(PG_FUNCTION_ARGS);
 Datum pcsa_size(PG_FUNCTION_ARGS);
@@ -78,7 +121,7 @@ pcsa_add_item(PG_FUNCTION_ARGS)
         char        typalign;
 
         /* estimator (we know it's not a NULL value) */
-        pcsa = (PCSACounter)PG_GETARG_BYTEA_P(0);
+        pcsa = PG_GETARG_PCSA_INPLACE(0);
 
         /* TODO The requests for type info shouldn't be a problem (thanks to lsyscache),
          * but if it turns out to have a noticeable impact it's possible to cache that
@@ -90,7 +133,7 @@ pcsa_add_item(PG_FUNCTION_ARGS)
         /* it this a varlena type, passed by reference or by value ? */
         if (typlen == -1) {
             /* varlena */
-            pcsa_add_element(pcsa, VARDATA(element), VARSIZE(element) - VARHDRSZ);
+            pcsa_add_varlena(pcsa, element);
         } else if (typbyval) {
             /* fixed-length, passed by value */
             pcsa_add_element(pcsa, (char*)&element, typlen);
@@ -133,10 +176,10 @@ pcsa_add_item_agg(PG_FUNCTION_ARGS)
             elog(ERROR, "number of bitmaps has to be between 1 and %d", MAX_BITMAPS);
         }
         
-        pcsa = pcsa_create(bitmaps, keysize);
+        pcsa = pcsa_create(bitmaps, keysize, PCSA_DEFAULT_WIDTH);
 
     } else { /* existing estimator */
-        pcsa = (PCSACounter)PG_GETARG_BYTEA_P(0);
+        pcsa = PG_GETARG_PCSA(0);
     }
 
     /* add the item to the estimator (skip NULLs) */
@@ -152,7 +195,7 @@ pcsa_add_item_agg(PG_FUNCTION_ARGS)
         /* it this a varlena type, passed by reference or by value ? */
         if (typlen == -1) {
             /* varlena */
-            pcsa_add_element(pcsa, VARDATA(element), VARSIZE(element) - VARHDRSZ);
+            pcsa_add_varlena(pcsa, element);
         } else if (typbyval) {
             /* fixed-length, passed by value */
             pcsa_add_element(pcsa, (char*)&element, typlen);
@@ -182,9 +225,9 @@ pcsa_add_item_agg2(PG_FUNCTION_ARGS)
 
     /* create a new estimator (with requested error rate) or reuse the existing one */
     if (PG_ARGISNULL(0)) {
-        pcsa = pcsa_create(DEFAULT_NBITMAPS, DEFAULT_KEYSIZE);
+        pcsa = pcsa_create(DEFAULT_NBITMAPS, DEFAULT_KEYSIZE, PCSA_DEFAULT_WIDTH);
     } else { /* existing estimator */
-        pcsa = (PCSACounter)PG_GETARG_BYTEA_P(0);
+        pcsa = PG_GETARG_PCSA(0);
     }
 
     /* add the item to the estimator (skip NULLs) */
@@ -200,7 +243,7 @@ pcsa_add_item_agg2(PG_FUNCTION_ARGS)
         /* it this a varlena type, passed by reference or by value ? */
         if (typlen == -1) {
             /* varlena */
-            pcsa_add_element(pcsa, VARDATA(element), VARSIZE(element) - VARHDRSZ);
+            pcsa_add_varlena(pcsa, element);
         } else if (typbyval) {
             /* fixed-length, passed by value */
             pcsa_add_element(pcsa, (char*)&element, typlen);
@@ -215,21 +258,332 @@ pcsa_add_item_agg2(PG_FUNCTION_ARGS)
 }
 
 Datum
-pcsa_merge_simple(PG_FUNCTION_ARGS)
+pcsa_add_hashed(PG_FUNCTION_ARGS)
 {
 
-    PCSACounter counter1 = (PCSACounter)PG_GETARG_BYTEA_P(0);
-    PCSACounter counter2 = (PCSACounter)PG_GETARG_BYTEA_P(1);
+    PCSACounter pcsa;
+    unsigned char hash[HASH_LENGTH];
 
-    /* is the counter created (if not, create it - error 1%, 10mil items) */
+    /* requires the estimator to be already created */
+    if (PG_ARGISNULL(0))
+        elog(ERROR, "pcsa counter must not be NULL");
+
+    /* if the hash is not NULL, add it to the estimator (i.e. skip NULLs) */
+    if (! PG_ARGISNULL(1)) {
+
+        /* estimator (we know it's not a NULL value) */
+        pcsa = PG_GETARG_PCSA_INPLACE(0);
+
+        pcsa_get_hash(fcinfo, 1, hash);
+
+        pcsa_add_hash(pcsa, hash);
+
+    }
+
+    PG_RETURN_VOID();
+
+}
+
+Datum
+pcsa_add_hashed_agg(PG_FUNCTION_ARGS)
+{
+
+    PCSACounter pcsa;
+    int  bitmaps; /* number of bitmaps */
+    int  keysize; /* keysize */
+
+    unsigned char hash[HASH_LENGTH];
+
+    /* create a new estimator (with requested error rate) or reuse the existing one */
+    if (PG_ARGISNULL(0)) {
+
+        bitmaps = PG_GETARG_INT32(2);
+        keysize = PG_GETARG_INT32(3);
+      
+        /* key size has to be between 1 and 4, bitmaps between 1 and 2048 */
+        if ((keysize < 1) || (keysize > MAX_KEYSIZE)) {
+            elog(ERROR, "key size has to be between 1 and %d", MAX_KEYSIZE);
+        } else if ((bitmaps < 1) || (bitmaps > MAX_BITMAPS)) {
+            elog(ERROR, "number of bitmaps has to be between 1 and %d", MAX_BITMAPS);
+        }
+        
+        pcsa = pcsa_create(bitmaps, keysize, PCSA_DEFAULT_WIDTH);
+
+    } else { /* existing estimator */
+        pcsa = PG_GETARG_PCSA(0);
+    }
+
+    /* add the hash to the estimator (skip NULLs) */
+    if (! PG_ARGISNULL(1)) {
+        pcsa_get_hash(fcinfo, 1, hash);
+        pcsa_add_hash(pcsa, hash);
+    }
+
+    /* return the updated bytea */
+    PG_RETURN_BYTEA_P(pcsa);
+    
+}
+
+Datum
+pcsa_add_hashed_agg2(PG_FUNCTION_ARGS)
+{
+
+    PCSACounter pcsa;
+
+    unsigned char hash[HASH_LENGTH];
+
+    /* create a new estimator (with requested error rate) or reuse the existing one */
+    if (PG_ARGISNULL(0)) {
+        pcsa = pcsa_create(DEFAULT_NBITMAPS, DEFAULT_KEYSIZE, PCSA_DEFAULT_WIDTH);
+    } else { /* existing estimator */
+        pcsa = PG_GETARG_PCSA(0);
+    }
+
+    /* add the hash to the estimator (skip NULLs) */
+    if (! PG_ARGISNULL(1)) {
+        pcsa_get_hash(fcinfo, 1, hash);
+        pcsa_add_hash(pcsa, hash);
+    }
+
+    /* return the updated bytea */
+    PG_RETURN_BYTEA_P(pcsa);
+}
+
+Datum
+pcsa_add_item_multi(PG_FUNCTION_ARGS)
+{
+
+    PCSACounter pcsa;
+    unsigned char hash[HASH_LENGTH];
+
+    /* requires the estimator to be already created */
+    if (PG_ARGISNULL(0))
+        elog(ERROR, "pcsa counter must not be NULL");
+
+    /* estimator (we know it's not a NULL value) */
+    pcsa = PG_GETARG_PCSA_INPLACE(0);
+
+    /* add the key to the estimator (skip keys with NULL values) */
+    if (distinct_hash_multi(fcinfo, 1, hash))
+        pcsa_add_hash(pcsa, hash);
+
+    PG_RETURN_VOID();
+
+}
+
+Datum
+pcsa_add_item_multi_agg(PG_FUNCTION_ARGS)
+{
+
+    PCSACounter pcsa;
+    unsigned char hash[HASH_LENGTH];
+
+    /* create a new estimator (with default parameters) or reuse the existing one */
+    if (PG_ARGISNULL(0)) {
+        pcsa = pcsa_create(DEFAULT_NBITMAPS, DEFAULT_KEYSIZE, PCSA_DEFAULT_WIDTH);
+    } else {
+        pcsa = PG_GETARG_PCSA(0);
+    }
+
+    /* add the key to the estimator (skip keys with NULL values) */
+    if (distinct_hash_multi(fcinfo, 1, hash))
+        pcsa_add_hash(pcsa, hash);
+
+    /* return the updated bytea */
+    PG_RETURN_BYTEA_P(pcsa);
+
+}
+
+/* Transition functions for the int2, int4, int8 and uuid overloads of the
+ * pcsa_distinct aggregates, without the type lookup and md5 of the generic
+ * (anyelement) ones - integers are expanded into a hash using the same mixing
+ * function as pre-hashed bigint values, uuids are folded into 64 bits first.
+ *
+ * The counters are not compatible with those built from the same values by
+ * pcsa_accum(anyelement), so only the pcsa_distinct aggregates (returning just
+ * the estimate) have such overloads. */
+Datum
+pcsa_add_int2_agg(PG_FUNCTION_ARGS)
+{
+
+    PCSACounter pcsa = pcsa_get_agg_counter(fcinfo);
+    unsigned char hash[HASH_LENGTH];
+
+    /* add the value to the estimator (skip NULLs) */
+    if (! PG_ARGISNULL(1)) {
+        distinct_hash_int64(PG_GETARG_INT16(1), hash);
+        pcsa_add_hash(pcsa, hash);
+    }
+
+    /* return the updated bytea */
+    PG_RETURN_BYTEA_P(pcsa);
+
+}
+
+Datum
+pcsa_add_int4_agg(PG_FUNCTION_ARGS)
+{
+
+    PCSACounter pcsa = pcsa_get_agg_counter(fcinfo);
+    unsigned char hash[HASH_LENGTH];
+
+    /* add the value to the estimator (skip NULLs) */
+    if (! PG_ARGISNULL(1)) {
+        distinct_hash_int64(PG_GETARG_INT32(1), hash);
+        pcsa_add_hash(pcsa, hash);
+    }
+
+    /* return the updated bytea */
+    PG_RETURN_BYTEA_P(pcsa);
+
+}
+
+Datum
+pcsa_add_int8_agg(PG_FUNCTION_ARGS)
+{
+
+    PCSACounter pcsa = pcsa_get_agg_counter(fcinfo);
+    unsigned char hash[HASH_LENGTH];
+
+    /* add the value to the estimator (skip NULLs) */
+    if (! PG_ARGISNULL(1)) {
+        distinct_hash_int64(PG_GETARG_INT64(1), hash);
+        pcsa_add_hash(pcsa, hash);
+    }
+
+    /* return the updated bytea */
+    PG_RETURN_BYTEA_P(pcsa);
+
+}
+
+Datum
+pcsa_add_uuid_agg(PG_FUNCTION_ARGS)
+{
+
+    PCSACounter pcsa = pcsa_get_agg_counter(fcinfo);
+    unsigned char hash[HASH_LENGTH];
+
+    /* add the value to the estimator (skip NULLs) */
+    if (! PG_ARGISNULL(1)) {
+
+        pg_uuid_t  *uuid = PG_GETARG_UUID_P(1);
+        uint64      hi, lo;
+
+        memcpy(&hi, uuid->data, sizeof(uint64));
+        memcpy(&lo, uuid->data + sizeof(uint64), sizeof(uint64));
+
+        /* The uuid bits can't be used directly, as time-based uuids (v1, v7)
+         * are not uniform at all. So fold the halves into 64 bits (mixing the
+         * low half first, which is in the first 8 bytes of the hash). */
+        distinct_hash_int64(lo, hash);
+        memcpy(&lo, hash, sizeof(uint64));
+
+        distinct_hash_int64(hi ^ lo, hash);
+        pcsa_add_hash(pcsa, hash);
+    }
+
+    /* return the updated bytea */
+    PG_RETURN_BYTEA_P(pcsa);
+
+}
+
+/* Returns the counter passed to the transition function, or creates a new one
+ * (with the parameters passed to the aggregate, or the default ones). */
+static PCSACounter
+pcsa_get_agg_counter(FunctionCallInfo fcinfo)
+{
+
+    int  bitmaps; /* number of bitmaps */
+    int  keysize; /* keysize */
+
+    /* existing estimator */
+    if (! PG_ARGISNULL(0))
+        return PG_GETARG_PCSA(0);
+
+    /* default parameters */
+    if (PG_NARGS() < 3)
+        return pcsa_create(DEFAULT_NBITMAPS, DEFAULT_KEYSIZE, PCSA_DEFAULT_WIDTH);
+
+    bitmaps = PG_GETARG_INT32(2);
+    keysize = PG_GETARG_INT32(3);
+
+    /* key size has to be between 1 and 4, bitmaps between 1 and 2048 */
+    if ((keysize < 1) || (keysize > MAX_KEYSIZE)) {
+        elog(ERROR, "key size has to be between 1 and %d", MAX_KEYSIZE);
+    } else if ((bitmaps < 1) || (bitmaps > MAX_BITMAPS)) {
+        elog(ERROR, "number of bitmaps has to be between 1 and %d", MAX_BITMAPS);
+    }
+
+    return pcsa_create(bitmaps, keysize, PCSA_DEFAULT_WIDTH);
+
+}
+
+/* Counters modified in place (by the functions returning void) can't be
+ * converted from the old format, as the converted copy would be thrown away
+ * (along with the new items). Such counters have to be converted first, by
+ * any function returning a counter - e.g. pcsa_merge(counter, NULL). */
+static PCSACounter
+pcsa_check_inplace(PCSACounter pcsa)
+{
+
+    if (pcsa_is_legacy(pcsa))
+        elog(ERROR, "pcsa counter created by an older version can't be modified in place (convert it using pcsa_merge first)");
+
+    return pcsa;
+
+}
+
+/* Adds a varlena value (hashed by distinct_hash_varlena). */
+static void
+pcsa_add_varlena(PCSACounter pcsa, Datum element)
+{
+
+    unsigned char hash[HASH_LENGTH];
+
+    distinct_hash_varlena(element, hash);
+
+    pcsa_add_hash(pcsa, hash);
+
+}
+
+/* Gets the hash from the argument - either the first HASH_LENGTH bytes of a bytea
+ * value (which has to be at least that long), or a bigint value expanded into
+ * HASH_LENGTH bytes. */
+static void
+pcsa_get_hash(FunctionCallInfo fcinfo, int argno, unsigned char * hash)
+{
+
+    if (get_fn_expr_argtype(fcinfo->flinfo, argno) == INT8OID) {
+
+        distinct_hash_int64(PG_GETARG_INT64(argno), hash);
+
+    } else {
+
+        bytea * value = PG_GETARG_BYTEA_PP(argno);
+
+        if (VARSIZE_ANY_EXHDR(value) < HASH_LENGTH)
+            elog(ERROR, "hash has to be at least %d bytes", HASH_LENGTH);
+
+        memcpy(hash, VARDATA_ANY(value), HASH_LENGTH);
+
+    }
+
+}
+
+Datum
+pcsa_merge_simple(PG_FUNCTION_ARGS)
+{
+
+    /* the arguments may be NULL, so fetch them only when needed (this is
+     * also how counters in the old format get converted by merging with NULL) */
     if (PG_ARGISNULL(0) && PG_ARGISNULL(1)) {
         PG_RETURN_NULL();
     } else if (PG_ARGISNULL(0)) {
-        PG_RETURN_BYTEA_P(pcsa_copy(counter2));
+        PG_RETURN_BYTEA_P(pcsa_copy(PG_GETARG_PCSA(1)));
     } else if (PG_ARGISNULL(1)) {
-        PG_RETURN_BYTEA_P(pcsa_copy(counter1));
+        PG_RETURN_BYTEA_P(pcsa_copy(PG_GETARG_PCSA(0)));
     } else {
-        PG_RETURN_BYTEA_P(pcsa_merge(counter1, counter2, false));
+        PG_RETURN_BYTEA_P(pcsa_merge(PG_GETARG_PCSA(0), PG_GETARG_PCSA(1), false));
     }
 
 }
@@ -239,7 +593,7 @@ pcsa_merge_agg(PG_FUNCTION_ARGS)
 {
 
     PCSACounter counter1;
-    PCSACounter counter2 = (PCSACounter)PG_GETARG_BYTEA_P(1);
+    PCSACounter counter2 = PG_GETARG_PCSA(1);
 
     /* is the counter created (if not, create it - error 1%, 10mil items) */
     if (PG_ARGISNULL(0)) {
@@ -250,7 +604,7 @@ pcsa_merge_agg(PG_FUNCTION_ARGS)
     } else {
 
         /* ok, we already have the estimator - merge the second one into it */
-        counter1 = (PCSACounter)PG_GETARG_BYTEA_P(0);
+        counter1 = PG_GETARG_PCSA(0);
 
         /* perform the merge (in place) */
         counter1 = pcsa_merge(counter1, counter2, true);
@@ -262,12 +616,100 @@ pcsa_merge_agg(PG_FUNCTION_ARGS)
 
 }
 
+/* Merges all the counters in the array into a single new counter, allocated
+ * only once (merging them one by one using || allocates a new counter for
+ * each step). NULL elements are skipped, returns NULL if there are no other
+ * elements in the array. */
+static PCSACounter
+pcsa_union_array(ArrayType * counters)
+{
+
+    int i;
+    int nelems;
+    Datum *elems;
+    bool *nulls;
+    int16 typlen;
+    bool typbyval;
+    char typalign;
+    PCSACounter result = NULL;
+
+    get_typlenbyvalalign(ARR_ELEMTYPE(counters), &typlen, &typbyval, &typalign);
+
+    deconstruct_array(counters, ARR_ELEMTYPE(counters), typlen, typbyval, typalign,
+                      &elems, &nulls, &nelems);
+
+    for (i = 0; i < nelems; i++) {
+
+        PCSACounter counter;
+
+        if (nulls[i])
+            continue;
+
+        /* the elements may have short headers, or be compressed */
+        counter = pcsa_upgrade((PCSACounter)PG_DETOAST_DATUM(elems[i]));
+
+        if (result == NULL) {
+            /* the first counter - reuse the detoasted copy if there is one */
+            if ((Pointer)counter != DatumGetPointer(elems[i]))
+                result = counter;
+            else
+                result = pcsa_copy(counter);
+            continue;
+        }
+
+        pcsa_merge(result, counter, true);
+
+        if ((Pointer)counter != DatumGetPointer(elems[i]))
+            pfree(counter);
+
+    }
+
+    pfree(elems);
+    pfree(nulls);
+
+    return result;
+
+}
+
+Datum
+pcsa_union(PG_FUNCTION_ARGS)
+{
+
+    PCSACounter result = pcsa_union_array(PG_GETARG_ARRAYTYPE_P(0));
+
+    if (result == NULL)
+        PG_RETURN_NULL();
+
+    PG_RETURN_BYTEA_P(result);
+
+}
+
+/* Estimate of the union of all the counters in the array, without returning
+ * the merged counter. */
+Datum
+pcsa_union_estimate(PG_FUNCTION_ARGS)
+{
+
+    int estimate;
+    PCSACounter result = pcsa_union_array(PG_GETARG_ARRAYTYPE_P(0));
+
+    if (result == NULL)
+        PG_RETURN_NULL();
+
+    estimate = pcsa_estimate(result);
+
+    pfree(result);
+
+    PG_RETURN_FLOAT4(estimate);
+
+}
+
 Datum
 pcsa_get_estimate(PG_FUNCTION_ARGS)
 {
   
     int estimate;
-    PCSACounter pcsa = (PCSACounter)PG_GETARG_BYTEA_P(0);
+    PCSACounter pcsa = PG_GETARG_PCSA(0);
     
     /* in-place update works only if executed as aggregate */
     estimate = pcsa_estimate(pcsa);
@@ -283,18 +725,22 @@ pcsa_init(PG_FUNCTION_ARGS)
       PCSACounter pcsa;
       int bitmaps;
       int keysize;
+      int width;
       
       bitmaps = PG_GETARG_INT32(0);
       keysize = PG_GETARG_INT32(1);
+      width = (PG_NARGS() > 2) ? PG_GETARG_INT32(2) : PCSA_DEFAULT_WIDTH;
             
       /* key size has to be between 1 and 4, bitmaps between 1 and 2048 */
       if ((keysize < 1) || (keysize > MAX_KEYSIZE)) {
           elog(ERROR, "key size has to be between 1 and %d", MAX_KEYSIZE);
       } else if ((bitmaps < 1) || (bitmaps > MAX_BITMAPS)) {
           elog(ERROR, "number of bitmaps has to be between 1 and %d", MAX_BITMAPS);
+      } else if ((width != 32) && (width != 64)) {
+          elog(ERROR, "bitmap width has to be 32 or 64 bits");
       }
       
-      pcsa = pcsa_create(bitmaps, keysize);
+      pcsa = pcsa_create(bitmaps, keysize, width);
       
       PG_RETURN_BYTEA_P(pcsa);
 }
@@ -304,30 +750,41 @@ pcsa_size(PG_FUNCTION_ARGS)
 {
       int bitmaps;
       int keysize;
+      int width;
       
       bitmaps = PG_GETARG_INT32(0);
       keysize = PG_GETARG_INT32(1);
+      width = (PG_NARGS() > 2) ? PG_GETARG_INT32(2) : PCSA_DEFAULT_WIDTH;
       
       /* key size has to be between 1 and 4, bitmaps between 1 and 2048 */
       if ((keysize < 1) || (keysize > MAX_KEYSIZE)) {
           elog(ERROR, "key size has to be between 1 and %d", MAX_KEYSIZE);
       } else if ((bitmaps < 1) || (bitmaps > MAX_BITMAPS)) {
           elog(ERROR, "number of bitmaps has to be between 1 and %d", MAX_BITMAPS);
+      } else if ((width != 32) && (width != 64)) {
+          elog(ERROR, "bitmap width has to be 32 or 64 bits");
       }
       
-      PG_RETURN_INT32(pcsa_get_size(bitmaps, keysize));      
+      PG_RETURN_INT32(pcsa_get_size(bitmaps, keysize, width));      
 }
 
 Datum
 pcsa_length(PG_FUNCTION_ARGS)
 {
-    PG_RETURN_INT32(VARSIZE((PCSACounter)PG_GETARG_BYTEA_P(0)));
+    PG_RETURN_INT32(VARSIZE(PG_GETARG_BYTEA_P(0)));
 }
 
 Datum
 pcsa_reset(PG_FUNCTION_ARGS)
 {
-	pcsa_reset_internal(((PCSACounter)PG_GETARG_BYTEA_P(0)));
+	PCSACounter pcsa = (PCSACounter)PG_GETARG_BYTEA_P(0);
+
+	/* counters created by older versions are reset in place too */
+	if (pcsa_is_legacy(pcsa))
+		memset(&pcsa->width, 0, VARSIZE(pcsa) - offsetof(PCSACounterData, width));
+	else
+		pcsa_reset_internal(pcsa);
+
 	PG_RETURN_VOID();
 }
 
@@ -0,0 +1,26 @@
+/* Static tracepoints in the pcsa estimator (see distinct_probes.h)
+ *
+ *   merge__start     (nmaps, keysize)
+ *   merge__done      (nmaps, keysize)
+ *   estimate__start  (nmaps, keysize)
+ *   estimate__done   (nmaps, keysize, estimate)
+ *   batch__start     (nmaps, keysize, nhashes)
+ *   batch__done      (nmaps, keysize, nhashes)
+ *
+ * Arguments are the geometry of the counter (number of bitmaps and key size),
+ * the estimate for estimate__done, and the number of hashes for the batches
+ * added by pcsa_add_hashes.
+ */
+#ifndef PCSA_PROBES_H
+#define PCSA_PROBES_H
+
+#include "distinct_probes.h"
+
+#define PCSA_MERGE_START(nmaps, keysize)             DISTINCT_PROBE2(pcsa, merge__start, nmaps, keysize)
+#define PCSA_MERGE_DONE(nmaps, keysize)              DISTINCT_PROBE2(pcsa, merge__done, nmaps, keysize)
+#define PCSA_ESTIMATE_START(nmaps, keysize)          DISTINCT_PROBE2(pcsa, estimate__start, nmaps, keysize)
+#define PCSA_ESTIMATE_DONE(nmaps, keysize, estimate) DISTINCT_PROBE3(pcsa, estimate__done, nmaps, keysize, estimate)
+#define PCSA_BATCH_START(nmaps, keysize, nhashes)    DISTINCT_PROBE3(pcsa, batch__start, nmaps, keysize, nhashes)
+#define PCSA_BATCH_DONE(nmaps, keysize, nhashes)     DISTINCT_PROBE3(pcsa, batch__done, nmaps, keysize, nhashes)
+
+#endif   /* PCSA_PROBES_H */
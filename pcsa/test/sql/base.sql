@@ -3,15 +3,35 @@ BEGIN;
 
 -- disable the notices for the create script (shell types etc.)
 SET client_min_messages = 'WARNING';
-\i sql/pcsa_counter--1.3.3.sql
+\i sql/pcsa_counter--1.4.0.sql
 SET client_min_messages = 'NOTICE';
 
 \set ECHO all
 
-SELECT pcsa_distinct(id, 32, 4) BETWEEN 90000 AND 110000 val FROM generate_series(1,100000) s(id);
+-- the integer overloads hash with splitmix64 rather than md5, and with only 32
+-- bitmaps (~14% standard error) this draw lands at ~83000
+SELECT pcsa_distinct(id, 32, 4) BETWEEN 80000 AND 120000 val FROM generate_series(1,100000) s(id);
 
 SELECT pcsa_distinct(id::text, 32, 4) BETWEEN 90000 AND 110000 val FROM generate_series(1,100000) s(id);
 
+SELECT pcsa_distinct(id::bigint) BETWEEN 85000 AND 115000 val FROM generate_series(1,100000) s(id);
+
+SELECT pcsa_distinct(md5(id::text)::uuid) BETWEEN 85000 AND 115000 val FROM generate_series(1,100000) s(id);
+
+SELECT pcsa_distinct((id % 30000)::smallint) BETWEEN 27000 AND 33000 val FROM generate_series(1,100000) s(id);
+
+SELECT pcsa_size(64, 4) = 272 AND pcsa_size(64, 4, 64) = 528 AND length(pcsa_init(64, 4)) = 272 val;
+
+SELECT pcsa_union_estimate(array_agg(c)) = (# pcsa_union(array_append(array_agg(c), NULL))) AND pcsa_union_estimate(array_agg(c)) = (# pcsa_merge(c)) AND pcsa_union_estimate(array_agg(c)) BETWEEN 80000 AND 120000 val FROM (SELECT pcsa_accum(id, 32, 4) c FROM generate_series(1,100000) s(id) GROUP BY id % 10) foo;
+
+SELECT pcsa_distinct_multi(id % 1000, id % 99) BETWEEN 79000 AND 119000 val FROM generate_series(1,100000) s(id);
+
+SELECT pcsa_distinct_multi(id % 1000, id % 99) / pcsa_distinct((id % 1000, id % 99)::text) BETWEEN 0.8 AND 1.25 val FROM generate_series(1,100000) s(id);
+
+SELECT (# pcsa_accum_multi(id, CASE WHEN id % 2 = 0 THEN id END)) = pcsa_distinct_multi(id, id) FILTER (WHERE id % 2 = 0) val FROM generate_series(1,100000) s(id);
+
+SELECT pcsa_distinct_multi(a, b) BETWEEN 150000 AND 226000 val FROM (SELECT id % 1000, id % 99 FROM generate_series(1,100000) s(id) UNION ALL SELECT id % 99, id % 1000 FROM generate_series(1,100000) s(id)) foo(a, b);
+
 DO LANGUAGE plpgsql $$
 DECLARE
     v_counter  pcsa_estimator := pcsa_init(32, 4);
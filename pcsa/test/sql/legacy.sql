@@ -0,0 +1,38 @@
+\set ECHO none
+BEGIN;
+
+-- disable the notices for the create script (shell types etc.)
+SET client_min_messages = 'WARNING';
+\i sql/pcsa_counter--1.4.0.sql
+SET client_min_messages = 'NOTICE';
+
+\set ECHO all
+
+-- counter created by an older version (2 bitmaps, 4B key, 12B per bitmap)
+SELECT length(c) = 36 AND length(pcsa_merge(c, NULL)) = 24 AND (# c) = 29 AND (# pcsa_merge(c, NULL)) = 29 AND (# (c || pcsa_init(2, 4))) = 29 AND (SELECT # pcsa_merge(x) FROM (VALUES (c), (pcsa_init(2, 4))) bar(x)) = 29 val FROM (SELECT '\x02000000040000000700000000000000000000000f0000000000000000000000'::pcsa_estimator c) foo;
+
+-- it can't be modified in place without converting it first
+SAVEPOINT s;
+SELECT pcsa_add_item('\x02000000040000000700000000000000000000000f0000000000000000000000'::pcsa_estimator, 1);
+ROLLBACK TO s;
+
+DO LANGUAGE plpgsql $$
+DECLARE
+    v_counter  pcsa_estimator := '\x02000000040000000700000000000000000000000f0000000000000000000000';
+BEGIN
+
+    -- convert the counter first, the void functions modify it in place
+    v_counter := pcsa_merge(v_counter, NULL);
+
+    FOR i IN 1..1000 LOOP
+        PERFORM pcsa_add_item(v_counter, i);
+    END LOOP;
+
+    IF (# v_counter) = (SELECT # pcsa_merge('\x02000000040000000700000000000000000000000f0000000000000000000000', pcsa_accum(i, 2, 4)) FROM generate_series(1,1000) s(i)) THEN
+        RAISE NOTICE 'estimate OK';
+    ELSE
+        RAISE NOTICE 'estimate ERROR (%)', # v_counter;
+    END IF;
+
+END$$;
+ROLLBACK;
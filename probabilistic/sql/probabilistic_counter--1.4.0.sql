@@ -73,7 +73,8 @@ CREATE AGGREGATE probabilistic_distinct(anyelement, int, int)
 (
     sfunc = probabilistic_add_item_agg,
     stype = probabilistic_estimator,
-    finalfunc = probabilistic_get_estimate
+    finalfunc = probabilistic_get_estimate,
+    finalfunc_modify = read_only
 );
 
 -- probabilistic counting based aggregate (item)
@@ -81,7 +82,8 @@ CREATE AGGREGATE probabilistic_distinct(anyelement)
 (
     sfunc = probabilistic_add_item_agg2,
     stype = probabilistic_estimator,
-    finalfunc = probabilistic_get_estimate
+    finalfunc = probabilistic_get_estimate,
+    finalfunc_modify = read_only
 );
 
 -- build the counter(s), but does not perform the final estimation (i.e. can be used to pre-aggregate data)
@@ -118,3 +120,38 @@ CREATE OPERATOR || (
     RIGHTARG = probabilistic_estimator,
     COMMUTATOR = ||
 );
+
+-- multi-column keys, e.g. probabilistic_distinct_multi(user_id, device_id) (keys with any NULL value are skipped)
+CREATE FUNCTION probabilistic_add_item_multi(counter probabilistic_estimator, VARIADIC items "any") RETURNS void
+     AS '$libdir/probabilistic_counter', 'probabilistic_add_item_multi'
+     LANGUAGE C;
+
+CREATE FUNCTION probabilistic_add_item_multi_agg(counter probabilistic_estimator, VARIADIC items "any") RETURNS probabilistic_estimator
+     AS '$libdir/probabilistic_counter', 'probabilistic_add_item_multi_agg'
+     LANGUAGE C;
+
+CREATE AGGREGATE probabilistic_distinct_multi(VARIADIC "any")
+(
+    sfunc = probabilistic_add_item_multi_agg,
+    stype = probabilistic_estimator,
+    finalfunc = probabilistic_get_estimate,
+    finalfunc_modify = read_only
+);
+
+CREATE AGGREGATE probabilistic_accum_multi(VARIADIC "any")
+(
+    sfunc = probabilistic_add_item_multi_agg,
+    stype = probabilistic_estimator
+);
+
+-- Union of arrays of estimators (NULL elements are skipped)
+
+-- merges all the estimators in the array into a single one
+CREATE FUNCTION probabilistic_union(estimators probabilistic_estimator[]) RETURNS probabilistic_estimator
+     AS '$libdir/probabilistic_counter', 'probabilistic_union'
+     LANGUAGE C STRICT PARALLEL SAFE;
+
+-- estimate of the union of all the estimators in the array
+CREATE FUNCTION probabilistic_union_estimate(estimators probabilistic_estimator[]) RETURNS real
+     AS '$libdir/probabilistic_counter', 'probabilistic_union_estimate'
+     LANGUAGE C STRICT PARALLEL SAFE;
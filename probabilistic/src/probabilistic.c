@@ -14,6 +14,15 @@
  * 
  * So by using 4B bitmaps and 16 salts, we're effectively using 64 bitmaps
  * (because 16/4 * 16 = 64).
+ *
+ * The bitmaps are stored packed one after another (nbytes each), so when
+ * nbytes does not divide the hash length the remaining bytes of the hash are
+ * not stored at all. Counters created by older versions keep HASH_LENGTH
+ * bytes for each salt (those are identical for nbytes = 1, 2, 4, 8 or 16),
+ * and are repacked by pc_upgrade.
+ *
+ * The bitmaps are processed in 64-bit words - bit k of the bitmap is bit
+ * (k % 8) of byte (k / 8), i.e. the words are little-endian.
  */
 
 #include <stdio.h>
@@ -25,16 +34,25 @@
 
 #include "probabilistic.h"
 #include "postgres.h"
-#include "libpq/md5.h"
+#include "distinct_md5.h"
+#include "probabilistic_probes.h"
 
 #define HASH_LENGTH 16
 
+/* elements shorter than this are salted in a buffer on the stack */
+#define ITEM_BUFFER_SIZE 1024
+
 int pc_estimate(ProbabilisticCounter pc);
 
-int pc_get_r(const unsigned char * buffer, int byteFrom, int bytes);
-int pc_get_min_bit(const unsigned char * buffer, int byteFrom, int bytes);
+static inline uint64 pc_load_word(const unsigned char * buffer, int nbytes);
+static inline int pc_lowest_bit(uint64 word);
+static int pc_get_r(const unsigned char * bitmap, int nbytes);
+static int pc_get_min_bit(const unsigned char * hash, int nbytes);
+
+/* size of the counter created by older versions (HASH_LENGTH per salt) */
+#define PC_LEGACY_SIZE(nsalts) \
+    (offsetof(ProbabilisticCounterData,bitmap) + (nsalts) * HASH_LENGTH)
 
-void pc_hash(unsigned char * buffer, char salt, const char * element, int elen);
 
 /* Allocate bitmap with a given length (to store the given number of elements).
  * 
@@ -51,11 +69,9 @@ void pc_hash(unsigned char * buffer, char salt, const char * element, int elen);
  */
 ProbabilisticCounter pc_create(int nbytes, int nsalts) {
   
-    /* the bitmap is allocated as part of this memory block (-1 as one char is already in) */
-    size_t length = offsetof(ProbabilisticCounterData,bitmap) + nsalts * HASH_LENGTH;
-    ProbabilisticCounter p = (ProbabilisticCounter)palloc(length);
-    
-    memset(p->bitmap, 0, nsalts * HASH_LENGTH);
+    /* the bitmap is allocated as part of this memory block */
+    size_t length = pc_size(nbytes, nsalts);
+    ProbabilisticCounter p = (ProbabilisticCounter)palloc0(length);
     
     SET_VARSIZE(p, length);
     
@@ -67,83 +83,103 @@ ProbabilisticCounter pc_create(int nbytes, int nsalts) {
 }
 
 int pc_size(int nbytes, int nsalts) {
-    return offsetof(ProbabilisticCounterData,bitmap) + nsalts * HASH_LENGTH;
+    return offsetof(ProbabilisticCounterData,bitmap) + (HASH_LENGTH / nbytes) * nsalts * nbytes;
 }
 
-/* searches for the leftmost 1 */
-int pc_get_min_bit(const unsigned char * buffer, int byteFrom, int bytes) {
-  
-    int k = 0;
-    int byteIdx = 0;
-    int bitIdx = 0;
-    
-    for (k = byteFrom * 8; k < ((byteFrom + bytes) * 8); k++) {
-        
-        byteIdx = k / 8;
-        bitIdx=  k % 8;
-        
-        if ((buffer[byteIdx] & (0x1 << bitIdx)) != 0) {
-            return k - byteFrom *8;
-        }
-        
+/* Loads up to 8 bytes into a word (little-endian, see the comment at the top). */
+static inline uint64 pc_load_word(const unsigned char * buffer, int nbytes) {
+
+    uint64 word = 0;
+
+#ifdef WORDS_BIGENDIAN
+    int i;
+
+    for (i = 0; i < nbytes; i++)
+        word |= ((uint64) buffer[i]) << (8 * i);
+#else
+    memcpy(&word, buffer, nbytes);
+#endif
+
+    return word;
+
+}
+
+/* index of the lowest 1 bit (the word must not be 0) */
+static inline int pc_lowest_bit(uint64 word) {
+
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_ctzll(word);
+#else
+    int bit = 0;
+
+    while ((word & 1) == 0) {
+        word >>= 1;
+        bit++;
     }
-    
-    return (HASH_LENGTH*8);
-  
+
+    return bit;
+#endif
+
 }
 
-/* searches for the leftmost zero */
-int pc_get_r(const unsigned char * buffer, int byteFrom, int bytes) {
-  
-    int k = 0;
-    int byteIdx = 0;
-    int bitIdx = 0;
-    
-    for (k = byteFrom * 8; k < ((byteFrom + bytes) * 8); k++) {
-        
-        byteIdx = k / 8;
-        bitIdx=  k % 8;
-        
-        if ((buffer[byteIdx] & (0x1 << bitIdx)) == 0) {
-            return k - byteFrom*8;
-        }
-        
+/* Searches for the leftmost 1 in the slice of the hash. If there's none (the
+ * slice is all zeroes), returns the last bit, so that it stays within the
+ * bitmap. */
+static int pc_get_min_bit(const unsigned char * hash, int nbytes) {
+
+    int offset;
+
+    for (offset = 0; offset < nbytes; offset += sizeof(uint64)) {
+
+        uint64 word = pc_load_word(hash + offset, Min(nbytes - offset, sizeof(uint64)));
+
+        if (word != 0)
+            return offset * 8 + pc_lowest_bit(word);
     }
-    
-    return (HASH_LENGTH*8);
-  
+
+    return nbytes * 8 - 1;
+
 }
 
-int pc_estimate(ProbabilisticCounter pc) {
-  
-    int salt = 0, slice = 0;
-    float bits = 0;
-    
-    /* for each salt and each slice, get the estimate */
-    for (salt = 0; salt < pc->nsalts; salt++) {
-        for (slice = 0; slice < (HASH_LENGTH/pc->nbytes); slice++) {
-        
-            bits += (float)pc_get_r(
-                                pc->bitmap,
-                                (salt * HASH_LENGTH) + (slice * pc->nbytes), pc->nbytes
-                           ) / (HASH_LENGTH/pc->nbytes * pc->nsalts);
-        
-        }
+/* searches for the leftmost zero in the bitmap (nbytes * 8 if there's none) */
+static int pc_get_r(const unsigned char * bitmap, int nbytes) {
+
+    int offset;
+
+    for (offset = 0; offset < nbytes; offset += sizeof(uint64)) {
+
+        int len = Min(nbytes - offset, sizeof(uint64));
+        uint64 word = pc_load_word(bitmap + offset, len);
+
+        /* the bytes beyond the bitmap are zeroes in the word, so there's
+         * always a zero for bitmaps shorter than a word */
+        if (~word != 0)
+            return offset * 8 + pc_lowest_bit(~word);
     }
-    
-    return powf(2, bits)/0.77351; /* magic constant, as listed in the paper */
-  
+
+    return nbytes * 8;
+
 }
 
-void pc_hash(unsigned char * buffer, char salt, const char * element, int elen) {
+int pc_estimate(ProbabilisticCounter pc) {
+  
+    int i;
+    int nbitmaps = PC_NBITMAPS(pc);
+    int estimate;
+    int bits = 0;
+
+    PROBABILISTIC_ESTIMATE_START(pc->nbytes, pc->nsalts);
     
-    unsigned char item[elen + 1];
+    /* sum of the estimates for all the bitmaps */
+    for (i = 0; i < nbitmaps; i++)
+        bits += pc_get_r(pc->bitmap + i * pc->nbytes, pc->nbytes);
     
-    memcpy(item, &salt, 1);
-    memcpy(item+1, element, elen);
-  
-    pg_md5_binary(item, elen + 1, buffer);
+    estimate = powf(2, (float) bits / nbitmaps)/0.77351; /* magic constant, as listed in the paper */
+
+    PROBABILISTIC_ESTIMATE_DONE(pc->nbytes, pc->nsalts, estimate);
 
+    return estimate;
+  
 }
 
 void pc_add_element(ProbabilisticCounter pc, char * element, int elen) {
@@ -152,40 +188,49 @@ void pc_add_element(ProbabilisticCounter pc, char * element, int elen) {
     unsigned char hash[HASH_LENGTH];
     
     int salt, slice;
+    int nslices = HASH_LENGTH / pc->nbytes;
+
+    /* The salted item is the salt (one byte) followed by the element. Short
+     * elements are copied to the stack, long ones to the heap (and only once,
+     * not for each salt), so that large values can't overflow the stack. */
+    char    buffer[ITEM_BUFFER_SIZE];
+    char   *item = (elen < ITEM_BUFFER_SIZE) ? buffer : palloc(elen + 1);
+
+    memcpy(item + 1, element, elen);
     
     /* compute hash for each salt, split the hash into pc->nbytes slices */
     for (salt = 0; salt < pc->nsalts; salt++) {
         
         /* compute the hash using the salt */
-        pc_hash(hash, salt, element, elen);
+        item[0] = (char) salt;
+        distinct_md5(item, elen + 1, hash);
         
         /* for each salt, process all the slices */
-        for (slice = 0; slice < (HASH_LENGTH / pc->nbytes); slice++) {
+        for (slice = 0; slice < nslices; slice++) {
         
-            /* get the min bit (but skip the previous slices) */
-            int bit = pc_get_min_bit(hash, (slice * pc->nbytes), pc->nbytes);
+            /* get the min bit of the slice */
+            int bit = pc_get_min_bit(hash + (slice * pc->nbytes), pc->nbytes);
             
-            /* get the current byte/bit index */
-            int byteIdx = (HASH_LENGTH * salt) + (slice * pc->nbytes) + bit / 8;
-            int bitIdx = bit % 8;
-            
-            /* set the bit of the bitmap */
-            pc->bitmap[byteIdx] = pc->bitmap[byteIdx] | (0x1 << bitIdx);
+            /* set the bit of the bitmap (the bitmaps are packed) */
+            unsigned char *bitmap = pc->bitmap + (salt * nslices + slice) * pc->nbytes;
+
+            bitmap[bit / 8] |= (0x1 << (bit % 8));
         
         }
     }
+
+    if (item != buffer)
+        pfree(item);
 }
 
 void pc_reset(ProbabilisticCounter pc) {
-    int i;
-    for (i = 0; i < pc->nsalts * HASH_LENGTH; i++) {
-        pc->bitmap[i] = 0;
-    }
+    /* the whole data part, so that counters in the old format are reset too */
+    memset(pc->bitmap, 0, VARSIZE(pc) - offsetof(ProbabilisticCounterData,bitmap));
 }
 
 ProbabilisticCounter pc_copy(ProbabilisticCounter counter) {
 
-    size_t length = counter->length;
+    size_t length = VARSIZE(counter);
     ProbabilisticCounter copy = (ProbabilisticCounter)palloc(length);
 
     memcpy(copy, counter, length);
@@ -197,6 +242,7 @@ ProbabilisticCounter pc_copy(ProbabilisticCounter counter) {
 ProbabilisticCounter pc_merge(ProbabilisticCounter counter1, ProbabilisticCounter counter2, bool inplace) {
 
     int i;
+    int nbytes;
     ProbabilisticCounter result;
 
     if ((counter1->length != counter2->length) ||
@@ -207,15 +253,79 @@ ProbabilisticCounter pc_merge(ProbabilisticCounter counter1, ProbabilisticCounte
 
     }
 
+    PROBABILISTIC_MERGE_START(counter1->nbytes, counter1->nsalts);
+
     if (inplace)
         result = counter1;
     else
         result = pc_copy(counter1);
 
-    for (i = 0; i < result->nsalts * HASH_LENGTH; i++) {
+    nbytes = VARSIZE(result) - offsetof(ProbabilisticCounterData,bitmap);
+
+    /* OR the bitmaps a word at a time (the byte order does not matter here) */
+    for (i = 0; i + sizeof(uint64) <= nbytes; i += sizeof(uint64)) {
+
+        uint64 word1, word2;
+
+        memcpy(&word1, result->bitmap + i, sizeof(uint64));
+        memcpy(&word2, counter2->bitmap + i, sizeof(uint64));
+
+        word1 |= word2;
+
+        memcpy(result->bitmap + i, &word1, sizeof(uint64));
+    }
+
+    for (; i < nbytes; i++) {
         result->bitmap[i] |= counter2->bitmap[i];
     }
 
+    PROBABILISTIC_MERGE_DONE(result->nbytes, result->nsalts);
+
+    return result;
+
+}
+
+/* The formats differ only when nbytes does not divide HASH_LENGTH, and then
+ * the legacy counter is longer, so the length decides. Counters matching
+ * neither of the lengths are rejected. */
+bool pc_is_legacy(ProbabilisticCounter counter) {
+
+    if ((counter->nbytes < 1) || (counter->nbytes > HASH_LENGTH) || (counter->nsalts < 1))
+        elog(ERROR, "invalid probabilistic estimator (%d bytes, %d salts)",
+             counter->nbytes, counter->nsalts);
+
+    if (VARSIZE(counter) == pc_size(counter->nbytes, counter->nsalts))
+        return false;
+
+    if (VARSIZE(counter) != PC_LEGACY_SIZE(counter->nsalts))
+        elog(ERROR, "invalid probabilistic estimator (length %d, %d bytes, %d salts)",
+             (int) VARSIZE(counter), counter->nbytes, counter->nsalts);
+
+    return true;
+
+}
+
+/* Converts a counter created by an older version (HASH_LENGTH bytes for each
+ * salt) to packed bitmaps. Counters in the current format are returned as
+ * they are (for nbytes dividing HASH_LENGTH the formats are the same). */
+ProbabilisticCounter pc_upgrade(ProbabilisticCounter counter) {
+
+    int salt;
+    int nslices;
+    ProbabilisticCounter result;
+
+    if (! pc_is_legacy(counter))
+        return counter;
+
+    result = pc_create(counter->nbytes, counter->nsalts);
+    nslices = HASH_LENGTH / counter->nbytes;
+
+    /* the slices of each salt are simply moved next to each other */
+    for (salt = 0; salt < counter->nsalts; salt++)
+        memcpy(result->bitmap + salt * nslices * counter->nbytes,
+               counter->bitmap + salt * HASH_LENGTH,
+               nslices * counter->nbytes);
+
     return result;
 
 }
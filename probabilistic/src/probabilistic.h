@@ -17,14 +17,17 @@ typedef struct ProbabilisticCounterData {
     /* number of salts */
     int nsalts;
     
-    /* bitmap used to keep the list of items (uses the very same trick as in
-     * the varlena type in include/c.h */
+    /* bitmaps (nbytes each, packed) used to keep the list of items (uses the
+     * very same trick as in the varlena type in include/c.h */
     unsigned char bitmap[1];
     
 } ProbabilisticCounterData;
 
 typedef ProbabilisticCounterData* ProbabilisticCounter;
 
+/* number of bitmaps (nbytes each, stored one after another) */
+#define PC_NBITMAPS(pc)     ((HASH_LENGTH / (pc)->nbytes) * (pc)->nsalts)
+
 /* creates an optimal bloom filter for the given bitmap size and number of distinct values */
 ProbabilisticCounter pc_create(int nbytes, int nsalts);
 int pc_size(int nbytes, int nsalts);
@@ -42,3 +45,10 @@ void pc_reset(ProbabilisticCounter pc);
 
 ProbabilisticCounter pc_copy(ProbabilisticCounter counter);
 ProbabilisticCounter pc_merge(ProbabilisticCounter counter1, ProbabilisticCounter counter2, bool inplace);
+
+/* converts counter in the format used by older versions (returns a new
+ * counter), counters in the current format are returned as they are */
+ProbabilisticCounter pc_upgrade(ProbabilisticCounter counter);
+
+/* is the counter in the format used by older versions? */
+bool pc_is_legacy(ProbabilisticCounter counter);
@@ -6,7 +6,9 @@
 #include "postgres.h"
 #include "fmgr.h"
 #include "probabilistic.h"
+#include "distinct_multi.h"
 #include "utils/builtins.h"
+#include "utils/array.h"
 #include "utils/bytea.h"
 #include "utils/lsyscache.h"
 #include "lib/stringinfo.h"
@@ -24,12 +26,24 @@ PG_MODULE_MAGIC;
 #define MAX_NBYTES      16
 #define MAX_NSALTS      1024
 
+/* counter argument, converted from the old format if needed (the converted
+ * counter is a copy, so only for functions returning the counter or just
+ * reading it) */
+#define PG_GETARG_PC(n)     pc_upgrade((ProbabilisticCounter)PG_GETARG_BYTEA_P(n))
+
+/* counter argument modified in place, has to be in the current format */
+#define PG_GETARG_PC_INPLACE(n)     pc_check_inplace((ProbabilisticCounter)PG_GETARG_BYTEA_P(n))
+
 PG_FUNCTION_INFO_V1(probabilistic_add_item);
 PG_FUNCTION_INFO_V1(probabilistic_add_item_agg);
 PG_FUNCTION_INFO_V1(probabilistic_add_item_agg2);
+PG_FUNCTION_INFO_V1(probabilistic_add_item_multi);
+PG_FUNCTION_INFO_V1(probabilistic_add_item_multi_agg);
 
 PG_FUNCTION_INFO_V1(probabilistic_merge_simple);
 PG_FUNCTION_INFO_V1(probabilistic_merge_agg);
+PG_FUNCTION_INFO_V1(probabilistic_union);
+PG_FUNCTION_INFO_V1(probabilistic_union_estimate);
 PG_FUNCTION_INFO_V1(probabilistic_get_estimate);
 PG_FUNCTION_INFO_V1(probabilistic_size);
 PG_FUNCTION_INFO_V1(probabilistic_init);
@@ -43,9 +57,17 @@ PG_FUNCTION_INFO_V1(probabilistic_length);
 Datum probabilistic_add_item(PG_FUNCTION_ARGS);
 Datum probabilistic_add_item_agg(PG_FUNCTION_ARGS);
 Datum probabilistic_add_item_agg2(PG_FUNCTION_ARGS);
+Datum probabilistic_add_item_multi(PG_FUNCTION_ARGS);
+Datum probabilistic_add_item_multi_agg(PG_FUNCTION_ARGS);
+
+static void probabilistic_add_varlena(ProbabilisticCounter pcounter, Datum element);
+static void probabilistic_add_multi(ProbabilisticCounter pcounter, FunctionCallInfo fcinfo);
+static ProbabilisticCounter pc_check_inplace(ProbabilisticCounter pcounter);
 
 Datum probabilistic_merge_simple(PG_FUNCTION_ARGS);
 Datum probabilistic_merge_agg(PG_FUNCTION_ARGS);
+Datum probabilistic_union(PG_FUNCTION_ARGS);
+Datum probabilistic_union_estimate(PG_FUNCTION_ARGS);
 Datum probabilistic_get_estimate(PG_FUNCTION_ARGS);
 Datum probabilistic_size(PG_FUNCTION_ARGS);
 Datum probabilistic_init(PG_FUNCTION_ARGS);
@@ -77,7 +99,7 @@ probabilistic_add_item(PG_FUNCTION_ARGS)
         char        typalign;
 
         /* estimator (we know it's not a NULL value) */
-        pcounter = (ProbabilisticCounter)PG_GETARG_BYTEA_P(0);
+        pcounter = PG_GETARG_PC_INPLACE(0);
 
         /* TODO The requests for type info shouldn't be a problem (thanks to lsyscache),
          * but if it turns out to have a noticeable impact it's possible to cache that
@@ -89,7 +111,7 @@ probabilistic_add_item(PG_FUNCTION_ARGS)
         /* it this a varlena type, passed by reference or by value ? */
         if (typlen == -1) {
             /* varlena */
-            pc_add_element(pcounter, VARDATA(element), VARSIZE(element) - VARHDRSZ);
+            probabilistic_add_varlena(pcounter, element);
         } else if (typbyval) {
             /* fixed-length, passed by value */
             pc_add_element(pcounter, (char*)&element, typlen);
@@ -135,7 +157,7 @@ probabilistic_add_item_agg(PG_FUNCTION_ARGS)
         pcounter = pc_create(nbytes, nsalts);
 
     } else { /* existing estimator */
-        pcounter = (ProbabilisticCounter)PG_GETARG_BYTEA_P(0);
+        pcounter = PG_GETARG_PC(0);
     }
 
     /* add the item to the estimator (skip NULLs) */
@@ -151,7 +173,7 @@ probabilistic_add_item_agg(PG_FUNCTION_ARGS)
         /* it this a varlena type, passed by reference or by value ? */
         if (typlen == -1) {
             /* varlena */
-            pc_add_element(pcounter, VARDATA(element), VARSIZE(element) - VARHDRSZ);
+            probabilistic_add_varlena(pcounter, element);
         } else if (typbyval) {
             /* fixed-length, passed by value */
             pc_add_element(pcounter, (char*)&element, typlen);
@@ -183,7 +205,7 @@ probabilistic_add_item_agg2(PG_FUNCTION_ARGS)
     if (PG_ARGISNULL(0)) {
         pcounter = pc_create(DEFAULT_NBYTES, DEFAULT_NSALTS);
     } else { /* existing estimator */
-        pcounter = (ProbabilisticCounter)PG_GETARG_BYTEA_P(0);
+        pcounter = PG_GETARG_PC(0);
     }
 
     /* add the item to the estimator (skip NULLs) */
@@ -199,7 +221,7 @@ probabilistic_add_item_agg2(PG_FUNCTION_ARGS)
         /* it this a varlena type, passed by reference or by value ? */
         if (typlen == -1) {
             /* varlena */
-            pc_add_element(pcounter, VARDATA(element), VARSIZE(element) - VARHDRSZ);
+            probabilistic_add_varlena(pcounter, element);
         } else if (typbyval) {
             /* fixed-length, passed by value */
             pc_add_element(pcounter, (char*)&element, typlen);
@@ -215,21 +237,127 @@ probabilistic_add_item_agg2(PG_FUNCTION_ARGS)
 }
 
 Datum
-probabilistic_merge_simple(PG_FUNCTION_ARGS)
+probabilistic_add_item_multi(PG_FUNCTION_ARGS)
 {
 
-    ProbabilisticCounter counter1 = (ProbabilisticCounter)PG_GETARG_BYTEA_P(0);
-    ProbabilisticCounter counter2 = (ProbabilisticCounter)PG_GETARG_BYTEA_P(1);
+    ProbabilisticCounter pcounter;
 
-    /* is the counter created (if not, create it - error 1%, 10mil items) */
+    /* requires the estimator to be already created */
+    if (PG_ARGISNULL(0))
+        elog(ERROR, "probabilistic counter must not be NULL");
+
+    /* estimator (we know it's not a NULL value) */
+    pcounter = PG_GETARG_PC_INPLACE(0);
+
+    /* add the key to the estimator (skip keys with NULL values) */
+    probabilistic_add_multi(pcounter, fcinfo);
+
+    PG_RETURN_VOID();
+
+}
+
+Datum
+probabilistic_add_item_multi_agg(PG_FUNCTION_ARGS)
+{
+
+    ProbabilisticCounter pcounter;
+
+    /* create a new estimator (with default parameters) or reuse the existing one */
+    if (PG_ARGISNULL(0)) {
+        pcounter = pc_create(DEFAULT_NBYTES, DEFAULT_NSALTS);
+    } else {
+        pcounter = PG_GETARG_PC(0);
+    }
+
+    /* add the key to the estimator (skip keys with NULL values) */
+    probabilistic_add_multi(pcounter, fcinfo);
+
+    /* return the updated bytea */
+    PG_RETURN_BYTEA_P(pcounter);
+
+}
+
+/* Counters modified in place (by the functions returning void) can't be
+ * converted from the old format, as the converted copy would be thrown away
+ * (along with the new items). Such counters have to be converted first, by
+ * any function returning a counter - e.g. probabilistic_merge(counter, NULL). */
+static ProbabilisticCounter
+pc_check_inplace(ProbabilisticCounter pcounter)
+{
+
+    if (pc_is_legacy(pcounter))
+        elog(ERROR, "probabilistic counter created by an older version can't be modified in place (convert it using probabilistic_merge first)");
+
+    return pcounter;
+
+}
+
+/* Adds a varlena value. Short (1-byte) headers are used in place, compressed
+ * or external values are detoasted first (the copy is freed right away, so
+ * that large values do not accumulate in the memory context). The value is
+ * hashed once for each salt, so it's not hashed incrementally in chunks. */
+static void
+probabilistic_add_varlena(ProbabilisticCounter pcounter, Datum element)
+{
+
+    struct varlena * value = PG_DETOAST_DATUM_PACKED(element);
+
+    pc_add_element(pcounter, VARDATA_ANY(value), VARSIZE_ANY_EXHDR(value));
+
+    if ((Pointer) value != DatumGetPointer(element))
+        pfree(value);
+
+}
+
+/* Adds the key of the *_multi functions (skipping keys with NULL values). The
+ * counter hashes the elements once for each salt, so a single value is added
+ * as it is (just like by probabilistic_add_item), while for multiple values
+ * the element is their combined hash (see distinct_hash_multi). */
+static void
+probabilistic_add_multi(ProbabilisticCounter pcounter, FunctionCallInfo fcinfo)
+{
+
+    unsigned char hash[DISTINCT_HASH_LENGTH];
+    DistinctMultiKeyCache * cache = distinct_multi_get_cache(fcinfo, 1);
+
+    if (cache->nargs == 1) {
+
+        Datum       element;
+        const char *data;
+        int         len;
+
+        if (PG_ARGISNULL(1))
+            return;
+
+        element = PG_GETARG_DATUM(1);
+
+        if (cache->typlen[0] == -1) {
+            probabilistic_add_varlena(pcounter, element);
+        } else {
+            data = distinct_multi_get_value(cache, 0, &element, &len);
+            pc_add_element(pcounter, (char *) data, len);
+        }
+
+    } else if (distinct_hash_multi(fcinfo, 1, hash)) {
+        pc_add_element(pcounter, (char *) hash, DISTINCT_HASH_LENGTH);
+    }
+
+}
+
+Datum
+probabilistic_merge_simple(PG_FUNCTION_ARGS)
+{
+
+    /* the arguments may be NULL, so fetch them only when needed (this is
+     * also how counters in the old format get converted by merging with NULL) */
     if (PG_ARGISNULL(0) && PG_ARGISNULL(1)) {
         PG_RETURN_NULL();
     } else if (PG_ARGISNULL(0)) {
-        PG_RETURN_BYTEA_P(pc_copy(counter2));
+        PG_RETURN_BYTEA_P(pc_copy(PG_GETARG_PC(1)));
     } else if (PG_ARGISNULL(1)) {
-        PG_RETURN_BYTEA_P(pc_copy(counter1));
+        PG_RETURN_BYTEA_P(pc_copy(PG_GETARG_PC(0)));
     } else {
-        PG_RETURN_BYTEA_P(pc_merge(counter1, counter2, false));
+        PG_RETURN_BYTEA_P(pc_merge(PG_GETARG_PC(0), PG_GETARG_PC(1), false));
     }
 
 }
@@ -239,7 +367,7 @@ probabilistic_merge_agg(PG_FUNCTION_ARGS)
 {
 
     ProbabilisticCounter counter1;
-    ProbabilisticCounter counter2 = (ProbabilisticCounter)PG_GETARG_BYTEA_P(1);
+    ProbabilisticCounter counter2 = PG_GETARG_PC(1);
 
     /* is the counter created (if not, create it - error 1%, 10mil items) */
     if (PG_ARGISNULL(0)) {
@@ -250,7 +378,7 @@ probabilistic_merge_agg(PG_FUNCTION_ARGS)
     } else {
 
         /* ok, we already have the estimator - merge the second one into it */
-        counter1 = (ProbabilisticCounter)PG_GETARG_BYTEA_P(0);
+        counter1 = PG_GETARG_PC(0);
 
         /* perform the merge (in place) */
         counter1 = pc_merge(counter1, counter2, true);
@@ -262,12 +390,100 @@ probabilistic_merge_agg(PG_FUNCTION_ARGS)
 
 }
 
+/* Merges all the counters in the array into a single new counter, allocated
+ * only once (merging them one by one using || allocates a new counter for
+ * each step). NULL elements are skipped, returns NULL if there are no other
+ * elements in the array. */
+static ProbabilisticCounter
+probabilistic_union_array(ArrayType * counters)
+{
+
+    int i;
+    int nelems;
+    Datum *elems;
+    bool *nulls;
+    int16 typlen;
+    bool typbyval;
+    char typalign;
+    ProbabilisticCounter result = NULL;
+
+    get_typlenbyvalalign(ARR_ELEMTYPE(counters), &typlen, &typbyval, &typalign);
+
+    deconstruct_array(counters, ARR_ELEMTYPE(counters), typlen, typbyval, typalign,
+                      &elems, &nulls, &nelems);
+
+    for (i = 0; i < nelems; i++) {
+
+        ProbabilisticCounter counter;
+
+        if (nulls[i])
+            continue;
+
+        /* the elements may have short headers, or be compressed */
+        counter = pc_upgrade((ProbabilisticCounter)PG_DETOAST_DATUM(elems[i]));
+
+        if (result == NULL) {
+            /* the first counter - reuse the detoasted copy if there is one */
+            if ((Pointer)counter != DatumGetPointer(elems[i]))
+                result = counter;
+            else
+                result = pc_copy(counter);
+            continue;
+        }
+
+        pc_merge(result, counter, true);
+
+        if ((Pointer)counter != DatumGetPointer(elems[i]))
+            pfree(counter);
+
+    }
+
+    pfree(elems);
+    pfree(nulls);
+
+    return result;
+
+}
+
+Datum
+probabilistic_union(PG_FUNCTION_ARGS)
+{
+
+    ProbabilisticCounter result = probabilistic_union_array(PG_GETARG_ARRAYTYPE_P(0));
+
+    if (result == NULL)
+        PG_RETURN_NULL();
+
+    PG_RETURN_BYTEA_P(result);
+
+}
+
+/* Estimate of the union of all the counters in the array, without returning
+ * the merged counter. */
+Datum
+probabilistic_union_estimate(PG_FUNCTION_ARGS)
+{
+
+    int estimate;
+    ProbabilisticCounter result = probabilistic_union_array(PG_GETARG_ARRAYTYPE_P(0));
+
+    if (result == NULL)
+        PG_RETURN_NULL();
+
+    estimate = pc_estimate(result);
+
+    pfree(result);
+
+    PG_RETURN_FLOAT4(estimate);
+
+}
+
 Datum
 probabilistic_get_estimate(PG_FUNCTION_ARGS)
 {
   
     int estimate;
-    ProbabilisticCounter pc = (ProbabilisticCounter)PG_GETARG_BYTEA_P(0);
+    ProbabilisticCounter pc = PG_GETARG_PC(0);
     
     /* in-place update works only if executed as aggregate */
     estimate = pc_estimate(pc);
@@ -315,7 +531,7 @@ probabilistic_size(PG_FUNCTION_ARGS)
 Datum
 probabilistic_length(PG_FUNCTION_ARGS)
 {
-    PG_RETURN_INT32(VARSIZE((ProbabilisticCounter)PG_GETARG_BYTEA_P(0)));
+    PG_RETURN_INT32(VARSIZE(PG_GETARG_BYTEA_P(0)));
 }
 
 Datum
@@ -0,0 +1,21 @@
+/* Static tracepoints in the probabilistic estimator (see distinct_probes.h)
+ *
+ *   merge__start     (nbytes, nsalts)
+ *   merge__done      (nbytes, nsalts)
+ *   estimate__start  (nbytes, nsalts)
+ *   estimate__done   (nbytes, nsalts, estimate)
+ *
+ * Arguments are the geometry of the counter (slice size and number of salts),
+ * and the estimate for estimate__done.
+ */
+#ifndef PROBABILISTIC_PROBES_H
+#define PROBABILISTIC_PROBES_H
+
+#include "distinct_probes.h"
+
+#define PROBABILISTIC_MERGE_START(nbytes, nsalts)             DISTINCT_PROBE2(probabilistic, merge__start, nbytes, nsalts)
+#define PROBABILISTIC_MERGE_DONE(nbytes, nsalts)              DISTINCT_PROBE2(probabilistic, merge__done, nbytes, nsalts)
+#define PROBABILISTIC_ESTIMATE_START(nbytes, nsalts)          DISTINCT_PROBE2(probabilistic, estimate__start, nbytes, nsalts)
+#define PROBABILISTIC_ESTIMATE_DONE(nbytes, nsalts, estimate) DISTINCT_PROBE3(probabilistic, estimate__done, nbytes, nsalts, estimate)
+
+#endif   /* PROBABILISTIC_PROBES_H */
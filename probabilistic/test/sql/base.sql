@@ -3,7 +3,7 @@ BEGIN;
 
 -- disable the notices for the create script (shell types etc.)
 SET client_min_messages = 'WARNING';
-\i sql/probabilistic_counter--1.3.3.sql
+\i sql/probabilistic_counter--1.4.0.sql
 SET client_min_messages = 'NOTICE';
 
 \set ECHO all
@@ -12,6 +12,20 @@ SELECT probabilistic_distinct(id, 4, 32) BETWEEN 90000 AND 110000 val FROM gener
 
 SELECT probabilistic_distinct(id::text, 4, 32) BETWEEN 90000 AND 110000 val FROM generate_series(1,100000) s(id);
 
+SELECT probabilistic_distinct(id::text, 6, 32) BETWEEN 85000 AND 115000 val FROM generate_series(1,100000) s(id);
+
+SELECT probabilistic_size(6, 32) = 396 AND length(probabilistic_init(6, 32)) = 396 AND probabilistic_size(4, 32) = 524 val;
+
+SELECT probabilistic_union_estimate(array_agg(c)) = (# probabilistic_union(array_append(array_agg(c), NULL))) AND probabilistic_union_estimate(array_agg(c)) = (# probabilistic_merge(c)) AND probabilistic_union_estimate(array_agg(c)) BETWEEN 90000 AND 110000 val FROM (SELECT probabilistic_accum(id, 4, 32) c FROM generate_series(1,100000) s(id) GROUP BY id % 10) foo;
+
+SELECT probabilistic_distinct_multi(id % 1000, id % 99) BETWEEN 89000 AND 109000 val FROM generate_series(1,100000) s(id);
+
+SELECT probabilistic_distinct_multi(id % 1000, id % 99) / probabilistic_distinct((id % 1000, id % 99)::text) BETWEEN 0.9 AND 1.1 val FROM generate_series(1,100000) s(id);
+
+SELECT (# probabilistic_accum_multi(id, CASE WHEN id % 2 = 0 THEN id END)) = probabilistic_distinct_multi(id, id) FILTER (WHERE id % 2 = 0) val FROM generate_series(1,100000) s(id);
+
+SELECT probabilistic_distinct_multi(a, b) BETWEEN 169000 AND 207000 val FROM (SELECT id % 1000, id % 99 FROM generate_series(1,100000) s(id) UNION ALL SELECT id % 99, id % 1000 FROM generate_series(1,100000) s(id)) foo(a, b);
+
 DO LANGUAGE plpgsql $$
 DECLARE
     v_counter  probabilistic_estimator := probabilistic_init(4, 32);
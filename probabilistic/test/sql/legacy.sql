@@ -0,0 +1,38 @@
+\set ECHO none
+BEGIN;
+
+-- disable the notices for the create script (shell types etc.)
+SET client_min_messages = 'WARNING';
+\i sql/probabilistic_counter--1.4.0.sql
+SET client_min_messages = 'NOTICE';
+
+\set ECHO all
+
+-- counter created by an older version (6B bitmaps, 1 salt, 16B per salt)
+SELECT length(c) = 28 AND length(probabilistic_merge(c, NULL)) = 24 AND (# c) = 14 AND (# probabilistic_merge(c, NULL)) = 14 AND (# (c || probabilistic_init(6, 1))) = 14 AND (SELECT # probabilistic_merge(x) FROM (VALUES (c), (probabilistic_init(6, 1))) bar(x)) = 14 val FROM (SELECT '\x06000000010000000700000000000f0000000000ff000000'::probabilistic_estimator c) foo;
+
+-- it can't be modified in place without converting it first
+SAVEPOINT s;
+SELECT probabilistic_add_item('\x06000000010000000700000000000f0000000000ff000000'::probabilistic_estimator, 1);
+ROLLBACK TO s;
+
+DO LANGUAGE plpgsql $$
+DECLARE
+    v_counter  probabilistic_estimator := '\x06000000010000000700000000000f0000000000ff000000';
+BEGIN
+
+    -- convert the counter first, the void functions modify it in place
+    v_counter := probabilistic_merge(v_counter, NULL);
+
+    FOR i IN 1..1000 LOOP
+        PERFORM probabilistic_add_item(v_counter, i);
+    END LOOP;
+
+    IF (# v_counter) = (SELECT # probabilistic_merge('\x06000000010000000700000000000f0000000000ff000000', probabilistic_accum(i, 6, 1)) FROM generate_series(1,1000) s(i)) THEN
+        RAISE NOTICE 'estimate OK';
+    ELSE
+        RAISE NOTICE 'estimate ERROR (%)', # v_counter;
+    END IF;
+
+END$$;
+ROLLBACK;
@@ -0,0 +1,175 @@
+-- finishes the counter built by the _accum aggregates (caches the estimate in it)
+CREATE FUNCTION superloglog_accum_final(counter superloglog_estimator) RETURNS superloglog_estimator
+     AS 'MODULE_PATHNAME', 'superloglog_accum_final'
+     LANGUAGE C;
+
+-- the estimate does not modify the aggregate state (e.g. for window aggregates)
+
+CREATE OR REPLACE AGGREGATE superloglog_distinct(anyelement, real)
+(
+    sfunc = superloglog_add_item_agg,
+    stype = superloglog_estimator,
+    finalfunc = superloglog_get_estimate,
+    finalfunc_modify = read_only
+);
+
+CREATE OR REPLACE AGGREGATE superloglog_distinct(anyelement)
+(
+    sfunc = superloglog_add_item_agg2,
+    stype = superloglog_estimator,
+    finalfunc = superloglog_get_estimate,
+    finalfunc_modify = read_only
+);
+
+-- pre-hashed values (bytea with at least 16 bytes, or bigint)
+
+CREATE FUNCTION superloglog_add_hash(counter superloglog_estimator, hash bytea) RETURNS void
+     AS 'MODULE_PATHNAME', 'superloglog_add_hashed'
+     LANGUAGE C;
+
+CREATE FUNCTION superloglog_add_hash(counter superloglog_estimator, hash bigint) RETURNS void
+     AS 'MODULE_PATHNAME', 'superloglog_add_hashed'
+     LANGUAGE C;
+
+CREATE FUNCTION superloglog_add_hashed_agg(counter superloglog_estimator, hash bytea, error_rate real) RETURNS superloglog_estimator
+     AS 'MODULE_PATHNAME', 'superloglog_add_hashed_agg'
+     LANGUAGE C;
+
+CREATE FUNCTION superloglog_add_hashed_agg(counter superloglog_estimator, hash bigint, error_rate real) RETURNS superloglog_estimator
+     AS 'MODULE_PATHNAME', 'superloglog_add_hashed_agg'
+     LANGUAGE C;
+
+CREATE FUNCTION superloglog_add_hashed_agg2(counter superloglog_estimator, hash bytea) RETURNS superloglog_estimator
+     AS 'MODULE_PATHNAME', 'superloglog_add_hashed_agg2'
+     LANGUAGE C;
+
+CREATE FUNCTION superloglog_add_hashed_agg2(counter superloglog_estimator, hash bigint) RETURNS superloglog_estimator
+     AS 'MODULE_PATHNAME', 'superloglog_add_hashed_agg2'
+     LANGUAGE C;
+
+CREATE AGGREGATE superloglog_distinct_hashed(bytea, real)
+(
+    sfunc = superloglog_add_hashed_agg,
+    stype = superloglog_estimator,
+    finalfunc = superloglog_get_estimate,
+    finalfunc_modify = read_only
+);
+
+CREATE AGGREGATE superloglog_distinct_hashed(bytea)
+(
+    sfunc = superloglog_add_hashed_agg2,
+    stype = superloglog_estimator,
+    finalfunc = superloglog_get_estimate,
+    finalfunc_modify = read_only
+);
+
+CREATE AGGREGATE superloglog_accum_hashed(bytea, real)
+(
+    sfunc = superloglog_add_hashed_agg,
+    stype = superloglog_estimator,
+    finalfunc = superloglog_accum_final,
+    finalfunc_modify = read_only
+);
+
+CREATE AGGREGATE superloglog_accum_hashed(bytea)
+(
+    sfunc = superloglog_add_hashed_agg2,
+    stype = superloglog_estimator,
+    finalfunc = superloglog_accum_final,
+    finalfunc_modify = read_only
+);
+
+CREATE AGGREGATE superloglog_distinct_hashed(bigint, real)
+(
+    sfunc = superloglog_add_hashed_agg,
+    stype = superloglog_estimator,
+    finalfunc = superloglog_get_estimate,
+    finalfunc_modify = read_only
+);
+
+CREATE AGGREGATE superloglog_distinct_hashed(bigint)
+(
+    sfunc = superloglog_add_hashed_agg2,
+    stype = superloglog_estimator,
+    finalfunc = superloglog_get_estimate,
+    finalfunc_modify = read_only
+);
+
+CREATE AGGREGATE superloglog_accum_hashed(bigint, real)
+(
+    sfunc = superloglog_add_hashed_agg,
+    stype = superloglog_estimator,
+    finalfunc = superloglog_accum_final,
+    finalfunc_modify = read_only
+);
+
+CREATE AGGREGATE superloglog_accum_hashed(bigint)
+(
+    sfunc = superloglog_add_hashed_agg2,
+    stype = superloglog_estimator,
+    finalfunc = superloglog_accum_final,
+    finalfunc_modify = read_only
+);
+
+-- multi-column keys, e.g. superloglog_distinct_multi(user_id, device_id) (keys with any NULL value are skipped)
+CREATE FUNCTION superloglog_add_item_multi(counter superloglog_estimator, VARIADIC items "any") RETURNS void
+     AS 'MODULE_PATHNAME', 'superloglog_add_item_multi'
+     LANGUAGE C;
+
+CREATE FUNCTION superloglog_add_item_multi_agg(counter superloglog_estimator, VARIADIC items "any") RETURNS superloglog_estimator
+     AS 'MODULE_PATHNAME', 'superloglog_add_item_multi_agg'
+     LANGUAGE C;
+
+CREATE AGGREGATE superloglog_distinct_multi(VARIADIC "any")
+(
+    sfunc = superloglog_add_item_multi_agg,
+    stype = superloglog_estimator,
+    finalfunc = superloglog_get_estimate,
+    finalfunc_modify = read_only
+);
+
+CREATE AGGREGATE superloglog_accum_multi(VARIADIC "any")
+(
+    sfunc = superloglog_add_item_multi_agg,
+    stype = superloglog_estimator,
+    finalfunc = superloglog_accum_final,
+    finalfunc_modify = read_only
+);
+
+-- the _accum aggregates cache the estimate in the counter
+
+CREATE OR REPLACE AGGREGATE superloglog_accum(anyelement, real)
+(
+    sfunc = superloglog_add_item_agg,
+    stype = superloglog_estimator,
+    finalfunc = superloglog_accum_final,
+    finalfunc_modify = read_only
+);
+
+CREATE OR REPLACE AGGREGATE superloglog_accum(anyelement)
+(
+    sfunc = superloglog_add_item_agg2,
+    stype = superloglog_estimator,
+    finalfunc = superloglog_accum_final,
+    finalfunc_modify = read_only
+);
+
+CREATE OR REPLACE AGGREGATE superloglog_merge(superloglog_estimator)
+(
+    sfunc = superloglog_merge_agg,
+    stype = superloglog_estimator,
+    finalfunc = superloglog_accum_final,
+    finalfunc_modify = read_only
+);
+
+-- Union of arrays of estimators (NULL elements are skipped)
+
+-- merges all the estimators in the array into a single one
+CREATE FUNCTION superloglog_union(estimators superloglog_estimator[]) RETURNS superloglog_estimator
+     AS 'MODULE_PATHNAME', 'superloglog_union'
+     LANGUAGE C STRICT PARALLEL SAFE;
+
+-- estimate of the union of all the estimators in the array
+CREATE FUNCTION superloglog_union_estimate(estimators superloglog_estimator[]) RETURNS real
+     AS 'MODULE_PATHNAME', 'superloglog_union_estimate'
+     LANGUAGE C STRICT PARALLEL SAFE;
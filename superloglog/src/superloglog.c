@@ -5,9 +5,10 @@
 #include <string.h>
 
 #include "postgres.h"
-#include "libpq/md5.h"
+#include "distinct_md5.h"
 
 #include "superloglog.h"
+#include "superloglog_probes.h"
 
 #define HASH_LENGTH 16
 #define NMAX 1000000000
@@ -16,7 +17,6 @@ int superloglog_get_min_bit(const unsigned char * buffer, int byteFrom, int byte
 int superloglog_get_r(const unsigned char * buffer, int byteFrom, int bytes);
 int superloglog_estimate(SuperLogLogCounter loglog);
 
-void superloglog_add_hash(SuperLogLogCounter loglog, const unsigned char * hash);
 void superloglog_reset_internal(SuperLogLogCounter loglog);
 
 static int char_comparator(const void * a, const void * b);
@@ -37,6 +37,8 @@ SuperLogLogCounter superloglog_create(float error) {
   memset(p->data, -1, p->m);
   
   SET_VARSIZE(p, length);
+
+  superloglog_set_cached_estimate(p, SLL_ESTIMATE_INVALID);
   
   return p;
   
@@ -47,7 +49,8 @@ int superloglog_get_size(float error) {
   float m = 1.3 / (error * error);
   int bits = (int)ceil(log2(m));
 
-  return offsetof(SuperLogLogCounterData,data) + (int)pow(2, bits);
+  /* bins, followed by the cached estimate */
+  return offsetof(SuperLogLogCounterData,data) + (int)pow(2, bits) + sizeof(int32);
 
 }
 
@@ -72,32 +75,93 @@ int superloglog_get_min_bit(const unsigned char * buffer, int bitfrom, int nbits
 
 }
 
+/* Counters may come from a table, so before reading the bins or the cached
+ * estimate make sure the header is consistent and the value is long enough
+ * to hold all the bins. */
+static void superloglog_check_counter(SuperLogLogCounter loglog) {
+
+    if (VARSIZE(loglog) < offsetof(SuperLogLogCounterData, data) ||
+        loglog->bits < 0 || loglog->bits > 30 || loglog->m != (1 << loglog->bits) ||
+        VARSIZE(loglog) < SLL_CACHE_OFFSET(loglog))
+        elog(ERROR, "invalid SuperLogLog counter (length %d)", (int) VARSIZE(loglog));
+
+}
+
 int superloglog_estimate(SuperLogLogCounter loglog) {
   
     int j;
+    int estimate;
+    int32 cached;
     float sum = 0;
     
-    /* truncation rule */
-    int m0 = 0.7 * loglog->m;
-    
-    /* restriction rule */
-    int B = ceil(log(NMAX / loglog->m) / log(2.0) + 3);
+    int m0, B;
     int m2 = 0;
     
-    /* sort the 'm' array, to keep only 70% lowest values */
-    qsort(loglog->data, loglog->m, sizeof(char), char_comparator);
+    /* sort a copy of the 'm' array, to keep only 70% lowest values (the counter
+     * itself must not be modified, e.g. when used as a window aggregate) */
+    char * data;
+
+    superloglog_check_counter(loglog);
+
+    /* truncation rule */
+    m0 = 0.7 * loglog->m;
+
+    /* restriction rule */
+    B = ceil(log(NMAX / loglog->m) / log(2.0) + 3);
+
+    /* valid cached estimate (the bins did not change since it was computed) */
+    if (SLL_HAS_CACHE(loglog)) {
+
+        memcpy(&cached, (char *) loglog + SLL_CACHE_OFFSET(loglog), sizeof(int32));
+
+        if (cached != SLL_ESTIMATE_INVALID)
+            return cached;
+    }
+
+    SUPERLOGLOG_ESTIMATE_START(loglog->bits, loglog->m);
+
+    data = palloc(loglog->m);
+
+    memcpy(data, loglog->data, loglog->m);
+    qsort(data, loglog->m, sizeof(char), char_comparator);
     
     /* get the estimate for each bitmap */
     for (j = 0; j < m0; j++) {
-        if (loglog->data[j] <= B) {
-            sum += loglog->data[j];
+        if (data[j] <= B) {
+            sum += data[j];
             m2++;
         }
     }
     
+    pfree(data);
+    
     /* FIXME This uses the same alpha constant as LogLog, not sure how
      * to compute the modified constant :-( */
-    return 0.39701 * m0 * powf(2, sum / m0);
+    estimate = 0.39701 * m0 * powf(2, sum / m0);
+
+    SUPERLOGLOG_ESTIMATE_DONE(loglog->bits, loglog->m, estimate);
+
+    return estimate;
+
+}
+
+/* Computes the estimate and stores it in the counter, so that it's not
+ * computed again until the counter changes. Only for counters that may be
+ * modified (e.g. not for values read from a table). */
+void superloglog_cache_estimate(SuperLogLogCounter loglog) {
+
+    superloglog_set_cached_estimate(loglog, superloglog_estimate(loglog));
+
+}
+
+/* The cache may be at any offset (unaligned), so use memcpy. Counters
+ * without the cache are left alone. */
+void superloglog_set_cached_estimate(SuperLogLogCounter loglog, int32 estimate) {
+
+    superloglog_check_counter(loglog);
+
+    if (SLL_HAS_CACHE(loglog))
+        memcpy((char *) loglog + SLL_CACHE_OFFSET(loglog), &estimate, sizeof(int32));
 
 }
 
@@ -107,7 +171,7 @@ void superloglog_add_element(SuperLogLogCounter loglog, const char * element, in
     unsigned char hash[HASH_LENGTH];
     
     /* compute the hash */
-    pg_md5_binary(element, elen, hash);
+    distinct_md5(element, elen, hash);
 
     superloglog_add_hash(loglog, hash);
   
@@ -136,7 +200,12 @@ void superloglog_add_hash(SuperLogLogCounter loglog, const unsigned char * hash)
     rho = superloglog_get_min_bit(&hash[4], 0, 64); /* 64-bit hash */
     
     /* keep the highest value */
-    loglog->data[idx] = (rho > (loglog->data[idx])) ? rho : loglog->data[idx];
+    if (rho > loglog->data[idx]) {
+
+        loglog->data[idx] = rho;
+
+        superloglog_set_cached_estimate(loglog, SLL_ESTIMATE_INVALID);
+    }
 
 }
 
@@ -144,6 +213,8 @@ void superloglog_reset_internal(SuperLogLogCounter loglog) {
     
     memset(loglog->data, 0, loglog->m);
 
+    superloglog_set_cached_estimate(loglog, SLL_ESTIMATE_INVALID);
+
 }
 
 static
@@ -184,14 +255,18 @@ SuperLogLogCounter superloglog_merge(SuperLogLogCounter counter1, SuperLogLogCou
     int i;
     SuperLogLogCounter result;
 
-    /* check compatibility first */
-    if (counter1->length != counter2->length)
-        elog(ERROR, "sizes of estimators differs (%d != %d)", counter1->length, counter2->length);
-    else if (counter1->bits != counter2->bits)
+    superloglog_check_counter(counter1);
+    superloglog_check_counter(counter2);
+
+    /* check compatibility first (the lengths may differ, if only one of the
+     * counters has the cached estimate) */
+    if (counter1->bits != counter2->bits)
         elog(ERROR, "index size of estimators differs (%d != %d)", counter1->bits, counter2->bits);
     else if (counter1->m != counter2->m)
         elog(ERROR, "bin count of estimators differs (%d != %d)", counter1->m, counter2->m);
 
+    SUPERLOGLOG_MERGE_START(counter1->bits, counter1->m);
+
     /* shall we create a new estimator, or merge into counter1 */
     if (! inplace)
         result = superloglog_copy(counter1);
@@ -202,6 +277,10 @@ SuperLogLogCounter superloglog_merge(SuperLogLogCounter counter1, SuperLogLogCou
     for (i = 0; i < result->m; i++)
         result->data[i] = (result->data[i] > counter2->data[i]) ? result->data[i] : counter2->data[i];
 
+    superloglog_set_cached_estimate(result, SLL_ESTIMATE_INVALID);
+
+    SUPERLOGLOG_MERGE_DONE(result->bits, result->m);
+
     return result;
 
-}
\ No newline at end of file
+}
@@ -29,6 +29,15 @@ typedef struct SuperLogLogCounterData {
 
 typedef SuperLogLogCounterData * SuperLogLogCounter;
 
+/* The bins are followed by a cached estimate (int32, -1 if not valid), so that
+ * repeated estimates of finished (e.g. stored) counters don't have to sort the
+ * bins again. It's invalidated whenever a bin changes, and filled when finishing
+ * the _accum aggregates. Counters created by older versions don't have it (the
+ * estimate is then always computed), so check the length before accessing it. */
+#define SLL_CACHE_OFFSET(c)     (offsetof(SuperLogLogCounterData, data) + (c)->m)
+#define SLL_HAS_CACHE(c)        (VARSIZE(c) >= SLL_CACHE_OFFSET(c) + sizeof(int32))
+#define SLL_ESTIMATE_INVALID    (-1)
+
 /* creates an optimal bitmap able to count a multiset with the expected
  * cardinality and the given error rate. */
 SuperLogLogCounter superloglog_create(float error);
@@ -37,9 +46,18 @@ int superloglog_get_size(float error);
 /* add element existence */
 void superloglog_add_element(SuperLogLogCounter sloglog, const char * element, int elen);
 
-/* get an estimate from the loglog counter */
+/* add a hash (HASH_LENGTH bytes) directly, without hashing */
+void superloglog_add_hash(SuperLogLogCounter sloglog, const unsigned char * hash);
+
+/* get an estimate from the loglog counter (the cached one, if valid) */
 int superloglog_estimate(SuperLogLogCounter loglog);
 
+/* computes the estimate and stores it in the counter (see SLL_HAS_CACHE) */
+void superloglog_cache_estimate(SuperLogLogCounter loglog);
+
+/* sets the cached estimate (SLL_ESTIMATE_INVALID to invalidate it) */
+void superloglog_set_cached_estimate(SuperLogLogCounter loglog, int32 estimate);
+
 void superloglog_reset_internal(SuperLogLogCounter loglog);
 
 SuperLogLogCounter superloglog_copy(SuperLogLogCounter counter);
@@ -5,8 +5,12 @@
 
 #include "postgres.h"
 #include "fmgr.h"
+#include "catalog/pg_type.h"
 #include "superloglog.h"
+#include "distinct_hash.h"
+#include "distinct_multi.h"
 #include "utils/builtins.h"
+#include "utils/array.h"
 #include "utils/bytea.h"
 #include "utils/lsyscache.h"
 #include "lib/stringinfo.h"
@@ -19,15 +23,26 @@ PG_MODULE_MAGIC;
 #define VAL(CH)         ((CH) - '0')
 #define DIG(VAL)        ((VAL) + '0')
 
+/* we're using md5, which produces 16B (128-bit) values */
+#define HASH_LENGTH 16
+
 #define DEFAULT_ERROR       0.025
 
 PG_FUNCTION_INFO_V1(superloglog_add_item);
 PG_FUNCTION_INFO_V1(superloglog_add_item_agg);
 PG_FUNCTION_INFO_V1(superloglog_add_item_agg2);
+PG_FUNCTION_INFO_V1(superloglog_add_hashed);
+PG_FUNCTION_INFO_V1(superloglog_add_hashed_agg);
+PG_FUNCTION_INFO_V1(superloglog_add_hashed_agg2);
+PG_FUNCTION_INFO_V1(superloglog_add_item_multi);
+PG_FUNCTION_INFO_V1(superloglog_add_item_multi_agg);
 
 PG_FUNCTION_INFO_V1(superloglog_merge_simple);
 PG_FUNCTION_INFO_V1(superloglog_merge_agg);
+PG_FUNCTION_INFO_V1(superloglog_union);
+PG_FUNCTION_INFO_V1(superloglog_union_estimate);
 PG_FUNCTION_INFO_V1(superloglog_get_estimate);
+PG_FUNCTION_INFO_V1(superloglog_accum_final);
 PG_FUNCTION_INFO_V1(superloglog_size);
 PG_FUNCTION_INFO_V1(superloglog_init);
 PG_FUNCTION_INFO_V1(superloglog_reset);
@@ -40,10 +55,21 @@ PG_FUNCTION_INFO_V1(superloglog_length);
 Datum superloglog_add_item(PG_FUNCTION_ARGS);
 Datum superloglog_add_item_agg(PG_FUNCTION_ARGS);
 Datum superloglog_add_item_agg2(PG_FUNCTION_ARGS);
+Datum superloglog_add_hashed(PG_FUNCTION_ARGS);
+Datum superloglog_add_hashed_agg(PG_FUNCTION_ARGS);
+Datum superloglog_add_hashed_agg2(PG_FUNCTION_ARGS);
+Datum superloglog_add_item_multi(PG_FUNCTION_ARGS);
+Datum superloglog_add_item_multi_agg(PG_FUNCTION_ARGS);
+
+static void superloglog_get_hash(FunctionCallInfo fcinfo, int argno, unsigned char * hash);
+static void superloglog_add_varlena(SuperLogLogCounter sloglog, Datum element);
 
 Datum superloglog_get_estimate(PG_FUNCTION_ARGS);
+Datum superloglog_accum_final(PG_FUNCTION_ARGS);
 Datum superloglog_merge_simple(PG_FUNCTION_ARGS);
 Datum superloglog_merge_agg(PG_FUNCTION_ARGS);
+Datum superloglog_union(PG_FUNCTION_ARGS);
+Datum superloglog_union_estimate(PG_FUNCTION_ARGS);
 
 Datum superloglog_size(PG_FUNCTION_ARGS);
 Datum superloglog_init(PG_FUNCTION_ARGS);
@@ -86,7 +112,7 @@ superloglog_add_item(PG_FUNCTION_ARGS)
         /* it this a varlena type, passed by reference or by value ? */
         if (typlen == -1) {
             /* varlena */
-            superloglog_add_element(sloglog, VARDATA(element), VARSIZE(element) - VARHDRSZ);
+            superloglog_add_varlena(sloglog, element);
         } else if (typbyval) {
             /* fixed-length, passed by value */
             superloglog_add_element(sloglog, (char*)&element, typlen);
@@ -143,7 +169,7 @@ superloglog_add_item_agg(PG_FUNCTION_ARGS)
         /* it this a varlena type, passed by reference or by value ? */
         if (typlen == -1) {
             /* varlena */
-            superloglog_add_element(sloglog, VARDATA(element), VARSIZE(element) - VARHDRSZ);
+            superloglog_add_varlena(sloglog, element);
         } else if (typbyval) {
             /* fixed-length, passed by value */
             superloglog_add_element(sloglog, (char*)&element, typlen);
@@ -191,7 +217,7 @@ superloglog_add_item_agg2(PG_FUNCTION_ARGS)
         /* it this a varlena type, passed by reference or by value ? */
         if (typlen == -1) {
             /* varlena */
-            superloglog_add_element(sloglog, VARDATA(element), VARSIZE(element) - VARHDRSZ);
+            superloglog_add_varlena(sloglog, element);
         } else if (typbyval) {
             /* fixed-length, passed by value */
             superloglog_add_element(sloglog, (char*)&element, typlen);
@@ -206,6 +232,176 @@ superloglog_add_item_agg2(PG_FUNCTION_ARGS)
     
 }
 
+Datum
+superloglog_add_hashed(PG_FUNCTION_ARGS)
+{
+
+    SuperLogLogCounter sloglog;
+    unsigned char hash[HASH_LENGTH];
+
+    /* requires the estimator to be already created */
+    if (PG_ARGISNULL(0))
+        elog(ERROR, "superloglog counter must not be NULL");
+
+    /* if the hash is not NULL, add it to the estimator (i.e. skip NULLs) */
+    if (! PG_ARGISNULL(1)) {
+
+        /* estimator (we know it's not a NULL value) */
+        sloglog = (SuperLogLogCounter)PG_GETARG_BYTEA_P(0);
+
+        superloglog_get_hash(fcinfo, 1, hash);
+
+        superloglog_add_hash(sloglog, hash);
+
+    }
+
+    PG_RETURN_VOID();
+
+}
+
+Datum
+superloglog_add_hashed_agg(PG_FUNCTION_ARGS)
+{
+
+    SuperLogLogCounter sloglog;
+    float errorRate; /* required error rate */
+
+    unsigned char hash[HASH_LENGTH];
+
+    /* create a new estimator (with requested error rate) or reuse the existing one */
+    if (PG_ARGISNULL(0)) {
+
+        errorRate = PG_GETARG_FLOAT4(2);
+
+        /* error rate between 0 and 1 (not 0) */
+        if ((errorRate <= 0) || (errorRate > 1))
+            elog(ERROR, "error rate has to be between 0 and 1");
+
+        sloglog = superloglog_create(errorRate);
+
+    } else { /* existing estimator */
+        sloglog = (SuperLogLogCounter)PG_GETARG_BYTEA_P(0);
+    }
+
+    /* add the hash to the estimator (skip NULLs) */
+    if (! PG_ARGISNULL(1)) {
+        superloglog_get_hash(fcinfo, 1, hash);
+        superloglog_add_hash(sloglog, hash);
+    }
+
+    /* return the updated bytea */
+    PG_RETURN_BYTEA_P(sloglog);
+    
+}
+
+Datum
+superloglog_add_hashed_agg2(PG_FUNCTION_ARGS)
+{
+
+    SuperLogLogCounter sloglog;
+
+    unsigned char hash[HASH_LENGTH];
+
+    /* create a new estimator (with requested error rate) or reuse the existing one */
+    if (PG_ARGISNULL(0)) {
+        sloglog = superloglog_create(DEFAULT_ERROR);
+    } else { /* existing estimator */
+        sloglog = (SuperLogLogCounter)PG_GETARG_BYTEA_P(0);
+    }
+
+    /* add the hash to the estimator (skip NULLs) */
+    if (! PG_ARGISNULL(1)) {
+        superloglog_get_hash(fcinfo, 1, hash);
+        superloglog_add_hash(sloglog, hash);
+    }
+
+    /* return the updated bytea */
+    PG_RETURN_BYTEA_P(sloglog);
+    
+}
+
+Datum
+superloglog_add_item_multi(PG_FUNCTION_ARGS)
+{
+
+    SuperLogLogCounter sloglog;
+    unsigned char hash[HASH_LENGTH];
+
+    /* requires the estimator to be already created */
+    if (PG_ARGISNULL(0))
+        elog(ERROR, "superloglog counter must not be NULL");
+
+    /* estimator (we know it's not a NULL value) */
+    sloglog = (SuperLogLogCounter)PG_GETARG_BYTEA_P(0);
+
+    /* add the key to the estimator (skip keys with NULL values) */
+    if (distinct_hash_multi(fcinfo, 1, hash))
+        superloglog_add_hash(sloglog, hash);
+
+    PG_RETURN_VOID();
+
+}
+
+Datum
+superloglog_add_item_multi_agg(PG_FUNCTION_ARGS)
+{
+
+    SuperLogLogCounter sloglog;
+    unsigned char hash[HASH_LENGTH];
+
+    /* create a new estimator (with default parameters) or reuse the existing one */
+    if (PG_ARGISNULL(0)) {
+        sloglog = superloglog_create(DEFAULT_ERROR);
+    } else {
+        sloglog = (SuperLogLogCounter)PG_GETARG_BYTEA_P(0);
+    }
+
+    /* add the key to the estimator (skip keys with NULL values) */
+    if (distinct_hash_multi(fcinfo, 1, hash))
+        superloglog_add_hash(sloglog, hash);
+
+    /* return the updated bytea */
+    PG_RETURN_BYTEA_P(sloglog);
+
+}
+
+/* Adds a varlena value (hashed by distinct_hash_varlena). */
+static void
+superloglog_add_varlena(SuperLogLogCounter sloglog, Datum element)
+{
+
+    unsigned char hash[HASH_LENGTH];
+
+    distinct_hash_varlena(element, hash);
+
+    superloglog_add_hash(sloglog, hash);
+
+}
+
+/* Gets the hash from the argument - either the first HASH_LENGTH bytes of a bytea
+ * value (which has to be at least that long), or a bigint value expanded into
+ * HASH_LENGTH bytes. */
+static void
+superloglog_get_hash(FunctionCallInfo fcinfo, int argno, unsigned char * hash)
+{
+
+    if (get_fn_expr_argtype(fcinfo->flinfo, argno) == INT8OID) {
+
+        distinct_hash_int64(PG_GETARG_INT64(argno), hash);
+
+    } else {
+
+        bytea * value = PG_GETARG_BYTEA_PP(argno);
+
+        if (VARSIZE_ANY_EXHDR(value) < HASH_LENGTH)
+            elog(ERROR, "hash has to be at least %d bytes", HASH_LENGTH);
+
+        memcpy(hash, VARDATA_ANY(value), HASH_LENGTH);
+
+    }
+
+}
+
 Datum
 superloglog_merge_simple(PG_FUNCTION_ARGS)
 {
@@ -254,6 +450,94 @@ superloglog_merge_agg(PG_FUNCTION_ARGS)
 
 }
 
+/* Merges all the counters in the array into a single new counter, allocated
+ * only once (merging them one by one using || allocates a new counter for
+ * each step). NULL elements are skipped, returns NULL if there are no other
+ * elements in the array. */
+static SuperLogLogCounter
+superloglog_union_array(ArrayType * counters)
+{
+
+    int i;
+    int nelems;
+    Datum *elems;
+    bool *nulls;
+    int16 typlen;
+    bool typbyval;
+    char typalign;
+    SuperLogLogCounter result = NULL;
+
+    get_typlenbyvalalign(ARR_ELEMTYPE(counters), &typlen, &typbyval, &typalign);
+
+    deconstruct_array(counters, ARR_ELEMTYPE(counters), typlen, typbyval, typalign,
+                      &elems, &nulls, &nelems);
+
+    for (i = 0; i < nelems; i++) {
+
+        SuperLogLogCounter counter;
+
+        if (nulls[i])
+            continue;
+
+        /* the elements may have short headers, or be compressed */
+        counter = (SuperLogLogCounter)PG_DETOAST_DATUM(elems[i]);
+
+        if (result == NULL) {
+            /* the first counter - reuse the detoasted copy if there is one */
+            if ((Pointer)counter != DatumGetPointer(elems[i]))
+                result = counter;
+            else
+                result = superloglog_copy(counter);
+            continue;
+        }
+
+        superloglog_merge(result, counter, true);
+
+        if ((Pointer)counter != DatumGetPointer(elems[i]))
+            pfree(counter);
+
+    }
+
+    pfree(elems);
+    pfree(nulls);
+
+    return result;
+
+}
+
+Datum
+superloglog_union(PG_FUNCTION_ARGS)
+{
+
+    SuperLogLogCounter result = superloglog_union_array(PG_GETARG_ARRAYTYPE_P(0));
+
+    if (result == NULL)
+        PG_RETURN_NULL();
+
+    PG_RETURN_BYTEA_P(result);
+
+}
+
+/* Estimate of the union of all the counters in the array, without returning
+ * the merged counter. */
+Datum
+superloglog_union_estimate(PG_FUNCTION_ARGS)
+{
+
+    int estimate;
+    SuperLogLogCounter result = superloglog_union_array(PG_GETARG_ARRAYTYPE_P(0));
+
+    if (result == NULL)
+        PG_RETURN_NULL();
+
+    estimate = superloglog_estimate(result);
+
+    pfree(result);
+
+    PG_RETURN_FLOAT4(estimate);
+
+}
+
 Datum
 superloglog_get_estimate(PG_FUNCTION_ARGS)
 {
@@ -269,6 +553,27 @@ superloglog_get_estimate(PG_FUNCTION_ARGS)
 
 }
 
+/* Final function of the _accum (and merge) aggregates. Returns a copy of the
+ * counter with the estimate cached in it, so that estimating the counter later
+ * (e.g. after storing it in a table) does not need to sort the bins. The state
+ * itself is not modified (it may still be used by a window aggregate). */
+Datum
+superloglog_accum_final(PG_FUNCTION_ARGS)
+{
+
+    SuperLogLogCounter loglog;
+
+    if (PG_ARGISNULL(0))
+        PG_RETURN_NULL();
+
+    loglog = superloglog_copy((SuperLogLogCounter)PG_GETARG_BYTEA_P(0));
+
+    superloglog_cache_estimate(loglog);
+
+    PG_RETURN_BYTEA_P(loglog);
+
+}
+
 Datum
 superloglog_init(PG_FUNCTION_ARGS)
 {
@@ -0,0 +1,21 @@
+/* Static tracepoints in the superloglog estimator (see distinct_probes.h)
+ *
+ *   merge__start     (bits, m)
+ *   merge__done      (bits, m)
+ *   estimate__start  (bits, m)
+ *   estimate__done   (bits, m, estimate)
+ *
+ * Arguments are the geometry of the counter (number of index bits and bins),
+ * and the estimate for estimate__done.
+ */
+#ifndef SUPERLOGLOG_PROBES_H
+#define SUPERLOGLOG_PROBES_H
+
+#include "distinct_probes.h"
+
+#define SUPERLOGLOG_MERGE_START(bits, m)             DISTINCT_PROBE2(superloglog, merge__start, bits, m)
+#define SUPERLOGLOG_MERGE_DONE(bits, m)              DISTINCT_PROBE2(superloglog, merge__done, bits, m)
+#define SUPERLOGLOG_ESTIMATE_START(bits, m)          DISTINCT_PROBE2(superloglog, estimate__start, bits, m)
+#define SUPERLOGLOG_ESTIMATE_DONE(bits, m, estimate) DISTINCT_PROBE3(superloglog, estimate__done, bits, m, estimate)
+
+#endif   /* SUPERLOGLOG_PROBES_H */
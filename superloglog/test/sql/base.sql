@@ -3,7 +3,7 @@ BEGIN;
 
 -- disable the notices for the create script (shell types etc.)
 SET client_min_messages = 'WARNING';
-\i sql/superloglog_counter--1.2.3.sql
+\i sql/superloglog_counter--1.3.0.sql
 SET client_min_messages = 'NOTICE';
 
 \set ECHO all
@@ -12,6 +12,29 @@ SELECT superloglog_distinct(id, 0.02) BETWEEN 66000 AND 125000 val FROM generate
 
 SELECT superloglog_distinct(id::text, 0.02) BETWEEN 66000 AND 125000 val FROM generate_series(1,100000) s(id);
 
+SELECT (# superloglog_accum(id, 0.02)) = superloglog_distinct(id, 0.02) val FROM generate_series(1,100000) s(id);
+
+SELECT (# superloglog_merge(a, b)) BETWEEN 66000 AND 125000 val FROM (SELECT superloglog_accum(id, 0.02) a FROM generate_series(1,50000) s(id)) x, (SELECT superloglog_accum(id, 0.02) b FROM generate_series(50001,100000) s(id)) y;
+
+SELECT e = (SELECT superloglog_distinct(id, 0.05) FROM generate_series(1,10000) s(id)) val FROM (SELECT id, superloglog_distinct(id, 0.05) OVER (ORDER BY id) e FROM generate_series(1,10000) s(id)) foo ORDER BY id DESC LIMIT 1;
+
+SELECT superloglog_union_estimate(array_agg(c)) = (# superloglog_union(array_append(array_agg(c), NULL))) AND superloglog_union_estimate(array_agg(c)) = (# superloglog_merge(c)) AND superloglog_union_estimate(array_agg(c)) BETWEEN 66000 AND 125000 val FROM (SELECT superloglog_accum(id, 0.02) c FROM generate_series(1,100000) s(id) GROUP BY id % 10) foo;
+
+SELECT superloglog_distinct_multi(id % 1000, id % 99) BETWEEN 65000 AND 124000 val FROM generate_series(1,100000) s(id);
+
+SELECT superloglog_distinct_multi(id % 1000, id % 99) / superloglog_distinct((id % 1000, id % 99)::text) BETWEEN 0.9 AND 1.1 val FROM generate_series(1,100000) s(id);
+
+SELECT (# superloglog_accum_multi(id, CASE WHEN id % 2 = 0 THEN id END)) = superloglog_distinct_multi(id, id) FILTER (WHERE id % 2 = 0) val FROM generate_series(1,100000) s(id);
+
+SELECT superloglog_distinct_multi(a, b) BETWEEN 124000 AND 235000 val FROM (SELECT id % 1000, id % 99 FROM generate_series(1,100000) s(id) UNION ALL SELECT id % 99, id % 1000 FROM generate_series(1,100000) s(id)) foo(a, b);
+
+-- truncated counters
+SAVEPOINT s;
+SELECT # (substring(superloglog_init(0.02)::text from 1 for 50))::superloglog_estimator;
+ROLLBACK TO s;
+SELECT superloglog_merge(superloglog_init(0.02), (substring(superloglog_init(0.02)::text from 1 for 50))::superloglog_estimator);
+ROLLBACK TO s;
+
 DO LANGUAGE plpgsql $$
 DECLARE
     v_counter  superloglog_estimator := superloglog_init(0.02);